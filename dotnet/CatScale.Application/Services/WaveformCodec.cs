@@ -0,0 +1,95 @@
+namespace CatScale.Application.Services;
+
+public record WaveformSample(double Offset, double Raw, double Weight);
+
+/// <summary>
+/// Binary format of the waveforms recorded by the scale (see measurement.c).
+/// Every sample consists of three zigzag-encoded LEB128 varints, each one the difference to the previous sample:
+/// time since start of the event in ms, raw value of the load cell, filtered weight in 0.1 g.
+/// </summary>
+public static class WaveformCodec
+{
+    private const double TimeResolution = 0.001;
+    private const double WeightResolution = 0.1;
+
+    public static WaveformSample[] Decode(byte[] data, int sampleCount)
+    {
+        if (sampleCount < 0)
+            throw new FormatException("Invalid sample count");
+
+        var samples = new WaveformSample[sampleCount];
+        int position = 0;
+        long time = 0, raw = 0, weight = 0;
+
+        for (int i = 0; i < sampleCount; i++)
+        {
+            time += ReadSignedVarint(data, ref position);
+            raw += ReadSignedVarint(data, ref position);
+            weight += ReadSignedVarint(data, ref position);
+
+            samples[i] = new WaveformSample(time * TimeResolution, raw, weight * WeightResolution);
+        }
+
+        if (position != data.Length)
+            throw new FormatException("Unexpected data after the last sample");
+
+        return samples;
+    }
+
+    public static byte[] Encode(IEnumerable<WaveformSample> samples)
+    {
+        var stream = new MemoryStream();
+        long time = 0, raw = 0, weight = 0;
+
+        foreach (var sample in samples)
+        {
+            long sampleTime = (long)Math.Round(sample.Offset / TimeResolution);
+            long sampleRaw = (long)Math.Round(sample.Raw);
+            long sampleWeight = (long)Math.Round(sample.Weight / WeightResolution);
+
+            WriteSignedVarint(stream, sampleTime - time);
+            WriteSignedVarint(stream, sampleRaw - raw);
+            WriteSignedVarint(stream, sampleWeight - weight);
+
+            time = sampleTime;
+            raw = sampleRaw;
+            weight = sampleWeight;
+        }
+
+        return stream.ToArray();
+    }
+
+    private static long ReadSignedVarint(byte[] data, ref int position)
+    {
+        ulong value = 0;
+
+        for (int shift = 0; ; shift += 7)
+        {
+            if (position >= data.Length)
+                throw new FormatException("Unexpected end of data");
+            if (shift > 63)
+                throw new FormatException("Varint too long");
+
+            byte b = data[position++];
+            value |= (ulong)(b & 0x7f) << shift;
+
+            if ((b & 0x80) == 0)
+                break;
+        }
+
+        return (long)(value >> 1) ^ -(long)(value & 1);
+    }
+
+    private static void WriteSignedVarint(Stream stream, long value)
+    {
+        ulong zigzag = (ulong)((value << 1) ^ (value >> 63));
+
+        while (zigzag >= 0x80)
+        {
+            stream.WriteByte((byte)(zigzag | 0x80));
+            zigzag >>= 7;
+        }
+
+        stream.WriteByte((byte)zigzag);
+    }
+}
\ No newline at end of file
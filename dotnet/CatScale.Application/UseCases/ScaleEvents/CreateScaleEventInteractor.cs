@@ -9,7 +9,8 @@ public interface ICreateScaleEventInteractor
 {
     record Request(int ToiletId, DateTimeOffset StartTime, DateTimeOffset EndTime,
         (DateTimeOffset Timestamp, double Length, double Value)[] StablePhases,
-        double Temperature, double Humidity, double Pressure
+        double Temperature, double Humidity, double Pressure,
+        (int SampleCount, bool Truncated, byte[] Data)? Waveform = null
     );
 
     record Response(ScaleEvent ScaleEvent);
@@ -19,6 +20,8 @@ public interface ICreateScaleEventInteractor
 
 public class CreateScaleEventInteractor : ICreateScaleEventInteractor
 {
+    private const int MaxWaveformSampleCount = 15 * 60 * 20; // 20 Hz for the maximum event length
+
     private readonly IUnitOfWork _unitOfWork;
     private readonly IClassificationService _classificationService;
     private readonly INotificationService _notificationService;
@@ -61,6 +64,7 @@ public class CreateScaleEventInteractor : ICreateScaleEventInteractor
     {
         CheckIfDatesArePlausible(request);
         CheckIfStablePhasesAreOutOfBounds(request);
+        CheckIfWaveformIsValid(request);
         await CheckIfToiletExists(request);
         await CheckIfEventAlreadyExists(request);
     }
@@ -87,6 +91,24 @@ public class CreateScaleEventInteractor : ICreateScaleEventInteractor
             throw new DomainValidationException("Stable phase outside of event bounds");
     }
 
+    private static void CheckIfWaveformIsValid(ICreateScaleEventInteractor.Request request)
+    {
+        if (request.Waveform is not { } waveform)
+            return;
+
+        if (waveform.SampleCount > MaxWaveformSampleCount)
+            throw new DomainValidationException("Waveform too long");
+
+        try
+        {
+            WaveformCodec.Decode(waveform.Data, waveform.SampleCount);
+        }
+        catch (FormatException e)
+        {
+            throw new DomainValidationException($"Invalid waveform: {e.Message}");
+        }
+    }
+
     private async Task CheckIfToiletExists(ICreateScaleEventInteractor.Request request)
     {
         var toiletExists = await _unitOfWork.GetRepository<Toilet>()
@@ -130,6 +152,14 @@ public class CreateScaleEventInteractor : ICreateScaleEventInteractor
             Temperature = request.Temperature,
             Humidity = request.Humidity,
             Pressure = request.Pressure,
+            Waveform = request.Waveform is { } waveform
+                ? new ScaleEventWaveform
+                {
+                    SampleCount = waveform.SampleCount,
+                    Truncated = waveform.Truncated,
+                    Data = waveform.Data,
+                }
+                : null,
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+using CatScale.Application.Exceptions;
+using CatScale.Application.Repository;
+using CatScale.Application.Services;
+using CatScale.Domain.Model;
+
+namespace CatScale.Application.UseCases.ScaleEvents;
+
+public interface IGetScaleEventWaveformInteractor
+{
+    Task<Response> GetScaleEventWaveform(Request request);
+
+    record Request(int ScaleEventId);
+
+    record Response(ScaleEventWaveform Waveform, WaveformSample[] Samples);
+}
+
+public class GetScaleEventWaveformInteractor : IGetScaleEventWaveformInteractor
+{
+    private readonly IUnitOfWork _unitOfWork;
+
+    public GetScaleEventWaveformInteractor(IUnitOfWork unitOfWork)
+    {
+        _unitOfWork = unitOfWork;
+    }
+
+    public async Task<IGetScaleEventWaveformInteractor.Response> GetScaleEventWaveform(
+        IGetScaleEventWaveformInteractor.Request request)
+    {
+        var waveform = await _unitOfWork
+            .GetRepository<ScaleEventWaveform>()
+            .Query(filter: w => w.ScaleEventId == request.ScaleEventId)
+            .SingleOrDefaultAsync();
+
+        if (waveform is null)
+            throw new EntityNotFoundException("Waveform not found");
+
+        var samples = WaveformCodec.Decode(waveform.Data, waveform.SampleCount);
+
+        return new IGetScaleEventWaveformInteractor.Response(waveform, samples);
+    }
+}
\ No newline at end of file
@@ -15,6 +15,8 @@ public class ScaleEvent
     public Measurement? Measurement { get; set; }
     
     public Cleaning? Cleaning { get; set; }
+
+    public ScaleEventWaveform? Waveform { get; set; }
     
     public double Temperature { get; set; }
     
@@ -0,0 +1,20 @@
+namespace CatScale.Domain.Model;
+
+public class ScaleEventWaveform
+{
+    public int Id { get; set; }
+
+    public int ScaleEventId { get; set; }
+
+    public int SampleCount { get; set; }
+
+    /// <summary>
+    /// The device ran out of buffer space before the end of the event.
+    /// </summary>
+    public bool Truncated { get; set; }
+
+    /// <summary>
+    /// Delta encoded raw and filtered weight samples, see WaveformCodec.
+    /// </summary>
+    public byte[] Data { get; set; } = null!;
+}
\ No newline at end of file
@@ -13,5 +13,6 @@ public record NewScaleEvent
     [Required] NewStablePhase[]? StablePhases,
     [Required] double? Temperature,
     [Required] double? Humidity,
-    [Required] double? Pressure
+    [Required] double? Pressure,
+    NewScaleEventWaveform? Waveform = null
 );
\ No newline at end of file
@@ -0,0 +1,18 @@
+using System.ComponentModel.DataAnnotations;
+using JetBrains.Annotations;
+
+namespace CatScale.Service.Model.ScaleEvent;
+
+[PublicAPI]
+public record NewScaleEventWaveform
+(
+    // Note: Types are nullable to allow for proper model binding validation.
+    [Required] int? SampleCount,
+    [Required] bool? Truncated,
+    [Required] string? Data // base64, see WaveformCodec
+)
+{
+    // Keep the (potentially large) data out of the logs.
+    public override string ToString()
+        => $"{nameof(NewScaleEventWaveform)} {{ SampleCount = {SampleCount}, Truncated = {Truncated}, Data = {Data?.Length} chars }}";
+}
\ No newline at end of file
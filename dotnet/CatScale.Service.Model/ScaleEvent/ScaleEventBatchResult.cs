@@ -0,0 +1,11 @@
+using JetBrains.Annotations;
+
+namespace CatScale.Service.Model.ScaleEvent;
+
+[PublicAPI]
+public record ScaleEventBatchResult
+(
+    int Index,
+    int? Id,
+    string? Error
+);
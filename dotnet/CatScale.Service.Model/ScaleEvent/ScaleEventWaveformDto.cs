@@ -0,0 +1,11 @@
+using JetBrains.Annotations;
+
+namespace CatScale.Service.Model.ScaleEvent;
+
+[PublicAPI]
+public record ScaleEventWaveformDto
+(
+    int ScaleEventId,
+    bool Truncated,
+    WaveformSampleDto[] Samples
+);
\ No newline at end of file
@@ -0,0 +1,11 @@
+using JetBrains.Annotations;
+
+namespace CatScale.Service.Model.ScaleEvent;
+
+[PublicAPI]
+public record WaveformSampleDto
+(
+    double Offset, // seconds since start of the event
+    double Raw,
+    double Weight
+);
\ No newline at end of file
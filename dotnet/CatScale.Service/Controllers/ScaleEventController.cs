@@ -1,3 +1,4 @@
+using CatScale.Application.Exceptions;
 using CatScale.Application.Services;
 using CatScale.Application.UseCases.ScaleEvents;
 using CatScale.Service.DbModel;
@@ -12,6 +13,8 @@ namespace CatScale.Service.Controllers;
 [Route("api/[controller]/[action]")]
 public class ScaleEventController : ControllerBase
 {
+    private const int MaxBatchSize = 50;
+
     private readonly ILogger<ScaleEventController> _logger;
     private readonly INotificationService _notificationService;
 
@@ -66,26 +69,59 @@ public class ScaleEventController : ControllerBase
         if (!ModelState.IsValid)
             return BadRequest(ModelState);
 
-        int toiletId = newScaleEvent.ToiletId!.Value;
-        DateTimeOffset startTime = newScaleEvent.StartTime!.Value;
-        DateTimeOffset endTime = newScaleEvent.EndTime!.Value;
-        double temperature = newScaleEvent.Temperature!.Value;
-        double humidity = newScaleEvent.Humidity!.Value;
-        double pressure = newScaleEvent.Pressure!.Value;
-
-        (DateTimeOffset, double, double)[] stablePhases = newScaleEvent.StablePhases!
-            .Select(sp => (sp.Timestamp!.Value, sp.Length!.Value, sp.Value!.Value))
-            .ToArray();
-
-        var response = await interactor.CreateScaleEvent(
-            new ICreateScaleEventInteractor.Request(toiletId, startTime, endTime,
-                stablePhases, temperature, humidity, pressure));
+        var response = await interactor.CreateScaleEvent(MapNewScaleEvent(newScaleEvent));
 
         return CreatedAtAction(nameof(GetOne),
             new { id = response.ScaleEvent.Id },
             DataMapper.MapScaleEvent(response.ScaleEvent));
     }
 
+    [Authorize(AuthenticationSchemes = "ApiKey, Identity.Application")]
+    [HttpPost]
+    public async Task<ActionResult<ScaleEventBatchResult[]>> CreateBatch(
+        [FromServices] ICreateScaleEventInteractor interactor,
+        [FromBody] NewScaleEvent[] newScaleEvents)
+    {
+        _logger.LogInformation("Creating {Count} scale events", newScaleEvents.Length);
+
+        if (!ModelState.IsValid)
+            return BadRequest(ModelState);
+
+        if (newScaleEvents.Length > MaxBatchSize)
+            return BadRequest($"Too many scale events in batch (max {MaxBatchSize})");
+
+        // Events are created one by one so a single rejected event (eg. one that was already delivered
+        // before the device lost the response) does not fail the whole batch.
+        var results = new List<ScaleEventBatchResult>();
+
+        for (int i = 0; i < newScaleEvents.Length; i++)
+        {
+            try
+            {
+                var response = await interactor.CreateScaleEvent(MapNewScaleEvent(newScaleEvents[i]));
+                results.Add(new ScaleEventBatchResult(i, response.ScaleEvent.Id, null));
+            }
+            catch (Exception e) when (e is DomainValidationException or EntityNotFoundException)
+            {
+                _logger.LogWarning("Failed to create scale event {Index} of batch: {Message}", i, e.Message);
+                results.Add(new ScaleEventBatchResult(i, null, e.Message));
+            }
+        }
+
+        return Ok(results);
+    }
+
+    [HttpGet("{id:int}")]
+    public async Task<ActionResult<ScaleEventWaveformDto>> GetWaveform(
+        [FromServices] IGetScaleEventWaveformInteractor interactor,
+        [FromRoute] int id)
+    {
+        var response = await interactor
+            .GetScaleEventWaveform(new IGetScaleEventWaveformInteractor.Request(id));
+
+        return Ok(DataMapper.MapScaleEventWaveform(response.Waveform, response.Samples));
+    }
+
     [Authorize(Roles = ApplicationRoles.Admin)]
     [HttpDelete("{id:int}")]
     public async Task<IActionResult> Delete(
@@ -202,4 +238,37 @@ public class ScaleEventController : ControllerBase
             _notificationService.ScaleEventsChanged -= handler;
         }
     }
+
+    private static ICreateScaleEventInteractor.Request MapNewScaleEvent(NewScaleEvent newScaleEvent)
+    {
+        int toiletId = newScaleEvent.ToiletId!.Value;
+        DateTimeOffset startTime = newScaleEvent.StartTime!.Value;
+        DateTimeOffset endTime = newScaleEvent.EndTime!.Value;
+        double temperature = newScaleEvent.Temperature!.Value;
+        double humidity = newScaleEvent.Humidity!.Value;
+        double pressure = newScaleEvent.Pressure!.Value;
+
+        (DateTimeOffset, double, double)[] stablePhases = newScaleEvent.StablePhases!
+            .Select(sp => (sp.Timestamp!.Value, sp.Length!.Value, sp.Value!.Value))
+            .ToArray();
+
+        (int, bool, byte[])? waveform = newScaleEvent.Waveform is { } w
+            ? (w.SampleCount!.Value, w.Truncated!.Value, DecodeWaveformData(w.Data!))
+            : null;
+
+        return new ICreateScaleEventInteractor.Request(toiletId, startTime, endTime,
+            stablePhases, temperature, humidity, pressure, waveform);
+    }
+
+    private static byte[] DecodeWaveformData(string data)
+    {
+        try
+        {
+            return Convert.FromBase64String(data);
+        }
+        catch (FormatException)
+        {
+            throw new DomainValidationException("Invalid waveform data");
+        }
+    }
 }
\ No newline at end of file
@@ -12,6 +12,7 @@ public class CatScaleDbContext : IdentityDbContext<ApplicationUser, ApplicationR
     public DbSet<CatWeight> CatWeights { get; set; } = null!;
     public DbSet<ScaleEvent> ScaleEvents { get; set; } = null!;
     public DbSet<StablePhase> StablePhases { get; set; } = null!;
+    public DbSet<ScaleEventWaveform> ScaleEventWaveforms { get; set; } = null!;
     public DbSet<Measurement> Measurements { get; set; } = null!;
     public DbSet<Cleaning> Cleanings { get; set; } = null!;
     public DbSet<Food> Foods { get; set; } = null!;
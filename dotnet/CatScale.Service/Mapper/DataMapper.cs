@@ -1,3 +1,4 @@
+using CatScale.Application.Services;
 using CatScale.Domain.Model;
 using CatScale.Service.DbModel;
 using CatScale.Service.Model.Cat;
@@ -57,4 +58,10 @@ public static partial class DataMapper
     {
         return new StablePhaseDto(stablePhase.Id, stablePhase.Timestamp, stablePhase.Length, stablePhase.Value);
     }
+
+    public static ScaleEventWaveformDto MapScaleEventWaveform(ScaleEventWaveform waveform, WaveformSample[] samples)
+    {
+        return new ScaleEventWaveformDto(waveform.ScaleEventId, waveform.Truncated,
+            samples.Select(s => new WaveformSampleDto(s.Offset, s.Raw, s.Weight)).ToArray());
+    }
 }
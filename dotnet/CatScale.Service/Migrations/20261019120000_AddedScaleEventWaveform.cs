@@ -0,0 +1,50 @@
+﻿using Microsoft.EntityFrameworkCore.Migrations;
+using Npgsql.EntityFrameworkCore.PostgreSQL.Metadata;
+
+#nullable disable
+
+namespace CatScale.Service.Migrations
+{
+    /// <inheritdoc />
+    public partial class AddedScaleEventWaveform : Migration
+    {
+        /// <inheritdoc />
+        protected override void Up(MigrationBuilder migrationBuilder)
+        {
+            migrationBuilder.CreateTable(
+                name: "ScaleEventWaveforms",
+                columns: table => new
+                {
+                    Id = table.Column<int>(type: "integer", nullable: false)
+                        .Annotation("Npgsql:ValueGenerationStrategy", NpgsqlValueGenerationStrategy.IdentityByDefaultColumn),
+                    ScaleEventId = table.Column<int>(type: "integer", nullable: false),
+                    SampleCount = table.Column<int>(type: "integer", nullable: false),
+                    Truncated = table.Column<bool>(type: "boolean", nullable: false),
+                    Data = table.Column<byte[]>(type: "bytea", nullable: false)
+                },
+                constraints: table =>
+                {
+                    table.PrimaryKey("PK_ScaleEventWaveforms", x => x.Id);
+                    table.ForeignKey(
+                        name: "FK_ScaleEventWaveforms_ScaleEvents_ScaleEventId",
+                        column: x => x.ScaleEventId,
+                        principalTable: "ScaleEvents",
+                        principalColumn: "Id",
+                        onDelete: ReferentialAction.Cascade);
+                });
+
+            migrationBuilder.CreateIndex(
+                name: "IX_ScaleEventWaveforms_ScaleEventId",
+                table: "ScaleEventWaveforms",
+                column: "ScaleEventId",
+                unique: true);
+        }
+
+        /// <inheritdoc />
+        protected override void Down(MigrationBuilder migrationBuilder)
+        {
+            migrationBuilder.DropTable(
+                name: "ScaleEventWaveforms");
+        }
+    }
+}
@@ -231,6 +231,35 @@ namespace CatScale.Service.Migrations
                     b.ToTable("ScaleEvents");
                 });
 
+            modelBuilder.Entity("CatScale.Domain.Model.ScaleEventWaveform", b =>
+                {
+                    b.Property<int>("Id")
+                        .ValueGeneratedOnAdd()
+                        .HasColumnType("integer");
+
+                    NpgsqlPropertyBuilderExtensions.UseIdentityByDefaultColumn(b.Property<int>("Id"));
+
+                    b.Property<byte[]>("Data")
+                        .IsRequired()
+                        .HasColumnType("bytea");
+
+                    b.Property<int>("SampleCount")
+                        .HasColumnType("integer");
+
+                    b.Property<int>("ScaleEventId")
+                        .HasColumnType("integer");
+
+                    b.Property<bool>("Truncated")
+                        .HasColumnType("boolean");
+
+                    b.HasKey("Id");
+
+                    b.HasIndex("ScaleEventId")
+                        .IsUnique();
+
+                    b.ToTable("ScaleEventWaveforms");
+                });
+
             modelBuilder.Entity("CatScale.Domain.Model.StablePhase", b =>
                 {
                     b.Property<int>("Id")
@@ -556,6 +585,15 @@ namespace CatScale.Service.Migrations
                         .IsRequired();
                 });
 
+            modelBuilder.Entity("CatScale.Domain.Model.ScaleEventWaveform", b =>
+                {
+                    b.HasOne("CatScale.Domain.Model.ScaleEvent", null)
+                        .WithOne("Waveform")
+                        .HasForeignKey("CatScale.Domain.Model.ScaleEventWaveform", "ScaleEventId")
+                        .OnDelete(DeleteBehavior.Cascade)
+                        .IsRequired();
+                });
+
             modelBuilder.Entity("CatScale.Domain.Model.StablePhase", b =>
                 {
                     b.HasOne("CatScale.Domain.Model.ScaleEvent", null)
@@ -648,6 +686,8 @@ namespace CatScale.Service.Migrations
                     b.Navigation("Measurement");
 
                     b.Navigation("StablePhases");
+
+                    b.Navigation("Waveform");
                 });
 
             modelBuilder.Entity("CatScale.Domain.Model.Toilet", b =>
@@ -103,6 +103,7 @@ builder.Services
     .AddTransient<ICreateScaleEventInteractor, CreateScaleEventInteractor>()
     .AddTransient<IClassifyScaleEventInteractor, ClassifyScaleEventInteractor>()
     .AddTransient<IDeleteScaleEventInteractor, DeleteScaleEventInteractor>()
+    .AddTransient<IGetScaleEventWaveformInteractor, GetScaleEventWaveformInteractor>()
     
     .AddTransient<IGetScaleEventStatsInteractor, GetScaleEventStatsInteractor>()
     .AddTransient<IGetPooCountInteractor, GetPooCountInteractor>()
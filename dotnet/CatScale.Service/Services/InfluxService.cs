@@ -54,7 +54,9 @@ public class InfluxService : IInfluxService
             .AppendLine($"from(bucket: \"{_influxBucket}\")")
             .AppendLine($"|> range(start: {ConvertDateTimeOffsetToString(start)}, stop: {ConvertDateTimeOffsetToString(end)})")
             .AppendLine($"|> filter(fn: (r) => r[\"_measurement\"] == \"scales\")")
-            .AppendLine($"|> filter(fn: (r) => r[\"_field\"] == \"{GetFieldName(value)}\")")
+            .AppendLine($"|> filter(fn: (r) => {GetAggregatedFieldFilter(value)})")
+            .AppendLine($"|> group(columns: [\"_measurement\"])")
+            .AppendLine($"|> sort(columns: [\"_time\"])")
             .AppendLine($"|> aggregateWindow(every: 1m, fn: mean, createEmpty: false)")
             .AppendLine($"|> yield(name: \"mean\")") // Optional?
             .ToString();
@@ -95,6 +97,19 @@ public class InfluxService : IInfluxService
         return value.ToUniversalTime().ToString("yyyy-MM-ddTHH:mm:ss.fffZ");
     }
 
+    private static string GetAggregatedFieldFilter(ToiletSensorValue value)
+    {
+        // While the scale is idle the device only uploads per-interval aggregates of the weight (see sensors.c).
+        string fieldName = GetFieldName(value);
+
+        return value switch
+        {
+            ToiletSensorValue.Weight or ToiletSensorValue.RawWeight =>
+                $"r[\"_field\"] == \"{fieldName}\" or r[\"_field\"] == \"{fieldName}_mean\"",
+            _ => $"r[\"_field\"] == \"{fieldName}\""
+        };
+    }
+
     private static string GetFieldName(ToiletSensorValue value)
     {
         return value switch
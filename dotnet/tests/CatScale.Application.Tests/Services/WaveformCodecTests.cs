@@ -0,0 +1,66 @@
+using CatScale.Application.Services;
+
+namespace CatScale.Application.Tests.Services;
+
+public class WaveformCodecTests
+{
+    [Fact]
+    public void Decode_Should_ReturnOriginalSamples_When_DataWasEncoded()
+    {
+        var samples = new[]
+        {
+            new WaveformSample(0.05d, 8388000d, 12.3d),
+            new WaveformSample(0.15d, 8387990d, 12.1d),
+            new WaveformSample(0.251d, 8390000d, -5.0d),
+        };
+
+        var decoded = WaveformCodec.Decode(WaveformCodec.Encode(samples), samples.Length);
+
+        Assert.Equal(samples.Length, decoded.Length);
+        for (int i = 0; i < samples.Length; i++)
+        {
+            Assert.Equal(samples[i].Offset, decoded[i].Offset, 0.0001d);
+            Assert.Equal(samples[i].Raw, decoded[i].Raw, 0.0001d);
+            Assert.Equal(samples[i].Weight, decoded[i].Weight, 0.0001d);
+        }
+    }
+
+    [Fact]
+    public void Decode_Should_MatchFirmwareEncoding()
+    {
+        // 50 ms / 100 / 1.2 g followed by +100 ms / -1 / -0.1 g
+        var data = new byte[] { 0x64, 0xc8, 0x01, 0x18, 0xc8, 0x01, 0x01, 0x01 };
+
+        var decoded = WaveformCodec.Decode(data, 2);
+
+        Assert.Equal(2, decoded.Length);
+        Assert.Equal(0.05d, decoded[0].Offset, 0.0001d);
+        Assert.Equal(100d, decoded[0].Raw, 0.0001d);
+        Assert.Equal(1.2d, decoded[0].Weight, 0.0001d);
+        Assert.Equal(0.15d, decoded[1].Offset, 0.0001d);
+        Assert.Equal(99d, decoded[1].Raw, 0.0001d);
+        Assert.Equal(1.1d, decoded[1].Weight, 0.0001d);
+    }
+
+    [Fact]
+    public void Decode_Should_ReturnEmptyArray_When_NoSamples()
+    {
+        Assert.Empty(WaveformCodec.Decode(Array.Empty<byte>(), 0));
+    }
+
+    [Fact]
+    public void Decode_Should_Throw_When_DataIsTooShort()
+    {
+        var data = WaveformCodec.Encode(new[] { new WaveformSample(0.1d, 1d, 1d) });
+
+        Assert.Throws<FormatException>(() => WaveformCodec.Decode(data, 2));
+    }
+
+    [Fact]
+    public void Decode_Should_Throw_When_DataIsTooLong()
+    {
+        var data = WaveformCodec.Encode(new[] { new WaveformSample(0.1d, 1d, 1d), new WaveformSample(0.2d, 1d, 1d) });
+
+        Assert.Throws<FormatException>(() => WaveformCodec.Decode(data, 1));
+    }
+}
\ No newline at end of file
@@ -43,6 +43,10 @@ public class ScaleEventHttpClient
         => await _client.GetFromJsonAsync<ScaleEventDto>($"api/ScaleEvent/GetOne/{id}")
            ?? throw new Exception("Failed to deserialize response");
 
+    public async Task<ScaleEventWaveformDto> GetWaveform(int id)
+        => await _client.GetFromJsonAsync<ScaleEventWaveformDto>($"api/ScaleEvent/GetWaveform/{id}")
+           ?? throw new Exception("Failed to deserialize response");
+
     public async Task<ScaleEventDto> Create(NewScaleEvent scaleEvent)
     {
         var response = await _client.PostAsJsonAsync("api/ScaleEvent/Create", scaleEvent);
@@ -57,6 +61,20 @@ public class ScaleEventHttpClient
                throw new Exception("Failed to deserialize response");
     }
 
+    public async Task<ScaleEventBatchResult[]> CreateBatch(NewScaleEvent[] scaleEvents)
+    {
+        var response = await _client.PostAsJsonAsync("api/ScaleEvent/CreateBatch", scaleEvents);
+        _output.WriteLine($"Http status: {response.StatusCode}");
+
+        var content = await response.Content.ReadAsStringAsync();
+        _output.WriteLine($"Http response: {content}");
+
+        response.EnsureSuccessStatusCode();
+
+        return await response.Content.ReadFromJsonAsync<ScaleEventBatchResult[]>() ??
+               throw new Exception("Failed to deserialize response");
+    }
+
     public async Task<ScaleEventDto> CreateSimpleMeasurement(int toiletId, DateTimeOffset startTime)
     {
         var tStart = startTime;
@@ -1,4 +1,5 @@
 using System.Net;
+using CatScale.Application.Services;
 using CatScale.Service.Model.Cat;
 using CatScale.Service.Model.ScaleEvent;
 using CatScale.Service.Model.Toilet;
@@ -536,6 +537,157 @@ public class ScaleEventIntegrationTests : IntegrationTest
         Assert.Equal(tEnd, scaleEvent.End, new DateTimeOffsetComparer(TimeSpan.FromSeconds(0.1d)));
     }
 
+    [Fact]
+    public async Task CreateBatch_Should_CreateAllEvents_When_ParametersAreValid()
+    {
+        await Login();
+        var toilet = await Toilet.Create("toilet", "desc");
+
+        var t0 = DateTimeOffset.Now;
+        var tStart1 = t0.AddMinutes(-30);
+        var tStart2 = t0.AddMinutes(-20);
+        var tStart3 = t0.AddMinutes(-10);
+
+        var results = await ScaleEvent.CreateBatch(new NewScaleEvent[]
+        {
+            new(toilet.Id, tStart1, tStart1.AddSeconds(10), Array.Empty<NewStablePhase>(), 22.0d, 50.0d, 100000.0d),
+            new(toilet.Id, tStart2, tStart2.AddSeconds(10), Array.Empty<NewStablePhase>(), 22.0d, 50.0d, 100000.0d),
+            new(toilet.Id, tStart3, tStart3.AddSeconds(10), Array.Empty<NewStablePhase>(), 22.0d, 50.0d, 100000.0d),
+        });
+
+        Assert.Equal(3, results.Length);
+        Assert.All(results, r =>
+        {
+            Assert.NotNull(r.Id);
+            Assert.Null(r.Error);
+        });
+        Assert.Equal(new[] { 0, 1, 2 }, results.Select(r => r.Index));
+
+        var scaleEvents = await ScaleEvent.GetAll();
+        Assert.Equal(3, scaleEvents.Length);
+    }
+
+    [Fact]
+    public async Task CreateBatch_Should_ReportRejectedEvents_When_SomeEventsAreInvalid()
+    {
+        await Login();
+        var toilet = await Toilet.Create("toilet", "desc");
+
+        var t0 = DateTimeOffset.Now;
+        var tStart1 = t0.AddMinutes(-30);
+        var tStart2 = t0.AddMinutes(-20);
+
+        var existingEvent = new NewScaleEvent(toilet.Id, tStart1, tStart1.AddSeconds(10),
+            Array.Empty<NewStablePhase>(), 22.0d, 50.0d, 100000.0d);
+        await ScaleEvent.Create(existingEvent);
+
+        var results = await ScaleEvent.CreateBatch(new NewScaleEvent[]
+        {
+            existingEvent, // already delivered
+            new(toilet.Id, tStart2, tStart2.AddSeconds(1), Array.Empty<NewStablePhase>(), 22.0d, 50.0d, 100000.0d), // too short
+            new(toilet.Id, tStart2, tStart2.AddSeconds(10), Array.Empty<NewStablePhase>(), 22.0d, 50.0d, 100000.0d),
+        });
+
+        Assert.Collection(results, r =>
+        {
+            Assert.Null(r.Id);
+            Assert.NotNull(r.Error);
+        }, r =>
+        {
+            Assert.Null(r.Id);
+            Assert.NotNull(r.Error);
+        }, r =>
+        {
+            Assert.NotNull(r.Id);
+            Assert.Null(r.Error);
+        });
+
+        var scaleEvents = await ScaleEvent.GetAll();
+        Assert.Equal(2, scaleEvents.Length);
+    }
+
+    [Fact]
+    public async Task CreateBatch_Should_ReturnUnauthorized_When_NotAuthorized()
+    {
+        await Login();
+        var toilet = await Toilet.Create("toilet", "desc");
+        await Logout();
+
+        var tStart = DateTimeOffset.Now.AddMinutes(-5);
+
+        async Task request() => await ScaleEvent.CreateBatch(new NewScaleEvent[]
+        {
+            new(toilet.Id, tStart, tStart.AddSeconds(10), Array.Empty<NewStablePhase>(), 22.0d, 50.0d, 100000.0d),
+        });
+
+        var response = await Assert.ThrowsAsync<HttpRequestException>(request);
+        Assert.Equal(HttpStatusCode.Unauthorized, response.StatusCode);
+    }
+
+    [Fact]
+    public async Task GetWaveform_Should_ReturnSamples_When_EventWasCreatedWithWaveform()
+    {
+        await Login();
+        var toilet = await Toilet.Create("toilet", "desc");
+
+        var t0 = DateTimeOffset.Now;
+        var tStart = t0.AddMinutes(-5);
+        var tEnd = tStart.AddSeconds(10);
+
+        var samples = Enumerable.Range(0, 100)
+            .Select(i => new WaveformSample(i * 0.1d, 8000000d + i, i * 0.5d))
+            .ToArray();
+
+        var createdScaleEvent = await ScaleEvent.Create(
+            new NewScaleEvent(toilet.Id, tStart, tEnd,
+                Array.Empty<NewStablePhase>(),
+                22.0d, 50.0d, 100000.0d,
+                new NewScaleEventWaveform(samples.Length, true, Convert.ToBase64String(WaveformCodec.Encode(samples)))));
+
+        var waveform = await ScaleEvent.GetWaveform(createdScaleEvent.Id);
+
+        Assert.Equal(createdScaleEvent.Id, waveform.ScaleEventId);
+        Assert.True(waveform.Truncated);
+        Assert.Equal(samples.Length, waveform.Samples.Length);
+        Assert.Equal(9.9d, waveform.Samples[99].Offset, 0.001d);
+        Assert.Equal(8000099d, waveform.Samples[99].Raw, 0.001d);
+        Assert.Equal(49.5d, waveform.Samples[99].Weight, 0.001d);
+    }
+
+    [Fact]
+    public async Task GetWaveform_Should_ReturnNotFound_When_EventHasNoWaveform()
+    {
+        await Login();
+        var toilet = await Toilet.Create("toilet", "desc");
+        var createdScaleEvent = await ScaleEvent.CreateSimpleMeasurement(toilet.Id, DateTimeOffset.Now.AddMinutes(-5));
+
+        var exception = await Assert.ThrowsAsync<HttpRequestException>(
+            async () => await ScaleEvent.GetWaveform(createdScaleEvent.Id));
+        Assert.Equal(HttpStatusCode.NotFound, exception.StatusCode);
+    }
+
+    [Fact]
+    public async Task Create_Should_ReturnBadRequest_When_WaveformIsInvalid()
+    {
+        await Login();
+        var toilet = await Toilet.Create("toilet", "desc");
+
+        var t0 = DateTimeOffset.Now;
+        var tStart = t0.AddMinutes(-5);
+        var tEnd = tStart.AddSeconds(10);
+
+        var data = Convert.ToBase64String(WaveformCodec.Encode(new[] { new WaveformSample(0.1d, 1d, 1d) }));
+
+        async Task request() => await ScaleEvent.Create(
+            new NewScaleEvent(toilet.Id, tStart, tEnd,
+                Array.Empty<NewStablePhase>(),
+                22.0d, 50.0d, 100000.0d,
+                new NewScaleEventWaveform(2, false, data)));
+
+        var response = await Assert.ThrowsAsync<HttpRequestException>(request);
+        Assert.Equal(HttpStatusCode.BadRequest, response.StatusCode);
+    }
+
     [Fact]
     public async Task Delete_Should_ReturnNotAuthorized_When_NotAuthorized()
     {
@@ -13,12 +13,12 @@ public static class NativeFilterLib
     public static extern void RegisterHandlers(StartOfEventHandler startOfEvent, StablePhaseHandler stablePhase,
         EndOfEventHandler endOfEvent, DebugHandler debugHandler);
     
-    [DllImport("filter_lib", EntryPoint = "filter_cascade_init")]
+    [DllImport("filter_lib", EntryPoint = "filter_lib_init")]
     public static extern void InitFilterCascade();
     
-    [DllImport("filter_lib", EntryPoint = "filter_cascade_cleanup")]
+    [DllImport("filter_lib", EntryPoint = "filter_lib_cleanup")]
     public static extern void CleanupFilterCascade();
     
-    [DllImport("filter_lib", EntryPoint = "filter_cascade_process")]
+    [DllImport("filter_lib", EntryPoint = "filter_lib_process")]
     public static extern double ProcessValueInFilterCascade(double input, double dt);
 }
\ No newline at end of file
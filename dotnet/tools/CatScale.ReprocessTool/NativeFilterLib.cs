@@ -7,13 +7,15 @@ public static class NativeFilterLib
     public delegate void StartOfEventHandler();
     public delegate void StablePhaseHandler(double length, double value);
     public delegate void EndOfEventHandler();
+    public delegate void DebugHandler(string id, double value);
     
     [DllImport("filter_lib.so", EntryPoint = "register_handlers")]
-    public static extern void RegisterHandlers(StartOfEventHandler startOfEvent, StablePhaseHandler stablePhase, EndOfEventHandler endOfEvent);
+    public static extern void RegisterHandlers(StartOfEventHandler startOfEvent, StablePhaseHandler stablePhase, EndOfEventHandler endOfEvent,
+        DebugHandler? debugHandler);
     
-    [DllImport("filter_lib.so", EntryPoint = "filter_cascade_init")]
+    [DllImport("filter_lib.so", EntryPoint = "filter_lib_init")]
     public static extern void InitFilterCascade();
     
-    [DllImport("filter_lib.so", EntryPoint = "filter_cascade_process")]
+    [DllImport("filter_lib.so", EntryPoint = "filter_lib_process")]
     public static extern double ProcessValueInFilterCascade(double input, double dt);
 }
\ No newline at end of file
@@ -91,7 +91,7 @@ public static class Program
             
         var eventBuffer = new EventBuffer();
         
-        NativeFilterLib.RegisterHandlers(eventBuffer.StartOfEvent, eventBuffer.StablePhase, eventBuffer.EndOfEvent);
+        NativeFilterLib.RegisterHandlers(eventBuffer.StartOfEvent, eventBuffer.StablePhase, eventBuffer.EndOfEvent, null);
         NativeFilterLib.InitFilterCascade();
         
         for (int i = 1; i < weightData.Length; i++)
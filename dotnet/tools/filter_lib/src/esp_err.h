@@ -1,3 +0,0 @@
-#pragma once
-
-typedef int esp_err_t;
@@ -2,6 +2,9 @@
 #include <stdio.h>
 #include <assert.h>
 
+#include "filter_cascade.h"
+#include "settings.h"
+
 typedef void(*start_of_event_handler_t)();
 typedef void(*stable_phase_handler_t)(double, double);
 typedef void(*end_of_event_handler_t)();
@@ -23,19 +26,43 @@ void register_handlers(start_of_event_handler_t start_handler,
     g_debug_handler = debug_handler;
 }
 
-void measurement_mark_start_of_event(void)
+// One cascade on channel 0 with the default settings, like a freshly flashed scale.
+static filter_cascade_t *g_cascade = NULL;
+
+void filter_lib_init(void)
+{
+    assert(!g_cascade);
+
+    settings_reset();
+    g_cascade = filter_cascade_create(0, SETTING_CALIBRATION_FACTOR);
+    assert(g_cascade);
+}
+
+void filter_lib_cleanup(void)
+{
+    filter_cascade_destroy(g_cascade);
+    g_cascade = NULL;
+}
+
+double filter_lib_process(double input, double dt)
+{
+    assert(g_cascade);
+    return filter_cascade_process(g_cascade, input, dt);
+}
+
+void measurement_mark_start_of_event(size_t channel)
 {
     assert(g_start_handler);
     g_start_handler();
 }
 
-void measurement_push_stable_phase(double length, double value)
+void measurement_push_stable_phase(size_t channel, double length, double value)
 {
     assert(g_stable_handler);
     g_stable_handler(length, value);
 }
 
-void measurement_mark_end_of_event(void)
+void measurement_mark_end_of_event(size_t channel)
 {
     assert(g_end_handler);
     g_end_handler();
@@ -43,6 +70,6 @@ void measurement_mark_end_of_event(void)
 
 void filter_cascade_debug(const char *id, double value)
 {
-    assert(g_debug_handler);
-    g_debug_handler(id, value);
-}
\ No newline at end of file
+    if (g_debug_handler)
+        g_debug_handler(id, value);
+}
@@ -13,7 +13,17 @@ echo ""
 echo "new version: `cat version.txt`"
 echo ""
 
+make -s -C host tools
+
 echo "Updating ..."
-time (cat build/cat_scale.bin | nc CatScale 69)
+# The image the device runs is kept after every update, the next one is sent as a delta against it.
+if [ -f deployed.bin ] && host/bin/ota_sender CatScale build/cat_scale.bin 69 --delta deployed.bin; then
+    cp build/cat_scale.bin deployed.bin
+elif host/bin/ota_sender CatScale build/cat_scale.bin 69 --deflate; then
+    cp build/cat_scale.bin deployed.bin
+else
+    echo "Update failed"
+    exit -1
+fi
 
 echo "All done."
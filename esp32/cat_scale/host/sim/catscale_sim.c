@@ -0,0 +1,306 @@
+// Runs the firmware pipeline on the host with recorded hx711 samples:
+// hx711 replay -> sensors (filter cascade, ring buffers, adaptive upload) -> measurement -> post queue / influx post
+// -> http.c -> http stand-in. The firmware modules are the ones of the device, only hardware and network
+// are replaced (sim_devices.c, hx711_replay.c, esp_http_client.c). Time is simulated, see sim_kernel.h.
+//
+// At the end the throughput (samples per wall second, speed-up over real time) and the latencies
+// (sample until uploaded, event until delivered) are reported. The exit code is 1 if data was lost.
+
+#include "sim_kernel.h"
+#include "sim_devices.h"
+#include "hx711_replay.h"
+#include "http_standin.h"
+
+#include "settings.h"
+#include "http.h"
+#include "post_queue.h"
+#include "measurement.h"
+#include "sensors.h"
+#include "radio.h"
+#include "scale_channel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <esp_log.h>
+#include <nvs_flash.h>
+
+static const char *TAG = "sim";
+
+// After the replay the pipeline gets this long to deliver what it still holds.
+#define SIM_MAX_DRAIN_US    ((int64_t)10 * 60 * 1000 * 1000)
+#define SIM_STEP_US         ((int64_t)1000 * 1000)
+
+static char g_influx_endpoint[32] = {};
+static char g_service_url[48] = {};
+
+const char *sim_influx_endpoint(void)
+{
+    return g_influx_endpoint;
+}
+
+void get_http_secrets(int endpoint, const char **addr, const char **token)
+{
+    *addr = g_service_url;
+    *token = "sim";
+}
+
+static int64_t wall_us(void)
+{
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 * 1000 + ts.tv_nsec / 1000;
+}
+
+static void usage(void)
+{
+    printf("usage: catscale_sim [options] recording.csv...\n");
+    printf("  --channels N      scale channels fed with the recordings, 1-%d (default 1)\n", SCALE_CHANNEL_MAX);
+    printf("  --loops N         play the recordings N times (default 1)\n");
+    printf("  --set NAME=VALUE  firmware setting, e.g. post_interval_s=30\n");
+    printf("  --fail-every N    the stand-in answers every N-th request with 503\n");
+    printf("  --latency MS      the stand-in waits before every response\n");
+    printf("  --record FILE     append the accepted request bodies to FILE\n");
+    printf("  -v, -vv           firmware log at info / debug level\n");
+}
+
+static bool apply_setting(const char *assignment)
+{
+    char name[32] = {};
+    double value = 0.0;
+    setting_id_t id = 0;
+
+    if (sscanf(assignment, "%31[^=]=%lf", name, &value) != 2 || !settings_find(name, &id))
+    {
+        fprintf(stderr, "unknown setting: %s\n", assignment);
+        return false;
+    }
+    if (settings_set(id, value) != ESP_OK)
+    {
+        fprintf(stderr, "invalid value: %s\n", assignment);
+        return false;
+    }
+    return true;
+}
+
+// Nothing left in the pipeline: all samples replayed, uploaded and the events delivered.
+static bool is_drained(void)
+{
+    if (!hx711_replay_done())
+        return false;
+
+    ringbuffer_stats_t fast = {};
+    sensors_get_buffer_stats(SENSORS_BUFFER_FAST, &fast);
+    if (fast.count > 0)
+        return false;
+
+    measurement_pool_status_t pool = {};
+    measurement_get_pool_status(&pool);
+    if (pool.in_use > 0)
+        return false;
+
+    for (int i = 0; i < HTTP_JSON_ENDPOINT_COUNT; i++)
+    {
+        post_queue_status_t status = {};
+        post_queue_get_status(i, &status);
+        if (status.queue_level > 0 || status.outbox_level > 0)
+            return false;
+    }
+
+    return true;
+}
+
+// Returns false if data was lost on the way.
+static bool report(size_t channels, int64_t sim_us, int64_t wall_time_us)
+{
+    bool complete = true;
+
+    hx711_replay_stats_t replay = {};
+    hx711_replay_get_stats(&replay);
+
+    printf("\n");
+    printf("replay      %"PRIu32" of %"PRIu64" samples on %zu channel(s), %.1f s simulated in %.3f s (%.0fx real time)\n",
+        replay.samples, hx711_replay_sample_count(), channels, sim_us / 1e6, wall_time_us / 1e6,
+        wall_time_us > 0 ? (double)sim_us / wall_time_us : 0.0);
+    printf("throughput  %.0f samples/s, read delay max %.1f ms, %"PRIu32" late\n",
+        wall_time_us > 0 ? replay.samples * 1e6 / wall_time_us : 0.0, replay.max_delay_us / 1e3, replay.late_samples);
+
+    for (size_t i = 0; i < channels; i++)
+    {
+        sensors_channel_stats_t stats = {};
+        sensors_get_channel_stats(i, &stats);
+        printf("channel %zu   %"PRIu32" samples, %"PRIu32" failures, busy avg %"PRIu64" us max %"PRIu32" us per sample\n",
+            i, stats.samples, stats.failures, stats.samples ? stats.total_busy_us / stats.samples : 0, stats.max_busy_us);
+    }
+
+    for (int i = 0; i < SENSORS_BUFFER_COUNT; i++)
+    {
+        static const char *names[SENSORS_BUFFER_COUNT] = { "fast", "aggregate", "slow" };
+        ringbuffer_stats_t stats = {};
+        sensors_get_buffer_stats(i, &stats);
+        printf("buffer      %-9s high water %"PRIu32"/%"PRIu32", %"PRIu32" overflows\n",
+            names[i], stats.count_high_water, stats.capacity, stats.overflows);
+        if (i != SENSORS_BUFFER_SLOW && stats.overflows > 0)
+            complete = false;
+    }
+
+    sensors_upload_stats_t upload = {};
+    sensors_get_upload_stats(&upload);
+    printf("upload      %"PRIu32" uploads with raw samples, oldest sample latency last %"PRIu32" ms max %"PRIu32" ms\n",
+        upload.uploads, upload.last_latency_ms, upload.max_latency_ms);
+
+    measurement_pool_status_t pool = {};
+    measurement_get_pool_status(&pool);
+    printf("events      %"PRIu32" dropped, %"PRIu32" messages dropped, %"PRIu32" samples dropped, waveform max %"PRIu32" bytes, %"PRIu32" truncated\n",
+        pool.events_dropped, pool.messages_dropped, pool.samples_dropped, pool.waveform_bytes_high_water, pool.waveforms_truncated);
+    if (pool.events_dropped > 0 || pool.messages_dropped > 0)
+        complete = false;
+
+    uint32_t events_delivered = 0;
+    for (int i = 0; i < HTTP_JSON_ENDPOINT_COUNT; i++)
+    {
+        post_queue_status_t status = {};
+        post_queue_get_status(i, &status);
+        printf("post %d      %"PRIu32" queued, %"PRIu32" delivered, %"PRIu32" replayed, %"PRIu32" retries, %"PRIu32" failed, %"PRIu32" dropped, latency last %.1f ms max %.1f ms\n",
+            i, status.queued, status.delivered, status.replayed, status.retries, status.failed, status.dropped,
+            status.last_latency_us / 1e3, status.max_latency_us / 1e3);
+        events_delivered += status.delivered + status.replayed;
+        if (status.failed > 0 || status.dropped > 0 || status.queue_level > 0 || status.outbox_level > 0)
+            complete = false;
+    }
+
+    for (int i = 0; i < HTTP_CLIENT_COUNT; i++)
+    {
+        static const char *names[HTTP_CLIENT_COUNT] = { "influx", "json0", "json1" };
+        http_client_stats_t stats = {};
+        http_get_client_stats(i, &stats);
+        printf("http        %-6s %"PRIu32" requests, %"PRIu32" failures, %"PRIu32" connects, %"PRIu64" body bytes, latency avg %.2f ms max %.2f ms\n",
+            names[i], stats.requests, stats.failures, stats.connects, stats.body_bytes,
+            stats.requests ? stats.total_latency_us / 1e3 / stats.requests : 0.0, stats.max_latency_us / 1e3);
+    }
+
+    radio_stats_t radio = {};
+    radio_get_stats(&radio);
+    const uint64_t radio_total_us = radio.awake_time_us + radio.sleep_time_us;
+    printf("radio       %"PRIu32" windows, awake %.1f %%, avg current ~%"PRIu32" mA\n",
+        radio.windows, radio_total_us ? radio.awake_time_us * 100.0 / radio_total_us : 0.0, radio.avg_current_ma);
+
+    http_standin_stats_t standin = {};
+    http_standin_get_stats(&standin);
+    printf("stand-in    %"PRIu32" requests, %"PRIu32" rejected, influx %"PRIu64" lines %"PRIu64" bytes, %"PRIu32" events in %"PRIu32" requests\n",
+        standin.requests, standin.rejected, standin.influx_lines, standin.influx_bytes, standin.events, standin.event_requests);
+    if (standin.events != events_delivered)
+    {
+        printf("stand-in received %"PRIu32" events, the post queues delivered %"PRIu32"\n", standin.events, events_delivered);
+        complete = false;
+    }
+
+    sim_kernel_stats_t kernel = {};
+    sim_get_stats(&kernel);
+    printf("kernel      %"PRIu32" tasks, %"PRIu64" switches, %"PRIu64" idle jumps, %.3f s in the tasks\n",
+        kernel.tasks, kernel.switches, kernel.jumps, kernel.busy_us / 1e6);
+
+    printf("%s\n", complete ? "complete" : "DATA LOST");
+    return complete;
+}
+
+int main(int argc, char **argv)
+{
+    size_t channels = 1;
+    uint32_t loops = 1;
+    http_standin_config_t standin = {};
+    const char *settings[16] = {};
+    size_t setting_count = 0;
+    const char *files[64] = {};
+    size_t file_count = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (strcmp(arg, "--channels") == 0 && has_value)
+            channels = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--loops") == 0 && has_value)
+            loops = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--set") == 0 && has_value && setting_count < 16)
+            settings[setting_count++] = argv[++i];
+        else if (strcmp(arg, "--fail-every") == 0 && has_value)
+            standin.fail_every = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--latency") == 0 && has_value)
+            standin.latency_ms = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--record") == 0 && has_value)
+        {
+            standin.record = fopen(argv[++i], "a");
+            if (!standin.record)
+            {
+                fprintf(stderr, "can't open %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(arg, "-v") == 0)
+            sim_log_level = ESP_LOG_INFO;
+        else if (strcmp(arg, "-vv") == 0)
+            sim_log_level = ESP_LOG_DEBUG;
+        else if (arg[0] != '-' && file_count < 64)
+            files[file_count++] = arg;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if (file_count == 0 || channels < 1 || channels > SCALE_CHANNEL_MAX || loops < 1)
+    {
+        usage();
+        return 2;
+    }
+
+    if (hx711_replay_load(files, file_count, channels, loops) != ESP_OK)
+        return 2;
+
+    const int port = http_standin_start(&standin);
+    if (port == 0)
+    {
+        fprintf(stderr, "can't start the http stand-in\n");
+        return 2;
+    }
+    snprintf(g_influx_endpoint, sizeof(g_influx_endpoint), "127.0.0.1:%d", port);
+    snprintf(g_service_url, sizeof(g_service_url), "http://127.0.0.1:%d", port);
+
+    // The recording starts HX711_REPLAY_START_US after boot.
+    sim_time_set_boot_unix_us(hx711_replay_start_unix_us() - HX711_REPLAY_START_US);
+
+    // Same order as app_main, without the network.
+    ESP_ERROR_CHECK(nvs_flash_init());
+    ESP_ERROR_CHECK(settings_init());
+    for (size_t i = 0; i < setting_count; i++)
+        if (!apply_setting(settings[i]))
+            return 2;
+    ESP_ERROR_CHECK(http_init());
+    ESP_ERROR_CHECK(post_queue_init());
+    ESP_ERROR_CHECK(measurement_init());
+    ESP_ERROR_CHECK(sensors_init());
+    ESP_ERROR_CHECK(radio_init());
+
+    ESP_LOGI(TAG, "replaying %"PRIu64" samples, stand-in on port %d", hx711_replay_sample_count(), port);
+
+    const int64_t wall_start = wall_us();
+
+    const int64_t replay_end = hx711_replay_end_time();
+    sim_run_until(replay_end);
+
+    int64_t now = replay_end;
+    while (!is_drained() && now < replay_end + SIM_MAX_DRAIN_US)
+    {
+        now += SIM_STEP_US;
+        sim_run_until(now);
+    }
+
+    const int64_t wall_time = wall_us() - wall_start;
+
+    return report(channels, now, wall_time) ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF gpio driver, only the pin numbers.
+
+typedef enum {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_4 = 4,
+    GPIO_NUM_5 = 5,
+    GPIO_NUM_18 = 18,
+    GPIO_NUM_19 = 19,
+    GPIO_NUM_21 = 21,
+    GPIO_NUM_22 = 22,
+    GPIO_NUM_23 = 23,
+    GPIO_NUM_25 = 25,
+} gpio_num_t;
@@ -0,0 +1,6 @@
+#pragma once
+
+// Host stand-in. The simulation is a single boot, rtc memory is plain (zeroed) memory.
+
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
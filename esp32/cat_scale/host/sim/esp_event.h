@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in, nothing of the event loop is simulated.
+
+#include <esp_err.h>
@@ -0,0 +1,549 @@
+// Host stand-in for the ESP-IDF http client: http/1.1 over a blocking POSIX socket, no tls, no redirects.
+// Enough for http.c talking to the http stand-in, the connection is kept between requests.
+
+#include <esp_http_client.h>
+#include <esp_log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+static const char *TAG = "http_client";
+
+#define HTTP_CLIENT_MAX_HEADERS     (16)
+#define HTTP_CLIENT_HOST_SIZE       (64)
+#define HTTP_CLIENT_PATH_SIZE       (256)
+#define HTTP_CLIENT_LINE_SIZE       (512)
+#define HTTP_CLIENT_BUFFER_SIZE     (4096)
+
+typedef struct {
+    char *key;
+    char *value;
+} header_t;
+
+struct esp_http_client {
+    esp_http_client_config_t config;
+    char host[HTTP_CLIENT_HOST_SIZE];
+    int port;
+    char path[HTTP_CLIENT_PATH_SIZE];
+    esp_http_client_method_t method;
+    header_t headers[HTTP_CLIENT_MAX_HEADERS];
+    size_t header_count;
+    const char *post_data;
+    int post_length;
+
+    int socket;                 // -1 while not connected
+    char connected_host[HTTP_CLIENT_HOST_SIZE];
+    int connected_port;
+
+    // response
+    int status_code;
+    int64_t content_length;     // -1 if unknown
+    bool chunked;
+    bool close_after;           // "Connection: close"
+    bool body_pending;          // headers were read, the body not yet
+    char buffer[HTTP_CLIENT_BUFFER_SIZE];
+    size_t buffer_start;
+    size_t buffer_end;
+};
+
+static void emit(esp_http_client_handle_t client, esp_http_client_event_id_t id, void *data, int data_len,
+    char *header_key, char *header_value)
+{
+    if (!client->config.event_handler)
+        return;
+
+    esp_http_client_event_t event = {
+        .event_id = id,
+        .client = client,
+        .data = data,
+        .data_len = data_len,
+        .user_data = client->config.user_data,
+        .header_key = header_key,
+        .header_value = header_value,
+    };
+    client->config.event_handler(&event);
+}
+
+static const char *method_name(esp_http_client_method_t method)
+{
+    switch (method)
+    {
+        case HTTP_METHOD_GET: return "GET";
+        case HTTP_METHOD_POST: return "POST";
+        case HTTP_METHOD_PUT: return "PUT";
+        case HTTP_METHOD_PATCH: return "PATCH";
+        case HTTP_METHOD_DELETE: return "DELETE";
+    }
+    return "GET";
+}
+
+// "http://host[:port][/path]"
+static esp_err_t parse_url(esp_http_client_handle_t client, const char *url)
+{
+    static const char scheme[] = "http://";
+    if (strncmp(url, scheme, sizeof(scheme) - 1) != 0)
+    {
+        ESP_LOGE(TAG, "only http is supported: %s", url);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    const char *host = url + sizeof(scheme) - 1;
+    const char *path = strchr(host, '/');
+    if (!path)
+        path = host + strlen(host);
+
+    const char *port = memchr(host, ':', path - host);
+    const size_t host_length = (port ? port : path) - host;
+    if (host_length == 0 || host_length >= sizeof(client->host) || strlen(path) >= sizeof(client->path))
+        return ESP_ERR_INVALID_ARG;
+
+    memcpy(client->host, host, host_length);
+    client->host[host_length] = '\0';
+    client->port = port ? atoi(port + 1) : 80;
+    snprintf(client->path, sizeof(client->path), "%s", *path ? path : "/");
+
+    return ESP_OK;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    assert(config);
+    assert(config->url);
+
+    esp_http_client_handle_t client = calloc(1, sizeof(struct esp_http_client));
+    if (!client)
+        return NULL;
+
+    client->config = *config;
+    client->config.url = NULL;
+    if (client->config.timeout_ms == 0)
+        client->config.timeout_ms = 5000;
+    client->method = config->method;
+    client->socket = -1;
+
+    if (parse_url(client, config->url) != ESP_OK)
+    {
+        free(client);
+        return NULL;
+    }
+
+    return client;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    assert(client);
+
+    if (client->socket >= 0)
+    {
+        close(client->socket);
+        client->socket = -1;
+        emit(client, HTTP_EVENT_DISCONNECTED, NULL, 0, NULL, NULL);
+    }
+
+    client->buffer_start = 0;
+    client->buffer_end = 0;
+    client->body_pending = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    if (!client)
+        return ESP_OK;
+
+    esp_http_client_close(client);
+    for (size_t i = 0; i < client->header_count; i++)
+    {
+        free(client->headers[i].key);
+        free(client->headers[i].value);
+    }
+    free(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url)
+{
+    assert(client);
+    assert(url);
+
+    return parse_url(client, url);
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method)
+{
+    assert(client);
+
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    assert(client);
+    assert(key);
+    assert(value);
+
+    for (size_t i = 0; i < client->header_count; i++)
+    {
+        if (strcasecmp(client->headers[i].key, key) == 0)
+        {
+            free(client->headers[i].value);
+            client->headers[i].value = strdup(value);
+            return ESP_OK;
+        }
+    }
+
+    if (client->header_count == HTTP_CLIENT_MAX_HEADERS)
+        return ESP_ERR_NO_MEM;
+
+    client->headers[client->header_count++] = (header_t){ strdup(key), strdup(value) };
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int length)
+{
+    assert(client);
+
+    client->post_data = data;
+    client->post_length = data ? length : 0;
+    return ESP_OK;
+}
+
+static esp_err_t connect_socket(esp_http_client_handle_t client)
+{
+    // The connection is kept as long as the host stays the same.
+    if (client->socket >= 0)
+    {
+        if (strcmp(client->connected_host, client->host) == 0 && client->connected_port == client->port)
+            return ESP_OK;
+        esp_http_client_close(client);
+    }
+
+    char port[8] = {};
+    snprintf(port, sizeof(port), "%d", client->port);
+
+    const struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *addresses = NULL;
+    if (getaddrinfo(client->host, port, &hints, &addresses) != 0 || !addresses)
+    {
+        ESP_LOGE(TAG, "can't resolve %s", client->host);
+        return ESP_FAIL;
+    }
+
+    const int s = socket(AF_INET, SOCK_STREAM, 0);
+    const int connected = s >= 0 ? connect(s, addresses->ai_addr, addresses->ai_addrlen) : -1;
+    freeaddrinfo(addresses);
+
+    if (connected != 0)
+    {
+        ESP_LOGE(TAG, "can't connect to %s:%d", client->host, client->port);
+        if (s >= 0)
+            close(s);
+        emit(client, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+        return ESP_FAIL;
+    }
+
+    const int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    const struct timeval timeout = {
+        .tv_sec = client->config.timeout_ms / 1000,
+        .tv_usec = (client->config.timeout_ms % 1000) * 1000,
+    };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    client->socket = s;
+    snprintf(client->connected_host, sizeof(client->connected_host), "%s", client->host);
+    client->connected_port = client->port;
+    client->buffer_start = 0;
+    client->buffer_end = 0;
+
+    emit(client, HTTP_EVENT_ON_CONNECTED, NULL, 0, NULL, NULL);
+    return ESP_OK;
+}
+
+static bool send_all(esp_http_client_handle_t client, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        const ssize_t n = send(client->socket, data, length, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+// content_length -1: chunked
+static esp_err_t send_request_headers(esp_http_client_handle_t client, int64_t content_length)
+{
+    char headers[2048] = {};
+    int length = snprintf(headers, sizeof(headers), "%s %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: catscale-sim\r\n",
+        method_name(client->method), client->path, client->host, client->port);
+
+    for (size_t i = 0; i < client->header_count && length < (int)sizeof(headers); i++)
+        length += snprintf(headers + length, sizeof(headers) - length, "%s: %s\r\n",
+            client->headers[i].key, client->headers[i].value);
+
+    if (length < (int)sizeof(headers))
+        length += content_length < 0
+            ? snprintf(headers + length, sizeof(headers) - length, "Transfer-Encoding: chunked\r\n\r\n")
+            : snprintf(headers + length, sizeof(headers) - length, "Content-Length: %lld\r\n\r\n", (long long)content_length);
+
+    if (length >= (int)sizeof(headers))
+        return ESP_ERR_INVALID_SIZE;
+
+    if (!send_all(client, headers, length))
+        return ESP_FAIL;
+
+    emit(client, HTTP_EVENT_HEADERS_SENT, NULL, 0, NULL, NULL);
+    return ESP_OK;
+}
+
+// Returns false on a closed connection, timeout or error.
+static bool fill_buffer(esp_http_client_handle_t client)
+{
+    if (client->buffer_start == client->buffer_end)
+    {
+        client->buffer_start = 0;
+        client->buffer_end = 0;
+    }
+    if (client->buffer_end == sizeof(client->buffer))
+        return false;
+
+    const ssize_t n = recv(client->socket, client->buffer + client->buffer_end, sizeof(client->buffer) - client->buffer_end, 0);
+    if (n <= 0)
+        return false;
+
+    client->buffer_end += (size_t)n;
+    return true;
+}
+
+// Without the line break.
+static bool read_line(esp_http_client_handle_t client, char *line, size_t size)
+{
+    while (true)
+    {
+        const char *start = client->buffer + client->buffer_start;
+        const char *end = memchr(start, '\n', client->buffer_end - client->buffer_start);
+        if (end)
+        {
+            size_t length = end - start;
+            if (length > 0 && start[length - 1] == '\r')
+                length--;
+            if (length >= size)
+                return false;
+
+            memcpy(line, start, length);
+            line[length] = '\0';
+            client->buffer_start += end - start + 1;
+            return true;
+        }
+
+        // Keep the partial line at the start of the buffer.
+        memmove(client->buffer, client->buffer + client->buffer_start, client->buffer_end - client->buffer_start);
+        client->buffer_end -= client->buffer_start;
+        client->buffer_start = 0;
+
+        if (!fill_buffer(client))
+            return false;
+    }
+}
+
+// Passes up to length bytes of the body to the event handler.
+static bool read_body(esp_http_client_handle_t client, int64_t length)
+{
+    while (length > 0)
+    {
+        if (client->buffer_start == client->buffer_end && !fill_buffer(client))
+            return false;
+
+        size_t n = client->buffer_end - client->buffer_start;
+        if ((int64_t)n > length)
+            n = (size_t)length;
+
+        emit(client, HTTP_EVENT_ON_DATA, client->buffer + client->buffer_start, (int)n, NULL, NULL);
+        client->buffer_start += n;
+        length -= (int64_t)n;
+    }
+    return true;
+}
+
+static int64_t read_response_headers(esp_http_client_handle_t client)
+{
+    char line[HTTP_CLIENT_LINE_SIZE] = {};
+
+    client->status_code = 0;
+    client->content_length = -1;
+    client->chunked = false;
+    client->close_after = false;
+
+    if (!read_line(client, line, sizeof(line)) || sscanf(line, "HTTP/1.%*d %d", &client->status_code) != 1)
+        return ESP_FAIL;
+
+    while (true)
+    {
+        if (!read_line(client, line, sizeof(line)))
+            return ESP_FAIL;
+        if (line[0] == '\0')
+            break;
+
+        char *value = strchr(line, ':');
+        if (!value)
+            continue;
+        *value++ = '\0';
+        while (*value == ' ')
+            value++;
+
+        emit(client, HTTP_EVENT_ON_HEADER, NULL, 0, line, value);
+
+        if (strcasecmp(line, "Content-Length") == 0)
+            client->content_length = atoll(value);
+        else if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasecmp(value, "chunked") == 0)
+            client->chunked = true;
+        else if (strcasecmp(line, "Connection") == 0 && strcasecmp(value, "close") == 0)
+            client->close_after = true;
+    }
+
+    client->body_pending = true;
+    return client->content_length < 0 ? 0 : client->content_length;
+}
+
+static esp_err_t read_response_body(esp_http_client_handle_t client)
+{
+    if (!client->body_pending)
+        return ESP_OK;
+    client->body_pending = false;
+
+    if (client->chunked)
+    {
+        char line[HTTP_CLIENT_LINE_SIZE] = {};
+        while (true)
+        {
+            if (!read_line(client, line, sizeof(line)))
+                return ESP_FAIL;
+            const int64_t length = strtoll(line, NULL, 16);
+            if (length == 0)
+                break;
+            if (!read_body(client, length) || !read_line(client, line, sizeof(line)))
+                return ESP_FAIL;
+        }
+        // trailers
+        do {
+            if (!read_line(client, line, sizeof(line)))
+                return ESP_FAIL;
+        } while (line[0] != '\0');
+    }
+    else if (client->content_length >= 0)
+    {
+        if (!read_body(client, client->content_length))
+            return ESP_FAIL;
+    }
+    else
+    {
+        // Until the server closes the connection.
+        while (read_body(client, sizeof(client->buffer)))
+            ;
+        client->close_after = true;
+    }
+
+    emit(client, HTTP_EVENT_ON_FINISH, NULL, 0, NULL, NULL);
+
+    if (client->close_after || !client->config.keep_alive_enable)
+        esp_http_client_close(client);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
+{
+    assert(client);
+
+    esp_err_t err = connect_socket(client);
+    if (err != ESP_OK)
+        return err;
+
+    err = send_request_headers(client, client->post_length);
+    if (err == ESP_OK && client->post_length > 0 && !send_all(client, client->post_data, client->post_length))
+        err = ESP_FAIL;
+    if (err == ESP_OK && read_response_headers(client) < 0)
+        err = ESP_FAIL;
+    if (err == ESP_OK)
+        err = read_response_body(client);
+
+    if (err != ESP_OK)
+    {
+        emit(client, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+        esp_http_client_close(client);
+    }
+
+    return err;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_length)
+{
+    assert(client);
+
+    esp_err_t err = connect_socket(client);
+    if (err != ESP_OK)
+        return err;
+
+    err = send_request_headers(client, write_length);
+    if (err != ESP_OK)
+        esp_http_client_close(client);
+
+    return err;
+}
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int length)
+{
+    assert(client);
+
+    if (client->socket < 0 || !send_all(client, buffer, length))
+        return -1;
+    return length;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    assert(client);
+
+    if (client->socket < 0)
+        return ESP_FAIL;
+
+    const int64_t content_length = read_response_headers(client);
+    if (content_length < 0)
+        esp_http_client_close(client);
+
+    return content_length;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *length)
+{
+    assert(client);
+
+    if (length)
+        *length = client->content_length < 0 ? 0 : (int)client->content_length;
+
+    const esp_err_t err = read_response_body(client);
+    if (err != ESP_OK)
+        esp_http_client_close(client);
+
+    return err;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    assert(client);
+    return client->status_code;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF http client, plain http over POSIX sockets, see esp_http_client.c.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef enum {
+    HTTP_EVENT_ERROR = 0,
+    HTTP_EVENT_ON_CONNECTED,
+    HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_HEADER_SENT = HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA,
+    HTTP_EVENT_ON_FINISH,
+    HTTP_EVENT_DISCONNECTED,
+    HTTP_EVENT_REDIRECT,
+} esp_http_client_event_id_t;
+
+typedef struct esp_http_client_event {
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t client;
+    void *data;
+    int data_len;
+    void *user_data;
+    char *header_key;
+    char *header_value;
+} esp_http_client_event_t;
+
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *evt);
+
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_PUT,
+    HTTP_METHOD_PATCH,
+    HTTP_METHOD_DELETE,
+} esp_http_client_method_t;
+
+typedef struct {
+    const char *url;
+    esp_http_client_method_t method;
+    int timeout_ms;                             // 5000 if 0
+    http_event_handle_cb event_handler;
+    void *user_data;
+    esp_err_t (*crt_bundle_attach)(void *conf); // ignored, there is no tls
+    bool keep_alive_enable;
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url);
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+// data is not copied, it has to stay valid until the request was performed.
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int length);
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client);
+
+// Streaming: open sends the request headers, write_length -1 for "Transfer-Encoding: chunked"
+// (the chunks are framed by the caller), then write the body and fetch the response.
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_length);
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int length);
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client);
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *length);
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
@@ -0,0 +1,34 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF logging of the simulation: "I (1234) tag: message" with the simulated ms.
+// One level for all tags (sim_log_level), the levels set by the firmware are ignored.
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <esp_err.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+extern esp_log_level_t sim_log_level;
+
+void sim_log_write(esp_log_level_t level, const char *tag, const char *format, ...);
+
+#define SIM_LOG(level, tag, format, ...) do { \
+        if ((level) <= sim_log_level) sim_log_write(level, tag, format, ##__VA_ARGS__); \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) SIM_LOG(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) SIM_LOG(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) SIM_LOG(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) SIM_LOG(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) SIM_LOG(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+static inline void esp_log_level_set(const char *tag, esp_log_level_t level) { (void)tag; (void)level; }
@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF system api.
+
+#include <esp_err.h>
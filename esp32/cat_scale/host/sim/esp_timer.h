@@ -0,0 +1,9 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF esp_timer api: µs of simulated time, see sim_kernel.h.
+
+#include <stdint.h>
+
+#include "sim_kernel.h"
+
+static inline int64_t esp_timer_get_time(void) { return sim_now(); }
@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in, the simulated http client has no tls.
+
+#include <esp_err.h>
@@ -0,0 +1,37 @@
+#pragma once
+
+// Host stand-in for FreeRTOS, the tasks run on the simulation kernel (sim_kernel.h).
+// Only what the simulated firmware modules use.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdFAIL                  (pdFALSE)
+#define pdPASS                  (pdTRUE)
+
+#define configTICK_RATE_HZ      (CONFIG_FREERTOS_HZ)
+#define portTICK_PERIOD_MS      ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+
+// Only one task runs at a time and tasks are only switched when they wait, critical sections need no lock.
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define taskENTER_CRITICAL(mux)         ((void)(mux))
+#define taskEXIT_CRITICAL(mux)          ((void)(mux))
+
+// Simulated µs until which a call with ticks_to_wait may block, see sim_freertos.c.
+int64_t sim_freertos_deadline(TickType_t ticks_to_wait);
@@ -0,0 +1,14 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS event group api, see FreeRTOS.h.
+
+#include "FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+typedef struct sim_event_group *EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+    BaseType_t wait_for_all, TickType_t ticks_to_wait);
@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS message buffer api, see FreeRTOS.h.
+// Every message takes its length plus a 4 byte header, like on the esp32.
+
+#include "FreeRTOS.h"
+
+typedef struct sim_message_buffer *MessageBufferHandle_t;
+
+MessageBufferHandle_t xMessageBufferCreate(size_t size);
+void vMessageBufferDelete(MessageBufferHandle_t buffer);
+
+size_t xMessageBufferSend(MessageBufferHandle_t buffer, const void *data, size_t length, TickType_t ticks_to_wait);
+size_t xMessageBufferReceive(MessageBufferHandle_t buffer, void *data, size_t size, TickType_t ticks_to_wait);
+size_t xMessageBufferSpacesAvailable(MessageBufferHandle_t buffer);
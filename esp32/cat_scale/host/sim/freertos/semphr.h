@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS semaphore api, see FreeRTOS.h.
+// A mutex is a semaphore with a count of 1, there is no priority inheritance.
+
+#include "FreeRTOS.h"
+
+typedef struct sim_semaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
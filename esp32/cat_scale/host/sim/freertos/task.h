@@ -0,0 +1,20 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS task api, see FreeRTOS.h.
+
+#include "FreeRTOS.h"
+
+#define tskIDLE_PRIORITY    ((UBaseType_t)0)
+
+typedef struct sim_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+// The stack size is ignored, every task is a thread with the default stack.
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameters,
+    UBaseType_t priority, TaskHandle_t *created_task);
+void vTaskDelete(TaskHandle_t task); // only NULL, the calling task
+
+void vTaskDelay(TickType_t ticks_to_delay);
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t time_increment);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
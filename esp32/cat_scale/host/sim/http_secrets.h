@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in for the http_secrets.h of the device: every json endpoint is the local http stand-in.
+
+void get_http_secrets(int endpoint, const char **addr, const char **token);
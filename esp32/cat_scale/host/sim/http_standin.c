@@ -0,0 +1,387 @@
+// Http stand-in for influx and the CatScale service, see http_standin.h.
+// One thread polls all connections, requests are answered in order. Keep-alive and chunked bodies are supported.
+
+#define _GNU_SOURCE // memmem
+
+#include "http_standin.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define STANDIN_MAX_CONNECTIONS (8)
+#define STANDIN_MAX_REQUEST     (1024 * 1024)
+
+#define INFLUX_PATH             "/api/v2/write"
+#define EVENT_BATCH_PATH        "/api/ScaleEvent/CreateBatch"
+#define EVENT_PATH              "/api/ScaleEvent/Create"
+
+typedef struct {
+    int socket;
+    char *data;
+    size_t length;
+    size_t size;
+} connection_t;
+
+typedef struct {
+    char method[8];
+    char path[256];
+    char *body;                 // decoded, owned by the request
+    size_t body_length;
+} request_t;
+
+static http_standin_config_t g_config = {};
+static int g_listen_socket = -1;
+static connection_t g_connections[STANDIN_MAX_CONNECTIONS] = {};
+
+static pthread_mutex_t g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static http_standin_stats_t g_stats = {};
+
+static void close_connection(connection_t *connection)
+{
+    close(connection->socket);
+    free(connection->data);
+    memset(connection, 0, sizeof(connection_t));
+    connection->socket = -1;
+}
+
+static const char *find_header(const char *headers, const char *end, const char *name)
+{
+    const size_t name_length = strlen(name);
+    for (const char *line = headers; line && line < end; line = strstr(line, "\r\n"))
+    {
+        if (line[0] == '\r')
+            line += 2;
+        if (end - line > (ptrdiff_t)name_length && strncasecmp(line, name, name_length) == 0 && line[name_length] == ':')
+            return line + name_length + 1;
+    }
+    return NULL;
+}
+
+// Chunked body starting at data. Returns the bytes used, 0 if incomplete, -1 if broken.
+static long decode_chunked(const char *data, size_t length, request_t *request)
+{
+    size_t position = 0;
+    request->body_length = 0;
+
+    while (true)
+    {
+        const char *line_end = memmem(data + position, length - position, "\r\n", 2);
+        if (!line_end)
+            return 0;
+
+        char *size_end = NULL;
+        const unsigned long size = strtoul(data + position, &size_end, 16);
+        if (size_end == data + position)
+            return -1;
+        position = line_end - data + 2;
+
+        if (size == 0)
+        {
+            // no trailers
+            if (length - position < 2)
+                return 0;
+            return memcmp(data + position, "\r\n", 2) == 0 ? (long)(position + 2) : -1;
+        }
+
+        if (length - position < size + 2)
+            return 0;
+
+        memcpy(request->body + request->body_length, data + position, size);
+        request->body_length += size;
+        position += size + 2;
+    }
+}
+
+// Returns the length of the request in the buffer, 0 if it is incomplete, -1 if it is broken.
+static long parse_request(const connection_t *connection, request_t *request)
+{
+    const char *data = connection->data;
+    const char *headers_end = memmem(data, connection->length, "\r\n\r\n", 4);
+    if (!headers_end)
+        return connection->length > 16 * 1024 ? -1 : 0;
+
+    if (sscanf(data, "%7s %255s", request->method, request->path) != 2)
+        return -1;
+
+    const size_t headers_length = headers_end - data + 4;
+    const char * const transfer_encoding = find_header(data, headers_end, "Transfer-Encoding");
+    const char * const content_length = find_header(data, headers_end, "Content-Length");
+
+    request->body = malloc(connection->length - headers_length + 1);
+    assert(request->body);
+
+    if (transfer_encoding && strncasecmp(transfer_encoding + strspn(transfer_encoding, " "), "chunked", 7) == 0)
+    {
+        const long used = decode_chunked(data + headers_length, connection->length - headers_length, request);
+        if (used <= 0)
+        {
+            free(request->body);
+            request->body = NULL;
+            return used;
+        }
+        request->body[request->body_length] = '\0';
+        return (long)headers_length + used;
+    }
+
+    const size_t length = content_length ? strtoul(content_length, NULL, 10) : 0;
+    if (connection->length - headers_length < length)
+    {
+        free(request->body);
+        request->body = NULL;
+        return length > STANDIN_MAX_REQUEST ? -1 : 0;
+    }
+
+    memcpy(request->body, data + headers_length, length);
+    request->body[length] = '\0';
+    request->body_length = length;
+    return (long)(headers_length + length);
+}
+
+static uint64_t count_lines(const char *data, size_t length)
+{
+    uint64_t lines = 0;
+    for (size_t i = 0; i < length; i++)
+        if (data[i] == '\n' || (i + 1 == length && data[i] != '\n'))
+            lines++;
+    return lines;
+}
+
+// Objects at the top level of a json array.
+static uint32_t count_array_objects(const char *data, size_t length)
+{
+    uint32_t objects = 0;
+    int depth = 0;
+    bool in_string = false;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        const char c = data[i];
+        if (in_string)
+        {
+            if (c == '\\')
+                i++;
+            else if (c == '"')
+                in_string = false;
+            continue;
+        }
+
+        if (c == '"')
+            in_string = true;
+        else if (c == '[' || c == '{')
+        {
+            if (c == '{' && depth == 1)
+                objects++;
+            depth++;
+        }
+        else if (c == ']' || c == '}')
+            depth--;
+    }
+
+    return objects;
+}
+
+static int handle_request(const request_t *request)
+{
+    pthread_mutex_lock(&g_stats_lock);
+
+    g_stats.requests++;
+    int status = 404;
+
+    if (g_config.fail_every && g_stats.requests % g_config.fail_every == 0)
+    {
+        g_stats.rejected++;
+        status = 503;
+    }
+    else if (strcmp(request->method, "POST") == 0 && strncmp(request->path, INFLUX_PATH, strlen(INFLUX_PATH)) == 0)
+    {
+        g_stats.influx_requests++;
+        g_stats.influx_lines += count_lines(request->body, request->body_length);
+        g_stats.influx_bytes += request->body_length;
+        status = 204;
+    }
+    else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, EVENT_BATCH_PATH) == 0)
+    {
+        g_stats.event_requests++;
+        g_stats.events += count_array_objects(request->body, request->body_length);
+        g_stats.event_bytes += request->body_length;
+        status = 200;
+    }
+    else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, EVENT_PATH) == 0)
+    {
+        g_stats.event_requests++;
+        g_stats.events++;
+        g_stats.event_bytes += request->body_length;
+        status = 200;
+    }
+    else
+    {
+        g_stats.unknown++;
+    }
+
+    pthread_mutex_unlock(&g_stats_lock);
+
+    if (g_config.record && status / 100 == 2)
+    {
+        fprintf(g_config.record, "# %s %s\n%s%s", request->method, request->path, request->body,
+            request->body_length && request->body[request->body_length - 1] == '\n' ? "" : "\n");
+        fflush(g_config.record);
+    }
+
+    return status;
+}
+
+static bool respond(connection_t *connection, int status)
+{
+    if (g_config.latency_ms)
+        usleep(g_config.latency_ms * 1000);
+
+    const char *reason = status == 200 ? "OK" : status == 204 ? "No Content" : status == 404 ? "Not Found" : "Service Unavailable";
+    char response[128] = {};
+    const int length = snprintf(response, sizeof(response), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\n\r\n", status, reason);
+
+    return send(connection->socket, response, length, MSG_NOSIGNAL) == length;
+}
+
+// Returns false if the connection was closed.
+static bool receive(connection_t *connection)
+{
+    if (connection->size - connection->length < 4096)
+    {
+        connection->size = connection->size ? connection->size * 2 : 16 * 1024;
+        connection->data = realloc(connection->data, connection->size + 1);
+        assert(connection->data);
+    }
+
+    const ssize_t n = recv(connection->socket, connection->data + connection->length, connection->size - connection->length, 0);
+    if (n <= 0)
+        return false;
+    connection->length += (size_t)n;
+    connection->data[connection->length] = '\0';
+
+    while (connection->length > 0)
+    {
+        request_t request = {};
+        const long used = parse_request(connection, &request);
+        if (used < 0)
+            return false;
+        if (used == 0)
+            break;
+
+        const int status = handle_request(&request);
+        free(request.body);
+
+        memmove(connection->data, connection->data + used, connection->length - used);
+        connection->length -= (size_t)used;
+
+        if (!respond(connection, status))
+            return false;
+    }
+
+    return connection->length <= STANDIN_MAX_REQUEST;
+}
+
+static void accept_connection(void)
+{
+    const int s = accept(g_listen_socket, NULL, NULL);
+    if (s < 0)
+        return;
+
+    for (int i = 0; i < STANDIN_MAX_CONNECTIONS; i++)
+    {
+        if (g_connections[i].socket < 0)
+        {
+            const int one = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            g_connections[i].socket = s;
+
+            pthread_mutex_lock(&g_stats_lock);
+            g_stats.connections++;
+            pthread_mutex_unlock(&g_stats_lock);
+            return;
+        }
+    }
+
+    close(s); // too many
+}
+
+static void *standin_thread(void *arg)
+{
+    (void)arg;
+
+    while (true)
+    {
+        struct pollfd fds[STANDIN_MAX_CONNECTIONS + 1] = {};
+        fds[0] = (struct pollfd){ .fd = g_listen_socket, .events = POLLIN };
+        for (int i = 0; i < STANDIN_MAX_CONNECTIONS; i++)
+            fds[i + 1] = (struct pollfd){ .fd = g_connections[i].socket, .events = POLLIN };
+
+        if (poll(fds, STANDIN_MAX_CONNECTIONS + 1, -1) < 0)
+            continue;
+
+        for (int i = 0; i < STANDIN_MAX_CONNECTIONS; i++)
+            if (fds[i + 1].revents && !receive(&g_connections[i]))
+                close_connection(&g_connections[i]);
+
+        if (fds[0].revents & POLLIN)
+            accept_connection();
+    }
+
+    return NULL;
+}
+
+int http_standin_start(const http_standin_config_t *config)
+{
+    assert(config);
+    assert(g_listen_socket < 0);
+
+    g_config = *config;
+    for (int i = 0; i < STANDIN_MAX_CONNECTIONS; i++)
+        g_connections[i].socket = -1;
+
+    g_listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (g_listen_socket < 0)
+        return 0;
+
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = 0,
+    };
+    socklen_t address_length = sizeof(address);
+
+    if (bind(g_listen_socket, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(g_listen_socket, 4) != 0 ||
+        getsockname(g_listen_socket, (struct sockaddr *)&address, &address_length) != 0)
+    {
+        close(g_listen_socket);
+        g_listen_socket = -1;
+        return 0;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, standin_thread, NULL) != 0)
+        return 0;
+    pthread_detach(thread);
+
+    return ntohs(address.sin_port);
+}
+
+void http_standin_get_stats(http_standin_stats_t *stats)
+{
+    assert(stats);
+
+    pthread_mutex_lock(&g_stats_lock);
+    *stats = g_stats;
+    pthread_mutex_unlock(&g_stats_lock);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Local stand-in for influx (POST /api/v2/write) and the CatScale service (POST /api/ScaleEvent/Create,
+// /api/ScaleEvent/CreateBatch). Runs in its own thread outside of the simulation, counts what arrives
+// and answers like the real ones, optionally slow or with errors.
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t fail_every;        // every n-th request is answered with 503, 0 = never
+    uint32_t latency_ms;        // before every response, it counts as simulated time of the waiting task
+    FILE *record;               // the request bodies are appended here, NULL = not recorded
+} http_standin_config_t;
+
+typedef struct {
+    uint32_t connections;
+    uint32_t requests;
+    uint32_t rejected;          // answered with 503 because of fail_every
+    uint32_t unknown;           // answered with 404
+    uint32_t influx_requests;
+    uint64_t influx_lines;
+    uint64_t influx_bytes;
+    uint32_t event_requests;
+    uint32_t events;            // a batch has several
+    uint64_t event_bytes;
+} http_standin_stats_t;
+
+// Listens on a free port of 127.0.0.1. Returns the port, 0 on failure.
+int http_standin_start(const http_standin_config_t *config);
+void http_standin_get_stats(http_standin_stats_t *stats);
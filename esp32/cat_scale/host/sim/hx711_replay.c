@@ -0,0 +1,240 @@
+// Host replacement of hx711.c which replays recordings, see hx711_replay.h.
+
+#define _DEFAULT_SOURCE // timegm
+
+#include "hx711_replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+static const char *TAG = "hx711_replay";
+
+// Above this a sample counts as late, the hx711 converts every 91 to 100 ms.
+#define HX711_REPLAY_LATE_US    (100 * 1000)
+
+typedef struct {
+    int64_t *offsets;           // µs since the first sample of the file
+    uint32_t *values;
+    size_t count;
+    int64_t first_unix_us;
+} recording_t;
+
+typedef struct {
+    uint32_t loop;
+    size_t position;            // in the play order of the channel
+    size_t row;
+    int64_t base;               // simulated µs of the first sample of the current file
+} cursor_t;
+
+static recording_t *g_recordings = NULL;
+static size_t g_recording_count = 0;
+static size_t g_replay_channels = 0;
+static uint32_t g_loops = 0;
+
+static size_t g_channel_count = 0;
+static cursor_t g_cursors[HX711_MAX_CHANNELS] = {};
+static hx711_replay_stats_t g_stats = {};
+
+// "2023-08-01T15:19:30.069Z,8448450.00"
+static bool parse_line(const char *line, int64_t *unix_us, uint32_t *value)
+{
+    struct tm tm = {};
+    double seconds = 0.0;
+    double raw = 0.0;
+
+    if (sscanf(line, "%d-%d-%dT%d:%d:%lfZ,%lf", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+            &tm.tm_hour, &tm.tm_min, &seconds, &raw) != 7)
+        return false;
+    if (raw < 0.0 || raw > (double)UINT32_MAX)
+        return false;
+
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_sec = 0;
+
+    *unix_us = (int64_t)timegm(&tm) * 1000 * 1000 + llround(seconds * 1e6);
+    *value = (uint32_t)llround(raw);
+    return true;
+}
+
+static esp_err_t load_recording(const char *file, recording_t *recording)
+{
+    FILE * const f = fopen(file, "r");
+    if (!f)
+    {
+        ESP_LOGE(TAG, "can't open %s", file);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    size_t capacity = 0;
+    char line[128] = {};
+    while (fgets(line, sizeof(line), f))
+    {
+        int64_t unix_us = 0;
+        uint32_t value = 0;
+        if (!parse_line(line, &unix_us, &value))
+            continue;
+
+        if (recording->count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            recording->offsets = realloc(recording->offsets, capacity * sizeof(int64_t));
+            recording->values = realloc(recording->values, capacity * sizeof(uint32_t));
+            assert(recording->offsets && recording->values);
+        }
+
+        if (recording->count == 0)
+            recording->first_unix_us = unix_us;
+
+        // Keep the replay monotonic, even if the clock of the recording was stepped.
+        int64_t offset = unix_us - recording->first_unix_us;
+        if (recording->count > 0 && offset < recording->offsets[recording->count - 1])
+            offset = recording->offsets[recording->count - 1];
+
+        recording->offsets[recording->count] = offset;
+        recording->values[recording->count] = value;
+        recording->count++;
+    }
+
+    fclose(f);
+
+    if (recording->count == 0)
+    {
+        ESP_LOGE(TAG, "no samples in %s", file);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    ESP_LOGI(TAG, "%s: %zu samples, %lld s", file, recording->count,
+        recording->offsets[recording->count - 1] / 1000 / 1000);
+    return ESP_OK;
+}
+
+esp_err_t hx711_replay_load(const char * const *files, size_t file_count, size_t channels, uint32_t loops)
+{
+    assert(files);
+    assert(file_count > 0);
+    assert(channels > 0 && channels <= HX711_MAX_CHANNELS);
+    assert(loops > 0);
+
+    g_recordings = calloc(file_count, sizeof(recording_t));
+    assert(g_recordings);
+
+    for (size_t i = 0; i < file_count; i++)
+    {
+        const esp_err_t err = load_recording(files[i], &g_recordings[i]);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    g_recording_count = file_count;
+    g_replay_channels = channels;
+    g_loops = loops;
+
+    for (size_t i = 0; i < HX711_MAX_CHANNELS; i++)
+        g_cursors[i] = (cursor_t){ .base = HX711_REPLAY_START_US };
+
+    return ESP_OK;
+}
+
+uint64_t hx711_replay_sample_count(void)
+{
+    uint64_t count = 0;
+    for (size_t i = 0; i < g_recording_count; i++)
+        count += g_recordings[i].count;
+    return count * g_loops * g_replay_channels;
+}
+
+int64_t hx711_replay_end_time(void)
+{
+    // The same for every channel, they play the same files in a different order.
+    int64_t duration = 0;
+    for (size_t i = 0; i < g_recording_count; i++)
+        duration += g_recordings[i].offsets[g_recordings[i].count - 1] + HX711_REPLAY_GAP_US;
+    return HX711_REPLAY_START_US + duration * g_loops - HX711_REPLAY_GAP_US;
+}
+
+int64_t hx711_replay_start_unix_us(void)
+{
+    assert(g_recording_count > 0);
+    return g_recordings[0].first_unix_us;
+}
+
+static bool cursor_done(const cursor_t *cursor)
+{
+    return cursor->loop >= g_loops;
+}
+
+bool hx711_replay_done(void)
+{
+    for (size_t i = 0; i < g_replay_channels; i++)
+        if (!cursor_done(&g_cursors[i]))
+            return false;
+    return true;
+}
+
+void hx711_replay_get_stats(hx711_replay_stats_t *stats)
+{
+    assert(stats);
+    *stats = g_stats;
+}
+
+esp_err_t hx711_init(const hx711_channel_config_t *channels, size_t count)
+{
+    ESP_LOGI(TAG, "hx711_init %zu channels, %zu replayed", count, g_replay_channels);
+
+    assert(channels);
+    assert(count > 0 && count <= HX711_MAX_CHANNELS);
+    assert(g_recording_count > 0); // hx711_replay_load not called?
+
+    g_channel_count = count;
+    return ESP_OK;
+}
+
+uint32_t hx711_read(size_t channel, uint32_t *values)
+{
+    assert(channel < g_channel_count);
+    assert(values);
+
+    g_stats.polls++;
+
+    if (channel >= g_replay_channels)
+        return 0;
+
+    cursor_t * const cursor = &g_cursors[channel];
+    if (cursor_done(cursor))
+        return 0;
+
+    const recording_t * const recording = &g_recordings[(channel + cursor->position) % g_recording_count];
+    const int64_t sample_time = cursor->base + recording->offsets[cursor->row];
+    const int64_t now = esp_timer_get_time();
+    if (now < sample_time)
+        return 0; // conversion not done
+
+    values[channel] = recording->values[cursor->row];
+
+    const int64_t delay = now - sample_time;
+    g_stats.samples++;
+    if (delay > HX711_REPLAY_LATE_US)
+        g_stats.late_samples++;
+    if (delay > g_stats.max_delay_us)
+        g_stats.max_delay_us = delay;
+
+    if (++cursor->row == recording->count)
+    {
+        cursor->base += recording->offsets[recording->count - 1] + HX711_REPLAY_GAP_US;
+        cursor->row = 0;
+        if (++cursor->position == g_recording_count)
+        {
+            cursor->position = 0;
+            cursor->loop++;
+        }
+    }
+
+    return 1u << channel;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Replay of recorded hx711 values in place of hx711.c, the recordings of dotnet/tools/CatScale.FilterConfigTool/data:
+// one "2023-08-01T15:19:30.069Z,8448450.00" line per sample.
+//
+// The files are played back to back, loops times, on every replayed channel. Channel i starts with file i,
+// so the channels don't see the same events at the same time. hx711_read hands out the next sample of a
+// channel once the simulated time reached it. Channels are independent, there is no shared clock line.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#include "hx711.h"
+
+// First sample after boot, the hx711 needs a few conversions before its values settle.
+#define HX711_REPLAY_START_US       (500 * 1000)
+// Between the end of a file and the start of the next one.
+#define HX711_REPLAY_GAP_US         (100 * 1000)
+
+typedef struct {
+    uint32_t polls;             // hx711_read calls
+    uint32_t samples;           // handed out
+    uint32_t late_samples;      // read more than one sample period after their timestamp
+    int64_t max_delay_us;       // from the timestamp of a sample until it was read
+} hx711_replay_stats_t;
+
+// Before hx711_init. channels: how many get samples, the others are never ready.
+esp_err_t hx711_replay_load(const char * const *files, size_t file_count, size_t channels, uint32_t loops);
+
+uint64_t hx711_replay_sample_count(void);   // of all channels and loops
+int64_t hx711_replay_end_time(void);        // simulated µs of the last sample
+int64_t hx711_replay_start_unix_us(void);   // recording time of the first sample of channel 0
+bool hx711_replay_done(void);
+
+void hx711_replay_get_stats(hx711_replay_stats_t *stats);
@@ -0,0 +1,42 @@
+#pragma once
+
+// Kconfig values of the simulated firmware, as in the sdkconfig of the device unless noted.
+
+#define CONFIG_FREERTOS_HZ                          100
+#define CONFIG_FREERTOS_MAX_TASK_NAME_LEN           16
+
+// The influx and json endpoints are the local http stand-in, see http_standin.h.
+const char *sim_influx_endpoint(void);
+
+#define CONFIG_CATSCALE_INFLUX_ENDPOINT             sim_influx_endpoint()
+#define CONFIG_CATSCALE_INFLUX_ORGANIZATION         "sim"
+#define CONFIG_CATSCALE_INFLUX_BUCKET               "sim"
+#define CONFIG_CATSCALE_INFLUX_TOKEN                "sim"
+
+#define CONFIG_CATSCALE_POST_QUEUE_LENGTH           8
+#define CONFIG_CATSCALE_POST_MAX_ATTEMPTS           5
+#define CONFIG_CATSCALE_POST_RETRY_DELAY_MS         2000
+#define CONFIG_CATSCALE_POST_MAX_RETRY_DELAY_MS     60000
+#define CONFIG_CATSCALE_OUTBOX_CAPACITY             32
+#define CONFIG_CATSCALE_OUTBOX_BATCH_SIZE           10
+#define CONFIG_CATSCALE_OUTBOX_BATCH_BUFFER_SIZE    16384
+
+#define CONFIG_CATSCALE_UPLOAD_ADAPTIVE             1
+#define CONFIG_CATSCALE_UPLOAD_AGGREGATE_INTERVAL_S 10
+#define CONFIG_CATSCALE_UPLOAD_PRE_TRIGGER_S        30
+#define CONFIG_CATSCALE_UPLOAD_POST_TRIGGER_S       30
+#define CONFIG_CATSCALE_UPLOAD_IDLE_POST_INTERVAL_S 60
+
+#define CONFIG_CATSCALE_EVENT_WAVEFORM_BUFFER_SIZE  16384
+#define CONFIG_CATSCALE_EVENT_POOL_SIZE             6
+#define CONFIG_CATSCALE_EVENT_MAX_STABLE_PHASES     64
+#define CONFIG_CATSCALE_FILTER_CHECKPOINT_MAX_AGE_S 60
+#define CONFIG_CATSCALE_METRICS_INTERVAL_S          60
+
+// All four channels, the replay decides which of them get samples.
+#define CONFIG_CATSCALE_SCALE_CHANNELS              4
+
+#define CONFIG_CATSCALE_RADIO_POWER_SAVE            1
+#define CONFIG_CATSCALE_WIFI_LISTEN_INTERVAL        3
+#define CONFIG_CATSCALE_RADIO_AWAKE_CURRENT_MA      110
+#define CONFIG_CATSCALE_RADIO_SLEEP_CURRENT_MA      30
@@ -0,0 +1,160 @@
+// Stand-ins of the firmware modules which need hardware or the network, see sim_devices.h.
+
+#include "sim_devices.h"
+
+#include "bme280_user.h"
+#include "ccs811.h"
+#include "i2c_bus.h"
+#include "time.h"
+#include "live_stream.h"
+#include "metrics.h"
+
+#include <math.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+static const char *TAG = "sim_devices";
+
+// Conversion time of the bme280 in forced mode with the oversampling of bme280_user.c.
+#define SIM_BME280_MEASUREMENT_MS   (10)
+
+static int64_t g_boot_unix_us = 0;
+
+// bme280_user.h: a room which slowly warms up and cools down again over the day.
+
+esp_err_t bme280_user_init(uint32_t read_interval_ms)
+{
+    ESP_LOGI(TAG, "bme280_user_init (simulated)");
+    return ESP_OK;
+}
+
+esp_err_t bme280_user_start_measurement(uint32_t *ready_in_ms)
+{
+    assert(ready_in_ms);
+    *ready_in_ms = SIM_BME280_MEASUREMENT_MS;
+    return ESP_OK;
+}
+
+esp_err_t bme280_user_read_from_sensor(double *temp, double *pres, double *hum)
+{
+    assert(temp && pres && hum);
+
+    const double day = (double)esp_timer_get_time() / (24.0 * 3600.0 * 1e6);
+    *temp = 22.0 + 1.5 * sin(2.0 * M_PI * day);
+    *pres = 101325.0;
+    *hum = 45.0 - 5.0 * sin(2.0 * M_PI * day);
+    return ESP_OK;
+}
+
+void bme280_user_get_stats(bme280_user_stats_t *stats)
+{
+    assert(stats);
+    *stats = (bme280_user_stats_t){ .measurement_time_ms = SIM_BME280_MEASUREMENT_MS };
+}
+
+// ccs811.h: fresh air.
+
+esp_err_t ccs811_init()
+{
+    ESP_LOGI(TAG, "ccs811_init (simulated)");
+    return ESP_OK;
+}
+
+esp_err_t ccs811_get_latest_values(uint32_t *co2, uint32_t *tvoc)
+{
+    assert(co2 && tvoc);
+    *co2 = 450;
+    *tvoc = 10;
+    return ESP_OK;
+}
+
+esp_err_t ccs811_set_environment_data(double temperature, double humidity)
+{
+    return ESP_OK;
+}
+
+void ccs811_get_stats(ccs811_stats_t *stats)
+{
+    assert(stats);
+    *stats = (ccs811_stats_t){};
+}
+
+// i2c_bus.h: the simulated sensors don't use the bus.
+
+esp_err_t i2c_bus_init(void)
+{
+    return ESP_OK;
+}
+
+// time.h: synchronized SIM_TIME_SYNC_US after boot, without any drift.
+
+void sim_time_set_boot_unix_us(int64_t unix_us)
+{
+    g_boot_unix_us = unix_us;
+}
+
+esp_err_t time_init()
+{
+    ESP_LOGI(TAG, "time_init (simulated)");
+    return ESP_OK;
+}
+
+bool time_is_synchronized(void)
+{
+    return esp_timer_get_time() >= SIM_TIME_SYNC_US;
+}
+
+int64_t time_monotonic_to_unix_us(int64_t monotonic_us)
+{
+    // Like time.c the offset is 0 until the first sync.
+    return time_is_synchronized() ? g_boot_unix_us + monotonic_us : monotonic_us;
+}
+
+int64_t time_get_unix_us(void)
+{
+    return time_monotonic_to_unix_us(esp_timer_get_time());
+}
+
+// live_stream.h: nobody watches.
+
+esp_err_t live_stream_init(void)
+{
+    return ESP_OK;
+}
+
+bool live_stream_is_active(void)
+{
+    return false;
+}
+
+void live_stream_push(const live_record_t *record)
+{
+}
+
+void live_stream_get_stats(live_stream_stats_t *stats)
+{
+    assert(stats);
+    *stats = (live_stream_stats_t){};
+}
+
+// metrics.h: there are no snapshots, heap and task statistics don't exist on the host.
+
+esp_err_t metrics_init(void)
+{
+    return ESP_OK;
+}
+
+bool metrics_get_snapshot(metrics_snapshot_t *snapshot)
+{
+    return false;
+}
+
+bool metrics_append_line_protocol(char *buffer, size_t buffer_size, size_t *offset, uint32_t *sequence)
+{
+    return false;
+}
+
+void metrics_set_uploaded(uint32_t sequence)
+{
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Stand-ins of the firmware modules which need hardware or the network, see sim_devices.c:
+// bme280_user, ccs811, i2c_bus, time (sntp), live_stream and the metrics upload.
+
+#include <stdint.h>
+
+// The sntp answers this long after boot, the samples before are buffered with esp_timer timestamps.
+#define SIM_TIME_SYNC_US    (3 * 1000 * 1000)
+
+// Unix µs at boot, the clock shows it once synchronized.
+void sim_time_set_boot_unix_us(int64_t unix_us);
@@ -0,0 +1,30 @@
+// Host stand-ins of the ESP-IDF functions the simulated modules call, see esp_log.h and esp_wifi.h.
+
+#include "sim_kernel.h"
+
+#include <stdarg.h>
+
+#include <esp_log.h>
+#include <esp_wifi.h>
+
+esp_log_level_t sim_log_level = ESP_LOG_WARN;
+
+void sim_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+
+    printf("%c (%lld) %s: ", letters[level], (long long)(sim_now() / 1000), tag);
+
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+
+    putchar('\n');
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    (void)type;
+    return ESP_OK;
+}
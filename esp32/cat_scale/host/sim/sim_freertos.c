@@ -0,0 +1,385 @@
+// FreeRTOS stand-in on the simulation kernel, see sim_kernel.h.
+// The objects are only touched by the running task, the kernel makes sure there is only one.
+// Waiting is always: check, sim_wait for the object, check again. Whoever changes an object wakes its waiters.
+
+#include "sim_kernel.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/message_buffer.h>
+#include <freertos/event_groups.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TICK_US     ((int64_t)1000 * 1000 / configTICK_RATE_HZ)
+
+struct sim_queue {
+    size_t length;
+    size_t item_size;
+    size_t head;
+    size_t count;
+    uint8_t *items;
+};
+
+struct sim_semaphore {
+    uint32_t count;
+    uint32_t max_count;
+};
+
+struct sim_message_buffer {
+    size_t size;
+    size_t head;
+    size_t used;        // including the headers
+    uint8_t *data;
+};
+
+struct sim_event_group {
+    EventBits_t bits;
+};
+
+typedef uint32_t message_header_t;
+
+int64_t sim_freertos_deadline(TickType_t ticks_to_wait)
+{
+    if (ticks_to_wait == portMAX_DELAY)
+        return SIM_FOREVER;
+    return sim_now() + (int64_t)ticks_to_wait * TICK_US;
+}
+
+// Waits until the object changed. False once the deadline passed, or right away if there is no time to wait.
+static bool wait_for(const void *object, int64_t deadline)
+{
+    if (deadline <= sim_now())
+        return false;
+
+    sim_wait(object, deadline);
+    return true;
+}
+
+// tasks
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameters,
+    UBaseType_t priority, TaskHandle_t *created_task)
+{
+    (void)stack_depth;
+
+    sim_task_t * const task = sim_task_create(name, (int)priority, function, parameters);
+    if (created_task)
+        *created_task = task;
+
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    assert(!task || task == sim_task_current());
+    sim_task_exit();
+}
+
+// Like FreeRTOS the delays end on a tick.
+static void delay_until_tick(TickType_t tick)
+{
+    const int64_t deadline = (int64_t)tick * TICK_US;
+    while (sim_now() < deadline)
+        sim_wait(NULL, deadline);
+}
+
+void vTaskDelay(TickType_t ticks_to_delay)
+{
+    if (ticks_to_delay == 0)
+    {
+        sim_wait(NULL, sim_now()); // yield
+        return;
+    }
+
+    delay_until_tick(xTaskGetTickCount() + ticks_to_delay);
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t time_increment)
+{
+    assert(previous_wake_time);
+
+    *previous_wake_time += time_increment;
+    delay_until_tick(*previous_wake_time);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(sim_now() / TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return sim_task_current();
+}
+
+// queues
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    assert(length > 0);
+
+    QueueHandle_t queue = calloc(1, sizeof(struct sim_queue));
+    if (!queue)
+        return NULL;
+
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->items = calloc(length, item_size);
+    if (!queue->items)
+    {
+        free(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (!queue)
+        return;
+    free(queue->items);
+    free(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    assert(queue);
+    assert(item);
+
+    const int64_t deadline = sim_freertos_deadline(ticks_to_wait);
+    while (queue->count == queue->length)
+        if (!wait_for(queue, deadline))
+            return pdFALSE;
+
+    const size_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+    queue->count++;
+
+    sim_wake(queue);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait)
+{
+    assert(queue);
+    assert(item);
+
+    const int64_t deadline = sim_freertos_deadline(ticks_to_wait);
+    while (queue->count == 0)
+        if (!wait_for(queue, deadline))
+            return pdFALSE;
+
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+
+    sim_wake(queue);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    assert(queue);
+    return (UBaseType_t)queue->count;
+}
+
+// semaphores
+
+static SemaphoreHandle_t create_semaphore(uint32_t count, uint32_t max_count)
+{
+    SemaphoreHandle_t semaphore = calloc(1, sizeof(struct sim_semaphore));
+    if (!semaphore)
+        return NULL;
+
+    semaphore->count = count;
+    semaphore->max_count = max_count;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return create_semaphore(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return create_semaphore(0, 1);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    free(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    assert(semaphore);
+
+    const int64_t deadline = sim_freertos_deadline(ticks_to_wait);
+    while (semaphore->count == 0)
+        if (!wait_for(semaphore, deadline))
+            return pdFALSE;
+
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    assert(semaphore);
+
+    if (semaphore->count == semaphore->max_count)
+        return pdFALSE;
+
+    semaphore->count++;
+    sim_wake(semaphore);
+    return pdTRUE;
+}
+
+// message buffers
+
+MessageBufferHandle_t xMessageBufferCreate(size_t size)
+{
+    assert(size > sizeof(message_header_t));
+
+    MessageBufferHandle_t buffer = calloc(1, sizeof(struct sim_message_buffer));
+    if (!buffer)
+        return NULL;
+
+    buffer->size = size;
+    buffer->data = malloc(size);
+    if (!buffer->data)
+    {
+        free(buffer);
+        return NULL;
+    }
+
+    return buffer;
+}
+
+void vMessageBufferDelete(MessageBufferHandle_t buffer)
+{
+    if (!buffer)
+        return;
+    free(buffer->data);
+    free(buffer);
+}
+
+static void copy_in(MessageBufferHandle_t buffer, size_t offset, const void *data, size_t length)
+{
+    const size_t position = (buffer->head + offset) % buffer->size;
+    const size_t first = length < buffer->size - position ? length : buffer->size - position;
+    memcpy(buffer->data + position, data, first);
+    memcpy(buffer->data, (const uint8_t *)data + first, length - first);
+}
+
+static void copy_out(MessageBufferHandle_t buffer, size_t offset, void *data, size_t length)
+{
+    const size_t position = (buffer->head + offset) % buffer->size;
+    const size_t first = length < buffer->size - position ? length : buffer->size - position;
+    memcpy(data, buffer->data + position, first);
+    memcpy((uint8_t *)data + first, buffer->data, length - first);
+}
+
+size_t xMessageBufferSend(MessageBufferHandle_t buffer, const void *data, size_t length, TickType_t ticks_to_wait)
+{
+    assert(buffer);
+    assert(data || length == 0);
+
+    const size_t needed = sizeof(message_header_t) + length;
+    if (needed > buffer->size)
+        return 0;
+
+    const int64_t deadline = sim_freertos_deadline(ticks_to_wait);
+    while (buffer->size - buffer->used < needed)
+        if (!wait_for(buffer, deadline))
+            return 0;
+
+    const message_header_t header = (message_header_t)length;
+    copy_in(buffer, buffer->used, &header, sizeof(header));
+    copy_in(buffer, buffer->used + sizeof(header), data, length);
+    buffer->used += needed;
+
+    sim_wake(buffer);
+    return length;
+}
+
+size_t xMessageBufferReceive(MessageBufferHandle_t buffer, void *data, size_t size, TickType_t ticks_to_wait)
+{
+    assert(buffer);
+    assert(data || size == 0);
+
+    const int64_t deadline = sim_freertos_deadline(ticks_to_wait);
+    while (buffer->used == 0)
+        if (!wait_for(buffer, deadline))
+            return 0;
+
+    message_header_t header = 0;
+    copy_out(buffer, 0, &header, sizeof(header));
+    if (header > size)
+        return 0; // stays in the buffer, like in FreeRTOS
+
+    copy_out(buffer, sizeof(header), data, header);
+    buffer->head = (buffer->head + sizeof(header) + header) % buffer->size;
+    buffer->used -= sizeof(header) + header;
+
+    sim_wake(buffer);
+    return header;
+}
+
+size_t xMessageBufferSpacesAvailable(MessageBufferHandle_t buffer)
+{
+    assert(buffer);
+    return buffer->size - buffer->used;
+}
+
+// event groups
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return calloc(1, sizeof(struct sim_event_group));
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    assert(group);
+
+    group->bits |= bits;
+    sim_wake(group);
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    assert(group);
+
+    const EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+    BaseType_t wait_for_all, TickType_t ticks_to_wait)
+{
+    assert(group);
+
+    const int64_t deadline = sim_freertos_deadline(ticks_to_wait);
+    while (true)
+    {
+        const EventBits_t set = group->bits & bits;
+        if (wait_for_all ? set == bits : set != 0)
+            break;
+        if (!wait_for(group, deadline))
+            return group->bits;
+    }
+
+    const EventBits_t result = group->bits;
+    if (clear_on_exit)
+        group->bits &= ~bits;
+    return result;
+}
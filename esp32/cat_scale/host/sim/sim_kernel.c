@@ -0,0 +1,271 @@
+// Simulation kernel, see sim_kernel.h.
+// All scheduling state is protected by g_lock. The code of the running task runs without it,
+// everything else is parked on a condition variable until it is switched to.
+
+#include "sim_kernel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+
+struct sim_task {
+    char name[16];
+    int priority;
+    sim_task_function_t function;
+    void *arg;
+    pthread_cond_t cond;
+    bool runnable;
+    bool exited;
+    bool woken;                 // by sim_wake, not by the deadline
+    const void *wait_object;
+    int64_t deadline;           // simulated µs, SIM_FOREVER while not waiting for one
+};
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_scheduler_cond = PTHREAD_COND_INITIALIZER;
+
+static sim_task_t *g_tasks[SIM_MAX_TASKS] = {};
+static size_t g_task_count = 0;
+static size_t g_next_pick = 0;          // round robin between tasks of the same priority
+static sim_task_t *g_running = NULL;    // NULL while the scheduler runs
+static int64_t g_now = 0;               // simulated µs at the start of the current slice
+static int64_t g_slice_start = 0;       // wall µs when the running task got the cpu
+static sim_kernel_stats_t g_stats = {};
+
+static __thread sim_task_t *t_self = NULL;
+
+static int64_t wall_us(void)
+{
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 * 1000 + ts.tv_nsec / 1000;
+}
+
+// Call with g_lock held, from the running task. Returns once the task got the cpu again.
+static void switch_to_scheduler(sim_task_t *self)
+{
+    const int64_t busy = wall_us() - g_slice_start;
+    g_now += busy;
+    g_stats.busy_us += busy;
+
+    g_running = NULL;
+    pthread_cond_signal(&g_scheduler_cond);
+
+    while (g_running != self)
+        pthread_cond_wait(&self->cond, &g_lock);
+
+    g_slice_start = wall_us();
+}
+
+static void *task_thread(void *arg)
+{
+    sim_task_t * const self = arg;
+    t_self = self;
+
+    pthread_mutex_lock(&g_lock);
+    while (g_running != self)
+        pthread_cond_wait(&self->cond, &g_lock);
+    g_slice_start = wall_us();
+    pthread_mutex_unlock(&g_lock);
+
+    self->function(self->arg);
+
+    sim_task_exit();
+    return NULL;
+}
+
+sim_task_t *sim_task_create(const char *name, int priority, sim_task_function_t function, void *arg)
+{
+    assert(name);
+    assert(function);
+
+    sim_task_t * const task = calloc(1, sizeof(sim_task_t));
+    assert(task);
+
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    task->priority = priority;
+    task->function = function;
+    task->arg = arg;
+    task->runnable = true;
+    task->deadline = SIM_FOREVER;
+    pthread_cond_init(&task->cond, NULL);
+
+    pthread_mutex_lock(&g_lock);
+    assert(g_task_count < SIM_MAX_TASKS);
+    g_tasks[g_task_count++] = task;
+    g_stats.tasks++;
+    pthread_mutex_unlock(&g_lock);
+
+    pthread_t thread;
+    const int ret = pthread_create(&thread, NULL, task_thread, task);
+    assert(ret == 0);
+    pthread_detach(thread);
+
+    return task;
+}
+
+sim_task_t *sim_task_current(void)
+{
+    return t_self;
+}
+
+const char *sim_task_name(const sim_task_t *task)
+{
+    assert(task);
+    return task->name;
+}
+
+void sim_task_exit(void)
+{
+    sim_task_t * const self = t_self;
+    assert(self);
+
+    pthread_mutex_lock(&g_lock);
+    self->exited = true;
+    self->runnable = false;
+
+    const int64_t busy = wall_us() - g_slice_start;
+    g_now += busy;
+    g_stats.busy_us += busy;
+
+    g_running = NULL;
+    pthread_cond_signal(&g_scheduler_cond);
+    pthread_mutex_unlock(&g_lock);
+
+    pthread_exit(NULL);
+}
+
+bool sim_wait(const void *object, int64_t deadline)
+{
+    sim_task_t * const self = t_self;
+    assert(self); // only tasks can wait
+
+    pthread_mutex_lock(&g_lock);
+
+    self->runnable = false;
+    self->woken = false;
+    self->wait_object = object;
+    self->deadline = deadline;
+
+    switch_to_scheduler(self);
+
+    const bool woken = self->woken;
+    self->wait_object = NULL;
+    self->deadline = SIM_FOREVER;
+
+    pthread_mutex_unlock(&g_lock);
+
+    return woken;
+}
+
+void sim_wake(const void *object)
+{
+    assert(object);
+
+    pthread_mutex_lock(&g_lock);
+    for (size_t i = 0; i < g_task_count; i++)
+    {
+        sim_task_t * const task = g_tasks[i];
+        if (!task->runnable && !task->exited && task->wait_object == object)
+        {
+            task->runnable = true;
+            task->woken = true;
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+int64_t sim_now(void)
+{
+    // Only the running task executes code, its slice is stable while it reads it.
+    if (t_self)
+        return g_now + (wall_us() - g_slice_start);
+    return g_now;
+}
+
+// Call with g_lock held.
+static void wake_expired(void)
+{
+    for (size_t i = 0; i < g_task_count; i++)
+    {
+        sim_task_t * const task = g_tasks[i];
+        if (!task->runnable && !task->exited && task->deadline <= g_now)
+            task->runnable = true;
+    }
+}
+
+// Call with g_lock held. The highest priority wins, the tasks of the same priority take turns.
+static sim_task_t *pick_task(void)
+{
+    sim_task_t *best = NULL;
+    size_t best_index = 0;
+
+    for (size_t n = 0; n < g_task_count; n++)
+    {
+        const size_t i = (g_next_pick + n) % g_task_count;
+        sim_task_t * const task = g_tasks[i];
+        if (task->runnable && (!best || task->priority > best->priority))
+        {
+            best = task;
+            best_index = i;
+        }
+    }
+
+    if (best)
+        g_next_pick = best_index + 1;
+
+    return best;
+}
+
+// Call with g_lock held.
+static int64_t next_deadline(void)
+{
+    int64_t deadline = SIM_FOREVER;
+    for (size_t i = 0; i < g_task_count; i++)
+        if (!g_tasks[i]->exited && g_tasks[i]->deadline < deadline)
+            deadline = g_tasks[i]->deadline;
+    return deadline;
+}
+
+void sim_run_until(int64_t end)
+{
+    assert(!t_self);
+
+    pthread_mutex_lock(&g_lock);
+
+    while (g_now < end)
+    {
+        wake_expired();
+
+        sim_task_t * const task = pick_task();
+        if (!task)
+        {
+            // Everybody waits, nothing happens until the next deadline.
+            const int64_t deadline = next_deadline();
+            g_now = deadline < end ? deadline : end;
+            g_stats.jumps++;
+            continue;
+        }
+
+        g_stats.switches++;
+        g_running = task;
+        pthread_cond_signal(&task->cond);
+
+        while (g_running)
+            pthread_cond_wait(&g_scheduler_cond, &g_lock);
+    }
+
+    pthread_mutex_unlock(&g_lock);
+}
+
+void sim_get_stats(sim_kernel_stats_t *stats)
+{
+    assert(stats);
+
+    pthread_mutex_lock(&g_lock);
+    *stats = g_stats;
+    pthread_mutex_unlock(&g_lock);
+}
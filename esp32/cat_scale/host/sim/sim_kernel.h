@@ -0,0 +1,48 @@
+#pragma once
+
+// Simulation kernel for running the firmware tasks on the host, the FreeRTOS stand-in is built on it.
+//
+// Every task is a thread, but only one of them runs at a time: tasks are switched when the running
+// task waits (delay, queue, semaphore, ...), there is no preemption.
+// The simulated clock advances by the wall time the running task spends, and jumps to the next
+// deadline whenever all tasks wait. Idle time costs nothing, the firmware runs faster than real time
+// while the time it measures for its own work stays realistic.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SIM_FOREVER     (INT64_MAX)
+#define SIM_MAX_TASKS   (32)
+
+typedef struct sim_task sim_task_t;
+typedef void (*sim_task_function_t)(void *arg);
+
+typedef struct {
+    uint32_t tasks;
+    uint64_t switches;          // a task got the cpu
+    uint64_t jumps;             // all tasks waited, the clock was advanced to the next deadline
+    int64_t busy_us;            // wall time spent in the tasks
+} sim_kernel_stats_t;
+
+// The task starts once sim_run_until is called, or right away if called from a task. Never fails.
+sim_task_t *sim_task_create(const char *name, int priority, sim_task_function_t function, void *arg);
+// NULL outside of the tasks.
+sim_task_t *sim_task_current(void);
+const char *sim_task_name(const sim_task_t *task);
+// Ends the calling task.
+void sim_task_exit(void);
+
+// Blocks the calling task until sim_wake(object) or until the simulated time reaches deadline (µs).
+// Returns false if the deadline passed. A deadline which passed already just lets the other tasks run.
+bool sim_wait(const void *object, int64_t deadline);
+// Makes all tasks waiting for object runnable, they run once the calling task waits.
+void sim_wake(const void *object);
+
+// Simulated µs since the start, what esp_timer_get_time returns.
+int64_t sim_now(void);
+
+// Called from the main thread: runs the tasks until the simulated time reaches end.
+void sim_run_until(int64_t end);
+
+void sim_get_stats(sim_kernel_stats_t *stats);
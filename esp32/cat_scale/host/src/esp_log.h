@@ -0,0 +1,25 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF logging macros.
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "esp_err.h"
+
+#define ESP_LOGE(tag, format, ...) printf("E (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) printf("W (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) printf("I (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do {} while(0)
+#define ESP_LOGV(tag, format, ...) do {} while(0)
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+static inline void esp_log_level_set(const char *tag, esp_log_level_t level) {}
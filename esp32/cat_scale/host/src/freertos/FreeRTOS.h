@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS critical sections, the code under test runs in a single thread.
+
+typedef struct {
+    int owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+
+#define taskENTER_CRITICAL(mux)         do { (void)(mux); } while (0)
+#define taskEXIT_CRITICAL(mux)          do { (void)(mux); } while (0)
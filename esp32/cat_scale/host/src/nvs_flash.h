@@ -0,0 +1,10 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF nvs_flash api, see nvs_host.c.
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+esp_err_t nvs_flash_init_partition(const char *partition_label);
+esp_err_t nvs_flash_erase_partition(const char *part_name);
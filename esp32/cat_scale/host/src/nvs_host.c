@@ -0,0 +1,248 @@
+// In-memory stand-in for the ESP-IDF nvs api.
+// Values survive nvs_close, so closing and reopening a namespace behaves like a reboot.
+
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define NVS_HOST_MAX_ENTRIES    (1024)
+#define NVS_HOST_MAX_HANDLES    (16)
+#define NVS_HOST_NAME_SIZE      (16)
+
+typedef struct {
+    bool used;
+    char partition[NVS_HOST_NAME_SIZE];
+    char namespace_name[NVS_HOST_NAME_SIZE];
+    char key[NVS_HOST_NAME_SIZE];
+    void *data;
+    size_t length;
+} nvs_host_entry_t;
+
+typedef struct {
+    bool used;
+    char partition[NVS_HOST_NAME_SIZE];
+    char namespace_name[NVS_HOST_NAME_SIZE];
+} nvs_host_handle_t;
+
+static nvs_host_entry_t g_entries[NVS_HOST_MAX_ENTRIES] = {};
+static nvs_host_handle_t g_handles[NVS_HOST_MAX_HANDLES] = {};
+static size_t g_space_used = 0;
+static size_t g_space_limit = 0;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_NOT_ENOUGH_SPACE: return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+        case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+        case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+        default: return "UNKNOWN";
+    }
+}
+
+void nvs_host_reset(size_t space_limit)
+{
+    for(int i=0; i<NVS_HOST_MAX_ENTRIES; i++)
+        free(g_entries[i].data);
+
+    memset(g_entries, 0, sizeof(g_entries));
+    memset(g_handles, 0, sizeof(g_handles));
+    g_space_used = 0;
+    g_space_limit = space_limit;
+}
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+esp_err_t nvs_flash_erase(void) { return ESP_OK; }
+esp_err_t nvs_flash_init_partition(const char *partition_label) { return ESP_OK; }
+esp_err_t nvs_flash_erase_partition(const char *part_name) { return ESP_OK; }
+
+esp_err_t nvs_open_from_partition(const char *part_name, const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    assert(part_name);
+    assert(namespace_name);
+    assert(out_handle);
+
+    for(int i=0; i<NVS_HOST_MAX_HANDLES; i++)
+    {
+        nvs_host_handle_t * const handle = &g_handles[i];
+        if (handle->used)
+            continue;
+
+        handle->used = true;
+        snprintf(handle->partition, sizeof(handle->partition), "%s", part_name);
+        snprintf(handle->namespace_name, sizeof(handle->namespace_name), "%s", namespace_name);
+
+        *out_handle = (nvs_handle_t)(i + 1);
+        return ESP_OK;
+    }
+
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    return nvs_open_from_partition("nvs", namespace_name, open_mode, out_handle);
+}
+
+static nvs_host_handle_t *get_handle(nvs_handle_t handle)
+{
+    if (handle < 1 || handle > NVS_HOST_MAX_HANDLES || !g_handles[handle - 1].used)
+        return NULL;
+
+    return &g_handles[handle - 1];
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    nvs_host_handle_t * const h = get_handle(handle);
+    if (h)
+        h->used = false;
+}
+
+static bool entry_matches(const nvs_host_entry_t *entry, const nvs_host_handle_t *h)
+{
+    return entry->used &&
+        strcmp(entry->partition, h->partition) == 0 &&
+        strcmp(entry->namespace_name, h->namespace_name) == 0;
+}
+
+static nvs_host_entry_t *find_entry(const nvs_host_handle_t *h, const char *key)
+{
+    for(int i=0; i<NVS_HOST_MAX_ENTRIES; i++)
+        if (entry_matches(&g_entries[i], h) && strcmp(g_entries[i].key, key) == 0)
+            return &g_entries[i];
+
+    return NULL;
+}
+
+static void free_entry(nvs_host_entry_t *entry)
+{
+    g_space_used -= entry->length;
+    free(entry->data);
+    memset(entry, 0, sizeof(nvs_host_entry_t));
+}
+
+static esp_err_t set_value(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    nvs_host_handle_t * const h = get_handle(handle);
+    if (!h)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+
+    nvs_host_entry_t *entry = find_entry(h, key);
+    const size_t old_length = entry ? entry->length : 0;
+
+    if (g_space_limit && g_space_used - old_length + length > g_space_limit)
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+
+    if (!entry)
+    {
+        for(int i=0; i<NVS_HOST_MAX_ENTRIES && !entry; i++)
+            if (!g_entries[i].used)
+                entry = &g_entries[i];
+
+        if (!entry)
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+
+        entry->used = true;
+        snprintf(entry->partition, sizeof(entry->partition), "%s", h->partition);
+        snprintf(entry->namespace_name, sizeof(entry->namespace_name), "%s", h->namespace_name);
+        snprintf(entry->key, sizeof(entry->key), "%s", key);
+    }
+
+    void * const data = malloc(length);
+    assert(data);
+    memcpy(data, value, length);
+
+    free(entry->data);
+    entry->data = data;
+    entry->length = length;
+    g_space_used = g_space_used - old_length + length;
+
+    return ESP_OK;
+}
+
+static esp_err_t get_value(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    nvs_host_handle_t * const h = get_handle(handle);
+    if (!h)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+
+    const nvs_host_entry_t * const entry = find_entry(h, key);
+    if (!entry)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    if (!out_value)
+    {
+        *length = entry->length;
+        return ESP_OK;
+    }
+
+    if (*length < entry->length)
+        return ESP_ERR_NVS_INVALID_LENGTH;
+
+    memcpy(out_value, entry->data, entry->length);
+    *length = entry->length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    size_t length = sizeof(uint32_t);
+    return get_value(handle, key, out_value, &length);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return set_value(handle, key, &value, sizeof(uint32_t));
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return get_value(handle, key, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return set_value(handle, key, value, length);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    nvs_host_handle_t * const h = get_handle(handle);
+    if (!h)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+
+    nvs_host_entry_t * const entry = find_entry(h, key);
+    if (!entry)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    free_entry(entry);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    nvs_host_handle_t * const h = get_handle(handle);
+    if (!h)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+
+    for(int i=0; i<NVS_HOST_MAX_ENTRIES; i++)
+        if (entry_matches(&g_entries[i], h))
+            free_entry(&g_entries[i]);
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return get_handle(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
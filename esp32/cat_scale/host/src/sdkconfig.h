@@ -0,0 +1,8 @@
+#pragma once
+
+// Host values of the Kconfig options used by the code under test.
+
+#define CONFIG_CATSCALE_EVENT_MAX_STABLE_PHASES     1024 // the maximum of the Kconfig range
+#define CONFIG_CATSCALE_UPLOAD_AGGREGATE_INTERVAL_S 10
+#define CONFIG_CATSCALE_UPLOAD_POST_TRIGGER_S       30
+#define CONFIG_CATSCALE_UPLOAD_IDLE_POST_INTERVAL_S 60
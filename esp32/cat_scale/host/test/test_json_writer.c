@@ -0,0 +1,210 @@
+// Host test for json_writer.c and the scale event serialization of scale_event.c.
+
+#include "json_writer.h"
+#include "scale_event.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t calls;
+    size_t max_chunk;
+    size_t fail_after;  // 0 = never
+} test_sink_t;
+
+static esp_err_t write_test_sink(void *sink_ptr, const char *data, size_t length)
+{
+    test_sink_t * const sink = sink_ptr;
+
+    sink->calls++;
+    if (sink->fail_after && sink->calls > sink->fail_after)
+        return ESP_FAIL;
+
+    assert(length > 0);
+    assert(length <= JSON_WRITER_BUFFER_SIZE);
+    if (length > sink->max_chunk)
+        sink->max_chunk = length;
+
+    sink->data = realloc(sink->data, sink->length + length + 1);
+    assert(sink->data);
+    memcpy(sink->data + sink->length, data, length);
+    sink->length += length;
+    sink->data[sink->length] = '\0';
+
+    return ESP_OK;
+}
+
+static void free_test_sink(test_sink_t *sink)
+{
+    free(sink->data);
+    memset(sink, 0, sizeof(test_sink_t));
+}
+
+static size_t count_occurrences(const char *haystack, const char *needle)
+{
+    size_t count = 0;
+    for (const char *p = strstr(haystack, needle); p; p = strstr(p + 1, needle))
+        count++;
+    return count;
+}
+
+static void test_structure(void)
+{
+    test_sink_t sink = {};
+    json_writer_t writer;
+    json_writer_init(&writer, write_test_sink, &sink);
+
+    json_writer_begin_object(&writer, NULL);
+    json_writer_int(&writer, "a", -12);
+    json_writer_begin_array(&writer, "b");
+    json_writer_double(&writer, NULL, 1.25, 1);
+    json_writer_bool(&writer, NULL, true);
+    json_writer_begin_object(&writer, NULL);
+    json_writer_end_object(&writer);
+    json_writer_begin_array(&writer, NULL);
+    json_writer_end_array(&writer);
+    json_writer_end_array(&writer);
+    json_writer_double(&writer, "c", 0.0 / 0.0, 2);
+    json_writer_string(&writer, "d", "x\"y\\z\n");
+    json_writer_end_object(&writer);
+
+    assert(json_writer_finish(&writer) == ESP_OK);
+    assert(strcmp(sink.data, "{\"a\":-12,\"b\":[1.2,true,{},[]],\"c\":null,\"d\":\"x\\\"y\\\\z\\u000a\"}") == 0);
+
+    free_test_sink(&sink);
+}
+
+static void assert_base64(const char *input, const char *expected)
+{
+    test_sink_t sink = {};
+    json_writer_t writer;
+    json_writer_init(&writer, write_test_sink, &sink);
+
+    json_writer_base64(&writer, NULL, (const uint8_t *)input, strlen(input));
+
+    assert(json_writer_finish(&writer) == ESP_OK);
+    assert(sink.length == strlen(expected) + 2);
+    assert(strncmp(sink.data + 1, expected, strlen(expected)) == 0);
+
+    free_test_sink(&sink);
+}
+
+static void test_base64(void)
+{
+    assert_base64("", "");
+    assert_base64("f", "Zg==");
+    assert_base64("fo", "Zm8=");
+    assert_base64("foo", "Zm9v");
+    assert_base64("foobar", "Zm9vYmFy");
+}
+
+static void test_sink_error_is_sticky(void)
+{
+    test_sink_t sink = { .fail_after = 2 };
+    json_writer_t writer;
+    json_writer_init(&writer, write_test_sink, &sink);
+
+    json_writer_begin_array(&writer, NULL);
+    for (int i = 0; i < 1000; i++)
+        json_writer_int(&writer, NULL, i);
+    json_writer_end_array(&writer);
+
+    assert(json_writer_finish(&writer) == ESP_FAIL);
+    assert(sink.calls == 3); // nothing is written after the first error
+
+    free_test_sink(&sink);
+}
+
+static void test_scale_event_with_many_stable_phases(void)
+{
+    // As many as the device can be configured to keep.
+    const size_t stable_phase_count = CONFIG_CATSCALE_EVENT_MAX_STABLE_PHASES;
+
+    static scale_event_t scale_event; // too large for the stack
+    static uint8_t waveform_buffer[64 * 1024];
+
+    // recorded 5 s after boot, before the clock was synchronized
+    const int64_t start = 5 * 1000000LL;
+    const int64_t unix_offset_us = 1700000000LL * 1000000 - start;
+    scale_event_reset(&scale_event, 2, start, waveform_buffer, sizeof(waveform_buffer));
+    scale_event.temperature = 21.5;
+    scale_event.humidity = 40.25;
+    scale_event.pressure = 100000.0;
+
+    for (size_t i = 0; i < stable_phase_count; i++)
+    {
+        const int64_t timestamp = start + i * 1000000LL + 500000;
+        scale_event_add_stable_phase(&scale_event, timestamp, 2.0, 4500.0 + i);
+        scale_event_add_sample(&scale_event, timestamp, 100000.0 + i, 4500.0 + i);
+    }
+    scale_event.end = start + stable_phase_count * 1000000LL;
+
+    // full document, with waveform
+    test_sink_t sink = {};
+    json_writer_t writer;
+    json_writer_init(&writer, write_test_sink, &sink);
+    scale_event_write_json(&scale_event, false, unix_offset_us, &writer);
+    assert(json_writer_finish(&writer) == ESP_OK);
+
+    assert(sink.length > 64 * 1024);
+    assert(sink.max_chunk <= JSON_WRITER_BUFFER_SIZE);
+    assert(count_occurrences(sink.data, "\"timestamp\"") == stable_phase_count);
+    assert(strncmp(sink.data, "{\"toiletId\":2,\"startTime\":\"2023-11-14T22:13:20.000Z\",", 52) == 0);
+    assert(strstr(sink.data, "\"endTime\":\"2023-11-14T22:30:24.000Z\","));
+    assert(strstr(sink.data, "{\"timestamp\":\"2023-11-14T22:13:20.500Z\",\"length\":2.0,\"value\":4500.0},"));
+    assert(strstr(sink.data, "\"value\":5523.0}],\"waveform\":{\"sampleCount\":1024,\"truncated\":false,\"data\":\""));
+    assert(sink.data[sink.length - 1] == '}');
+    assert(count_occurrences(sink.data, "{") == count_occurrences(sink.data, "}"));
+    free_test_sink(&sink);
+
+    // compact document, without waveform
+    json_writer_init(&writer, write_test_sink, &sink);
+    scale_event_write_json(&scale_event, true, unix_offset_us, &writer);
+    assert(json_writer_finish(&writer) == ESP_OK);
+
+    assert(count_occurrences(sink.data, "\"timestamp\"") == stable_phase_count);
+    assert(!strstr(sink.data, "waveform"));
+    free_test_sink(&sink);
+}
+
+static void test_scale_event_overflow(void)
+{
+    static scale_event_t scale_event;
+    uint8_t waveform_buffer[16];
+
+    const int64_t start = 1000000;
+    scale_event_reset(&scale_event, 1, start, waveform_buffer, sizeof(waveform_buffer));
+
+    for (size_t i = 0; i < CONFIG_CATSCALE_EVENT_MAX_STABLE_PHASES + 3; i++)
+        scale_event_add_stable_phase(&scale_event, start, 1.0, i);
+
+    assert(scale_event.stable_phase_count == CONFIG_CATSCALE_EVENT_MAX_STABLE_PHASES);
+    assert(scale_event.stable_phases_dropped == 3);
+    assert(scale_event.stable_phases[0].value == 0.0); // first ones are kept
+
+    for (int i = 0; i < 10; i++)
+        scale_event_add_sample(&scale_event, start + i * 50000, 100000.0 * i, 1.0);
+
+    assert(scale_event.waveform.truncated);
+    assert(scale_event.waveform.sample_count > 0 && scale_event.waveform.sample_count < 10);
+    assert(scale_event.waveform.length <= sizeof(waveform_buffer));
+
+    // first sample: 0 ms, raw 0, weight 10 (0.1 g)
+    assert(scale_event.waveform.data[0] == 0x00);
+    assert(scale_event.waveform.data[1] == 0x00);
+    assert(scale_event.waveform.data[2] == 0x14);
+}
+
+int main(void)
+{
+    test_structure();
+    test_base64();
+    test_sink_error_is_sticky();
+    test_scale_event_with_many_stable_phases();
+    test_scale_event_overflow();
+
+    printf("test_json_writer: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Host test for live_record.c.
+
+#include "live_record.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+static void test_layout(void)
+{
+    const live_record_t record = {
+        .channel = 2,
+        .flags = LIVE_RECORD_FLAG_VALID | LIVE_RECORD_FLAG_INPUT_SWITCH,
+        .dropped = 0x0102,
+        .sequence = 0x03040506,
+        .timestamp = 0x0708090A0B0C0D0ELL,
+        .weight_raw = 0x00ABCDEF,
+        .weight = 1.0f,
+        .stable_time = -2.0f,
+        .hold_timer = 0.5f,
+    };
+
+    uint8_t data[LIVE_RECORD_SIZE];
+    memset(data, 0xCC, sizeof(data));
+    live_record_encode(&record, data);
+
+    const uint8_t expected[LIVE_RECORD_SIZE] = {
+        0x02, 0x03, 0x02, 0x01,
+        0x06, 0x05, 0x04, 0x03,
+        0x0E, 0x0D, 0x0C, 0x0B, 0x0A, 0x09, 0x08, 0x07,
+        0xEF, 0xCD, 0xAB, 0x00,
+        0x00, 0x00, 0x80, 0x3F,     // 1.0f
+        0x00, 0x00, 0x00, 0xC0,     // -2.0f
+        0x00, 0x00, 0x00, 0x3F,     // 0.5f
+    };
+    assert(memcmp(data, expected, sizeof(expected)) == 0);
+}
+
+static void test_round_trip(void)
+{
+    const live_record_t record = {
+        .channel = 3,
+        .flags = LIVE_RECORD_FLAG_VALID,
+        .dropped = 65535,
+        .sequence = 0xFFFFFFFF,
+        .timestamp = -1234567890123LL,
+        .weight_raw = 8388607,
+        .weight = 4321.5f,
+        .stable_time = 12.25f,
+        .hold_timer = 0.0f,
+    };
+
+    uint8_t data[LIVE_RECORD_SIZE];
+    live_record_encode(&record, data);
+
+    live_record_t decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    live_record_decode(data, &decoded);
+
+    assert(decoded.channel == record.channel);
+    assert(decoded.flags == record.flags);
+    assert(decoded.dropped == record.dropped);
+    assert(decoded.sequence == record.sequence);
+    assert(decoded.timestamp == record.timestamp);
+    assert(decoded.weight_raw == record.weight_raw);
+    assert(decoded.weight == record.weight);
+    assert(decoded.stable_time == record.stable_time);
+    assert(decoded.hold_timer == record.hold_timer);
+}
+
+int main(void)
+{
+    test_layout();
+    test_round_trip();
+
+    printf("test_live_record: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Host test for log_record.c, the deferred formatting has to produce the same text as vsnprintf.
+
+#include "log_record.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <inttypes.h>
+
+static void assert_same_as_printf(const char *format, ...)
+{
+    char expected[LOG_RECORD_MAX_SIZE] = {};
+    va_list args;
+    va_start(args, format);
+    vsnprintf(expected, sizeof(expected), format, args);
+    va_end(args);
+
+    uint8_t record[LOG_RECORD_MAX_SIZE];
+    va_start(args, format);
+    const size_t record_size = log_record_encode(record, sizeof(record), format, args);
+    va_end(args);
+    assert(record_size > 0);
+
+    char actual[LOG_RECORD_MAX_SIZE] = {};
+    const size_t length = log_record_format(record, record_size, actual, sizeof(actual));
+
+    if (strcmp(expected, actual) != 0)
+        printf("format '%s': expected '%s', got '%s'\n", format, expected, actual);
+    assert(strcmp(expected, actual) == 0);
+    assert(length == strlen(expected));
+}
+
+static void test_conversions(void)
+{
+    assert_same_as_printf("no arguments\n");
+    assert_same_as_printf("I (%lu) %s: hello %d\n", 12345UL, "main", -42);
+    assert_same_as_printf("%u %x %X %o %c %%", 4000000000u, 0xbeef, 0xBEEF, 8, 'z');
+    assert_same_as_printf("%5d|%-5d|%05d|%+d", 42, 42, 42, 42);
+    assert_same_as_printf("%lld %llu %"PRIu64" %"PRId32, -1234567890123LL, 18446744073709551615ULL, (uint64_t)1 << 40, (int32_t)-7);
+    assert_same_as_printf("%zu %ld", (size_t)123456, -99L);
+    assert_same_as_printf("%0.1f %.3f %e %g %10.2f", 1.25, 3.14159, 12345.678, 0.0001, -2.5);
+    assert_same_as_printf("%*d|%-*d|%.*f", 6, 1, 4, 2, 2, 1.23456);
+    assert_same_as_printf("%s and %10s and %.3s", "abc", "right", "truncated");
+    assert_same_as_printf("%s", (const char *)NULL);
+    assert_same_as_printf("%hhd %hd", 5, 300);
+}
+
+static size_t encode_into(uint8_t *record, size_t record_size, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const size_t n = log_record_encode(record, record_size, format, args);
+    va_end(args);
+    return n;
+}
+
+static void test_long_strings_are_truncated(void)
+{
+    char long_string[LOG_RECORD_MAX_STRING * 2 + 1];
+    memset(long_string, 'a', sizeof(long_string) - 1);
+    long_string[sizeof(long_string) - 1] = '\0';
+
+    uint8_t record[LOG_RECORD_MAX_SIZE];
+    const size_t record_size = encode_into(record, sizeof(record), "[%s]", long_string);
+    assert(record_size > 0);
+
+    char text[LOG_RECORD_MAX_SIZE] = {};
+    assert(log_record_format(record, record_size, text, sizeof(text)) == LOG_RECORD_MAX_STRING + 2);
+}
+
+static void test_small_buffers(void)
+{
+    uint8_t record[LOG_RECORD_MAX_SIZE];
+
+    // record does not fit
+    assert(encode_into(record, 8, "%d %d", 1, 2) == 0);
+
+    // text is truncated
+    const size_t record_size = encode_into(record, sizeof(record), "value=%d", 123456);
+    assert(record_size > 0);
+
+    char text[8];
+    memset(text, 'x', sizeof(text));
+    assert(log_record_format(record, record_size, text, 6) == 5);
+    assert(strcmp(text, "value") == 0);
+    assert(text[6] == 'x');
+}
+
+int main(void)
+{
+    test_conversions();
+    test_long_strings_are_truncated();
+    test_small_buffers();
+
+    printf("test_log_record: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,284 @@
+// Host test for log_datagram.c and the receiver in tools/log_stream.c, the last test goes over udp on the loopback interface.
+
+#include "log_datagram.h"
+#include "log_stream.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define BOOT_ID (0x12345678)
+
+typedef struct {
+    char text[4096];        // lines and markers, in the order they were reported
+    uint32_t lost;
+} recorder_t;
+
+static void record_event(void *context, const log_stream_event_t *event)
+{
+    recorder_t * const recorder = context;
+    char *end = recorder->text + strlen(recorder->text);
+    const size_t free = sizeof(recorder->text) - strlen(recorder->text);
+
+    switch (event->type)
+    {
+        case LOG_STREAM_LINES:
+            snprintf(end, free, "%.*s", (int)event->length, event->lines);
+            break;
+        case LOG_STREAM_LATE_LINES:
+            snprintf(end, free, "late:%.*s", (int)event->length, event->lines);
+            break;
+        case LOG_STREAM_LOST:
+            snprintf(end, free, "lost %u-%u\n", event->first, event->last);
+            recorder->lost += event->count;
+            break;
+        case LOG_STREAM_DEVICE_DROPPED:
+            snprintf(end, free, "dropped %u\n", event->count);
+            break;
+        case LOG_STREAM_NEW_BOOT:
+            snprintf(end, free, "boot %x\n", event->boot_id);
+            break;
+    }
+}
+
+// One datagram with the line "<sequence>".
+static size_t build(uint8_t *out, uint32_t boot_id, uint32_t sequence, uint32_t dropped)
+{
+    static log_datagram_builder_t builder;
+    log_datagram_builder_reset(&builder);
+
+    char line[16];
+    const int length = snprintf(line, sizeof(line), "%u\n", sequence);
+    assert(log_datagram_builder_append(&builder, line, length));
+
+    const size_t size = log_datagram_builder_finish(&builder, boot_id, sequence, dropped);
+    memcpy(out, builder.data, size);
+    return size;
+}
+
+static void receive(log_stream_t *stream, uint32_t boot_id, uint32_t sequence, uint32_t dropped, int64_t now_ms)
+{
+    uint8_t data[LOG_DATAGRAM_MAX_SIZE];
+    const size_t size = build(data, boot_id, sequence, dropped);
+    log_stream_receive(stream, data, size, now_ms);
+}
+
+static void test_builder_round_trip(void)
+{
+    static log_datagram_builder_t builder;
+    log_datagram_builder_reset(&builder);
+
+    assert(log_datagram_builder_append(&builder, "first\n", 6));
+    assert(log_datagram_builder_append(&builder, "second without newline", 22));
+
+    const size_t size = log_datagram_builder_finish(&builder, 0xCAFEBABE, 7, 3);
+    assert(size == LOG_DATAGRAM_HEADER_SIZE + 6 + 23);
+
+    log_datagram_header_t header = {};
+    const char *payload = NULL;
+    size_t payload_length = 0;
+    assert(log_datagram_parse(builder.data, size, &header, &payload, &payload_length));
+    assert(header.line_count == 2);
+    assert(header.boot_id == 0xCAFEBABE);
+    assert(header.sequence == 7);
+    assert(header.dropped == 3);
+    assert(payload_length == 29);
+    assert(memcmp(payload, "first\nsecond without newline\n", 29) == 0);
+
+    // Not a datagram.
+    assert(!log_datagram_parse((const uint8_t *)"hello world, this is no datagram", 32, &header, &payload, &payload_length));
+    assert(!log_datagram_parse(builder.data, LOG_DATAGRAM_HEADER_SIZE - 1, &header, &payload, &payload_length));
+}
+
+static void test_builder_fills_up(void)
+{
+    static log_datagram_builder_t builder;
+    log_datagram_builder_reset(&builder);
+
+    char line[100];
+    memset(line, 'x', sizeof(line));
+    line[sizeof(line) - 1] = '\n';
+
+    size_t lines = 0;
+    while (log_datagram_builder_append(&builder, line, sizeof(line)))
+        lines++;
+
+    assert(lines == (LOG_DATAGRAM_MAX_SIZE - LOG_DATAGRAM_HEADER_SIZE) / sizeof(line));
+    assert(builder.line_count == lines);
+    assert(builder.length <= LOG_DATAGRAM_MAX_SIZE);
+
+    // A line longer than a datagram is truncated if it is the only one.
+    char long_line[2 * LOG_DATAGRAM_MAX_SIZE];
+    memset(long_line, 'y', sizeof(long_line));
+    assert(!log_datagram_builder_append(&builder, long_line, sizeof(long_line)));
+    log_datagram_builder_reset(&builder);
+    assert(log_datagram_builder_append(&builder, long_line, sizeof(long_line)));
+    assert(builder.length == LOG_DATAGRAM_MAX_SIZE);
+    assert(builder.data[LOG_DATAGRAM_MAX_SIZE - 1] == '\n');
+}
+
+static void test_in_order(void)
+{
+    static log_stream_t stream;
+    recorder_t recorder = {};
+    log_stream_init(&stream, record_event, &recorder);
+
+    // The receiver was started while the device was already running.
+    for (uint32_t i = 10; i < 13; i++)
+        receive(&stream, BOOT_ID, i, 0, 0);
+
+    assert(strcmp(recorder.text, "boot 12345678\n10\n11\n12\n") == 0);
+    assert(stream.stats.lost == 0);
+    assert(stream.stats.datagrams == 3);
+}
+
+static void test_reordered(void)
+{
+    static log_stream_t stream;
+    recorder_t recorder = {};
+    log_stream_init(&stream, record_event, &recorder);
+
+    receive(&stream, BOOT_ID, 0, 0, 0);
+    receive(&stream, BOOT_ID, 2, 0, 0);
+    receive(&stream, BOOT_ID, 3, 0, 0);
+    receive(&stream, BOOT_ID, 1, 0, 0);
+    receive(&stream, BOOT_ID, 3, 0, 0);
+
+    assert(strcmp(recorder.text, "boot 12345678\n0\n1\n2\n3\nlate:3\n") == 0);
+    assert(stream.stats.lost == 0);
+}
+
+static void test_gap_after_timeout(void)
+{
+    static log_stream_t stream;
+    recorder_t recorder = {};
+    log_stream_init(&stream, record_event, &recorder);
+
+    receive(&stream, BOOT_ID, 0, 0, 0);
+    receive(&stream, BOOT_ID, 1, 0, 0);
+    receive(&stream, BOOT_ID, 4, 0, 100);
+    receive(&stream, BOOT_ID, 5, 0, 200);
+
+    // Still waiting for 2 and 3.
+    log_stream_poll(&stream, 100 + LOG_STREAM_REORDER_TIMEOUT_MS - 1);
+    assert(strcmp(recorder.text, "boot 12345678\n0\n1\n") == 0);
+
+    log_stream_poll(&stream, 100 + LOG_STREAM_REORDER_TIMEOUT_MS);
+    assert(strcmp(recorder.text, "boot 12345678\n0\n1\nlost 2-3\n4\n5\n") == 0);
+
+    // Arrives after it was given up.
+    receive(&stream, BOOT_ID, 3, 0, 2000);
+    receive(&stream, BOOT_ID, 6, 0, 2000);
+    assert(strcmp(recorder.text, "boot 12345678\n0\n1\nlost 2-3\n4\n5\nlate:3\n6\n") == 0);
+    assert(stream.stats.lost == 2);
+    assert(stream.stats.late == 1);
+}
+
+static void test_gap_when_window_full(void)
+{
+    static log_stream_t stream;
+    recorder_t recorder = {};
+    log_stream_init(&stream, record_event, &recorder);
+
+    receive(&stream, BOOT_ID, 0, 0, 0);
+    for (uint32_t i = 2; i < 2 + LOG_STREAM_REORDER_WINDOW; i++)
+        receive(&stream, BOOT_ID, i, 0, 0);
+    assert(strcmp(recorder.text, "boot 12345678\n0\n") == 0);
+
+    receive(&stream, BOOT_ID, 2 + LOG_STREAM_REORDER_WINDOW, 0, 0);
+    assert(strncmp(recorder.text, "boot 12345678\n0\nlost 1-1\n2\n3\n", 28) == 0);
+    assert(stream.stats.lost == 1);
+    assert(stream.next_sequence == 3 + LOG_STREAM_REORDER_WINDOW);
+}
+
+static void test_reboot_and_device_drops(void)
+{
+    static log_stream_t stream;
+    recorder_t recorder = {};
+    log_stream_init(&stream, record_event, &recorder);
+
+    receive(&stream, BOOT_ID, 0, 0, 0);
+    receive(&stream, BOOT_ID, 1, 5, 0);
+    receive(&stream, BOOT_ID, 3, 5, 0);
+
+    // The new boot gives up on datagram 2 of the old one, its own first datagram got lost.
+    receive(&stream, 0xABCD, 1, 0, 0);
+    receive(&stream, 0xABCD, 2, 2, 0);
+
+    assert(strcmp(recorder.text,
+        "boot 12345678\n0\ndropped 5\n1\nlost 2-2\n3\n"
+        "boot abcd\nlost 0-0\n1\ndropped 2\n2\n") == 0);
+    assert(stream.stats.boots == 2);
+    assert(stream.stats.lost == 2);
+    assert(stream.stats.device_dropped == 7);
+}
+
+static void test_loopback(void)
+{
+    const int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    assert(receiver >= 0);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    assert(bind(receiver, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    socklen_t addr_length = sizeof(addr);
+    assert(getsockname(receiver, (struct sockaddr *)&addr, &addr_length) == 0);
+
+    const int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    assert(sender >= 0);
+
+    // 100 datagrams, every 10th one is not sent.
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        if (i % 10 == 5)
+            continue;
+
+        uint8_t data[LOG_DATAGRAM_MAX_SIZE];
+        const size_t size = build(data, BOOT_ID, i, 0);
+        assert(sendto(sender, data, size, 0, (struct sockaddr *)&addr, sizeof(addr)) == (ssize_t)size);
+    }
+
+    static log_stream_t stream;
+    static recorder_t recorder = {};
+    log_stream_init(&stream, record_event, &recorder);
+
+    for (size_t i = 0; i < 90; i++)
+    {
+        uint8_t buffer[LOG_DATAGRAM_MAX_SIZE + 1];
+        const ssize_t length = recv(receiver, buffer, sizeof(buffer), 0);
+        assert(length > 0);
+        log_stream_receive(&stream, buffer, (size_t)length, 0);
+    }
+    log_stream_poll(&stream, LOG_STREAM_REORDER_TIMEOUT_MS);
+
+    close(sender);
+    close(receiver);
+
+    assert(stream.stats.datagrams == 90);
+    assert(stream.stats.lines == 90);
+    assert(recorder.lost == 10);
+    assert(strstr(recorder.text, "\n4\nlost 5-5\n6\n"));
+    assert(strstr(recorder.text, "\n94\nlost 95-95\n96\n"));
+}
+
+int main(void)
+{
+    test_builder_round_trip();
+    test_builder_fills_up();
+    test_in_order();
+    test_reordered();
+    test_gap_after_timeout();
+    test_gap_when_window_full();
+    test_reboot_and_device_drops();
+    test_loopback();
+
+    printf("test_log_stream: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Host test for metrics_snapshot.c.
+
+#include "metrics_snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+static void add_task(metrics_snapshot_t *snapshot, const char *name, uint32_t number, uint32_t run_time)
+{
+    metrics_task_t * const task = &snapshot->tasks[snapshot->task_count++];
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    task->number = number;
+    task->run_time = run_time;
+    task->stack_free = 1000 + number;
+}
+
+static void test_cpu(void)
+{
+    metrics_snapshot_t previous = { .sequence = 1, .run_time = 1000000 };
+    add_task(&previous, "IDLE0", 1, 900000);
+    add_task(&previous, "sensors", 2, 50000);
+
+    // First snapshot: usage since boot.
+    metrics_update_cpu(&previous, NULL);
+    assert(previous.tasks[0].cpu_permille == 900);
+    assert(previous.tasks[1].cpu_permille == 50);
+
+    metrics_snapshot_t current = { .sequence = 2, .run_time = 3000000 };
+    add_task(&current, "sensors", 2, 250000);
+    add_task(&current, "IDLE0", 1, 2500000);
+    add_task(&current, "new", 7, 20000);
+    metrics_update_cpu(&current, &previous);
+
+    assert(current.tasks[0].cpu_permille == 100);   // 200 ms of 2 s
+    assert(current.tasks[1].cpu_permille == 800);
+    assert(current.tasks[2].cpu_permille == 10);    // started in between
+
+    // The run time counters wrap after about 71 minutes.
+    metrics_snapshot_t wrapped = { .sequence = 3, .run_time = 3000000 + UINT32_MAX / 2 };
+    add_task(&wrapped, "sensors", 2, 250000 + UINT32_MAX / 4);
+    metrics_snapshot_t before_wrap = { .sequence = 2, .run_time = 3000000 };
+    add_task(&before_wrap, "sensors", 2, 250000);
+    wrapped.run_time += UINT32_MAX / 2 + 1;           // wraps
+    wrapped.tasks[0].run_time += UINT32_MAX / 2 + 1;  // wraps as well
+    metrics_update_cpu(&wrapped, &before_wrap);
+    assert(wrapped.tasks[0].cpu_permille > 740 && wrapped.tasks[0].cpu_permille < 760);
+
+    // No time passed, no division by zero.
+    metrics_snapshot_t same = current;
+    metrics_update_cpu(&same, &current);
+    assert(same.tasks[0].cpu_permille == 0);
+}
+
+static void test_fragmentation(void)
+{
+    metrics_snapshot_t snapshot = { .heap_free = 100000, .heap_largest_block = 25000 };
+    assert(metrics_heap_fragmentation(&snapshot) == 750);
+
+    snapshot.heap_largest_block = 100000;
+    assert(metrics_heap_fragmentation(&snapshot) == 0);
+
+    snapshot.heap_free = 0;
+    snapshot.heap_largest_block = 0;
+    assert(metrics_heap_fragmentation(&snapshot) == 0);
+}
+
+typedef struct {
+    size_t count;
+    int64_t fast_overflows;
+    int64_t influx_failures;
+    int64_t post1_outbox_level;
+    int64_t wifi_rssi;
+    int64_t wifi_max_outage_ms;
+} field_recorder_t;
+
+static void record_field(void *context, const char *name, int64_t value)
+{
+    field_recorder_t * const recorder = context;
+    recorder->count++;
+
+    if (strcmp(name, "fast_overflows") == 0) recorder->fast_overflows = value;
+    if (strcmp(name, "influx_failures") == 0) recorder->influx_failures = value;
+    if (strcmp(name, "post1_outbox_level") == 0) recorder->post1_outbox_level = value;
+    if (strcmp(name, "wifi_rssi") == 0) recorder->wifi_rssi = value;
+    if (strcmp(name, "wifi_max_outage_ms") == 0) recorder->wifi_max_outage_ms = value;
+}
+
+static void test_fields(void)
+{
+    metrics_snapshot_t snapshot = {};
+    snapshot.buffers[METRICS_BUFFER_FAST].overflows = 3;
+    snapshot.http[METRICS_HTTP_INFLUX].failures = 4;
+    snapshot.post[1].outbox_level = 5;
+    snapshot.wifi.rssi = -67;
+    snapshot.wifi.max_outage_ms = 4200;
+
+    field_recorder_t recorder = {};
+    metrics_for_each_field(&snapshot, record_field, &recorder);
+
+    assert(recorder.count == 5 + METRICS_BUFFER_COUNT * 4 + 4 + METRICS_HTTP_COUNT * 4 + METRICS_POST_ENDPOINT_COUNT * 5 + 8);
+    assert(recorder.fast_overflows == 3);
+    assert(recorder.influx_failures == 4);
+    assert(recorder.post1_outbox_level == 5);
+    assert(recorder.wifi_rssi == -67);
+    assert(recorder.wifi_max_outage_ms == 4200);
+}
+
+static void test_line_protocol(void)
+{
+    metrics_snapshot_t snapshot = { .sequence = 1, .timestamp = 61500000, .heap_free = 1000, .heap_largest_block = 800 };
+    add_task(&snapshot, "Tmr Svc", 3, 0);
+    snapshot.tasks[0].cpu_permille = 12;
+
+    char buffer[4096];
+    const size_t length = metrics_write_line_protocol(&snapshot, "CAT1", 1700000000000000000ULL, buffer, sizeof(buffer));
+    assert(length == strlen(buffer));
+
+    // One line for the device, one per task.
+    const char * const second_line = strchr(buffer, '\n') + 1;
+    assert(strncmp(buffer, "metrics,scale_id=CAT1 uptime_s=61i,heap_free=1000i,", 51) == 0);
+    assert(strstr(buffer, ",heap_fragmentation=200i,"));
+    assert(strstr(buffer, ",json1_latency_max_us=0i,"));
+    assert(second_line - buffer < (long)length);
+    assert(strncmp(second_line - 21, " 1700000000000000000\n", 21) == 0);
+    assert(strcmp(second_line, "metrics,scale_id=CAT1,task=Tmr\\ Svc cpu_permille=12i,stack_free=1003i 1700000000000000000\n") == 0);
+
+    // Does not fit: nothing is written.
+    assert(metrics_write_line_protocol(&snapshot, "CAT1", 1700000000000000000ULL, buffer, length) == 0);
+    assert(buffer[0] == '\0');
+    assert(metrics_write_line_protocol(&snapshot, "CAT1", 1700000000000000000ULL, buffer, length + 1) == length);
+}
+
+int main(void)
+{
+    test_cpu();
+    test_fragmentation();
+    test_fields();
+    test_line_protocol();
+
+    printf("test_metrics_snapshot: all tests passed\n");
+    return 0;
+}
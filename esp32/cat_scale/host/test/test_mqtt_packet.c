@@ -0,0 +1,139 @@
+// Host test for mqtt_packet.c.
+
+#include "mqtt_packet.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+static void test_connect(void)
+{
+    uint8_t data[64];
+    const size_t length = mqtt_packet_encode_connect(data, sizeof(data), "bridge", 60, false);
+
+    const uint8_t expected[] = {
+        0x10, 18,                               // CONNECT, remaining length
+        0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04,   // protocol name and level
+        0x00,                                   // flags: keep the session
+        0x00, 60,                               // keep alive
+        0x00, 0x06, 'b', 'r', 'i', 'd', 'g', 'e',
+    };
+    assert(length == sizeof(expected));
+    assert(memcmp(data, expected, sizeof(expected)) == 0);
+
+    // too small
+    assert(mqtt_packet_encode_connect(data, 10, "bridge", 60, false) == 0);
+}
+
+static void test_publish_round_trip(void)
+{
+    static uint8_t payload[20000];
+    for (size_t i = 0; i < sizeof(payload); i++)
+        payload[i] = (uint8_t)i;
+
+    static uint8_t data[sizeof(payload) + 64];
+
+    // The remaining length needs 1, 2 and 3 bytes.
+    const size_t payload_lengths[] = { 0, 100, 121, 122, 16000, sizeof(payload) };
+    for (size_t i = 0; i < sizeof(payload_lengths) / sizeof(payload_lengths[0]); i++)
+    {
+        const mqtt_publish_t publish = {
+            .topic = "catscale/influx",
+            .topic_length = 15,
+            .qos = 1,
+            .packet_id = 0x1234,
+            .payload = payload,
+            .payload_length = payload_lengths[i],
+        };
+
+        const size_t length = mqtt_packet_encode_publish(data, sizeof(data), &publish);
+        assert(length == mqtt_packet_publish_size(15, payload_lengths[i], 1));
+        assert(data[0] == 0x32); // PUBLISH, qos 1
+
+        // incomplete until the last byte
+        mqtt_packet_t packet = {};
+        assert(mqtt_packet_parse(data, 1, &packet) == 0);
+        assert(mqtt_packet_parse(data, length - 1, &packet) == 0);
+        assert(mqtt_packet_parse(data, length, &packet) == (int)length);
+        assert(packet.type == MQTT_PACKET_PUBLISH);
+
+        mqtt_publish_t parsed = {};
+        assert(mqtt_packet_parse_publish(&packet, &parsed));
+        assert(parsed.topic_length == 15 && memcmp(parsed.topic, "catscale/influx", 15) == 0);
+        assert(parsed.qos == 1);
+        assert(!parsed.dup);
+        assert(parsed.packet_id == 0x1234);
+        assert(parsed.payload_length == payload_lengths[i]);
+        assert(memcmp(parsed.payload, payload, payload_lengths[i]) == 0);
+    }
+
+    // 2 + 15 + 2 + 108 = 127 fits into one byte of remaining length, one more doesn't
+    assert(mqtt_packet_publish_size(15, 108, 1) == 1 + 1 + 127);
+    assert(mqtt_packet_publish_size(15, 109, 1) == 1 + 2 + 128);
+    assert(mqtt_packet_publish_size(15, 108, 0) == 1 + 1 + 125);
+}
+
+static void test_acks(void)
+{
+    uint8_t data[16];
+    mqtt_packet_t packet = {};
+
+    size_t length = mqtt_packet_encode_puback(data, sizeof(data), 0xBEEF);
+    assert(length == 4);
+    assert(mqtt_packet_parse(data, length, &packet) == 4);
+    uint16_t packet_id = 0;
+    assert(mqtt_packet_parse_puback(&packet, &packet_id));
+    assert(packet_id == 0xBEEF);
+
+    const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x05 };
+    assert(mqtt_packet_parse(connack, sizeof(connack), &packet) == 4);
+    uint8_t return_code = 0;
+    assert(mqtt_packet_parse_connack(&packet, &return_code));
+    assert(return_code == 5);
+    assert(!mqtt_packet_parse_puback(&packet, &packet_id));
+
+    const uint8_t suback[] = { 0x90, 0x03, 0x00, 0x01, 0x01 };
+    assert(mqtt_packet_parse(suback, sizeof(suback), &packet) == 5);
+    uint8_t granted_qos = 0;
+    assert(mqtt_packet_parse_suback(&packet, &packet_id, &granted_qos));
+    assert(packet_id == 1 && granted_qos == 1);
+
+    length = mqtt_packet_encode_subscribe(data, sizeof(data), 1, "a/#", 1);
+    const uint8_t subscribe[] = { 0x82, 0x08, 0x00, 0x01, 0x00, 0x03, 'a', '/', '#', 0x01 };
+    assert(length == sizeof(subscribe));
+    assert(memcmp(data, subscribe, sizeof(subscribe)) == 0);
+
+    assert(mqtt_packet_encode_pingreq(data, sizeof(data)) == 2);
+    assert(data[0] == 0xC0 && data[1] == 0x00);
+}
+
+static void test_malformed(void)
+{
+    mqtt_packet_t packet = {};
+
+    // more than 4 bytes of remaining length
+    const uint8_t too_long[] = { 0x30, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+    assert(mqtt_packet_parse(too_long, sizeof(too_long), &packet) == -1);
+
+    // topic longer than the packet
+    const uint8_t bad_topic[] = { 0x30, 0x03, 0x00, 0x05, 'a' };
+    assert(mqtt_packet_parse(bad_topic, sizeof(bad_topic), &packet) == 5);
+    mqtt_publish_t publish = {};
+    assert(!mqtt_packet_parse_publish(&packet, &publish));
+
+    // qos 1 without packet id
+    const uint8_t no_id[] = { 0x32, 0x03, 0x00, 0x01, 'a' };
+    assert(mqtt_packet_parse(no_id, sizeof(no_id), &packet) == 5);
+    assert(!mqtt_packet_parse_publish(&packet, &publish));
+}
+
+int main(void)
+{
+    test_connect();
+    test_publish_round_trip();
+    test_acks();
+    test_malformed();
+
+    printf("test_mqtt_packet: all tests passed\n");
+    return 0;
+}
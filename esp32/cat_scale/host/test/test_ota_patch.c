@@ -0,0 +1,222 @@
+// Host test for the delta updates: patches created by tools/ota_delta.c, applied by main/ota_patch.c.
+
+#include "ota_patch.h"
+#include "ota_delta.h"
+#include "sha256.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define OLD_SIZE (200 * 1024)
+
+typedef struct {
+    const uint8_t *old_data;
+    size_t old_size;
+    uint8_t *new_data;
+    size_t new_size;
+    size_t new_capacity;
+} image_t;
+
+static esp_err_t read_old(void *context, uint32_t offset, void *data, size_t length)
+{
+    image_t * const image = context;
+    assert(offset + length <= image->old_size);
+    memcpy(data, image->old_data + offset, length);
+    return ESP_OK;
+}
+
+static esp_err_t write_new(void *context, const void *data, size_t length)
+{
+    image_t * const image = context;
+    if (image->new_size + length > image->new_capacity)
+        return ESP_ERR_NO_MEM;
+    memcpy(image->new_data + image->new_size, data, length);
+    image->new_size += length;
+    return ESP_OK;
+}
+
+static esp_err_t check_base(void *context, uint32_t old_size, const uint8_t *old_sha256)
+{
+    image_t * const image = context;
+    if (old_size != image->old_size)
+        return ESP_ERR_INVALID_STATE;
+
+    uint8_t digest[SHA256_SIZE];
+    sha256_t sha256;
+    sha256_init(&sha256);
+    sha256_update(&sha256, image->old_data, image->old_size);
+    sha256_finish(&sha256, digest);
+
+    return memcmp(digest, old_sha256, SHA256_SIZE) == 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+static uint32_t random_state = 12345;
+
+static uint32_t next_random(void)
+{
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 8;
+}
+
+// Something resembling code: instructions with a 32 bit address every 32 bytes.
+static void make_old_image(uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; i += 32)
+    {
+        const uint32_t address = 0x400D0000 + (next_random() % 0x10000) * 4;
+        memcpy(data + i, &address, 4);
+        for (size_t j = 4; j < 32; j++)
+            data[i + j] = (uint8_t)next_random();
+    }
+}
+
+// A typical rebuild: some code inserted, all addresses behind it moved, a few constants changed.
+static size_t make_new_image(const uint8_t *old_data, uint8_t *new_data)
+{
+    size_t new_size = 0;
+
+    memcpy(new_data, old_data, 100000);
+    new_size = 100000;
+
+    for (size_t i = 0; i < 512; i++)
+        new_data[new_size++] = (uint8_t)next_random();
+
+    memcpy(new_data + new_size, old_data + 100000, OLD_SIZE - 100000 - 8000);
+    for (size_t i = new_size; i + 32 <= new_size + OLD_SIZE - 100000 - 8000; i += 32)
+    {
+        uint32_t address = 0;
+        memcpy(&address, new_data + i, 4);
+        address += 512;
+        memcpy(new_data + i, &address, 4);
+    }
+    new_size += OLD_SIZE - 100000 - 8000;
+
+    new_data[500] ^= 0x5A;
+    new_data[150000] ^= 0x01;
+
+    return new_size;
+}
+
+static esp_err_t apply(const uint8_t *patch, size_t patch_size, image_t *image, size_t chunk_size)
+{
+    ota_patch_t ota_patch;
+    ota_patch_init(&ota_patch, read_old, write_new, check_base, image);
+
+    for (size_t offset = 0; offset < patch_size; offset += chunk_size)
+    {
+        const size_t n = patch_size - offset < chunk_size ? patch_size - offset : chunk_size;
+        const esp_err_t err = ota_patch_feed(&ota_patch, patch + offset, n);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    return ota_patch_finish(&ota_patch);
+}
+
+static uint8_t old_data[OLD_SIZE];
+static uint8_t new_data[2 * OLD_SIZE];
+static uint8_t output[2 * OLD_SIZE];
+
+static void test_round_trip(void)
+{
+    make_old_image(old_data, sizeof(old_data));
+    const size_t new_size = make_new_image(old_data, new_data);
+
+    size_t patch_size = 0;
+    uint8_t * const patch = ota_delta_create(old_data, sizeof(old_data), new_data, new_size, &patch_size);
+    assert(patch);
+
+    // Moved addresses end up as identical diff bytes, that is what makes the patch compress well.
+    size_t nonzero = 0;
+    for (size_t i = OTA_PATCH_HEADER_SIZE; i < patch_size; i++)
+        if (patch[i] != 0 && patch[i] != 0x02)
+            nonzero++;
+    printf("test_ota_patch: %zu -> %zu bytes, patch %zu bytes, %zu not 0 or 2\n", sizeof(old_data), new_size, patch_size, nonzero);
+    assert(nonzero < new_size / 50);
+
+    const size_t chunk_sizes[] = { 1, 7, 300, 4096, 1 << 20 };
+    for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++)
+    {
+        image_t image = { .old_data = old_data, .old_size = sizeof(old_data), .new_data = output, .new_capacity = sizeof(output) };
+        assert(apply(patch, patch_size, &image, chunk_sizes[i]) == ESP_OK);
+        assert(image.new_size == new_size);
+        assert(memcmp(output, new_data, new_size) == 0);
+    }
+
+    free(patch);
+}
+
+static void test_identical_and_empty(void)
+{
+    size_t patch_size = 0;
+    uint8_t *patch = ota_delta_create(old_data, sizeof(old_data), old_data, sizeof(old_data), &patch_size);
+    assert(patch);
+
+    image_t image = { .old_data = old_data, .old_size = sizeof(old_data), .new_data = output, .new_capacity = sizeof(output) };
+    assert(apply(patch, patch_size, &image, 1000) == ESP_OK);
+    assert(image.new_size == sizeof(old_data));
+    assert(memcmp(output, old_data, sizeof(old_data)) == 0);
+    free(patch);
+
+    // Nothing in common with the old image.
+    patch = ota_delta_create(old_data, 0, new_data, 1000, &patch_size);
+    assert(patch);
+    image_t empty = { .old_data = old_data, .old_size = 0, .new_data = output, .new_capacity = sizeof(output) };
+    assert(apply(patch, patch_size, &empty, 1000) == ESP_OK);
+    assert(empty.new_size == 1000);
+    assert(memcmp(output, new_data, 1000) == 0);
+    free(patch);
+}
+
+static void test_rejects_bad_patches(void)
+{
+    size_t patch_size = 0;
+    uint8_t * const patch = ota_delta_create(old_data, sizeof(old_data), new_data, 100000, &patch_size);
+    assert(patch);
+
+    // Another base.
+    static uint8_t other_old[OLD_SIZE];
+    memcpy(other_old, old_data, sizeof(other_old));
+    other_old[1234] ^= 1;
+    image_t other = { .old_data = other_old, .old_size = sizeof(other_old), .new_data = output, .new_capacity = sizeof(output) };
+    assert(apply(patch, patch_size, &other, 4096) == ESP_ERR_INVALID_STATE);
+    assert(other.new_size == 0);
+
+    // Truncated.
+    image_t image = { .old_data = old_data, .old_size = sizeof(old_data), .new_data = output, .new_capacity = sizeof(output) };
+    assert(apply(patch, patch_size - 1, &image, 4096) == ESP_ERR_INVALID_SIZE);
+
+    // Trailing data.
+    uint8_t * const longer = malloc(patch_size + 1);
+    memcpy(longer, patch, patch_size);
+    longer[patch_size] = 0;
+    image.new_size = 0;
+    assert(apply(longer, patch_size + 1, &image, 4096) == ESP_ERR_INVALID_SIZE);
+    free(longer);
+
+    // A record beyond the end of the new image.
+    uint8_t * const corrupt = malloc(patch_size);
+    memcpy(corrupt, patch, patch_size);
+    memset(corrupt + OTA_PATCH_HEADER_SIZE, 0xFF, 4);
+    image.new_size = 0;
+    assert(apply(corrupt, patch_size, &image, 4096) == ESP_ERR_INVALID_SIZE);
+
+    // Not a patch at all.
+    memcpy(corrupt, "XXXX", 4);
+    image.new_size = 0;
+    assert(apply(corrupt, patch_size, &image, 4096) == ESP_ERR_INVALID_VERSION);
+    free(corrupt);
+
+    free(patch);
+}
+
+int main(void)
+{
+    test_round_trip();
+    test_identical_and_empty();
+    test_rejects_bad_patches();
+
+    printf("test_ota_patch: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,163 @@
+// Host test for outbox.c, runs against the in-memory nvs of nvs_host.c.
+
+#include "outbox.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static void push_string(outbox_t *outbox, const char *s)
+{
+    assert(outbox_push(outbox, s, strlen(s) + 1) == ESP_OK);
+}
+
+static void assert_entry(outbox_t *outbox, size_t index, const char *expected)
+{
+    char buffer[64] = {};
+    size_t length = sizeof(buffer);
+    assert(outbox_peek(outbox, index, buffer, &length) == ESP_OK);
+    assert(length == strlen(expected) + 1);
+    assert(strcmp(buffer, expected) == 0);
+}
+
+static void test_fifo_order(void)
+{
+    nvs_host_reset(0);
+    outbox_t *outbox = outbox_create("ob", 4);
+    assert(outbox);
+    assert(outbox_count(outbox) == 0);
+
+    push_string(outbox, "a");
+    push_string(outbox, "b");
+    push_string(outbox, "c");
+    assert(outbox_count(outbox) == 3);
+    assert_entry(outbox, 0, "a");
+    assert_entry(outbox, 2, "c");
+
+    char buffer[8];
+    size_t length = sizeof(buffer);
+    assert(outbox_peek(outbox, 3, buffer, &length) == ESP_ERR_NOT_FOUND);
+
+    assert(outbox_remove(outbox, 2) == ESP_OK);
+    assert(outbox_count(outbox) == 1);
+    assert_entry(outbox, 0, "c");
+
+    // Wrap around the key space.
+    push_string(outbox, "d");
+    push_string(outbox, "e");
+    push_string(outbox, "f");
+    assert(outbox_count(outbox) == 4);
+    assert_entry(outbox, 0, "c");
+    assert_entry(outbox, 3, "f");
+
+    assert(outbox_remove(outbox, 10) == ESP_OK);
+    assert(outbox_count(outbox) == 0);
+
+    outbox_destroy(outbox);
+}
+
+static void test_persistence(void)
+{
+    nvs_host_reset(0);
+    outbox_t *outbox = outbox_create("ob", 4);
+    push_string(outbox, "first");
+    push_string(outbox, "second");
+    outbox_remove(outbox, 1);
+    push_string(outbox, "third");
+    outbox_destroy(outbox);
+
+    // Same namespace after a "reboot".
+    outbox = outbox_create("ob", 4);
+    assert(outbox_count(outbox) == 2);
+    assert_entry(outbox, 0, "second");
+    assert_entry(outbox, 1, "third");
+    outbox_destroy(outbox);
+
+    // Other namespaces are independent.
+    outbox = outbox_create("other", 4);
+    assert(outbox_count(outbox) == 0);
+    outbox_destroy(outbox);
+}
+
+static void test_overflow_drops_oldest(void)
+{
+    nvs_host_reset(0);
+    outbox_t *outbox = outbox_create("ob", 3);
+
+    push_string(outbox, "1");
+    push_string(outbox, "2");
+    push_string(outbox, "3");
+    push_string(outbox, "4");
+    push_string(outbox, "5");
+
+    assert(outbox_count(outbox) == 3);
+    assert(outbox->dropped == 2);
+    assert_entry(outbox, 0, "3");
+    assert_entry(outbox, 2, "5");
+
+    outbox_destroy(outbox);
+}
+
+static void test_flash_full_drops_oldest(void)
+{
+    // Room for the three u32 indices plus two 10 byte entries.
+    nvs_host_reset(3 * sizeof(uint32_t) + 2 * 10);
+    outbox_t *outbox = outbox_create("ob", 8);
+
+    push_string(outbox, "123456789");
+    push_string(outbox, "abcdefghi");
+    push_string(outbox, "ABCDEFGHI");
+
+    assert(outbox_count(outbox) == 2);
+    assert(outbox->dropped == 1);
+    assert_entry(outbox, 0, "abcdefghi");
+    assert_entry(outbox, 1, "ABCDEFGHI");
+
+    // An entry that never fits is rejected after the outbox ran empty.
+    char big[64];
+    memset(big, 'x', sizeof(big));
+    assert(outbox_push(outbox, big, sizeof(big)) == ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    assert(outbox_count(outbox) == 0);
+
+    outbox_destroy(outbox);
+}
+
+static void test_buffer_too_small(void)
+{
+    nvs_host_reset(0);
+    outbox_t *outbox = outbox_create("ob", 4);
+    push_string(outbox, "0123456789");
+
+    char buffer[4];
+    size_t length = sizeof(buffer);
+    assert(outbox_peek(outbox, 0, buffer, &length) == ESP_ERR_INVALID_SIZE);
+    assert(length == 11);
+
+    outbox_destroy(outbox);
+}
+
+static void test_capacity_change_clears(void)
+{
+    nvs_host_reset(0);
+    outbox_t *outbox = outbox_create("ob", 4);
+    push_string(outbox, "a");
+    outbox_destroy(outbox);
+
+    outbox = outbox_create("ob", 8);
+    assert(outbox_count(outbox) == 0);
+    push_string(outbox, "b");
+    assert_entry(outbox, 0, "b");
+    outbox_destroy(outbox);
+}
+
+int main(void)
+{
+    test_fifo_order();
+    test_persistence();
+    test_overflow_drops_oldest();
+    test_flash_full_drops_oldest();
+    test_buffer_too_small();
+    test_capacity_change_clears();
+
+    printf("test_outbox: all tests passed\n");
+    return 0;
+}
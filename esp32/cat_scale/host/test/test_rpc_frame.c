@@ -0,0 +1,119 @@
+// Host test for rpc_frame.c.
+
+#include "rpc_frame.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+static void test_header(void)
+{
+    const rpc_frame_header_t header = { .command = RPC_COMMAND_SET_SETTING, .sequence = 7, .length = 0x0102 };
+    uint8_t data[RPC_FRAME_HEADER_SIZE];
+    rpc_frame_encode_header(&header, data);
+
+    const uint8_t expected[] = { 0x04, 0x07, 0x02, 0x01 };
+    assert(memcmp(data, expected, sizeof(expected)) == 0);
+
+    rpc_frame_header_t decoded = {};
+    assert(rpc_frame_decode_header(data, &decoded));
+    assert(decoded.command == header.command);
+    assert(decoded.sequence == header.sequence);
+    assert(decoded.length == header.length);
+
+    // Longer payloads than the device can buffer are rejected.
+    const uint8_t too_long[] = { 0x01, 0x00, 0x01, 0x10 };
+    assert(!rpc_frame_decode_header(too_long, &decoded));
+}
+
+static void test_round_trip(void)
+{
+    uint8_t data[64];
+    rpc_writer_t writer;
+    rpc_writer_init(&writer, data, sizeof(data));
+
+    rpc_put_u8(&writer, 0xAB);
+    rpc_put_u16(&writer, 0x1234);
+    rpc_put_u32(&writer, 0xDEADBEEF);
+    rpc_put_i64(&writer, -1234567890123LL);
+    rpc_put_double(&writer, 1.0 / 23.0);
+    rpc_put_string(&writer, "dxdt_threshold");
+    rpc_put_string(&writer, "");
+    assert(!writer.overflow);
+    assert(writer.length == 1 + 2 + 4 + 8 + 8 + 15 + 1);
+
+    // Little endian on the wire, independent of the host.
+    assert(data[1] == 0x34 && data[2] == 0x12);
+    assert(data[3] == 0xEF && data[6] == 0xDE);
+
+    rpc_reader_t reader;
+    rpc_reader_init(&reader, data, writer.length);
+
+    char text[32];
+    assert(rpc_get_u8(&reader) == 0xAB);
+    assert(rpc_get_u16(&reader) == 0x1234);
+    assert(rpc_get_u32(&reader) == 0xDEADBEEF);
+    assert(rpc_get_i64(&reader) == -1234567890123LL);
+    assert(rpc_get_double(&reader) == 1.0 / 23.0);
+    rpc_get_string(&reader, text, sizeof(text));
+    assert(strcmp(text, "dxdt_threshold") == 0);
+    rpc_get_string(&reader, text, sizeof(text));
+    assert(strcmp(text, "") == 0);
+    assert(!reader.error);
+    assert(reader.position == writer.length);
+
+    // Nothing left.
+    assert(rpc_get_u8(&reader) == 0);
+    assert(reader.error);
+}
+
+static void test_overflow(void)
+{
+    uint8_t data[5];
+    rpc_writer_t writer;
+    rpc_writer_init(&writer, data, sizeof(data));
+
+    rpc_put_u32(&writer, 1);
+    assert(!writer.overflow);
+    rpc_put_u16(&writer, 2);
+    assert(writer.overflow);
+
+    // Stays in overflow, even if the next field would fit.
+    rpc_put_u8(&writer, 3);
+    assert(writer.overflow);
+    assert(writer.length == 4);
+}
+
+static void test_short_payload(void)
+{
+    const uint8_t data[] = { 0x05, 'a', 'b' };
+    rpc_reader_t reader;
+    char text[16];
+
+    // String shorter than announced.
+    rpc_reader_init(&reader, data, sizeof(data));
+    rpc_get_string(&reader, text, sizeof(text));
+    assert(reader.error);
+    assert(text[0] == '\0');
+
+    // String does not fit the buffer.
+    const uint8_t long_string[] = { 0x04, 'a', 'b', 'c', 'd' };
+    rpc_reader_init(&reader, long_string, sizeof(long_string));
+    rpc_get_string(&reader, text, 4);
+    assert(reader.error);
+
+    rpc_reader_init(&reader, data, 1);
+    assert(rpc_get_u16(&reader) == 0);
+    assert(reader.error);
+}
+
+int main(void)
+{
+    test_header();
+    test_round_trip();
+    test_overflow();
+    test_short_payload();
+
+    printf("test_rpc_frame: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Host test for settings.c, runs against the in-memory nvs of nvs_host.c.
+
+#include "settings.h"
+
+#include "sdkconfig.h"
+#include <nvs.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+static void test_defaults(void)
+{
+    nvs_host_reset(0);
+    assert(settings_init() == ESP_OK);
+
+    for (setting_id_t id = 0; id < SETTING_COUNT; id++)
+    {
+        const setting_info_t * const info = settings_get_info(id);
+        assert(strlen(info->name) <= 15); // nvs key
+        assert(info->min <= info->default_value && info->default_value <= info->max);
+        assert(settings_get(id) == info->default_value);
+
+        setting_id_t found = SETTING_COUNT;
+        assert(settings_find(info->name, &found));
+        assert(found == id);
+    }
+
+    setting_id_t id = 0;
+    assert(!settings_find("unknown", &id));
+    assert(settings_get(SETTING_CALIBRATION_FACTOR) == 1.0 / 23.0);
+}
+
+static void test_validation(void)
+{
+    nvs_host_reset(0);
+    assert(settings_init() == ESP_OK);
+
+    assert(settings_set(SETTING_DXDT_THRESHOLD, 40.0) == ESP_OK);
+    assert(settings_get(SETTING_DXDT_THRESHOLD) == 40.0);
+
+    // Rejected values don't change anything.
+    assert(settings_set(SETTING_DXDT_THRESHOLD, 0.0) == ESP_ERR_INVALID_ARG);
+    assert(settings_set(SETTING_DXDT_THRESHOLD, NAN) == ESP_ERR_INVALID_ARG);
+    assert(settings_set(SETTING_DXDT_THRESHOLD, INFINITY) == ESP_ERR_INVALID_ARG);
+    assert(settings_get(SETTING_DXDT_THRESHOLD) == 40.0);
+
+    assert(settings_set(SETTING_UPLOAD_POST_INTERVAL, 5.0) == ESP_OK);
+    assert(settings_set(SETTING_UPLOAD_POST_INTERVAL, 5.5) == ESP_ERR_INVALID_ARG);
+    assert(settings_get(SETTING_UPLOAD_POST_INTERVAL) == 5.0);
+
+    // The ring buffers are sized for the configured idle post interval.
+    assert(settings_set(SETTING_UPLOAD_IDLE_POST_INTERVAL, CONFIG_CATSCALE_UPLOAD_IDLE_POST_INTERVAL_S + 1) == ESP_ERR_INVALID_ARG);
+
+    settings_reset();
+    assert(settings_get(SETTING_DXDT_THRESHOLD) == 50.0);
+}
+
+static void test_persistence(void)
+{
+    nvs_host_reset(0);
+    assert(settings_init() == ESP_OK);
+
+    assert(settings_set(SETTING_HOLD_WEIGHT_HIGH, 6000.0) == ESP_OK);
+    assert(settings_set(SETTING_CALIBRATION_FACTOR, 0.05) == ESP_OK);
+    assert(settings_set_log_level("sensors", ESP_LOG_WARN) == ESP_OK);
+    assert(settings_save() == ESP_OK);
+
+    // Not saved, lost on restart.
+    assert(settings_set(SETTING_HOLD_TIMER, 20.0) == ESP_OK);
+
+    assert(settings_init() == ESP_OK);
+    assert(settings_get(SETTING_HOLD_WEIGHT_HIGH) == 6000.0);
+    assert(settings_get(SETTING_CALIBRATION_FACTOR) == 0.05);
+    assert(settings_get(SETTING_HOLD_TIMER) == 10.0);
+
+    settings_log_level_t levels[SETTINGS_LOG_LEVEL_COUNT] = {};
+    assert(settings_get_log_levels(levels, SETTINGS_LOG_LEVEL_COUNT) == 1);
+    assert(strcmp(levels[0].tag, "sensors") == 0);
+    assert(levels[0].level == ESP_LOG_WARN);
+
+    // Saving the defaults removes the stored values.
+    settings_reset();
+    assert(settings_save() == ESP_OK);
+    assert(settings_init() == ESP_OK);
+    assert(settings_get(SETTING_HOLD_WEIGHT_HIGH) == 5000.0);
+    assert(settings_get_log_levels(levels, SETTINGS_LOG_LEVEL_COUNT) == 0);
+}
+
+static void test_log_levels(void)
+{
+    nvs_host_reset(0);
+    assert(settings_init() == ESP_OK);
+
+    assert(settings_set_log_level("*", ESP_LOG_INFO) == ESP_OK);
+    assert(settings_set_log_level("http", ESP_LOG_DEBUG) == ESP_OK);
+    assert(settings_set_log_level("http", ESP_LOG_ERROR) == ESP_OK);   // replaces the entry
+
+    settings_log_level_t levels[SETTINGS_LOG_LEVEL_COUNT] = {};
+    assert(settings_get_log_levels(levels, SETTINGS_LOG_LEVEL_COUNT) == 2);
+    assert(strcmp(levels[1].tag, "http") == 0);
+    assert(levels[1].level == ESP_LOG_ERROR);
+
+    assert(settings_set_log_level("", ESP_LOG_INFO) == ESP_ERR_INVALID_ARG);
+    assert(settings_set_log_level("a_very_long_tag_name", ESP_LOG_INFO) == ESP_ERR_INVALID_ARG);
+    assert(settings_set_log_level("rc", ESP_LOG_VERBOSE + 1) == ESP_ERR_INVALID_ARG);
+
+    // Limited number of entries.
+    char tag[8];
+    for (int i = 2; i < SETTINGS_LOG_LEVEL_COUNT; i++)
+    {
+        snprintf(tag, sizeof(tag), "t%d", i);
+        assert(settings_set_log_level(tag, ESP_LOG_WARN) == ESP_OK);
+    }
+    assert(settings_set_log_level("full", ESP_LOG_WARN) == ESP_ERR_NO_MEM);
+}
+
+int main(void)
+{
+    test_defaults();
+    test_validation();
+    test_persistence();
+    test_log_levels();
+
+    printf("test_settings: all tests passed\n");
+    return 0;
+}
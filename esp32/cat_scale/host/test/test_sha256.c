@@ -0,0 +1,66 @@
+// Host test for tools/sha256.c, used by the ota sender to announce the image hash.
+
+#include "sha256.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+static void assert_digest(const void *data, size_t length, const char *expected_hex)
+{
+    uint8_t digest[SHA256_SIZE];
+    sha256_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, length);
+    sha256_finish(&ctx, digest);
+
+    char hex[SHA256_SIZE * 2 + 1] = {};
+    for (int i = 0; i < SHA256_SIZE; i++)
+        snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+
+    if (strcmp(hex, expected_hex) != 0)
+        printf("expected %s, got %s\n", expected_hex, hex);
+    assert(strcmp(hex, expected_hex) == 0);
+}
+
+static void test_known_digests(void)
+{
+    assert_digest("", 0, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    assert_digest("abc", 3, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    assert_digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56,
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+static void test_split_updates(void)
+{
+    // 1,000,000 x 'a', fed in uneven pieces.
+    static char data[1000000];
+    memset(data, 'a', sizeof(data));
+
+    uint8_t digest[SHA256_SIZE];
+    sha256_t ctx;
+    sha256_init(&ctx);
+    size_t offset = 0;
+    for (size_t n = 1; offset < sizeof(data); n = n * 3 % 1000 + 1)
+    {
+        const size_t length = sizeof(data) - offset < n ? sizeof(data) - offset : n;
+        sha256_update(&ctx, data + offset, length);
+        offset += length;
+    }
+    sha256_finish(&ctx, digest);
+
+    static const uint8_t expected[SHA256_SIZE] = {
+        0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92, 0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+        0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e, 0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0,
+    };
+    assert(memcmp(digest, expected, SHA256_SIZE) == 0);
+}
+
+int main(void)
+{
+    test_known_digests();
+    test_split_updates();
+
+    printf("test_sha256: all tests passed\n");
+    return 0;
+}
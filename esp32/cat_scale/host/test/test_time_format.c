@@ -0,0 +1,91 @@
+// Host test for the ISO-8601 formatting of time_format.c, compared against gmtime_r.
+
+#include "time.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static void format_reference(int64_t unix_us, char *output, size_t output_size)
+{
+    const time_t seconds = (time_t)(unix_us / 1000000);
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+
+    snprintf(output, output_size, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+        tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(unix_us % 1000000 / 1000));
+}
+
+static void assert_format(int64_t unix_us)
+{
+    char expected[64] = {};
+    format_reference(unix_us, expected, sizeof(expected));
+
+    char actual[TIME_ISO8601_BUFFER_SIZE] = {};
+    const size_t length = time_format_iso8601(unix_us, actual, sizeof(actual));
+
+    if (strcmp(expected, actual) != 0)
+        printf("%lld: expected %s, got %s\n", (long long)unix_us, expected, actual);
+    assert(strcmp(expected, actual) == 0);
+    assert(length == TIME_ISO8601_BUFFER_SIZE - 1);
+}
+
+static void test_against_gmtime(void)
+{
+    assert_format(0);
+    assert_format(951782400LL * 1000000);                 // 2000-02-29
+    assert_format(1700000000LL * 1000000 + 500999);
+    assert_format(4102444799LL * 1000000 + 999999);       // 2099-12-31T23:59:59.999
+
+    // every hour over several years, with the day prefix cached in between
+    for (int64_t s = 946684800LL; s < 1893456000LL; s += 3600 + 7)
+        assert_format(s * 1000000 + (s % 1000) * 1000);
+
+    // back and forth across a day boundary
+    for (int i = 0; i < 10; i++)
+    {
+        assert_format(1700006399LL * 1000000 + 999000);
+        assert_format(1700006400LL * 1000000);
+    }
+}
+
+static void test_small_buffers(void)
+{
+    const int64_t unix_us = 1700000000LL * 1000000 + 500000;
+
+    for (size_t size = 1; size <= TIME_ISO8601_BUFFER_SIZE; size++)
+    {
+        char buffer[TIME_ISO8601_BUFFER_SIZE + 8];
+        memset(buffer, 'x', sizeof(buffer));
+
+        const size_t length = time_format_iso8601(unix_us, buffer, size);
+
+        assert(length == size - 1);
+        assert(buffer[length] == '\0');
+        assert(strncmp(buffer, "2023-11-14T22:13:20.500Z", length) == 0);
+        for (size_t i = size; i < sizeof(buffer); i++)
+            assert(buffer[i] == 'x'); // nothing written past the end
+    }
+
+    char unused = 'x';
+    assert(time_format_iso8601(unix_us, &unused, 0) == 0);
+    assert(unused == 'x');
+}
+
+static void test_timeval(void)
+{
+    const struct timeval tv = { .tv_sec = 1700000000, .tv_usec = 123456 };
+    char buffer[64] = {};
+    convert_timeval_to_iso8601(tv, buffer, sizeof(buffer));
+    assert(strcmp(buffer, "2023-11-14T22:13:20.123Z") == 0);
+}
+
+int main(void)
+{
+    test_against_gmtime();
+    test_small_buffers();
+    test_timeval();
+
+    printf("test_time_format: all tests passed\n");
+    return 0;
+}
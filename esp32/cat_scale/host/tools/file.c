@@ -0,0 +1,49 @@
+#include "file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+uint8_t *file_read(const char *path, size_t *size)
+{
+    FILE * const f = fopen(path, "rb");
+    if (!f)
+    {
+        perror(path);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    const long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t * const data = length > 0 ? malloc(length) : NULL;
+    if (!data || fread(data, 1, length, f) != (size_t)length)
+    {
+        fprintf(stderr, "%s: failed to read\n", path);
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+
+    fclose(f);
+    *size = (size_t)length;
+    return data;
+}
+
+bool file_write(const char *path, const uint8_t *data, size_t size)
+{
+    FILE * const f = fopen(path, "wb");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+
+    const bool ok = fwrite(data, 1, size, f) == size;
+    if (fclose(f) != 0 || !ok)
+    {
+        fprintf(stderr, "%s: failed to write\n", path);
+        return false;
+    }
+    return true;
+}
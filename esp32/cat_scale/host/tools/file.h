@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Whole files for the host tools. Errors are printed to stderr.
+
+// Returns the content (malloc'ed) or NULL.
+uint8_t *file_read(const char *path, size_t *size);
+
+bool file_write(const char *path, const uint8_t *data, size_t size);
@@ -0,0 +1,154 @@
+// Prints the live weight stream of the cat scale (live_stream.c, CONFIG_CATSCALE_LIVE_STREAM_PORT),
+// one line per hx711 sample, for watching the filters while calibrating.
+//
+// usage: live_client <host> [--port <port>] [--channel <n>] [--csv]
+//
+// Columns: time since boot (s), channel, sequence, raw count, weight (g), input switch, stable time (s), hold timer (s).
+// Records the device had to drop because this client was too slow are reported as gaps.
+
+#include "live_record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define DEFAULT_PORT    "70"
+#define MAX_CHANNELS    (256)
+
+static int connect_to(const char *host, const char *port)
+{
+    const struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *result = NULL;
+
+    const int ret = getaddrinfo(host, port, &hints, &result);
+    if (ret != 0)
+    {
+        fprintf(stderr, "%s: %s\n", host, gai_strerror(ret));
+        return -1;
+    }
+
+    int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (sock >= 0 && connect(sock, result->ai_addr, result->ai_addrlen) != 0)
+    {
+        perror("connect");
+        close(sock);
+        sock = -1;
+    }
+
+    freeaddrinfo(result);
+    return sock;
+}
+
+static int recv_all(int sock, void *data, size_t length)
+{
+    uint8_t *p = data;
+    while (length > 0)
+    {
+        const ssize_t received = recv(sock, p, length, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+        {
+            fprintf(stderr, "connection closed by the device\n");
+            return -1;
+        }
+        p += received;
+        length -= (size_t)received;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = NULL;
+    const char *port = DEFAULT_PORT;
+    int channel = -1;
+    bool csv = false;
+    bool usage = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+            port = argv[++i];
+        else if (strcmp(argv[i], "--channel") == 0 && i + 1 < argc)
+            channel = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0)
+            csv = true;
+        else if (!host)
+            host = argv[i];
+        else
+            usage = true;
+    }
+
+    if (!host || usage)
+    {
+        fprintf(stderr, "usage: %s <host> [--port <port>] [--channel <n>] [--csv]\n", argv[0]);
+        return 1;
+    }
+
+    const int sock = connect_to(host, port);
+    if (sock < 0)
+        return 1;
+
+    // Read every record as soon as it arrives, the device drops what doesn't fit into its send buffer.
+    int opt = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (csv)
+        printf("time_s,channel,sequence,raw,weight_g,input_switch,stable_time_s,hold_timer_s,dropped\n");
+
+    uint32_t next_sequence[MAX_CHANNELS] = {};
+    bool seen[MAX_CHANNELS] = {};
+
+    while (true)
+    {
+        uint8_t data[LIVE_RECORD_SIZE];
+        if (recv_all(sock, data, sizeof(data)) != 0)
+            break;
+
+        live_record_t record = {};
+        live_record_decode(data, &record);
+
+        if (channel >= 0 && record.channel != channel)
+            continue;
+
+        // dropped only counts what the device dropped for this client, the sequence covers its queue as well.
+        const uint32_t missed = seen[record.channel] ? record.sequence - next_sequence[record.channel] : 0;
+        seen[record.channel] = true;
+        next_sequence[record.channel] = record.sequence + 1;
+
+        const bool valid = record.flags & LIVE_RECORD_FLAG_VALID;
+        const bool input_switch = record.flags & LIVE_RECORD_FLAG_INPUT_SWITCH;
+        const double time_s = (double)record.timestamp / 1e6;
+
+        if (csv)
+        {
+            printf("%.3f,%u,%"PRIu32",%"PRIu32",%.2f,%d,%.2f,%.2f,%"PRIu32"\n",
+                time_s, record.channel, record.sequence, record.weight_raw, valid ? record.weight : 0.0f,
+                input_switch, record.stable_time, record.hold_timer, missed);
+            continue;
+        }
+
+        if (missed > 0)
+            printf("-- channel %u: %"PRIu32" records missed (%u dropped for this client)\n", record.channel, missed, record.dropped);
+
+        if (valid)
+            printf("%10.3f ch%u #%-8"PRIu32" raw=%8"PRIu32" weight=%9.2f g %s stable=%6.2f s hold=%5.2f s\n",
+                time_s, record.channel, record.sequence, record.weight_raw, record.weight,
+                input_switch ? "HOLD" : "    ", record.stable_time, record.hold_timer);
+        else
+            printf("%10.3f ch%u #%-8"PRIu32" no data from hx711\n", time_s, record.channel, record.sequence);
+    }
+
+    close(sock);
+    return 0;
+}
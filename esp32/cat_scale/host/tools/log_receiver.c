@@ -0,0 +1,133 @@
+// Receives the udp log of the cat scale (see log_datagram.h) and prints it in order,
+// together with the datagrams that got lost on the way.
+//
+// usage: log_receiver [port]
+
+#include "log_stream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define DEFAULT_PORT (55555)
+
+static volatile sig_atomic_t stop = 0;
+
+static void handle_signal(int signal)
+{
+    stop = 1;
+}
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void print_event(void *context, const log_stream_event_t *event)
+{
+    switch (event->type)
+    {
+        case LOG_STREAM_LINES:
+            fwrite(event->lines, 1, event->length, stdout);
+            break;
+        case LOG_STREAM_LATE_LINES:
+            printf("--- late datagram %"PRIu32" (reported as lost before) ---\n", event->first);
+            fwrite(event->lines, 1, event->length, stdout);
+            printf("--- end of late datagram %"PRIu32" ---\n", event->first);
+            break;
+        case LOG_STREAM_LOST:
+            if (event->first == event->last)
+                printf("--- lost datagram %"PRIu32" ---\n", event->first);
+            else
+                printf("--- lost datagrams %"PRIu32"..%"PRIu32" (%"PRIu32") ---\n", event->first, event->last, event->count);
+            break;
+        case LOG_STREAM_DEVICE_DROPPED:
+            printf("--- device dropped %"PRIu32" lines ---\n", event->count);
+            break;
+        case LOG_STREAM_NEW_BOOT:
+            printf("--- boot %08"PRIx32" (first datagram %"PRIu32") ---\n", event->boot_id, event->first);
+            break;
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    const int port = argc > 1 ? atoi(argv[1]) : DEFAULT_PORT;
+    if (port <= 0 || port > 65535)
+    {
+        fprintf(stderr, "usage: %s [port]\n", argv[0]);
+        return 1;
+    }
+
+    const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+
+    const int enable = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        close(sock);
+        return 1;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    static log_stream_t stream;
+    log_stream_init(&stream, print_event, NULL);
+
+    fprintf(stderr, "listening on udp port %d\n", port);
+
+    while (!stop)
+    {
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        const int ret = poll(&pfd, 1, LOG_STREAM_REORDER_TIMEOUT_MS / 4);
+        if (ret < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+
+        if (ret > 0)
+        {
+            uint8_t buffer[LOG_DATAGRAM_MAX_SIZE + 1];
+            const ssize_t length = recv(sock, buffer, sizeof(buffer), 0);
+            if (length > 0)
+                log_stream_receive(&stream, buffer, (size_t)length, now_ms());
+        }
+
+        log_stream_poll(&stream, now_ms());
+    }
+
+    log_stream_flush(&stream);
+    close(sock);
+
+    const log_stream_stats_t *stats = &stream.stats;
+    fprintf(stderr, "datagrams=%"PRIu32" lines=%"PRIu32" lost=%"PRIu32" late=%"PRIu32" duplicates=%"PRIu32
+        " invalid=%"PRIu32" device_dropped=%"PRIu32" boots=%"PRIu32"\n",
+        stats->datagrams, stats->lines, stats->lost, stats->late, stats->duplicates,
+        stats->invalid, stats->device_dropped, stats->boots);
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+#include "log_stream.h"
+
+#include <string.h>
+#include <assert.h>
+
+// Sequence numbers may wrap around.
+static bool sequence_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static void emit(log_stream_t *stream, log_stream_event_type_t type, uint32_t first, uint32_t last, uint32_t count,
+    const char *lines, size_t length)
+{
+    const log_stream_event_t event = {
+        .type = type,
+        .boot_id = stream->boot_id,
+        .first = first,
+        .last = last,
+        .count = count,
+        .lines = lines,
+        .length = length,
+    };
+    stream->output(stream->context, &event);
+}
+
+static void report_lost(log_stream_t *stream, uint32_t first, uint32_t end)
+{
+    if (first == end)
+        return;
+
+    stream->stats.lost += end - first;
+    emit(stream, LOG_STREAM_LOST, first, end - 1, end - first, NULL, 0);
+}
+
+static void deliver(log_stream_t *stream, const log_datagram_header_t *header, const char *lines, size_t length)
+{
+    if (header->dropped != stream->device_dropped)
+    {
+        // A smaller number means the counter of the device restarted, nothing to report.
+        if (header->dropped > stream->device_dropped)
+        {
+            const uint32_t count = header->dropped - stream->device_dropped;
+            stream->stats.device_dropped += count;
+            emit(stream, LOG_STREAM_DEVICE_DROPPED, header->sequence, header->sequence, count, NULL, 0);
+        }
+        stream->device_dropped = header->dropped;
+    }
+
+    stream->stats.lines += header->line_count;
+    emit(stream, LOG_STREAM_LINES, header->sequence, header->sequence, header->line_count, lines, length);
+    stream->next_sequence = header->sequence + 1;
+}
+
+static void deliver_pending(log_stream_t *stream, log_stream_pending_t *pending)
+{
+    log_datagram_header_t header = {};
+    const char *lines = NULL;
+    size_t length = 0;
+    const bool valid = log_datagram_parse(pending->data, pending->length, &header, &lines, &length);
+    assert(valid);
+
+    deliver(stream, &header, lines, length);
+    pending->used = false;
+}
+
+static log_stream_pending_t *find_pending(log_stream_t *stream, uint32_t sequence)
+{
+    for (size_t i = 0; i < LOG_STREAM_REORDER_WINDOW; i++)
+        if (stream->pending[i].used && stream->pending[i].sequence == sequence)
+            return &stream->pending[i];
+    return NULL;
+}
+
+static log_stream_pending_t *oldest_pending(log_stream_t *stream)
+{
+    log_stream_pending_t *oldest = NULL;
+    for (size_t i = 0; i < LOG_STREAM_REORDER_WINDOW; i++)
+        if (stream->pending[i].used && (!oldest || sequence_before(stream->pending[i].sequence, oldest->sequence)))
+            oldest = &stream->pending[i];
+    return oldest;
+}
+
+// Delivers the datagrams held back which are next in sequence.
+static void release_in_order(log_stream_t *stream)
+{
+    log_stream_pending_t *pending = NULL;
+    while ((pending = find_pending(stream, stream->next_sequence)) != NULL)
+        deliver_pending(stream, pending);
+}
+
+// Gives up on the gap in front of the oldest datagram held back.
+static bool skip_gap(log_stream_t *stream)
+{
+    log_stream_pending_t * const oldest = oldest_pending(stream);
+    if (!oldest)
+        return false;
+
+    report_lost(stream, stream->next_sequence, oldest->sequence);
+    stream->next_sequence = oldest->sequence;
+    release_in_order(stream);
+    return true;
+}
+
+void log_stream_init(log_stream_t *stream, log_stream_output_t output, void *context)
+{
+    assert(stream);
+    assert(output);
+
+    memset(stream, 0, sizeof(log_stream_t));
+    stream->output = output;
+    stream->context = context;
+}
+
+void log_stream_receive(log_stream_t *stream, const uint8_t *data, size_t length, int64_t now_ms)
+{
+    assert(stream);
+    assert(data);
+
+    log_datagram_header_t header = {};
+    const char *lines = NULL;
+    size_t lines_length = 0;
+    if (!log_datagram_parse(data, length, &header, &lines, &lines_length))
+    {
+        stream->stats.invalid++;
+        return;
+    }
+
+    stream->stats.datagrams++;
+
+    if (!stream->started || header.boot_id != stream->boot_id)
+    {
+        // Whatever is left of the previous boot will not be completed anymore.
+        log_stream_flush(stream);
+
+        // The first datagrams of a new boot are expected, the receiver may be started at any time though.
+        const bool reboot = stream->started;
+        stream->started = true;
+        stream->boot_id = header.boot_id;
+        stream->device_dropped = 0;
+        stream->stats.boots++;
+        emit(stream, LOG_STREAM_NEW_BOOT, header.sequence, header.sequence, 0, NULL, 0);
+
+        if (reboot)
+            report_lost(stream, 0, header.sequence);
+        stream->next_sequence = header.sequence;
+    }
+
+    if (sequence_before(header.sequence, stream->next_sequence))
+    {
+        stream->stats.late++;
+        emit(stream, LOG_STREAM_LATE_LINES, header.sequence, header.sequence, header.line_count, lines, lines_length);
+        return;
+    }
+
+    if (header.sequence == stream->next_sequence)
+    {
+        deliver(stream, &header, lines, lines_length);
+        release_in_order(stream);
+        return;
+    }
+
+    if (find_pending(stream, header.sequence))
+    {
+        stream->stats.duplicates++;
+        return;
+    }
+
+    log_stream_pending_t *slot = NULL;
+    while (!slot)
+    {
+        for (size_t i = 0; i < LOG_STREAM_REORDER_WINDOW && !slot; i++)
+            if (!stream->pending[i].used)
+                slot = &stream->pending[i];
+
+        if (!slot)
+        {
+            skip_gap(stream);
+
+            // The gap may be closed now.
+            if (header.sequence == stream->next_sequence)
+            {
+                deliver(stream, &header, lines, lines_length);
+                release_in_order(stream);
+                return;
+            }
+            if (sequence_before(header.sequence, stream->next_sequence))
+            {
+                stream->stats.late++;
+                emit(stream, LOG_STREAM_LATE_LINES, header.sequence, header.sequence, header.line_count, lines, lines_length);
+                return;
+            }
+        }
+    }
+
+    slot->used = true;
+    slot->sequence = header.sequence;
+    slot->received_ms = now_ms;
+    slot->length = length;
+    memcpy(slot->data, data, length);
+}
+
+void log_stream_poll(log_stream_t *stream, int64_t now_ms)
+{
+    assert(stream);
+
+    while (true)
+    {
+        const log_stream_pending_t * const oldest = oldest_pending(stream);
+        if (!oldest)
+            return;
+
+        // Every datagram held back starts its own timeout.
+        bool expired = false;
+        for (size_t i = 0; i < LOG_STREAM_REORDER_WINDOW; i++)
+            if (stream->pending[i].used && now_ms - stream->pending[i].received_ms >= LOG_STREAM_REORDER_TIMEOUT_MS)
+                expired = true;
+
+        if (!expired)
+            return;
+
+        skip_gap(stream);
+    }
+}
+
+void log_stream_flush(log_stream_t *stream)
+{
+    assert(stream);
+
+    while (skip_gap(stream))
+        ;
+}
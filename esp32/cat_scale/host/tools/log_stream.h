@@ -0,0 +1,78 @@
+#pragma once
+
+#include "log_datagram.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Receiver side of the udp log (see log_datagram.h): puts the datagrams of a device back in order
+// and reports the sequence ranges that did not arrive.
+//
+// Datagrams that arrive early are held back until the missing ones show up, the window is full
+// or they waited longer than LOG_STREAM_REORDER_TIMEOUT_MS. Then the missing ones are reported as lost.
+
+#define LOG_STREAM_REORDER_WINDOW       (16)
+#define LOG_STREAM_REORDER_TIMEOUT_MS   (1000)
+
+typedef enum {
+    LOG_STREAM_LINES,           // lines, in order
+    LOG_STREAM_LATE_LINES,      // lines of a datagram which was already reported as lost
+    LOG_STREAM_LOST,            // datagrams first..last did not arrive
+    LOG_STREAM_DEVICE_DROPPED,  // the device dropped count lines before sending them
+    LOG_STREAM_NEW_BOOT,        // the device rebooted (or the first datagram)
+} log_stream_event_type_t;
+
+typedef struct {
+    log_stream_event_type_t type;
+    uint32_t boot_id;
+    uint32_t first;             // sequence
+    uint32_t last;
+    uint32_t count;
+    const char *lines;          // '\n' terminated lines
+    size_t length;
+} log_stream_event_t;
+
+typedef void (*log_stream_output_t)(void *context, const log_stream_event_t *event);
+
+typedef struct {
+    bool used;
+    uint32_t sequence;
+    int64_t received_ms;
+    size_t length;
+    uint8_t data[LOG_DATAGRAM_MAX_SIZE];
+} log_stream_pending_t;
+
+typedef struct {
+    uint32_t datagrams;
+    uint32_t lines;
+    uint32_t lost;              // datagrams
+    uint32_t late;              // datagrams
+    uint32_t duplicates;        // datagrams
+    uint32_t invalid;           // datagrams
+    uint32_t device_dropped;    // lines
+    uint32_t boots;
+} log_stream_stats_t;
+
+typedef struct {
+    log_stream_output_t output;
+    void *context;
+
+    bool started;
+    uint32_t boot_id;
+    uint32_t next_sequence;
+    uint32_t device_dropped;
+    log_stream_pending_t pending[LOG_STREAM_REORDER_WINDOW];
+
+    log_stream_stats_t stats;
+} log_stream_t;
+
+void log_stream_init(log_stream_t *stream, log_stream_output_t output, void *context);
+
+void log_stream_receive(log_stream_t *stream, const uint8_t *data, size_t length, int64_t now_ms);
+
+// Releases datagrams which waited too long for a missing one, call it regularly.
+void log_stream_poll(log_stream_t *stream, int64_t now_ms);
+
+// Releases all datagrams held back, reporting the gaps as lost.
+void log_stream_flush(log_stream_t *stream);
@@ -0,0 +1,489 @@
+// Forwards the sensor data the cat scale publishes over mqtt (CONFIG_CATSCALE_MQTT) to influx.
+// The payloads are influx line protocol already, every message becomes one write request.
+//
+// usage: mqtt_bridge <broker host[:port]> <influx host[:port]> <org> <bucket> [topic filter]
+//   The influx token is taken from the environment (INFLUX_TOKEN). Default ports: 1883 and 8086.
+//
+// The session on the broker is kept across restarts (qos 1, no clean session) and a message is only
+// acknowledged after influx accepted it. If influx fails the bridge reconnects later and the broker delivers
+// the message again, nothing is lost as long as the broker keeps the session.
+//
+// Everything on one linux machine:
+//   mosquitto -v                                                       (broker on port 1883)
+//   INFLUX_TOKEN=... ./bin/mqtt_bridge localhost localhost:8086 <org> <bucket>
+//   mosquitto_pub -q 1 -t catscale/influx -m "scales,scale_id=CAT1 weight=1.0 $(date +%s%N)"
+// With the device pointed at the broker, compare "mqtt.*" and "influx.*" of "rc_client <host> stats"
+// (wire bytes, latency) and the cpu of the tasks in "rc_client <host> metrics" with the http upload.
+
+#include "mqtt_packet.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#define DEFAULT_BROKER_PORT     "1883"
+#define DEFAULT_INFLUX_PORT     "8086"
+#define DEFAULT_TOPIC_FILTER    "catscale/influx"
+#define CLIENT_ID               "catscale-bridge"
+#define KEEP_ALIVE_S            (30)
+#define RECONNECT_DELAY_S       (5)
+#define STATS_INTERVAL_S        (60)
+#define MAX_PACKET_SIZE         (1024 * 1024)
+
+typedef struct {
+    char host[256];
+    char port[8];
+} address_t;
+
+typedef struct {
+    address_t broker;
+    address_t influx;
+    const char *org;
+    const char *bucket;
+    const char *token;
+    const char *topic_filter;
+} config_t;
+
+typedef struct {
+    uint64_t messages;
+    uint64_t duplicates;        // redelivered by the broker
+    uint64_t lines;
+    uint64_t payload_bytes;
+    uint64_t wire_bytes;        // publish packets as received
+    uint64_t influx_requests;
+    uint64_t influx_failures;
+    uint64_t connects;
+    int64_t total_delay_ms;     // newest sample of a message until it arrived here
+    int64_t max_delay_ms;
+} stats_t;
+
+static volatile sig_atomic_t stop = 0;
+static stats_t g_stats = {};
+
+static void handle_signal(int signal)
+{
+    stop = 1;
+}
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t unix_time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool parse_address(const char *text, const char *default_port, address_t *address)
+{
+    const char *colon = strrchr(text, ':');
+    const size_t host_length = colon ? (size_t)(colon - text) : strlen(text);
+    if (host_length == 0 || host_length >= sizeof(address->host))
+        return false;
+
+    memcpy(address->host, text, host_length);
+    address->host[host_length] = '\0';
+    snprintf(address->port, sizeof(address->port), "%s", colon ? colon + 1 : default_port);
+    return true;
+}
+
+static int connect_to(const address_t *address)
+{
+    const struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *result = NULL;
+
+    const int ret = getaddrinfo(address->host, address->port, &hints, &result);
+    if (ret != 0)
+    {
+        fprintf(stderr, "%s: %s\n", address->host, gai_strerror(ret));
+        return -1;
+    }
+
+    int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (sock >= 0 && connect(sock, result->ai_addr, result->ai_addrlen) != 0)
+    {
+        fprintf(stderr, "connect %s:%s: %s\n", address->host, address->port, strerror(errno));
+        close(sock);
+        sock = -1;
+    }
+
+    freeaddrinfo(result);
+    return sock;
+}
+
+static int send_all(int sock, const void *data, size_t length)
+{
+    const uint8_t *p = data;
+    while (length > 0)
+    {
+        const ssize_t sent = send(sock, p, length, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("send");
+            return -1;
+        }
+        p += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+// One connection per request, the bridge is not where the overhead matters.
+static bool post_to_influx(const config_t *config, const uint8_t *payload, size_t length)
+{
+    g_stats.influx_requests++;
+
+    const int sock = connect_to(&config->influx);
+    if (sock < 0)
+    {
+        g_stats.influx_failures++;
+        return false;
+    }
+
+    char header[1024];
+    const int header_length = snprintf(header, sizeof(header),
+        "POST /api/v2/write?org=%s&bucket=%s&precision=ns HTTP/1.1\r\n"
+        "Host: %s:%s\r\n"
+        "Authorization: Token %s\r\n"
+        "Content-Type: text/plain; charset=utf-8\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: close\r\n"
+        "\r\n",
+        config->org, config->bucket, config->influx.host, config->influx.port, config->token, length);
+
+    bool ok = header_length > 0 && (size_t)header_length < sizeof(header) &&
+        send_all(sock, header, (size_t)header_length) == 0 &&
+        send_all(sock, payload, length) == 0;
+
+    // Only the status line matters: "HTTP/1.1 204 No Content"
+    char response[256] = {};
+    size_t received = 0;
+    while (ok && received < sizeof(response) - 1 && !strchr(response, '\n'))
+    {
+        const ssize_t n = recv(sock, response + received, sizeof(response) - 1 - received, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        received += (size_t)n;
+    }
+    close(sock);
+
+    int status = 0;
+    if (ok && sscanf(response, "HTTP/%*s %d", &status) != 1)
+        status = 0;
+
+    if (status / 100 != 2)
+    {
+        fprintf(stderr, "influx: write failed (status %d)\n", status);
+        g_stats.influx_failures++;
+        return false;
+    }
+
+    return true;
+}
+
+// Lines end with the timestamp in ns, the newest one tells how long the samples were on the way.
+static void count_lines(const uint8_t *payload, size_t length)
+{
+    int64_t newest_ms = 0;
+    size_t line_start = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (payload[i] != '\n')
+            continue;
+
+        g_stats.lines++;
+
+        size_t space = i;
+        while (space > line_start && payload[space - 1] != ' ')
+            space--;
+
+        int64_t timestamp_ns = 0;
+        for (size_t j = space; j < i && payload[j] >= '0' && payload[j] <= '9'; j++)
+            timestamp_ns = timestamp_ns * 10 + (payload[j] - '0');
+        if (timestamp_ns / 1000000 > newest_ms)
+            newest_ms = timestamp_ns / 1000000;
+
+        line_start = i + 1;
+    }
+
+    if (newest_ms > 0)
+    {
+        const int64_t delay_ms = unix_time_ms() - newest_ms;
+        g_stats.total_delay_ms += delay_ms;
+        if (delay_ms > g_stats.max_delay_ms)
+            g_stats.max_delay_ms = delay_ms;
+    }
+}
+
+static void print_stats(void)
+{
+    fprintf(stderr, "messages=%"PRIu64" duplicates=%"PRIu64" lines=%"PRIu64" payload=%"PRIu64"B wire=%"PRIu64"B"
+        " influx requests=%"PRIu64" failures=%"PRIu64" connects=%"PRIu64" delay avg=%"PRId64"ms max=%"PRId64"ms\n",
+        g_stats.messages, g_stats.duplicates, g_stats.lines, g_stats.payload_bytes, g_stats.wire_bytes,
+        g_stats.influx_requests, g_stats.influx_failures, g_stats.connects,
+        g_stats.messages ? g_stats.total_delay_ms / (int64_t)g_stats.messages : 0, g_stats.max_delay_ms);
+}
+
+// Returns false if the session has to be closed.
+static bool handle_packet(int sock, const config_t *config, const mqtt_packet_t *packet, size_t wire_length)
+{
+    uint8_t response[16];
+
+    switch (packet->type)
+    {
+        case MQTT_PACKET_PUBLISH:
+        {
+            mqtt_publish_t publish = {};
+            if (!mqtt_packet_parse_publish(packet, &publish))
+            {
+                fprintf(stderr, "malformed publish\n");
+                return false;
+            }
+
+            g_stats.messages++;
+            if (publish.dup)
+                g_stats.duplicates++;
+            g_stats.payload_bytes += publish.payload_length;
+            g_stats.wire_bytes += wire_length;
+            count_lines(publish.payload, publish.payload_length);
+
+            if (!post_to_influx(config, publish.payload, publish.payload_length))
+                return false; // not acknowledged, the broker delivers it again
+
+            if (publish.qos == 1)
+            {
+                const size_t length = mqtt_packet_encode_puback(response, sizeof(response), publish.packet_id);
+                return send_all(sock, response, length) == 0;
+            }
+            if (publish.qos == 2)
+            {
+                fprintf(stderr, "qos 2 is not supported\n");
+                return false;
+            }
+            return true;
+        }
+
+        case MQTT_PACKET_SUBACK:
+        {
+            // Queued messages of the session may arrive before it, they are handled above.
+            uint16_t packet_id = 0;
+            uint8_t granted_qos = 0x80;
+            if (!mqtt_packet_parse_suback(packet, &packet_id, &granted_qos) || granted_qos == 0x80)
+            {
+                fprintf(stderr, "subscribing to '%s' failed\n", config->topic_filter);
+                return false;
+            }
+            fprintf(stderr, "subscribed to '%s' (qos %d)\n", config->topic_filter, granted_qos);
+            return true;
+        }
+
+        case MQTT_PACKET_PINGRESP:
+            return true;
+
+        default:
+            fprintf(stderr, "unexpected packet type %d\n", packet->type);
+            return false;
+    }
+}
+
+// Waits for the first packet of the session. Whatever was received after it stays in the buffer.
+static int receive_packet(int sock, uint8_t *buffer, size_t size, size_t *received, mqtt_packet_t *packet)
+{
+    while (true)
+    {
+        const int length = mqtt_packet_parse(buffer, *received, packet);
+        if (length != 0)
+            return length;
+        if (*received == size)
+            return -1;
+
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        if (poll(&pfd, 1, 10 * 1000) <= 0)
+            return -1;
+
+        const ssize_t n = recv(sock, buffer + *received, size - *received, 0);
+        if (n <= 0)
+            return -1;
+        *received += (size_t)n;
+    }
+}
+
+static void run_session(const config_t *config, uint8_t *buffer)
+{
+    const int sock = connect_to(&config->broker);
+    if (sock < 0)
+        return;
+
+    mqtt_packet_t packet = {};
+    size_t received = 0;
+    size_t length = mqtt_packet_encode_connect(buffer, MAX_PACKET_SIZE, CLIENT_ID, KEEP_ALIVE_S, false);
+    uint8_t return_code = 0xFF;
+    if (send_all(sock, buffer, length) != 0)
+    {
+        close(sock);
+        return;
+    }
+
+    const int connack_length = receive_packet(sock, buffer, MAX_PACKET_SIZE, &received, &packet);
+    if (connack_length <= 0 || !mqtt_packet_parse_connack(&packet, &return_code) || return_code != 0)
+    {
+        fprintf(stderr, "broker refused the connection (%d)\n", return_code);
+        close(sock);
+        return;
+    }
+
+    // The broker redelivers the messages queued for the session right after the connack.
+    received -= (size_t)connack_length;
+    memmove(buffer, buffer + connack_length, received);
+
+    // The suback is handled in the loop below, together with those messages.
+    uint8_t subscribe[512];
+    length = mqtt_packet_encode_subscribe(subscribe, sizeof(subscribe), 1, config->topic_filter, 1);
+    if (length == 0 || send_all(sock, subscribe, length) != 0)
+    {
+        fprintf(stderr, "subscribing to '%s' failed\n", config->topic_filter);
+        close(sock);
+        return;
+    }
+
+    g_stats.connects++;
+    fprintf(stderr, "connected to %s:%s\n", config->broker.host, config->broker.port);
+
+    int64_t last_send_ms = now_ms();
+    int64_t last_stats_ms = now_ms();
+
+    while (!stop)
+    {
+        bool ok = true;
+        size_t offset = 0;
+        while (ok)
+        {
+            const int packet_length = mqtt_packet_parse(buffer + offset, received - offset, &packet);
+            if (packet_length == 0)
+                break;
+            if (packet_length < 0)
+            {
+                fprintf(stderr, "malformed packet\n");
+                ok = false;
+                break;
+            }
+
+            ok = handle_packet(sock, config, &packet, (size_t)packet_length);
+            offset += (size_t)packet_length;
+            last_send_ms = now_ms();
+        }
+
+        if (!ok)
+            break;
+
+        memmove(buffer, buffer + offset, received - offset);
+        received -= offset;
+        if (received == MAX_PACKET_SIZE)
+        {
+            fprintf(stderr, "packet larger than %d bytes\n", MAX_PACKET_SIZE);
+            break;
+        }
+
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        const int ret = poll(&pfd, 1, 1000);
+        if (ret < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+
+        if (ret > 0)
+        {
+            const ssize_t n = recv(sock, buffer + received, MAX_PACKET_SIZE - received, 0);
+            if (n <= 0)
+            {
+                fprintf(stderr, "connection closed by the broker\n");
+                break;
+            }
+            received += (size_t)n;
+        }
+
+        if (now_ms() - last_send_ms >= KEEP_ALIVE_S * 1000 / 2)
+        {
+            uint8_t ping[2];
+            length = mqtt_packet_encode_pingreq(ping, sizeof(ping));
+            if (send_all(sock, ping, length) != 0)
+                break;
+            last_send_ms = now_ms();
+        }
+
+        if (now_ms() - last_stats_ms >= STATS_INTERVAL_S * 1000)
+        {
+            print_stats();
+            last_stats_ms = now_ms();
+        }
+    }
+
+    close(sock);
+}
+
+int main(int argc, char **argv)
+{
+    config_t config = {
+        .token = getenv("INFLUX_TOKEN"),
+        .topic_filter = DEFAULT_TOPIC_FILTER,
+    };
+
+    if (argc < 5 || argc > 6 ||
+        !parse_address(argv[1], DEFAULT_BROKER_PORT, &config.broker) ||
+        !parse_address(argv[2], DEFAULT_INFLUX_PORT, &config.influx))
+    {
+        fprintf(stderr, "usage: %s <broker host[:port]> <influx host[:port]> <org> <bucket> [topic filter]\n", argv[0]);
+        return 1;
+    }
+
+    config.org = argv[3];
+    config.bucket = argv[4];
+    if (argc > 5)
+        config.topic_filter = argv[5];
+
+    if (!config.token)
+    {
+        fprintf(stderr, "INFLUX_TOKEN is not set\n");
+        return 1;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    uint8_t * const buffer = malloc(MAX_PACKET_SIZE);
+    if (!buffer)
+        return 1;
+
+    while (!stop)
+    {
+        run_session(&config, buffer);
+
+        for (int i = 0; i < RECONNECT_DELAY_S * 10 && !stop; i++)
+            usleep(100 * 1000);
+    }
+
+    free(buffer);
+    print_stats();
+
+    return 0;
+}
@@ -0,0 +1,294 @@
+#include "ota_delta.h"
+#include "ota_patch.h"
+#include "sha256.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} output_t;
+
+static void output_append(output_t *out, const void *data, size_t length)
+{
+    if (out->failed)
+        return;
+
+    if (out->length + length > out->capacity)
+    {
+        size_t capacity = out->capacity ? out->capacity * 2 : 64 * 1024;
+        while (capacity < out->length + length)
+            capacity *= 2;
+
+        uint8_t * const data = realloc(out->data, capacity);
+        if (!data)
+        {
+            out->failed = true;
+            return;
+        }
+        out->data = data;
+        out->capacity = capacity;
+    }
+
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+static void output_u32(output_t *out, uint32_t value)
+{
+    const uint8_t bytes[4] = { value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24 };
+    output_append(out, bytes, sizeof(bytes));
+}
+
+// Sorts the indices by (key1, key2), both keys < bucket_count. Counting sort, stable.
+static void sort_by_keys(int32_t *index, int32_t *temp, size_t n, const int32_t *key1, const int32_t *key2,
+    int32_t *count, size_t bucket_count)
+{
+    const int32_t *keys[2] = { key2, key1 };
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const int32_t * const key = keys[pass];
+
+        memset(count, 0, bucket_count * sizeof(int32_t));
+        for (size_t i = 0; i < n; i++)
+            count[key[index[i]]]++;
+        for (size_t i = 1; i < bucket_count; i++)
+            count[i] += count[i - 1];
+        for (size_t i = n; i-- > 0;)
+            temp[--count[key[index[i]]]] = index[i];
+        memcpy(index, temp, n * sizeof(int32_t));
+    }
+}
+
+// Suffix array by prefix doubling. Has n + 1 entries, the first one is the empty suffix (n).
+static int32_t *suffix_array(const uint8_t *data, size_t n)
+{
+    const size_t bucket_count = (n > 256 ? n : 256) + 1;
+    int32_t * const sa = malloc((n + 1) * sizeof(int32_t));
+    int32_t * const rank = malloc(n * sizeof(int32_t) + 1);
+    int32_t * const key2 = malloc(n * sizeof(int32_t) + 1);
+    int32_t * const temp = malloc(n * sizeof(int32_t) + 1);
+    int32_t * const count = malloc(bucket_count * sizeof(int32_t));
+
+    if (!sa || !rank || !key2 || !temp || !count)
+    {
+        free(sa);
+        free(rank);
+        free(key2);
+        free(temp);
+        free(count);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        sa[i + 1] = (int32_t)i;
+        rank[i] = data[i] + 1;
+    }
+
+    for (size_t k = 1; n > 0; k *= 2)
+    {
+        // Ranks start at 1, 0 stands for "past the end".
+        for (size_t i = 0; i < n; i++)
+            key2[i] = i + k < n ? rank[i + k] : 0;
+
+        sort_by_keys(sa + 1, temp, n, rank, key2, count, bucket_count);
+
+        temp[sa[1]] = 1;
+        for (size_t i = 2; i <= n; i++)
+        {
+            const int32_t a = sa[i - 1], b = sa[i];
+            temp[b] = temp[a] + (rank[a] != rank[b] || key2[a] != key2[b]);
+        }
+        memcpy(rank, temp, n * sizeof(int32_t));
+
+        if ((size_t)rank[sa[n]] == n)
+            break;
+    }
+    sa[0] = (int32_t)n;
+
+    free(rank);
+    free(key2);
+    free(temp);
+    free(count);
+    return sa;
+}
+
+static size_t match_length(const uint8_t *a, size_t a_size, const uint8_t *b, size_t b_size)
+{
+    size_t i = 0;
+    while (i < a_size && i < b_size && a[i] == b[i])
+        i++;
+    return i;
+}
+
+// Longest match of new_data in old_data, binary search in the suffix array between start and end.
+static size_t search(const int32_t *sa, const uint8_t *old_data, size_t old_size,
+    const uint8_t *new_data, size_t new_size, size_t start, size_t end, size_t *position)
+{
+    while (end - start >= 2)
+    {
+        const size_t middle = start + (end - start) / 2;
+        const size_t n = old_size - sa[middle] < new_size ? old_size - sa[middle] : new_size;
+        if (memcmp(old_data + sa[middle], new_data, n) < 0)
+            start = middle;
+        else
+            end = middle;
+    }
+
+    const size_t x = match_length(old_data + sa[start], old_size - sa[start], new_data, new_size);
+    const size_t y = match_length(old_data + sa[end], old_size - sa[end], new_data, new_size);
+    *position = x > y ? sa[start] : sa[end];
+    return x > y ? x : y;
+}
+
+static void output_record(output_t *out, const uint8_t *old_data, const uint8_t *new_data,
+    size_t last_scan, size_t last_position, size_t diff_length, size_t extra_length, int64_t seek)
+{
+    output_u32(out, (uint32_t)diff_length);
+    output_u32(out, (uint32_t)extra_length);
+    output_u32(out, (uint32_t)(int32_t)seek);
+
+    uint8_t buffer[4096];
+    for (size_t i = 0; i < diff_length; i += sizeof(buffer))
+    {
+        const size_t n = diff_length - i < sizeof(buffer) ? diff_length - i : sizeof(buffer);
+        for (size_t j = 0; j < n; j++)
+            buffer[j] = new_data[last_scan + i + j] - old_data[last_position + i + j];
+        output_append(out, buffer, n);
+    }
+
+    output_append(out, new_data + last_scan + diff_length, extra_length);
+}
+
+uint8_t *ota_delta_create(const uint8_t *old_data, size_t old_size, const uint8_t *new_data, size_t new_size,
+    size_t *patch_size)
+{
+    output_t out = {};
+
+    uint8_t old_sha256[SHA256_SIZE];
+    sha256_t sha256;
+    sha256_init(&sha256);
+    sha256_update(&sha256, old_data, old_size);
+    sha256_finish(&sha256, old_sha256);
+
+    output_append(&out, OTA_PATCH_MAGIC, 4);
+    output_u32(&out, OTA_PATCH_VERSION);
+    output_u32(&out, (uint32_t)old_size);
+    output_u32(&out, (uint32_t)new_size);
+    output_append(&out, old_sha256, sizeof(old_sha256));
+
+    int32_t * const sa = suffix_array(old_data, old_size);
+    if (!sa)
+    {
+        free(out.data);
+        return NULL;
+    }
+
+    // bsdiff 4.3, with the records written as they are found.
+    size_t scan = 0, length = 0, position = 0;
+    size_t last_scan = 0, last_position = 0;
+    int64_t last_offset = 0;
+
+    while (scan < new_size)
+    {
+        int64_t old_score = 0;
+        size_t scsc = scan += length;
+
+        for (; scan < new_size; scan++)
+        {
+            length = search(sa, old_data, old_size, new_data + scan, new_size - scan, 0, old_size, &position);
+
+            for (; scsc < scan + length; scsc++)
+                if ((int64_t)scsc + last_offset < (int64_t)old_size && old_data[scsc + last_offset] == new_data[scsc])
+                    old_score++;
+
+            if (((int64_t)length == old_score && length != 0) || (int64_t)length > old_score + 8)
+                break;
+
+            if ((int64_t)scan + last_offset < (int64_t)old_size && old_data[scan + last_offset] == new_data[scan])
+                old_score--;
+        }
+
+        if ((int64_t)length != old_score || scan == new_size)
+        {
+            // Extend the previous match forwards and this one backwards, as long as more than half of the bytes match.
+            int64_t s = 0, best = 0;
+            size_t forward = 0;
+            for (size_t i = 0; last_scan + i < scan && last_position + i < old_size;)
+            {
+                if (old_data[last_position + i] == new_data[last_scan + i])
+                    s++;
+                i++;
+                if (s * 2 - (int64_t)i > best * 2 - (int64_t)forward)
+                {
+                    best = s;
+                    forward = i;
+                }
+            }
+
+            size_t backward = 0;
+            if (scan < new_size)
+            {
+                s = 0;
+                best = 0;
+                for (size_t i = 1; scan >= last_scan + i && position >= i; i++)
+                {
+                    if (old_data[position - i] == new_data[scan - i])
+                        s++;
+                    if (s * 2 - (int64_t)i > best * 2 - (int64_t)backward)
+                    {
+                        best = s;
+                        backward = i;
+                    }
+                }
+            }
+
+            if (last_scan + forward > scan - backward)
+            {
+                const size_t overlap = (last_scan + forward) - (scan - backward);
+                s = 0;
+                best = 0;
+                size_t split = 0;
+                for (size_t i = 0; i < overlap; i++)
+                {
+                    if (new_data[last_scan + forward - overlap + i] == old_data[last_position + forward - overlap + i])
+                        s++;
+                    if (new_data[scan - backward + i] == old_data[position - backward + i])
+                        s--;
+                    if (s > best)
+                    {
+                        best = s;
+                        split = i + 1;
+                    }
+                }
+
+                forward += split - overlap;
+                backward -= split;
+            }
+
+            const size_t extra_length = (scan - backward) - (last_scan + forward);
+            const int64_t seek = (int64_t)(position - backward) - (int64_t)(last_position + forward);
+            output_record(&out, old_data, new_data, last_scan, last_position, forward, extra_length, seek);
+
+            last_scan = scan - backward;
+            last_position = position - backward;
+            last_offset = (int64_t)position - (int64_t)scan;
+        }
+    }
+
+    free(sa);
+
+    if (out.failed)
+    {
+        free(out.data);
+        return NULL;
+    }
+
+    *patch_size = out.length;
+    return out.data;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Creates a binary delta between two firmware images in the format of main/ota_patch.h.
+// The algorithm is the one of bsdiff: approximate matches found with a suffix array of the old image,
+// the differences of a match are mostly zeros when only addresses moved, which compresses well.
+
+// Returns the patch (malloc'ed) or NULL if out of memory.
+uint8_t *ota_delta_create(const uint8_t *old_data, size_t old_size, const uint8_t *new_data, size_t new_size,
+    size_t *patch_size);
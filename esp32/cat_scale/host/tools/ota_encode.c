@@ -0,0 +1,35 @@
+#include "ota_encode.h"
+#include "ota_delta.h"
+
+#include <stdlib.h>
+#include <zlib.h>
+
+uint8_t *ota_encode_deflate(const uint8_t *image, size_t image_size, size_t *encoded_size)
+{
+    uLongf size = compressBound(image_size);
+    uint8_t * const encoded = malloc(size);
+    if (!encoded)
+        return NULL;
+
+    if (compress2(encoded, &size, image, image_size, Z_BEST_COMPRESSION) != Z_OK)
+    {
+        free(encoded);
+        return NULL;
+    }
+
+    *encoded_size = size;
+    return encoded;
+}
+
+uint8_t *ota_encode_delta(const uint8_t *old_image, size_t old_size, const uint8_t *image, size_t image_size,
+    size_t *encoded_size)
+{
+    size_t patch_size = 0;
+    uint8_t * const patch = ota_delta_create(old_image, old_size, image, image_size, &patch_size);
+    if (!patch)
+        return NULL;
+
+    uint8_t * const encoded = ota_encode_deflate(patch, patch_size, encoded_size);
+    free(patch);
+    return encoded;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Encodings of an update image understood by the rc server ("ota <size> <sha256> <encoding> <transfer size>").
+
+// zlib stream of the image.
+uint8_t *ota_encode_deflate(const uint8_t *image, size_t image_size, size_t *encoded_size);
+
+// zlib stream of a delta against the running image, see main/ota_patch.h.
+uint8_t *ota_encode_delta(const uint8_t *old_image, size_t old_size, const uint8_t *image, size_t image_size,
+    size_t *encoded_size);
@@ -0,0 +1,62 @@
+// Produces the compressed image or the delta for an update and shows what it saves.
+// ota_sender does the same on the fly (--deflate, --delta), this is for looking at the numbers.
+//
+// usage: ota_pack deflate <new.bin> <output>
+//        ota_pack delta <old.bin> <new.bin> <output>
+
+#include "ota_encode.h"
+#include "file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s deflate <new.bin> <output>\n", name);
+    fprintf(stderr, "       %s delta <old.bin> <new.bin> <output>\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    const bool delta = argc == 5 && strcmp(argv[1], "delta") == 0;
+    const bool deflate = argc == 4 && strcmp(argv[1], "deflate") == 0;
+    if (!delta && !deflate)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char * const old_path = delta ? argv[2] : NULL;
+    const char * const new_path = delta ? argv[3] : argv[2];
+    const char * const output_path = delta ? argv[4] : argv[3];
+
+    size_t old_size = 0, new_size = 0, encoded_size = 0;
+    uint8_t * const old_image = old_path ? file_read(old_path, &old_size) : NULL;
+    uint8_t * const new_image = file_read(new_path, &new_size);
+    if (!new_image || (old_path && !old_image))
+        return 1;
+
+    const clock_t start = clock();
+    uint8_t * const encoded = delta
+        ? ota_encode_delta(old_image, old_size, new_image, new_size, &encoded_size)
+        : ota_encode_deflate(new_image, new_size, &encoded_size);
+    const double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    if (!encoded)
+    {
+        fprintf(stderr, "encoding failed\n");
+        return 1;
+    }
+
+    printf("%s: %zu -> %zu bytes (%.1f%%) in %.2f s\n",
+        argv[1], new_size, encoded_size, encoded_size * 100.0 / new_size, seconds);
+
+    const bool ok = file_write(output_path, encoded, encoded_size);
+
+    free(encoded);
+    free(old_image);
+    free(new_image);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+// Sends a firmware image to the cat scale (rc task, CONFIG_CATSCALE_OTA_PORT) and reports the throughput.
+// The image is announced with its size and SHA-256, the device checks both before it activates the image.
+// It can be sent compressed or as a delta against the image the device is running.
+//
+// usage: ota_sender <host> <image.bin> [port] [--deflate | --delta <running.bin>]
+
+#include "sha256.h"
+#include "ota_encode.h"
+#include "file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#define DEFAULT_PORT    "69"
+#define CHUNK_SIZE      (16 * 1024)
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_to(const char *host, const char *port)
+{
+    const struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *result = NULL;
+
+    const int ret = getaddrinfo(host, port, &hints, &result);
+    if (ret != 0)
+    {
+        fprintf(stderr, "%s: %s\n", host, gai_strerror(ret));
+        return -1;
+    }
+
+    int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (sock >= 0 && connect(sock, result->ai_addr, result->ai_addrlen) != 0)
+    {
+        perror("connect");
+        close(sock);
+        sock = -1;
+    }
+
+    freeaddrinfo(result);
+    return sock;
+}
+
+static int send_all(int sock, const void *data, size_t length)
+{
+    const uint8_t *p = data;
+    while (length > 0)
+    {
+        const ssize_t sent = send(sock, p, length, 0);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("send");
+            return -1;
+        }
+        p += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *positional[3] = { NULL, NULL, DEFAULT_PORT };   // host, image, port
+    int positional_count = 0;
+    const char *old_path = NULL;
+    bool deflate = false;
+    bool valid = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--deflate") == 0)
+            deflate = true;
+        else if (strcmp(argv[i], "--delta") == 0 && i + 1 < argc)
+            old_path = argv[++i];
+        else if (positional_count < 3)
+            positional[positional_count++] = argv[i];
+        else
+            valid = false;
+    }
+
+    const char * const host = positional[0];
+    const char * const path = positional[1];
+    const char * const port = positional[2];
+
+    if (!valid || !host || !path || (deflate && old_path))
+    {
+        fprintf(stderr, "usage: %s <host> <image.bin> [port] [--deflate | --delta <running.bin>]\n", argv[0]);
+        return 1;
+    }
+
+    size_t size = 0;
+    uint8_t * const image = file_read(path, &size);
+    if (!image)
+        return 1;
+
+    uint8_t digest[SHA256_SIZE];
+    sha256_t sha256;
+    sha256_init(&sha256);
+    sha256_update(&sha256, image, size);
+    sha256_finish(&sha256, digest);
+
+    char digest_hex[SHA256_SIZE * 2 + 1] = {};
+    for (int i = 0; i < SHA256_SIZE; i++)
+        snprintf(digest_hex + 2 * i, 3, "%02x", digest[i]);
+
+    printf("%s: %zu bytes, sha256 %s\n", path, size, digest_hex);
+
+    // What goes over the wire.
+    const uint8_t *payload = image;
+    size_t payload_size = size;
+    uint8_t *encoded = NULL;
+    char header[160];
+    int header_length = 0;
+
+    if (old_path || deflate)
+    {
+        size_t old_size = 0;
+        uint8_t * const old_image = old_path ? file_read(old_path, &old_size) : NULL;
+        if (old_path && !old_image)
+            return 1;
+
+        encoded = old_image
+            ? ota_encode_delta(old_image, old_size, image, size, &payload_size)
+            : ota_encode_deflate(image, size, &payload_size);
+        free(old_image);
+        if (!encoded)
+        {
+            fprintf(stderr, "encoding failed\n");
+            return 1;
+        }
+
+        payload = encoded;
+        header_length = snprintf(header, sizeof(header), "ota %zu %s %s %zu\n",
+            size, digest_hex, old_path ? "delta" : "deflate", payload_size);
+        printf("%s: %zu bytes (%.1f%%)\n", old_path ? "delta" : "deflate", payload_size, payload_size * 100.0 / size);
+    }
+    else
+    {
+        header_length = snprintf(header, sizeof(header), "ota %zu %s\n", size, digest_hex);
+    }
+
+    const int sock = connect_to(host, port);
+    if (sock < 0)
+    {
+        free(encoded);
+        free(image);
+        return 1;
+    }
+
+    const double start = now_s();
+    int result = send_all(sock, header, header_length);
+
+    // Roughly what the device received, the socket buffers hold a few KiB.
+    size_t sent = 0;
+    int last_percent = -1;
+    while (result == 0 && sent < payload_size)
+    {
+        const size_t n = payload_size - sent < CHUNK_SIZE ? payload_size - sent : CHUNK_SIZE;
+        result = send_all(sock, payload + sent, n);
+        sent += n;
+
+        const int percent = (int)(sent * 100 / payload_size);
+        if (percent / 10 != last_percent / 10)
+        {
+            const double elapsed = now_s() - start;
+            printf("  %3d%% %7zu KiB %7.1f KiB/s\n", percent, sent / 1024, elapsed > 0 ? sent / 1024.0 / elapsed : 0.0);
+            fflush(stdout);
+            last_percent = percent;
+        }
+    }
+    const double sent_time = now_s() - start;
+
+    // The device answers "ok ..." or "error ..." once the last buffer is written and the image is checked.
+    char reply[512] = {};
+    size_t reply_length = 0;
+    while (reply_length < sizeof(reply) - 1)
+    {
+        const ssize_t n = recv(sock, reply + reply_length, sizeof(reply) - 1 - reply_length, 0);
+        if (n <= 0)
+            break;
+        reply_length += (size_t)n;
+    }
+    const double total_time = now_s() - start;
+    close(sock);
+    free(encoded);
+    free(image);
+
+    printf("sent %zu bytes in %.2f s, done after %.2f s: %.1f KiB/s of image\n",
+        payload_size, sent_time, total_time, total_time > 0 ? size / 1024.0 / total_time : 0.0);
+
+    const char * const ok = strstr(reply, "ok ");
+    const char * const error = strstr(reply, "error ");
+    if (result == 0 && ok)
+    {
+        printf("device: %.*s\n", (int)strcspn(ok, "\n"), ok);
+        return 0;
+    }
+
+    if (error)
+        printf("device: %.*s\n", (int)strcspn(error, "\n"), error);
+    else
+        printf("device: no result (%s)\n", reply_length ? reply : "connection closed");
+    return 1;
+}
@@ -0,0 +1,424 @@
+// Talks to the rpc of the cat scale (rc task, CONFIG_CATSCALE_OTA_PORT): tunes the settings at runtime
+// and reads the statistics of the device. Changed settings are lost on restart unless saved.
+//
+// usage: rc_client <host> [--port <port>] <command>
+//   list                       all settings with value, range and default
+//   get <name>
+//   set <name> <value>
+//   save                       persists the settings and log levels
+//   reset                      back to the defaults (persisted on save)
+//   log                        log levels set at runtime
+//   log <tag> <level>          level: none, error, warn, info, debug, verbose
+//   stats
+//   metrics                    latest snapshot of the runtime metrics (cpu, stacks, heap, buffers, http)
+//   ping
+//   reboot
+
+#include "rpc_frame.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#define DEFAULT_PORT    "69"
+#define GREETING        "hello"
+#define MAX_SETTINGS    (256)
+
+typedef struct {
+    int sock;
+    uint8_t sequence;
+    uint8_t response[RPC_FRAME_HEADER_SIZE + RPC_FRAME_MAX_PAYLOAD];
+} connection_t;
+
+typedef struct {
+    uint16_t id;
+    uint8_t flags;
+    double value;
+    double min;
+    double max;
+    double default_value;
+    char name[64];
+    char unit[16];
+} setting_t;
+
+static const char *g_level_names[] = { "none", "error", "warn", "info", "debug", "verbose" };
+#define LEVEL_COUNT (sizeof(g_level_names) / sizeof(g_level_names[0]))
+
+static int connect_to(const char *host, const char *port)
+{
+    const struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *result = NULL;
+
+    const int ret = getaddrinfo(host, port, &hints, &result);
+    if (ret != 0)
+    {
+        fprintf(stderr, "%s: %s\n", host, gai_strerror(ret));
+        return -1;
+    }
+
+    int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (sock >= 0 && connect(sock, result->ai_addr, result->ai_addrlen) != 0)
+    {
+        perror("connect");
+        close(sock);
+        sock = -1;
+    }
+
+    freeaddrinfo(result);
+    return sock;
+}
+
+static int send_all(int sock, const void *data, size_t length)
+{
+    const uint8_t *p = data;
+    while (length > 0)
+    {
+        const ssize_t sent = send(sock, p, length, 0);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("send");
+            return -1;
+        }
+        p += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+static int recv_all(int sock, void *data, size_t length)
+{
+    uint8_t *p = data;
+    while (length > 0)
+    {
+        const ssize_t received = recv(sock, p, length, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+        {
+            fprintf(stderr, "connection closed by the device\n");
+            return -1;
+        }
+        p += received;
+        length -= (size_t)received;
+    }
+    return 0;
+}
+
+// Returns the status of the response (or -1 if there was none), response is set to the rest of the payload.
+static int request(connection_t *connection, uint8_t command, const rpc_writer_t *payload, rpc_reader_t *response)
+{
+    uint8_t header_data[RPC_FRAME_HEADER_SIZE];
+    const rpc_frame_header_t header = {
+        .command = command,
+        .sequence = ++connection->sequence,
+        .length = payload ? (uint16_t)payload->length : 0,
+    };
+    rpc_frame_encode_header(&header, header_data);
+
+    if (send_all(connection->sock, header_data, sizeof(header_data)) != 0 ||
+        (payload && send_all(connection->sock, payload->data, payload->length) != 0))
+        return -1;
+
+    rpc_frame_header_t response_header = {};
+    if (recv_all(connection->sock, connection->response, RPC_FRAME_HEADER_SIZE) != 0)
+        return -1;
+    if (!rpc_frame_decode_header(connection->response, &response_header) ||
+        response_header.command != (command | RPC_RESPONSE_FLAG) ||
+        response_header.sequence != header.sequence ||
+        response_header.length < 1)
+    {
+        fprintf(stderr, "invalid response\n");
+        return -1;
+    }
+
+    uint8_t * const payload_data = connection->response + RPC_FRAME_HEADER_SIZE;
+    if (recv_all(connection->sock, payload_data, response_header.length) != 0)
+        return -1;
+
+    rpc_reader_init(response, payload_data, response_header.length);
+    return rpc_get_u8(response);
+}
+
+static bool check_status(int status)
+{
+    if (status < 0)
+        return false;
+    if (status != RPC_STATUS_OK)
+    {
+        fprintf(stderr, "device: %s\n", rpc_status_to_name((uint8_t)status));
+        return false;
+    }
+    return true;
+}
+
+static size_t list_settings(connection_t *connection, setting_t *settings, size_t capacity)
+{
+    size_t count = 0;
+
+    while (count < capacity)
+    {
+        uint8_t data[2];
+        rpc_writer_t payload;
+        rpc_writer_init(&payload, data, sizeof(data));
+        rpc_put_u16(&payload, (uint16_t)count);
+
+        rpc_reader_t response;
+        const int status = request(connection, RPC_COMMAND_LIST_SETTINGS, &payload, &response);
+        if (status == RPC_STATUS_NOT_FOUND)
+            break;
+        if (!check_status(status))
+            return 0;
+
+        setting_t * const setting = &settings[count];
+        setting->id = rpc_get_u16(&response);
+        setting->flags = rpc_get_u8(&response);
+        setting->value = rpc_get_double(&response);
+        setting->min = rpc_get_double(&response);
+        setting->max = rpc_get_double(&response);
+        setting->default_value = rpc_get_double(&response);
+        rpc_get_string(&response, setting->name, sizeof(setting->name));
+        rpc_get_string(&response, setting->unit, sizeof(setting->unit));
+        if (response.error)
+        {
+            fprintf(stderr, "invalid setting %zu\n", count);
+            return 0;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+static const setting_t *find_setting(const setting_t *settings, size_t count, const char *name)
+{
+    for (size_t i = 0; i < count; i++)
+        if (strcmp(settings[i].name, name) == 0)
+            return &settings[i];
+
+    fprintf(stderr, "unknown setting '%s'\n", name);
+    return NULL;
+}
+
+static void print_setting(const setting_t *setting, double value)
+{
+    printf("%-20s %12g %-4s [%g .. %g] default %g%s\n", setting->name, value, setting->unit,
+        setting->min, setting->max, setting->default_value, value != setting->default_value ? " *" : "");
+}
+
+static int command_list(connection_t *connection)
+{
+    static setting_t settings[MAX_SETTINGS];
+    const size_t count = list_settings(connection, settings, MAX_SETTINGS);
+    for (size_t i = 0; i < count; i++)
+        print_setting(&settings[i], settings[i].value);
+    return count > 0 ? 0 : 1;
+}
+
+static int command_get_set(connection_t *connection, const char *name, const char *value_text)
+{
+    static setting_t settings[MAX_SETTINGS];
+    const size_t count = list_settings(connection, settings, MAX_SETTINGS);
+    const setting_t * const setting = find_setting(settings, count, name);
+    if (!setting)
+        return 1;
+
+    uint8_t data[16];
+    rpc_writer_t payload;
+    rpc_writer_init(&payload, data, sizeof(data));
+    rpc_put_u16(&payload, setting->id);
+
+    if (value_text)
+    {
+        char *end = NULL;
+        const double value = strtod(value_text, &end);
+        if (end == value_text || *end != '\0')
+        {
+            fprintf(stderr, "invalid value '%s'\n", value_text);
+            return 1;
+        }
+        rpc_put_double(&payload, value);
+    }
+
+    rpc_reader_t response;
+    const int status = request(connection, value_text ? RPC_COMMAND_SET_SETTING : RPC_COMMAND_GET_SETTING, &payload, &response);
+    if (!check_status(status))
+        return 1;
+
+    rpc_get_u16(&response);
+    const double value = rpc_get_double(&response);
+    if (response.error)
+    {
+        fprintf(stderr, "invalid response\n");
+        return 1;
+    }
+
+    print_setting(setting, value);
+    return 0;
+}
+
+static int command_simple(connection_t *connection, uint8_t command)
+{
+    rpc_reader_t response;
+    return check_status(request(connection, command, NULL, &response)) ? 0 : 1;
+}
+
+static int command_log(connection_t *connection, const char *tag, const char *level_name)
+{
+    rpc_reader_t response;
+
+    if (!tag)
+    {
+        if (!check_status(request(connection, RPC_COMMAND_GET_LOG_LEVELS, NULL, &response)))
+            return 1;
+
+        const uint8_t count = rpc_get_u8(&response);
+        for (uint8_t i = 0; i < count && !response.error; i++)
+        {
+            char entry_tag[64];
+            rpc_get_string(&response, entry_tag, sizeof(entry_tag));
+            const uint8_t level = rpc_get_u8(&response);
+            printf("%-16s %s\n", entry_tag, level < LEVEL_COUNT ? g_level_names[level] : "?");
+        }
+        return response.error ? 1 : 0;
+    }
+
+    size_t level = 0;
+    while (level < LEVEL_COUNT && strcmp(g_level_names[level], level_name) != 0)
+        level++;
+    if (level == LEVEL_COUNT)
+    {
+        fprintf(stderr, "unknown log level '%s'\n", level_name);
+        return 1;
+    }
+
+    uint8_t data[300];
+    rpc_writer_t payload;
+    rpc_writer_init(&payload, data, sizeof(data));
+    rpc_put_string(&payload, tag);
+    rpc_put_u8(&payload, (uint8_t)level);
+
+    return check_status(request(connection, RPC_COMMAND_SET_LOG_LEVEL, &payload, &response)) ? 0 : 1;
+}
+
+static int print_values(rpc_reader_t *response)
+{
+    const uint16_t count = rpc_get_u16(response);
+    for (uint16_t i = 0; i < count && !response->error; i++)
+    {
+        char name[256];
+        rpc_get_string(response, name, sizeof(name));
+        const int64_t value = rpc_get_i64(response);
+        if (!response->error)
+            printf("%-32s %"PRId64"\n", name, value);
+    }
+    return response->error ? 1 : 0;
+}
+
+static int command_stats(connection_t *connection)
+{
+    rpc_reader_t response;
+    if (!check_status(request(connection, RPC_COMMAND_GET_STATS, NULL, &response)))
+        return 1;
+
+    return print_values(&response);
+}
+
+static int command_metrics(connection_t *connection)
+{
+    rpc_reader_t response;
+    if (!check_status(request(connection, RPC_COMMAND_GET_METRICS, NULL, &response)))
+        return 1;
+
+    printf("snapshot taken %.1f s ago\n", rpc_get_i64(&response) / 1000.0);
+    return print_values(&response);
+}
+
+static int run_command(connection_t *connection, int argc, char **argv)
+{
+    const char * const command = argv[0];
+
+    if (strcmp(command, "list") == 0 && argc == 1)
+        return command_list(connection);
+    if (strcmp(command, "get") == 0 && argc == 2)
+        return command_get_set(connection, argv[1], NULL);
+    if (strcmp(command, "set") == 0 && argc == 3)
+        return command_get_set(connection, argv[1], argv[2]);
+    if (strcmp(command, "save") == 0 && argc == 1)
+        return command_simple(connection, RPC_COMMAND_SAVE_SETTINGS);
+    if (strcmp(command, "reset") == 0 && argc == 1)
+        return command_simple(connection, RPC_COMMAND_RESET_SETTINGS);
+    if (strcmp(command, "log") == 0 && (argc == 1 || argc == 3))
+        return command_log(connection, argc == 3 ? argv[1] : NULL, argc == 3 ? argv[2] : NULL);
+    if (strcmp(command, "stats") == 0 && argc == 1)
+        return command_stats(connection);
+    if (strcmp(command, "metrics") == 0 && argc == 1)
+        return command_metrics(connection);
+    if (strcmp(command, "ping") == 0 && argc == 1)
+        return command_simple(connection, RPC_COMMAND_PING);
+    if (strcmp(command, "reboot") == 0 && argc == 1)
+        return command_simple(connection, RPC_COMMAND_REBOOT);
+
+    return -1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = NULL;
+    const char *port = DEFAULT_PORT;
+    int command_index = 0;
+
+    for (int i = 1; i < argc && !command_index; i++)
+    {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+            port = argv[++i];
+        else if (!host)
+            host = argv[i];
+        else
+            command_index = i;
+    }
+
+    if (!host || !command_index)
+    {
+        fprintf(stderr, "usage: %s <host> [--port <port>] <list | get <name> | set <name> <value> | save | reset | "
+            "log [<tag> <level>] | stats | metrics | ping | reboot>\n", argv[0]);
+        return 1;
+    }
+
+    connection_t connection = { .sock = connect_to(host, port) };
+    if (connection.sock < 0)
+        return 1;
+
+    // The device greets every connection before it looks at the first read.
+    char greeting[sizeof(GREETING) - 1];
+    if (recv_all(connection.sock, greeting, sizeof(greeting)) != 0 || memcmp(greeting, GREETING, sizeof(greeting)) != 0 ||
+        send_all(connection.sock, RPC_MAGIC, RPC_MAGIC_SIZE) != 0)
+    {
+        fprintf(stderr, "no rpc on %s:%s\n", host, port);
+        close(connection.sock);
+        return 1;
+    }
+
+    int result = run_command(&connection, argc - command_index, argv + command_index);
+    if (result < 0)
+    {
+        fprintf(stderr, "invalid command, run without arguments for usage\n");
+        result = 1;
+    }
+
+    // Closing our side ends the session, the device says goodbye (and reboots if asked to).
+    shutdown(connection.sock, SHUT_WR);
+    char rest[64];
+    while (recv(connection.sock, rest, sizeof(rest), 0) > 0)
+        ;
+    close(connection.sock);
+
+    return result;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Plain SHA-256 (FIPS 180-4) for the host tools, the device uses mbedtls.
+
+#define SHA256_SIZE (32)
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;        // bytes
+    uint8_t block[64];
+    size_t block_length;
+} sha256_t;
+
+void sha256_init(sha256_t *ctx);
+void sha256_update(sha256_t *ctx, const void *data, size_t length);
+void sha256_finish(sha256_t *ctx, uint8_t digest[SHA256_SIZE]);
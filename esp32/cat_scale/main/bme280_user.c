@@ -2,6 +2,7 @@
 
 #include "bme280_user.h"
 #include "bme280.h"
+#include "i2c_bus.h"
 
 #include "sdkconfig.h"
 
@@ -14,8 +15,7 @@
 #include <esp_system.h>
 #include <esp_event.h>
 #include <esp_log.h>
-
-#include <driver/i2c.h>
+#include <esp_cpu.h>
 
 static const char *TAG = "bme280";
 
@@ -25,7 +25,59 @@ static int8_t bme280_user_i2c_write(uint8_t reg_addr, const uint8_t *reg_data, u
 
 static struct bme280_dev dev = {};
 
-esp_err_t bme280_user_init()
+static uint32_t g_measurement_delay_ms = 0;    // forced mode: conversion time of one reading
+
+static portMUX_TYPE g_stats_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static bme280_user_stats_t g_stats = {};
+
+#if CONFIG_CATSCALE_BME280_FORCED_MODE
+#define BME280_USER_MODE_NAME "forced"
+#else
+#define BME280_USER_MODE_NAME "normal"
+#endif
+
+#if defined(BME280_FLOAT_ENABLE)
+#define BME280_USER_COMPENSATION_NAME "double"
+#elif defined(BME280_32BIT_ENABLE)
+#define BME280_USER_COMPENSATION_NAME "int32"
+#else
+#define BME280_USER_COMPENSATION_NAME "int64"
+#endif
+
+// Supply current of the sensor while it measures humidity, pressure and temperature, and in sleep/standby (datasheet table 1).
+#define BME280_CURRENT_HUMIDITY_UA      (340)
+#define BME280_CURRENT_PRESSURE_UA      (714)
+#define BME280_CURRENT_TEMPERATURE_UA   (350)
+#define BME280_CURRENT_SLEEP_NA         (100)
+#define BME280_CURRENT_STANDBY_NA       (200)
+
+static uint32_t oversampling_factor(uint8_t osr)
+{
+    static const uint8_t factors[] = { 0, 1, 2, 4, 8, 16 };
+    return osr < sizeof(factors) ? factors[osr] : 16;
+}
+
+// Average supply current in nA with one measurement per period, idle in between.
+// Typical measurement times from datasheet 9.1: 1 ms + 2 ms per oversampling step, + 0.5 ms for pressure and humidity.
+static uint32_t estimate_current_na(const struct bme280_settings *settings, uint32_t period_us, uint32_t idle_na)
+{
+    const uint32_t temperature_us = 1000 + 2000 * oversampling_factor(settings->osr_t);
+    const uint32_t pressure_us = 2000 * oversampling_factor(settings->osr_p) + 500;
+    const uint32_t humidity_us = 2000 * oversampling_factor(settings->osr_h) + 500;
+    const uint32_t active_us = temperature_us + pressure_us + humidity_us;
+
+    if (period_us < active_us)
+        period_us = active_us;
+
+    // µA * µs
+    const uint64_t charge = (uint64_t)temperature_us * BME280_CURRENT_TEMPERATURE_UA
+        + (uint64_t)pressure_us * BME280_CURRENT_PRESSURE_UA
+        + (uint64_t)humidity_us * BME280_CURRENT_HUMIDITY_UA;
+
+    return (uint32_t)((charge * 1000 + (uint64_t)(period_us - active_us) * idle_na) / period_us);
+}
+
+esp_err_t bme280_user_init(uint32_t read_interval_ms)
 {
     ESP_LOGI(TAG, "bme280_user_init ...");
 
@@ -38,46 +90,146 @@ esp_err_t bme280_user_init()
     rslt = bme280_init(&dev);
     ESP_ERROR_CHECK((rslt == BME280_OK) ? ESP_OK : ESP_FAIL);
 
-	// Recommended mode of operation: Indoor navigation
-	dev.settings.osr_h = BME280_OVERSAMPLING_1X;
-	dev.settings.osr_p = BME280_OVERSAMPLING_16X;
-	dev.settings.osr_t = BME280_OVERSAMPLING_2X;
-	dev.settings.filter = BME280_FILTER_COEFF_16;
-	dev.settings.standby_time = BME280_STANDBY_TIME_62_5_MS;
-
-	uint8_t settings_sel;
-	settings_sel = BME280_OSR_PRESS_SEL;
-	settings_sel |= BME280_OSR_TEMP_SEL;
-	settings_sel |= BME280_OSR_HUM_SEL;
-	settings_sel |= BME280_STANDBY_SEL;
-	settings_sel |= BME280_FILTER_SEL;
-	rslt = bme280_set_sensor_settings(settings_sel, &dev);
-	rslt = bme280_set_sensor_mode(BME280_NORMAL_MODE, &dev);
-
-	ESP_LOGI(TAG, "Temperature, Pressure, Humidity");
-    for(int i=0; i<10; i++)
+    // Recommended mode of operation: Indoor navigation
+    dev.settings.osr_h = BME280_OVERSAMPLING_1X;
+    dev.settings.osr_p = BME280_OVERSAMPLING_16X;
+    dev.settings.osr_t = BME280_OVERSAMPLING_2X;
+    dev.settings.standby_time = BME280_STANDBY_TIME_62_5_MS;
+#if CONFIG_CATSCALE_BME280_FORCED_MODE
+    // The filter runs once per reading in forced mode, with 16 it would take half a minute to follow a change.
+    dev.settings.filter = BME280_FILTER_COEFF_OFF;
+#else
+    dev.settings.filter = BME280_FILTER_COEFF_16;
+#endif
+
+    uint8_t settings_sel;
+    settings_sel = BME280_OSR_PRESS_SEL;
+    settings_sel |= BME280_OSR_TEMP_SEL;
+    settings_sel |= BME280_OSR_HUM_SEL;
+    settings_sel |= BME280_STANDBY_SEL;
+    settings_sel |= BME280_FILTER_SEL;
+    rslt = bme280_set_sensor_settings(settings_sel, &dev);
+    ESP_ERROR_CHECK((rslt == BME280_OK) ? ESP_OK : ESP_FAIL);
+
+    g_measurement_delay_ms = bme280_cal_meas_delay(&dev.settings);
+
+#if !CONFIG_CATSCALE_BME280_FORCED_MODE
+    rslt = bme280_set_sensor_mode(BME280_NORMAL_MODE, &dev);
+    ESP_ERROR_CHECK((rslt == BME280_OK) ? ESP_OK : ESP_FAIL);
+#endif
+
+    // Normal mode converts every t_measure + t_standby, forced mode once per reading.
+    const uint32_t normal_current_na = estimate_current_na(&dev.settings,
+        g_measurement_delay_ms * 1000 + 62500, BME280_CURRENT_STANDBY_NA);
+    const uint32_t forced_current_na = estimate_current_na(&dev.settings,
+        read_interval_ms * 1000, BME280_CURRENT_SLEEP_NA);
+
+    g_stats.measurement_time_ms = g_measurement_delay_ms;
+#if CONFIG_CATSCALE_BME280_FORCED_MODE
+    g_stats.current_na = forced_current_na;
+#else
+    g_stats.current_na = normal_current_na;
+#endif
+
+    ESP_LOGI(TAG, "%s mode, %s compensation, conversion %u ms", BME280_USER_MODE_NAME, BME280_USER_COMPENSATION_NAME,
+        g_measurement_delay_ms);
+    ESP_LOGI(TAG, "estimated current: normal mode %u nA, forced mode every %u ms %u nA",
+        normal_current_na, read_interval_ms, forced_current_na);
+
+    ESP_LOGI(TAG, "Temperature, Pressure, Humidity");
+    for(int i=0; i<3; i++)
+    {
+        uint32_t ready_in_ms = 0;
+        bme280_user_start_measurement(&ready_in_ms);
+        vTaskDelay(ready_in_ms / portTICK_PERIOD_MS + 1);
+
+        double temperature = 0.0, pressure = 0.0, humidity = 0.0;
+        const esp_err_t ret = bme280_user_read_from_sensor(&temperature, &pressure, &humidity);
+        ESP_LOGI(TAG, "%d, %0.2f, %0.2f, %0.2f", ret, temperature, pressure, humidity);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t bme280_user_start_measurement(uint32_t *ready_in_ms)
+{
+    assert(ready_in_ms);
+    *ready_in_ms = 0;
+
+#if CONFIG_CATSCALE_BME280_FORCED_MODE
+    // ctrl_meas: osr_t [7:5], osr_p [4:2], mode [1:0]. The sensor is asleep between readings,
+    // writing the register directly saves the mode read of bme280_set_sensor_mode.
+    const uint8_t reg_addr = BME280_CTRL_MEAS_ADDR;
+    const uint8_t ctrl_meas = (dev.settings.osr_t << 5) | (dev.settings.osr_p << 2) | BME280_FORCED_MODE;
+
+    const int8_t rslt = bme280_set_regs((uint8_t*)&reg_addr, &ctrl_meas, 1, &dev);
+    if (rslt != BME280_OK)
     {
-	 	dev.delay_us(70, dev.intf_ptr);
+        ESP_LOGE(TAG, "Error in bme280_user_start_measurement err=%d", rslt);
+        return ESP_FAIL;
+    }
 
-        struct bme280_data comp_data = {};
-	 	rslt = bme280_get_sensor_data(BME280_ALL, &comp_data, &dev);
-        ESP_LOGI(TAG, "%d, %0.2f, %0.2f, %0.2f", rslt, comp_data.temperature, comp_data.pressure, comp_data.humidity);
-	}
+    *ready_in_ms = g_measurement_delay_ms;
+#endif
 
     return ESP_OK;
 }
 
+// Compensation only, the cycles spent waiting for the bus are not counted.
+static int8_t compensate(const uint8_t *reg_data, struct bme280_data *comp_data, uint32_t *cycles)
+{
+    struct bme280_uncomp_data uncomp_data = {};
+    bme280_parse_sensor_data(reg_data, &uncomp_data);
+
+    // The cycle counter is per core, the task must not be switched out (or moved) in between.
+    vTaskSuspendAll();
+    const uint32_t start = esp_cpu_get_cycle_count();
+    const int8_t rslt = bme280_compensate_data(BME280_ALL, &uncomp_data, comp_data, &dev.calib_data);
+    *cycles = esp_cpu_get_cycle_count() - start;
+    xTaskResumeAll();
+
+    return rslt;
+}
+
 esp_err_t bme280_user_read_from_sensor(double *temperature, double *pressure, double *humidity)
 {
+    uint8_t reg_data[BME280_P_T_H_DATA_LEN] = {};
     struct bme280_data comp_data = {};
+    uint32_t cycles = 0;
+
+    int8_t rslt = bme280_get_regs(BME280_DATA_ADDR, reg_data, BME280_P_T_H_DATA_LEN, &dev);
+    if (rslt == BME280_OK)
+        rslt = compensate(reg_data, &comp_data, &cycles);
 
-    int8_t rslt = bme280_get_sensor_data(BME280_ALL, &comp_data, &dev);
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    if (rslt == BME280_OK)
+    {
+        g_stats.readings++;
+        g_stats.compensation_cycles = cycles;
+        if (cycles > g_stats.max_compensation_cycles)
+            g_stats.max_compensation_cycles = cycles;
+    }
+    else
+    {
+        g_stats.failures++;
+    }
+    taskEXIT_CRITICAL(&g_stats_spinlock);
 
     if (rslt == 0)
     {
+#if defined(BME280_FLOAT_ENABLE)
         *temperature = comp_data.temperature;
         *pressure = comp_data.pressure;
         *humidity = comp_data.humidity;
+#else
+        *temperature = comp_data.temperature / 100.0;   // 0.01 °C
+#if defined(BME280_32BIT_ENABLE)
+        *pressure = comp_data.pressure;                 // Pa
+#else
+        *pressure = comp_data.pressure / 100.0;         // 0.01 Pa
+#endif
+        *humidity = comp_data.humidity / 1024.0;        // 1/1024 %RH
+#endif
 
         return ESP_OK;
     }
@@ -93,49 +245,27 @@ esp_err_t bme280_user_read_from_sensor(double *temperature, double *pressure, do
     }
 }
 
+void bme280_user_get_stats(bme280_user_stats_t *stats)
+{
+    assert(stats);
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    *stats = g_stats;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+}
+
 static void bme280_user_delay_ms(uint32_t period_ms, void *intf_ptr)
 {
     vTaskDelay(period_ms / portTICK_PERIOD_MS);
 }
 
+// The data registers are read in a single burst, the bus is shared with the ccs811 through the i2c_bus task.
 static int8_t bme280_user_i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t len, void *intf_ptr)
 {
-    const uint8_t dev_addr = BME280_I2C_ADDR_PRIM;
-    const int i2c_master_port = 0;
-    const int i2c_timeout_ticks = 1000 / portTICK_PERIOD_MS;
-
-    esp_err_t ret;
-
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    {
-        i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, reg_addr, true);
-    }
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(i2c_master_port, cmd, i2c_timeout_ticks);
-    i2c_cmd_link_delete(cmd);
-
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "error in bme280_user_i2c_read #1 err=%d", ret);
-        return -1;
-    }
-
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    {
-        i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_READ, true);
-
-        for(uint32_t i=0; i<len; i++)
-            i2c_master_read_byte(cmd, reg_data + i, (i == len-1) ? I2C_MASTER_LAST_NACK : I2C_MASTER_ACK);
-    }
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(i2c_master_port, cmd, i2c_timeout_ticks);
-    i2c_cmd_link_delete(cmd);
-
+    const esp_err_t ret = i2c_bus_read(I2C_BUS_DEVICE_BME280, reg_addr, reg_data, len);
     if (ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "error in bme280_user_i2c_read #2 err=%d", ret);
+        ESP_LOGE(TAG, "error in bme280_user_i2c_read reg=%x err=%x", reg_addr, ret);
         return -1;
     }
 
@@ -145,28 +275,10 @@ static int8_t bme280_user_i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t
 
 static int8_t bme280_user_i2c_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t len, void *intf_ptr)
 {
-    const uint8_t dev_addr = BME280_I2C_ADDR_PRIM;
-    const int i2c_master_port = 0;
-    const int i2c_timeout_ticks = 1000 / portTICK_PERIOD_MS;
-
-    esp_err_t ret;
-
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
+    const esp_err_t ret = i2c_bus_write(I2C_BUS_DEVICE_BME280, reg_addr, reg_data, len);
+    if (ret != ESP_OK)
     {
-        i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, reg_addr, true);
-
-        for(uint32_t i=0; i<len; i++)
-            i2c_master_write_byte(cmd, reg_data[i], true);
-    }
-    i2c_master_stop(cmd);
-
-    ret = i2c_master_cmd_begin(i2c_master_port, cmd, i2c_timeout_ticks);
-    i2c_cmd_link_delete(cmd);
-
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "error in bme280_user_i2c_write #1");
+        ESP_LOGE(TAG, "error in bme280_user_i2c_write reg=%x err=%x", reg_addr, ret);
         return -1;
     }
 
@@ -1,9 +1,24 @@
 #pragma once
 
+#include <stdint.h>
 #include <esp_err.h>
 
-esp_err_t bme280_user_init();
+typedef struct {
+    uint32_t readings;
+    uint32_t failures;
+    uint32_t compensation_cycles;       // cpu cycles of the last reading's compensation
+    uint32_t max_compensation_cycles;
+    uint32_t measurement_time_ms;       // conversion time
+    uint32_t current_na;                // estimated average supply current of the sensor
+} bme280_user_stats_t;
+
+// read_interval_ms: how often the sensor is read, for the current estimate in forced mode.
+esp_err_t bme280_user_init(uint32_t read_interval_ms);
+
+// Forced mode (CONFIG_CATSCALE_BME280_FORCED_MODE): starts a conversion, the result can be read after ready_in_ms.
+// Normal mode: does nothing, ready_in_ms is 0.
+esp_err_t bme280_user_start_measurement(uint32_t *ready_in_ms);
 
 esp_err_t bme280_user_read_from_sensor(double *temp, double *pres, double *hum);
 
-//void bme280_sensor_task();
+void bme280_user_get_stats(bme280_user_stats_t *stats);
@@ -1,6 +1,7 @@
 #undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
 
 #include "ccs811.h"
+#include "i2c_bus.h"
 
 #include "sdkconfig.h"
 
@@ -16,8 +17,10 @@
 #include <esp_event.h>
 #include <esp_log.h>
 #include <esp_timer.h>
+#include <esp_attr.h>
+#include <nvs.h>
 
-#include <driver/i2c.h>
+#include <driver/gpio.h>
 
 static const char *TAG = "ccs811";
 
@@ -50,22 +53,48 @@ static const char *TAG = "ccs811";
 #define CCS811_STATUS_APP_VALID         0x10
 #define CCS811_STATUS_FW_MODE           0x80
 
+#define CCS811_MEAS_MODE_1S             (1 << 4)
+#define CCS811_MEAS_MODE_INTERRUPT      (1 << 3)    // nINT goes low when new results are ready
+
+// Reported by the algorithm until it has produced its first results.
+#define CCS811_CO2_RESET_VALUE          (400)
+#define CCS811_TVOC_RESET_VALUE         (0)
+
+#define CCS811_NVS_NAMESPACE            "ccs811"
+#define CCS811_NVS_KEY_BASELINE         "baseline"
+
+// The baseline is not worth keeping before the sensor ran for 20 minutes (ams application note).
+#define CCS811_BASELINE_RUN_IN_US       (20LL * 60 * 1000 * 1000)
+#define CCS811_BASELINE_SAVE_INTERVAL_US ((int64_t)CONFIG_CATSCALE_CCS811_BASELINE_SAVE_INTERVAL_MIN * 60 * 1000 * 1000)
+
+#define CCS811_NINT_ENABLED             (CONFIG_CATSCALE_CCS811_NINT_GPIO >= 0)
+
 const uint8_t ccs811_reset_seq[4] = { 0x11, 0xE5, 0x72, 0x8A };
 
 static esp_err_t ccs811_i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t len);
 static esp_err_t ccs811_i2c_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t len);
-static void ccs811_read_from_sensor();
+static esp_err_t read_results(void);
+static esp_err_t setup_nint(void);
+static bool load_baseline(uint8_t *baseline);
 
-static int64_t last_measure_time = 0;
 static uint32_t last_co2 = 0;
 static uint32_t last_tvoc = 0;
 
+static int64_t g_init_time = 0;                 // µs since boot
+static int64_t g_last_baseline_save_time = 0;   // µs since boot, 0 = not yet
+static uint8_t g_saved_baseline[2] = {};
+
+static portMUX_TYPE g_stats_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static ccs811_stats_t g_stats = {};
+
 esp_err_t ccs811_init() // TODO extend error handling? maybe ignore device in main if init fails?
 {
     esp_log_level_set(TAG, ESP_LOG_DEBUG);
 
     ESP_LOGI(TAG, "ccs811_init");
 
+    g_init_time = esp_timer_get_time();
+
     // check device compatibility.
     uint8_t status = 0;
     uint8_t hw_id = 0;
@@ -131,264 +160,275 @@ esp_err_t ccs811_init() // TODO extend error handling? maybe ignore device in ma
     ccs811_i2c_read(CCS811_REG_MEAS_MODE, &mode, 1);
     ESP_LOGD(TAG, "mode after app_start %x", mode);
 
-    mode = (1 << 4); // 1/s
+    esp_err_t ret = setup_nint();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "nint setup failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    mode = CCS811_MEAS_MODE_1S;
+    if (CCS811_NINT_ENABLED)
+        mode |= CCS811_MEAS_MODE_INTERRUPT;
     ccs811_i2c_write(CCS811_REG_MEAS_MODE, &mode, 1);
     vTaskDelay(50 / portTICK_PERIOD_MS);
 
     ccs811_i2c_read(CCS811_REG_MEAS_MODE, &mode, 1);
     ESP_LOGD(TAG, "mode after mode set %x", mode);
 
-    // restore baseline.
-    //const uint8_t prev_baseline[2] = { 0x1C, 0xBB };
-    //const uint8_t prev_baseline[2] = { 0x18, 0xBD };
-    // ccs811_i2c_write(CCS811_REG_BASELINE, prev_baseline, sizeof(prev_baseline));
-    // vTaskDelay(50 / portTICK_PERIOD_MS);
+    // restore baseline, the sensor keeps its conditioning across reboots this way.
+    if (load_baseline(g_saved_baseline))
+    {
+        ret = ccs811_i2c_write(CCS811_REG_BASELINE, g_saved_baseline, sizeof(g_saved_baseline));
+        ESP_LOGI(TAG, "restoring baseline %02x%02x: %s", g_saved_baseline[0], g_saved_baseline[1], esp_err_to_name(ret));
+        g_stats.baseline_restored = ret == ESP_OK;
+        vTaskDelay(50 / portTICK_PERIOD_MS);
+    }
 
     // try reading some samples.
-    uint8_t baseline1[2] = {};
-    ccs811_i2c_read(CCS811_REG_BASELINE, baseline1, sizeof(baseline1));
-    ESP_LOGD(TAG, "baseline1 %x %x", baseline1[0], baseline1[1]);
-
     for(int i=0; i<3; i++)
     {
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-        ccs811_read_from_sensor();
+        vTaskDelay(1100 / portTICK_PERIOD_MS);
+        ret = read_results();
+        ESP_LOGD(TAG, "sample %d: co2 %u tvoc %u (%s)", i, last_co2, last_tvoc, esp_err_to_name(ret));
     }
 
-    uint8_t baseline2[2] = {};
-    ccs811_i2c_read(CCS811_REG_BASELINE, baseline2, sizeof(baseline2));
-    ESP_LOGD(TAG, "baseline2 %x %x", baseline2[0], baseline2[1]);
-
     return ESP_OK;
 }
 
-static uint8_t current_baseline[2] = {};
+#if CCS811_NINT_ENABLED
+static volatile bool g_data_ready = false;      // set by the nINT interrupt
 
-esp_err_t ccs811_get_latest_values(uint32_t *co2, uint32_t *tvoc)
+static void IRAM_ATTR ccs811_nint_isr(void *arg)
 {
-    assert(co2);
-    assert(tvoc);
+    g_data_ready = true;
 
-    const int64_t t_now = esp_timer_get_time(); // us
-    const int64_t t_diff = t_now - last_measure_time;
+    portENTER_CRITICAL_ISR(&g_stats_spinlock);
+    g_stats.interrupts++;
+    portEXIT_CRITICAL_ISR(&g_stats_spinlock);
+}
+#endif
 
-    esp_err_t ret;
+static esp_err_t setup_nint(void)
+{
+#if CCS811_NINT_ENABLED
+    const gpio_config_t conf = {
+        .pin_bit_mask = 1ULL << CONFIG_CATSCALE_CCS811_NINT_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,       // open drain
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
 
-    // has 1 second passed since last (successful) read?
-    if (t_diff > 1 * 1000 * 1000)
-    {
-        // Data ready?
-        uint8_t status = 0;
-        ret = ccs811_i2c_read(CCS811_REG_STATUS, &status, 1);
-        if (ret == ESP_OK && (status & CCS811_STATUS_DATA_READY))
-        {
-            uint8_t data[4] = {}; // only read 4 bytes (out of 8)
-            esp_err_t ret = ccs811_i2c_read(CCS811_REG_ALG_RESULT_DATA, data, sizeof(data));
-            if (ret == ESP_OK)
-            {
-                last_measure_time = t_now;
-                last_co2 = (data[0] << 8) | data[1];
-                last_tvoc = (data[2] << 8) | data[3];
-
-                // New baseline?
-                uint8_t baseline[2] = {};
-                if (ccs811_i2c_read(CCS811_REG_BASELINE, baseline, sizeof(baseline)) == ESP_OK)
-                {
-                    if (memcmp(current_baseline, baseline, 2) != 0)
-                    {
-                        ESP_LOGD(TAG, "new baseline: %x %x", baseline[0], baseline[1]);
-                        memcpy(current_baseline, baseline, 2);
-                        // TODO save to nvs & restore on next start
-                    }
-                }
-            }
-        }
-    }
+    esp_err_t ret = gpio_config(&conf);
+    if (ret != ESP_OK)
+        return ret;
 
-    *co2 = last_co2;
-    *tvoc = last_tvoc;
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) // already installed
+        return ret;
 
+    return gpio_isr_handler_add(CONFIG_CATSCALE_CCS811_NINT_GPIO, ccs811_nint_isr, NULL);
+#else
     return ESP_OK;
+#endif
 }
 
-static uint16_t ccs811_double_to_u16(double input)
+static bool is_data_ready(void)
 {
-    int x = round(input);
+#if CCS811_NINT_ENABLED
+    // nINT stays low until the results are read, the level covers an edge before the handler was installed.
+    if (!g_data_ready && gpio_get_level(CONFIG_CATSCALE_CCS811_NINT_GPIO) != 0)
+        return false;
 
-    if (x < 0)
-        x = 0;
-
-    if (x > 0xFFFF)
-        x = 0xFFFF;
-
-    return (uint16_t)x;
+    g_data_ready = false;
+#endif
+    return true;
 }
 
-esp_err_t ccs811_set_environment_data(double temperature, double humidity)
+// One transaction per reading: results, status and error id. Without nINT the status tells whether there is something new.
+// ESP_ERR_NOT_FOUND if there are no new results.
+static esp_err_t read_results(void)
 {
-    //ESP_LOGD(TAG, "set env data %0.2f %0.2f", temperature, humidity);
+    if (!is_data_ready())
+        return ESP_ERR_NOT_FOUND;
 
-    const double humidity_1_512_th = humidity / (1. / 512.);
-    const double temperature_1_512_th = (temperature + 25.) / (1. / 512.);
+    uint8_t data[6] = {}; // only read 6 bytes (out of 8)
+    const esp_err_t ret = ccs811_i2c_read(CCS811_REG_ALG_RESULT_DATA, data, sizeof(data));
 
-    //printf("h %f t %f\n", humidity_1_512_th, temperature_1_512_th);
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    g_stats.transactions++;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
 
-    const uint16_t h = ccs811_double_to_u16(humidity_1_512_th);
-    const uint16_t t = ccs811_double_to_u16(temperature_1_512_th);
+    if (ret != ESP_OK)
+        return ret;
 
-    //printf("h %x t %x\n", h, t);
+    const uint8_t status = data[4];
+    if (status & CCS811_STATUS_ERROR)
+        ESP_LOGW(TAG, "error flag is set, error_id %x", data[5]);
 
-    const uint8_t data[4] =
-    {
-        (h & 0xFF00) >> 8,
-        (h & 0xFF),
+    if (!(status & CCS811_STATUS_DATA_READY))
+        return ESP_ERR_NOT_FOUND;
 
-        (t & 0xFF00) >> 8,
-        (t & 0xFF),
-    };
+    last_co2 = (data[0] << 8) | data[1];
+    last_tvoc = (data[2] << 8) | data[3];
 
-    //ESP_LOG_BUFFER_HEX(TAG, data, sizeof(data));
+    uint32_t time_to_valid_ms = 0;
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    g_stats.readings++;
+    if (g_stats.time_to_valid_ms == 0 && (last_co2 != CCS811_CO2_RESET_VALUE || last_tvoc != CCS811_TVOC_RESET_VALUE))
+    {
+        g_stats.time_to_valid_ms = (uint32_t)((esp_timer_get_time() - g_init_time) / 1000);
+        time_to_valid_ms = g_stats.time_to_valid_ms;
+    }
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+
+    if (time_to_valid_ms)
+        ESP_LOGI(TAG, "first valid results %u ms after init (baseline %s)", time_to_valid_ms,
+            g_stats.baseline_restored ? "restored" : "not restored");
 
-    return ccs811_i2c_write(CCS811_REG_ENV_DATA, data, sizeof(data));
+    return ESP_OK;
 }
 
-static void ccs811_read_from_sensor()
+static bool load_baseline(uint8_t *baseline)
 {
-    while(true)
+    nvs_handle_t nvs = 0;
+    esp_err_t ret = nvs_open(CCS811_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret != ESP_OK)
     {
-        uint8_t status = 0;
-        ccs811_i2c_read(CCS811_REG_STATUS, &status, 1);
+        // The namespace does not exist before the first save.
+        if (ret != ESP_ERR_NVS_NOT_FOUND)
+            ESP_LOGE(TAG, "nvs_open failed: %s", esp_err_to_name(ret));
+        return false;
+    }
 
-        if (status & CCS811_STATUS_DATA_READY)
-            break;
+    size_t length = 2;
+    ret = nvs_get_blob(nvs, CCS811_NVS_KEY_BASELINE, baseline, &length);
+    nvs_close(nvs);
 
-        vTaskDelay(1);
-    }
+    return ret == ESP_OK && length == 2;
+}
 
-    uint8_t data[8] = {};
-    ccs811_i2c_read(CCS811_REG_ALG_RESULT_DATA, data, sizeof(data));
+static esp_err_t save_baseline(const uint8_t *baseline)
+{
+    nvs_handle_t nvs = 0;
+    esp_err_t ret = nvs_open(CCS811_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK)
+        return ret;
+
+    ret = nvs_set_blob(nvs, CCS811_NVS_KEY_BASELINE, baseline, 2);
+    if (ret == ESP_OK)
+        ret = nvs_commit(nvs);
+    nvs_close(nvs);
 
-    ESP_LOG_BUFFER_HEX(TAG, data, sizeof(data));
+    return ret;
 }
 
-#if 0
-static esp_err_t ccs811_i2c_read__(uint8_t reg_addr, uint8_t *reg_data, uint32_t len)
+// After the run-in time and then every CONFIG_CATSCALE_CCS811_BASELINE_SAVE_INTERVAL_MIN, if it changed.
+static void maintain_baseline(int64_t now)
 {
-    const uint8_t dev_addr = CCS811_ADDR_PRIMARY;
-    const int i2c_master_port = 0;
-    const int i2c_timeout_ticks = 1000 / portTICK_PERIOD_MS;
+    if (now - g_init_time < CCS811_BASELINE_RUN_IN_US)
+        return;
+    if (g_last_baseline_save_time != 0 && now - g_last_baseline_save_time < CCS811_BASELINE_SAVE_INTERVAL_US)
+        return;
 
-    // xxx
-    //esp_rom_delay_us(1000);
-    // xxx
+    g_last_baseline_save_time = now;
 
-    esp_err_t ret;
+    uint8_t baseline[2] = {};
+    if (ccs811_i2c_read(CCS811_REG_BASELINE, baseline, sizeof(baseline)) != ESP_OK)
+        return;
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
+    if (memcmp(g_saved_baseline, baseline, sizeof(baseline)) == 0)
     {
-        i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, reg_addr, true);
-    }
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(i2c_master_port, cmd, i2c_timeout_ticks);
-    i2c_cmd_link_delete(cmd);
-
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "error in ccs811_i2c_read reg=%x err=%x %s", reg_addr, ret, esp_err_to_name(ret));
-        return -1;
+        ESP_LOGD(TAG, "baseline unchanged: %02x%02x", baseline[0], baseline[1]);
+        return;
     }
 
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
+    const esp_err_t ret = save_baseline(baseline);
+    ESP_LOGI(TAG, "saving baseline %02x%02x: %s", baseline[0], baseline[1], esp_err_to_name(ret));
+    if (ret == ESP_OK)
     {
-        i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_READ, true);
+        memcpy(g_saved_baseline, baseline, sizeof(baseline));
 
-        for(uint32_t i=0; i<len; i++)
-            i2c_master_read_byte(cmd, reg_data + i, (i == len-1) ? I2C_MASTER_LAST_NACK : I2C_MASTER_ACK);
+        taskENTER_CRITICAL(&g_stats_spinlock);
+        g_stats.baseline_saves++;
+        taskEXIT_CRITICAL(&g_stats_spinlock);
     }
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(i2c_master_port, cmd, i2c_timeout_ticks);
-    i2c_cmd_link_delete(cmd);
+}
 
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "error in ccs811_i2c_read reg=%x err=%x %s", reg_addr, ret, esp_err_to_name(ret));
-        return ret;
-    }
+esp_err_t ccs811_get_latest_values(uint32_t *co2, uint32_t *tvoc)
+{
+    assert(co2);
+    assert(tvoc);
+
+    // New results once a second, as often as this is called. With nINT there's no i2c traffic until they are ready.
+    if (read_results() == ESP_OK)
+        maintain_baseline(esp_timer_get_time());
+
+    *co2 = last_co2;
+    *tvoc = last_tvoc;
 
     return ESP_OK;
 }
-#endif
 
-static esp_err_t ccs811_i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t len)
+void ccs811_get_stats(ccs811_stats_t *stats)
 {
-    const uint8_t dev_addr = CCS811_ADDR_PRIMARY;
-    const int i2c_master_port = 0;
-    const int i2c_timeout_ticks = 1000 / portTICK_PERIOD_MS;
+    assert(stats);
 
-    // xxx
-    //esp_rom_delay_us(1000);
-    // xxx
-
-    esp_err_t ret;
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    *stats = g_stats;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+}
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    {
-        i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, reg_addr, true);
-    }
-    i2c_master_start(cmd);
-    {
-        i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_READ, true);
+static uint16_t ccs811_double_to_u16(double input)
+{
+    int x = round(input);
 
-        for(uint32_t i=0; i<len; i++)
-            i2c_master_read_byte(cmd, reg_data + i, (i == len-1) ? I2C_MASTER_LAST_NACK : I2C_MASTER_ACK);
-    }
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(i2c_master_port, cmd, i2c_timeout_ticks);
-    i2c_cmd_link_delete(cmd);
+    if (x < 0)
+        x = 0;
 
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "error in ccs811_i2c_read reg=%x err=%x %s", reg_addr, ret, esp_err_to_name(ret));
-        return ret;
-    }
+    if (x > 0xFFFF)
+        x = 0xFFFF;
 
-    return ESP_OK;
+    return (uint16_t)x;
 }
 
-static esp_err_t ccs811_i2c_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t len)
+esp_err_t ccs811_set_environment_data(double temperature, double humidity)
 {
-    const uint8_t dev_addr = CCS811_ADDR_PRIMARY;
-    const int i2c_master_port = 0;
-    const int i2c_timeout_ticks = 1000 / portTICK_PERIOD_MS;
+    //ESP_LOGD(TAG, "set env data %0.2f %0.2f", temperature, humidity);
 
-    // xxx
-    //esp_rom_delay_us(1000);
-    // xxx
+    const double humidity_1_512_th = humidity / (1. / 512.);
+    const double temperature_1_512_th = (temperature + 25.) / (1. / 512.);
+
+    //printf("h %f t %f\n", humidity_1_512_th, temperature_1_512_th);
+
+    const uint16_t h = ccs811_double_to_u16(humidity_1_512_th);
+    const uint16_t t = ccs811_double_to_u16(temperature_1_512_th);
 
-    esp_err_t ret;
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    //printf("h %x t %x\n", h, t);
 
-    i2c_master_start(cmd);
+    const uint8_t data[4] =
     {
-        i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, reg_addr, true);
+        (h & 0xFF00) >> 8,
+        (h & 0xFF),
 
-        for(uint32_t i=0; i<len; i++)
-            i2c_master_write_byte(cmd, reg_data[i], true);
-    }
-    i2c_master_stop(cmd);
+        (t & 0xFF00) >> 8,
+        (t & 0xFF),
+    };
 
-    ret = i2c_master_cmd_begin(i2c_master_port, cmd, i2c_timeout_ticks);
-    i2c_cmd_link_delete(cmd);
+    //ESP_LOG_BUFFER_HEX(TAG, data, sizeof(data));
 
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "error in ccs811_i2c_write err=%x (%s)", ret, esp_err_to_name(ret));
-        return ret;
-    }
+    // Nothing to wait for, the data is copied into the job.
+    const i2c_bus_transfer_t transfer = { .reg = CCS811_REG_ENV_DATA, .write_data = data, .length = sizeof(data) };
+    return i2c_bus_submit(I2C_BUS_DEVICE_CCS811, &transfer, 1, NULL, NULL);
+}
 
-    return ESP_OK;
+static esp_err_t ccs811_i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t len)
+{
+    return i2c_bus_read(I2C_BUS_DEVICE_CCS811, reg_addr, reg_data, len);
+}
+
+static esp_err_t ccs811_i2c_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t len)
+{
+    return i2c_bus_write(I2C_BUS_DEVICE_CCS811, reg_addr, reg_data, len);
 }
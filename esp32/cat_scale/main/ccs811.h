@@ -1,9 +1,22 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
 #include <esp_err.h>
 
+typedef struct {
+    uint32_t readings;
+    uint32_t transactions;      // i2c transactions for the readings (baseline and environment data not included)
+    uint32_t interrupts;        // nINT
+    uint32_t baseline_saves;
+    bool baseline_restored;
+    uint32_t time_to_valid_ms;  // from init until the results left their reset values, 0 until then
+} ccs811_stats_t;
+
 esp_err_t ccs811_init();
 
 esp_err_t ccs811_get_latest_values(uint32_t *co2, uint32_t *tvoc);
 
 esp_err_t ccs811_set_environment_data(double temperature, double humidity);
+
+void ccs811_get_stats(ccs811_stats_t *stats);
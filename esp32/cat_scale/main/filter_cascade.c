@@ -3,130 +3,130 @@
 #include "filter_cascade.h"
 #include "filters.h"
 #include "measurement.h"
+#include "settings.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
 #include <assert.h>
 
-static high_pass_filter_t *g_hpf = NULL;
-static low_pass_filter_t *g_lpf = NULL;
-static mean_filter_t *g_mean = NULL;
-static median_filter_t *g_median = NULL;
-static differentiator_t *g_dxdt = NULL;
+#define HPF_HISTORY_SIZE    FILTER_CASCADE_HPF_HISTORY_SIZE
+#define STABLE_VALUES_SIZE  (1000)
+
+struct filter_cascade {
+    size_t channel;
+    setting_id_t calibration;
+
+    high_pass_filter_t *hpf;
+    low_pass_filter_t *lpf;
+    mean_filter_t *mean;
+    median_filter_t *median;
+    differentiator_t *dxdt;
 
 #if DEBUG_FILTER_CASCADE
-static double g_first_input_value = 0.0;
+    double first_input_value;
 #endif
 
-#define HPF_HISTORY_SIZE    (10)
-#define STABLE_VALUES_SIZE  (1000)
+    bool input_switch;
+    double input_offset;
+    double prev_hpf_offsets[HPF_HISTORY_SIZE];
+    double input_switch_timer;
 
-static bool g_input_switch = false;
-static double g_input_offset = 0.0;
-static double g_prev_hpf_offsets[HPF_HISTORY_SIZE] = {};
-static double g_input_switch_timer = 0.0;
+    // Only the mean of a stable phase is reported, so the sum of its first STABLE_VALUES_SIZE values is enough.
+    double stable_time;
+    double stable_phase_sum;
+    int stable_phase_values_count;
 
-static double g_stable_time = 0.0;
-static double g_stable_phase_values[STABLE_VALUES_SIZE] = {};
-static int g_stable_phase_values_count = 0;
+    double settle_time; // since the filters were reset
+};
 
+// The other parameters can be tuned at runtime, see settings.h.
 static const double cfg_sampling_frequency = 10.0;
-static const double cfg_dxdt_threshold = 50.0;
-static const double cfg_stable_phase_min_time = 2.5;
-static const double cfg_hold_timer = 10.0;
-static const double cfg_hold_timeout = 300.0;
-static const double cfg_hold_weight_low = -500.0;
-static const double cfg_hold_weight_high = 5000.0;
-static const double cfg_calibration_factor = 1.0 / 23.0;
-
-void filter_cascade_init(void)
+
+filter_cascade_t *filter_cascade_create(size_t channel, setting_id_t calibration)
 {
-    g_hpf = create_high_pass_filter(cfg_sampling_frequency, 0.1);
-    g_lpf = create_low_pass_filter(cfg_sampling_frequency, 0.5);
-    g_mean = create_mean_filter(10);
-    g_median = create_median_filter(10);
-    g_dxdt = create_differentiator(cfg_sampling_frequency);
+    assert(calibration < SETTING_COUNT);
 
-#if DEBUG_FILTER_CASCADE
-    g_first_input_value = 0.0;
-#endif
+    filter_cascade_t * const cascade = calloc(1, sizeof(filter_cascade_t));
+    assert(cascade);
 
-    g_input_switch = false;
-    g_input_offset = 0.0;
-    memset(g_prev_hpf_offsets, 0, sizeof(g_prev_hpf_offsets));
-    g_input_switch_timer = 0.0;
+    cascade->channel = channel;
+    cascade->calibration = calibration;
 
-    g_stable_time = 0.0;
-    memset(g_stable_phase_values, 0, sizeof(g_stable_phase_values));
-    g_stable_phase_values_count = 0;
+    cascade->hpf = create_high_pass_filter(cfg_sampling_frequency, 0.1);
+    cascade->lpf = create_low_pass_filter(cfg_sampling_frequency, 0.5);
+    cascade->mean = create_mean_filter(FILTER_CASCADE_WINDOW_SIZE);
+    cascade->median = create_median_filter(FILTER_CASCADE_WINDOW_SIZE);
+    cascade->dxdt = create_differentiator(cfg_sampling_frequency);
+
+    return cascade;
 }
 
-void filter_cascade_cleanup(void)
+void filter_cascade_destroy(filter_cascade_t *cascade)
 {
-    if (g_hpf) destroy_high_pass_filter(g_hpf);
-    if (g_lpf) destroy_low_pass_filter(g_lpf);
-    if (g_mean) destroy_mean_filter(g_mean);
-    if (g_median) destroy_median_filter(g_median);
-    if (g_dxdt) destroy_differentiator(g_dxdt);
-
-    g_hpf = NULL;
-    g_lpf = NULL;
-    g_mean = NULL;
-    g_median = NULL;
-    g_dxdt = NULL;
+    if (!cascade)
+        return;
+
+    destroy_high_pass_filter(cascade->hpf);
+    destroy_low_pass_filter(cascade->lpf);
+    destroy_mean_filter(cascade->mean);
+    destroy_median_filter(cascade->median);
+    destroy_differentiator(cascade->dxdt);
+
+    free(cascade);
 }
 
-static void push_stable_value(double value, double dt)
+static void push_stable_value(filter_cascade_t *cascade, double value, double dt)
 {
-    g_stable_time += dt;
+    cascade->stable_time += dt;
 
-    if (g_stable_phase_values_count < STABLE_VALUES_SIZE)
-        g_stable_phase_values[g_stable_phase_values_count++] = value;
+    if (cascade->stable_phase_values_count < STABLE_VALUES_SIZE)
+    {
+        cascade->stable_phase_sum += value;
+        cascade->stable_phase_values_count++;
+    }
 }
 
-static void clear_stable_phase(void)
+static void clear_stable_phase(filter_cascade_t *cascade)
 {
-    if (g_stable_time >= cfg_stable_phase_min_time &&
-        g_stable_phase_values_count > 0 &&
-        g_input_switch)
+    if (cascade->stable_time >= settings_get(SETTING_STABLE_MIN_TIME) &&
+        cascade->stable_phase_values_count > 0 &&
+        cascade->input_switch)
     {
-        double avg = 0;
-        for(size_t i=0; i<g_stable_phase_values_count; i++)
-            avg += g_stable_phase_values[i];
-        avg /= (double)g_stable_phase_values_count;
+        const double avg = cascade->stable_phase_sum / (double)cascade->stable_phase_values_count;
 
-        measurement_push_stable_phase(g_stable_time, avg);
+        measurement_push_stable_phase(cascade->channel, cascade->stable_time, avg);
     }
 
-    g_stable_time = 0.0;
-    memset(g_stable_phase_values, 0, sizeof(g_stable_phase_values));
-    g_stable_phase_values_count = 0;
+    cascade->stable_time = 0.0;
+    cascade->stable_phase_sum = 0.0;
+    cascade->stable_phase_values_count = 0;
 }
 
-double filter_cascade_process(double input, double dt)
+double filter_cascade_process(filter_cascade_t *cascade, double input, double dt)
 {
-    assert(g_hpf);
+    assert(cascade);
 
 #if DEBUG_FILTER_CASCADE
-    if (g_first_input_value == 0.0)
-        g_first_input_value = input;
+    if (cascade->first_input_value == 0.0)
+        cascade->first_input_value = input;
 #endif
 
-    const double output_hpf1 = high_pass_filter(g_hpf, input);
-    const double input_for_lpf = g_input_switch ? (input + g_input_offset) : output_hpf1;
-    const double output_lpf = low_pass_filter(g_lpf, input_for_lpf);
-    const double output_mean = mean_filter(g_mean, output_lpf);
-    const double output_median = median_filter(g_median, output_mean);
-    const double output_grams = output_median * cfg_calibration_factor;
-    const double output_dxdt = differentiate(g_dxdt, output_grams);
+    const double output_hpf1 = high_pass_filter(cascade->hpf, input);
+    const double input_for_lpf = cascade->input_switch ? (input + cascade->input_offset) : output_hpf1;
+    const double output_lpf = low_pass_filter(cascade->lpf, input_for_lpf);
+    const double output_mean = mean_filter(cascade->mean, output_lpf);
+    const double output_median = median_filter(cascade->median, output_mean);
+    const double output_grams = output_median * settings_get(cascade->calibration);
+    const double output_dxdt = differentiate(cascade->dxdt, output_grams);
 
-    for(size_t i=HPF_HISTORY_SIZE-1; i>0; i--) g_prev_hpf_offsets[i] = g_prev_hpf_offsets[i-1];
-    g_prev_hpf_offsets[0] = output_hpf1 - input;
+    for(size_t i=HPF_HISTORY_SIZE-1; i>0; i--) cascade->prev_hpf_offsets[i] = cascade->prev_hpf_offsets[i-1];
+    cascade->prev_hpf_offsets[0] = output_hpf1 - input;
 
 #if DEBUG_FILTER_CASCADE
-    filter_cascade_debug("input", input - g_first_input_value + 50000);
-    filter_cascade_debug("hpf hold", g_input_switch ? (100000) : (75000));
+    filter_cascade_debug("input", input - cascade->first_input_value + 50000);
+    filter_cascade_debug("hpf hold", cascade->input_switch ? (100000) : (75000));
     //filter_cascade_debug("hpf out", output_hpf);
     //filter_cascade_debug("lpf in", input_for_lpf);
     //filter_cascade_debug("lpf out", output_lpf);
@@ -136,54 +136,114 @@ double filter_cascade_process(double input, double dt)
     //filter_cascade_debug("dxdt out", output_dxdt);
 #endif
 
-    const bool signal_stable = fabs(output_dxdt) < cfg_dxdt_threshold;
+    const bool signal_stable = fabs(output_dxdt) < settings_get(SETTING_DXDT_THRESHOLD);
 
     const bool hold_trigger = !signal_stable ||
-        output_grams < cfg_hold_weight_low ||
-        output_grams > cfg_hold_weight_high;
+        output_grams < settings_get(SETTING_HOLD_WEIGHT_LOW) ||
+        output_grams > settings_get(SETTING_HOLD_WEIGHT_HIGH);
 
     if (signal_stable)
     {
-        push_stable_value(output_grams, dt);
+        push_stable_value(cascade, output_grams, dt);
     }
     else
     {
-        clear_stable_phase();
+        clear_stable_phase(cascade);
     }
 
     if (hold_trigger)
     {
         // activate switch?
-        if (!g_input_switch)
+        if (!cascade->input_switch)
         {
-            measurement_mark_start_of_event();
-            g_input_switch = true;
-            g_input_offset = g_prev_hpf_offsets[HPF_HISTORY_SIZE-1];
+            measurement_mark_start_of_event(cascade->channel);
+            cascade->input_switch = true;
+            cascade->input_offset = cascade->prev_hpf_offsets[HPF_HISTORY_SIZE-1];
         }
 
-        g_input_switch_timer = cfg_hold_timer;
+        cascade->input_switch_timer = settings_get(SETTING_HOLD_TIMER);
     }
 
-    if (g_input_switch)
+    if (!cascade->input_switch)
+        cascade->settle_time += dt;
+
+    if (cascade->input_switch)
     {
-        g_input_switch_timer -= dt;
+        cascade->input_switch_timer -= dt;
 
         // deactivate switch?
-        if (g_input_switch_timer <= 0 || g_stable_time >= cfg_hold_timeout)
+        if (cascade->input_switch_timer <= 0 || cascade->stable_time >= settings_get(SETTING_HOLD_TIMEOUT))
         {
-            clear_stable_phase();
-            measurement_mark_end_of_event();
+            clear_stable_phase(cascade);
+            measurement_mark_end_of_event(cascade->channel);
 
-            g_input_switch = false;
+            cascade->input_switch = false;
 
-            g_hpf->reset = true;
-            g_lpf->reset = true;
-            g_mean->reset = true;
-            g_median->reset = true;
-            g_dxdt->reset = true;
+            cascade->hpf->reset = true;
+            cascade->lpf->reset = true;
+            cascade->mean->reset = true;
+            cascade->median->reset = true;
+            cascade->dxdt->reset = true;
+            cascade->settle_time = 0.0;
         }
     }
 
     return output_grams;
 }
 
+void filter_cascade_get_status(const filter_cascade_t *cascade, filter_cascade_status_t *status)
+{
+    assert(cascade);
+    assert(status);
+
+    status->input_switch = cascade->input_switch;
+    status->input_switch_timer = cascade->input_switch ? cascade->input_switch_timer : 0.0;
+    status->stable_time = cascade->stable_time;
+}
+
+bool filter_cascade_save_state(const filter_cascade_t *cascade, filter_cascade_state_t *state)
+{
+    assert(cascade);
+    assert(state);
+
+    if (cascade->input_switch || cascade->settle_time < settings_get(SETTING_SETTLE_TIME))
+        return false;
+
+    state->hpf_prev_input = cascade->hpf->prev_input;
+    state->hpf_prev_output = cascade->hpf->prev_output;
+    state->lpf_prev_output = cascade->lpf->prev_output;
+    memcpy(state->mean_values, cascade->mean->prev_values, sizeof(state->mean_values));
+    memcpy(state->median_values, cascade->median->prev_values, sizeof(state->median_values));
+    state->dxdt_prev_input = cascade->dxdt->prev_input;
+    memcpy(state->prev_hpf_offsets, cascade->prev_hpf_offsets, sizeof(state->prev_hpf_offsets));
+
+    return true;
+}
+
+void filter_cascade_restore_state(filter_cascade_t *cascade, const filter_cascade_state_t *state)
+{
+    assert(cascade);
+    assert(state);
+
+    cascade->hpf->prev_input = state->hpf_prev_input;
+    cascade->hpf->prev_output = state->hpf_prev_output;
+    cascade->hpf->reset = false;
+
+    cascade->lpf->prev_output = state->lpf_prev_output;
+    cascade->lpf->reset = false;
+
+    memcpy(cascade->mean->prev_values, state->mean_values, sizeof(state->mean_values));
+    cascade->mean->reset = false;
+
+    memcpy(cascade->median->prev_values, state->median_values, sizeof(state->median_values));
+    cascade->median->reset = false;
+
+    cascade->dxdt->prev_input = state->dxdt_prev_input;
+    cascade->dxdt->reset = false;
+
+    memcpy(cascade->prev_hpf_offsets, state->prev_hpf_offsets, sizeof(cascade->prev_hpf_offsets));
+
+    cascade->input_switch = false;
+    cascade->settle_time = settings_get(SETTING_SETTLE_TIME);
+}
+
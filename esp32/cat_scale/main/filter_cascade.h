@@ -1,9 +1,46 @@
 #pragma once
 
-void filter_cascade_init(void);
-void filter_cascade_cleanup(void);
+#include <stddef.h>
+#include <stdbool.h>
 
-double filter_cascade_process(double input, double dt);
+#include "settings.h"
+
+#define FILTER_CASCADE_WINDOW_SIZE      (10)
+#define FILTER_CASCADE_HPF_HISTORY_SIZE (10)
+
+// Filter state of the idle scale, restored after a restart so the filters don't have to converge again.
+typedef struct {
+    double hpf_prev_input;
+    double hpf_prev_output;
+    double lpf_prev_output;
+    double mean_values[FILTER_CASCADE_WINDOW_SIZE];
+    double median_values[FILTER_CASCADE_WINDOW_SIZE];
+    double dxdt_prev_input;
+    double prev_hpf_offsets[FILTER_CASCADE_HPF_HISTORY_SIZE];
+} filter_cascade_state_t;
+
+// What the cascade decided for the last sample, for watching it live.
+typedef struct {
+    bool input_switch;          // offset held, something is on the scale
+    double input_switch_timer;  // s until the offset is released
+    double stable_time;         // s of the current stable phase
+} filter_cascade_status_t;
+
+// One cascade per scale channel, the events it detects are reported to the measurement module for that channel.
+typedef struct filter_cascade filter_cascade_t;
+
+// calibration: setting with the g per hx711 count of the channel.
+filter_cascade_t *filter_cascade_create(size_t channel, setting_id_t calibration);
+void filter_cascade_destroy(filter_cascade_t *cascade);
+
+double filter_cascade_process(filter_cascade_t *cascade, double input, double dt);
+
+void filter_cascade_get_status(const filter_cascade_t *cascade, filter_cascade_status_t *status);
+
+// Returns false if there is nothing worth saving: during an event or while the filters are still settling.
+bool filter_cascade_save_state(const filter_cascade_t *cascade, filter_cascade_state_t *state);
+// Must be called before the first sample is processed.
+void filter_cascade_restore_state(filter_cascade_t *cascade, const filter_cascade_state_t *state);
 
 #if DEBUG_FILTER_CASCADE
 void filter_cascade_debug(const char *id, double value);
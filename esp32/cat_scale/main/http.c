@@ -8,20 +8,52 @@
 #include "sdkconfig.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
+#include <freertos/semphr.h>
 
 #include <esp_system.h>
 #include <esp_event.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <esp_tls.h>
 #include <esp_http_client.h>
 #include <esp_crt_bundle.h>
 
 static const char *TAG = "app-http";
 
+// After this many failed requests in a row the client handle is destroyed and created from scratch.
+#define HTTP_MAX_CONSECUTIVE_FAILURES   (3)
+
+// Streamed bodies are collected into chunks of this size before they are sent.
+#define HTTP_CHUNK_SIZE                 (512)
+
+typedef struct {
+    esp_http_client_handle_t client;
+    size_t length;
+    size_t total;
+    char buffer[HTTP_CHUNK_SIZE];
+} http_chunk_sink_t;
+
+typedef struct {
+    const char *name;
+    SemaphoreHandle_t mutex;
+    esp_http_client_handle_t client;
+    int consecutive_failures;
+    http_client_stats_t stats;
+    http_chunk_sink_t sink; // protected by mutex like the client
+} http_pool_entry_t;
+
+static http_pool_entry_t g_pool[HTTP_CLIENT_COUNT] = {
+    [HTTP_CLIENT_INFLUX]            = { .name = "influx" },
+    [HTTP_CLIENT_JSON_ENDPOINT_0]   = { .name = "json0" },
+    [HTTP_CLIENT_JSON_ENDPOINT_1]   = { .name = "json1" },
+};
+
 static esp_err_t http_client_event_handler(esp_http_client_event_t *evt)
 {
     switch(evt->event_id) 
@@ -32,6 +64,10 @@ static esp_err_t http_client_event_handler(esp_http_client_event_t *evt)
 
         case HTTP_EVENT_ON_CONNECTED:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+            if (evt->user_data) {
+                http_pool_entry_t * const entry = evt->user_data;
+                entry->stats.connects++;
+            }
             break;
 
         case HTTP_EVENT_HEADER_SENT:
@@ -73,12 +109,21 @@ static esp_err_t http_client_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
-esp_err_t http_post_sensor_data_influx(const char *sensor_data)
+esp_err_t http_init(void)
 {
-    assert(sensor_data);
+    ESP_LOGI(TAG, "http_init");
 
-    //esp_log_level_set(TAG, ESP_LOG_DEBUG);
+    for(int i=0; i<HTTP_CLIENT_COUNT; i++)
+    {
+        g_pool[i].mutex = xSemaphoreCreateMutex();
+        assert(g_pool[i].mutex);
+    }
+
+    return ESP_OK;
+}
 
+static esp_http_client_handle_t create_influx_client(http_pool_entry_t *entry)
+{
     const char *addr   = CONFIG_CATSCALE_INFLUX_ENDPOINT;
     const char *org    = CONFIG_CATSCALE_INFLUX_ORGANIZATION;
     const char *bucket = CONFIG_CATSCALE_INFLUX_BUCKET;
@@ -94,91 +139,323 @@ esp_err_t http_post_sensor_data_influx(const char *sensor_data)
         .url = url,
         .method = HTTP_METHOD_POST,
         .event_handler = http_client_event_handler,
+        .user_data = entry,
+        .keep_alive_enable = true,
     };
 
     esp_http_client_handle_t client = esp_http_client_init(&config);
     if (!client)
-    {
-        ESP_LOGE(TAG, "esp_http_client_init failed");
-        return ESP_FAIL;
-    }
+        return NULL;
 
     esp_http_client_set_header(client, "Authorization", auth);
     esp_http_client_set_header(client, "Content-Type", "text/plain; charset=utf-8");
     esp_http_client_set_header(client, "Accept", "application/json");
-    esp_http_client_set_post_field(client, sensor_data, strlen(sensor_data));
-
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "HTTP POST Status = %d", esp_http_client_get_status_code(client));
-
-    } else {
-        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
-    }
-
-    esp_http_client_cleanup(client);
 
-    return ESP_OK;
+    return client;
 }
 
-static esp_err_t http_post_json_data_with_endpoint(int endpoint, const char *path, const char *json)
+static esp_http_client_handle_t create_json_client(http_pool_entry_t *entry, int endpoint)
 {
-    assert(path);
-    assert(json);
-
     const char *addr = NULL;
     const char *token = NULL;
     get_http_secrets(endpoint, &addr, &token);
-    if (!addr || !token) return ESP_FAIL;
-
-    char url[256] = {};
-    snprintf(url, sizeof(url), "%s/%s", addr, path);
-    ESP_LOGI(TAG, "Posting to '%s' ...", url);
+    if (!addr || !token) return NULL;
 
+    // The path is set for each request, the connection is kept as long as the host stays the same.
     const esp_http_client_config_t config = {
-        .url = url,
+        .url = addr,
         .method = HTTP_METHOD_POST,
         .event_handler = http_client_event_handler,
+        .user_data = entry,
         .crt_bundle_attach = esp_crt_bundle_attach,
+        .keep_alive_enable = true,
     };
 
     esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "esp_http_client_init failed");
-        return ESP_FAIL;
-    }
+    if (!client)
+        return NULL;
 
     esp_http_client_set_header(client, "Content-Type", "application/json");
     esp_http_client_set_header(client, "Authorization", "ApiKey");
     esp_http_client_set_header(client, "ApiKey", token);
-    esp_http_client_set_post_field(client, json, strlen(json));
 
-    esp_err_t ret = ESP_OK;
-    esp_err_t err = esp_http_client_perform(client);
+    return client;
+}
+
+static http_pool_entry_t *acquire_client(http_client_id_t id)
+{
+    assert(id < HTTP_CLIENT_COUNT);
+
+    http_pool_entry_t * const entry = &g_pool[id];
+    assert(entry->mutex); // http_init() not called?
+
+    xSemaphoreTake(entry->mutex, portMAX_DELAY);
+
+    if (!entry->client)
+    {
+        ESP_LOGI(TAG, "Creating http client '%s' ...", entry->name);
+
+        entry->client = (id == HTTP_CLIENT_INFLUX)
+            ? create_influx_client(entry)
+            : create_json_client(entry, id - HTTP_CLIENT_JSON_ENDPOINT_0);
+
+        if (!entry->client)
+            ESP_LOGE(TAG, "Failed to create http client '%s'", entry->name);
+    }
+
+    return entry;
+}
+
+static void release_client(http_pool_entry_t *entry)
+{
+    assert(entry);
+    xSemaphoreGive(entry->mutex);
+}
+
+static esp_err_t write_chunk(esp_http_client_handle_t client, const char *data, size_t length)
+{
+    char header[16] = {};
+    const int header_length = snprintf(header, sizeof(header), "%x\r\n", (unsigned int)length);
+
+    if (esp_http_client_write(client, header, header_length) != header_length)
+        return ESP_FAIL;
+    if (length && esp_http_client_write(client, data, length) != (int)length)
+        return ESP_FAIL;
+    if (esp_http_client_write(client, "\r\n", 2) != 2)
+        return ESP_FAIL;
+
+    return ESP_OK;
+}
+
+static esp_err_t flush_chunk_sink(http_chunk_sink_t *sink)
+{
+    if (sink->length == 0)
+        return ESP_OK;
+
+    const esp_err_t ret = write_chunk(sink->client, sink->buffer, sink->length);
+    sink->length = 0;
+    return ret;
+}
+
+static esp_err_t write_chunk_sink(void *sink_ptr, const char *data, size_t length)
+{
+    http_chunk_sink_t * const sink = sink_ptr;
+    assert(sink);
+    assert(data || !length);
+
+    while (length > 0)
+    {
+        size_t n = HTTP_CHUNK_SIZE - sink->length;
+        if (n > length)
+            n = length;
+
+        memcpy(sink->buffer + sink->length, data, n);
+        sink->length += n;
+        sink->total += n;
+        data += n;
+        length -= n;
+
+        if (sink->length == HTTP_CHUNK_SIZE)
+        {
+            esp_err_t ret = flush_chunk_sink(sink);
+            if (ret != ESP_OK)
+                return ret;
+        }
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t stream_request(http_pool_entry_t *entry, http_body_source_t source, const void *context)
+{
+    esp_http_client_handle_t client = entry->client;
+
+    // Note: The client only sets the Transfer-Encoding header, the chunks have to be framed here.
+    esp_err_t err = esp_http_client_open(client, -1);
+    if (err != ESP_OK)
+        return err;
+
+    http_chunk_sink_t * const sink = &entry->sink;
+    sink->client = client;
+    sink->length = 0;
+    sink->total = 0;
+
+    err = source(context, write_chunk_sink, sink);
+    entry->stats.body_bytes += sink->total;
+    if (err == ESP_OK)
+        err = flush_chunk_sink(sink);
+    if (err == ESP_OK)
+        err = write_chunk(client, NULL, 0);
+
+    if (err != ESP_OK)
+        return err;
+
+    if (esp_http_client_fetch_headers(client) < 0)
+        return ESP_FAIL;
+
+    // Read the rest of the response so the connection can be reused.
+    esp_http_client_flush_response(client, NULL);
+
+    return ESP_OK;
+}
+
+static esp_err_t perform_request(http_pool_entry_t *entry, http_body_source_t source, const void *context, int *http_status_out)
+{
+    assert(entry);
+    assert(entry->client);
+
+    const int64_t t0 = esp_timer_get_time();
+    esp_err_t err = source
+        ? stream_request(entry, source, context)
+        : esp_http_client_perform(entry->client);
+    const int64_t dt = esp_timer_get_time() - t0;
+
+    entry->stats.requests++;
+    entry->stats.last_latency_us = dt;
+    entry->stats.total_latency_us += dt;
+    if (dt > entry->stats.max_latency_us)
+        entry->stats.max_latency_us = dt;
+
+    int http_status = 0;
     if (err == ESP_OK) {
-        int httpStatus = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "HTTP POST Status = %d", httpStatus);
-        if (httpStatus / 100 != 2)
-            ret = ESP_FAIL;
+        http_status = esp_http_client_get_status_code(entry->client);
+        ESP_LOGI(TAG, "HTTP POST Status = %d (%s, %lld ms)", http_status, entry->name, dt / 1000);
     } else {
-        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
-        ret = ESP_FAIL;
+        ESP_LOGE(TAG, "HTTP POST request failed: %s (%s)", esp_err_to_name(err), entry->name);
+    }
+
+    if (http_status_out)
+        *http_status_out = http_status;
+
+    if (err == ESP_OK && http_status / 100 == 2)
+    {
+        entry->consecutive_failures = 0;
+        return ESP_OK;
+    }
+
+    entry->stats.failures++;
+
+    // A response with an error status still leaves a usable connection behind.
+    if (err == ESP_OK)
+        return ESP_FAIL;
+
+    entry->consecutive_failures++;
+    if (entry->consecutive_failures >= HTTP_MAX_CONSECUTIVE_FAILURES)
+    {
+        ESP_LOGW(TAG, "%d failures in a row, recreating http client '%s'", entry->consecutive_failures, entry->name);
+        esp_http_client_cleanup(entry->client);
+        entry->client = NULL;
+        entry->consecutive_failures = 0;
+        entry->stats.recreates++;
+    }
+    else
+    {
+        // Drop the possibly broken connection, the next request reconnects.
+        esp_http_client_close(entry->client);
+    }
+
+    return ESP_FAIL;
+}
+
+esp_err_t http_post_sensor_data_influx(const char *sensor_data)
+{
+    assert(sensor_data);
+
+    //esp_log_level_set(TAG, ESP_LOG_DEBUG);
+
+    http_pool_entry_t * const entry = acquire_client(HTTP_CLIENT_INFLUX);
+    if (!entry->client)
+    {
+        release_client(entry);
+        return ESP_FAIL;
     }
 
-    esp_http_client_cleanup(client);
+    const size_t length = strlen(sensor_data);
+    esp_http_client_set_post_field(entry->client, sensor_data, length);
+    entry->stats.body_bytes += length;
+    esp_err_t ret = perform_request(entry, NULL, NULL, NULL);
+
+    release_client(entry);
 
     return ret;
 }
 
-esp_err_t http_post_json_data(const char *path, const char *json)
+static esp_err_t post_json(int endpoint, const char *path, const char *json,
+    http_body_source_t source, const void *context, int *http_status)
 {
-    esp_err_t ret = ESP_OK;
+    if (http_status)
+        *http_status = 0;
 
-    for(int i=0; i<2; i++)
+    http_pool_entry_t * const entry = acquire_client(HTTP_CLIENT_JSON_ENDPOINT_0 + endpoint);
+    if (!entry->client)
     {
-        if (http_post_json_data_with_endpoint(i, path, json) != ESP_OK)
-            ret = ESP_FAIL;
+        release_client(entry);
+        return ESP_FAIL;
+    }
+
+    const char *addr = NULL;
+    const char *token = NULL;
+    get_http_secrets(endpoint, &addr, &token);
+
+    char url[256] = {};
+    snprintf(url, sizeof(url), "%s/%s", addr, path);
+    ESP_LOGI(TAG, "Posting to '%s' ...", url);
+
+    esp_http_client_set_url(entry->client, url);
+    esp_http_client_set_method(entry->client, HTTP_METHOD_POST);
+    if (json)
+    {
+        esp_http_client_set_post_field(entry->client, json, strlen(json));
+        entry->stats.body_bytes += strlen(json);
     }
+    else
+        esp_http_client_set_post_field(entry->client, NULL, 0);
+
+    esp_err_t ret = perform_request(entry, source, context, http_status);
+
+    release_client(entry);
 
     return ret;
 }
+
+esp_err_t http_post_json_data(int endpoint, const char *path, const char *json, int *http_status)
+{
+    assert(endpoint >= 0 && endpoint < HTTP_JSON_ENDPOINT_COUNT);
+    assert(path);
+    assert(json);
+
+    return post_json(endpoint, path, json, NULL, NULL, http_status);
+}
+
+esp_err_t http_post_json_stream(int endpoint, const char *path, http_body_source_t source, const void *context, int *http_status)
+{
+    assert(endpoint >= 0 && endpoint < HTTP_JSON_ENDPOINT_COUNT);
+    assert(path);
+    assert(source);
+
+    return post_json(endpoint, path, NULL, source, context, http_status);
+}
+
+void http_get_client_stats(http_client_id_t id, http_client_stats_t *stats)
+{
+    assert(id < HTTP_CLIENT_COUNT);
+    assert(stats);
+
+    // Note: No locking here, the numbers are only used for monitoring and a torn read is harmless.
+    memcpy(stats, &g_pool[id].stats, sizeof(http_client_stats_t));
+}
+
+void http_log_stats(void)
+{
+    for(int i=0; i<HTTP_CLIENT_COUNT; i++)
+    {
+        http_client_stats_t stats = {};
+        http_get_client_stats(i, &stats);
+
+        const int64_t avg_latency_us = stats.requests ? stats.total_latency_us / stats.requests : 0;
+
+        ESP_LOGI(TAG, "%s: requests=%"PRIu32" failures=%"PRIu32" connects=%"PRIu32" recreates=%"PRIu32" latency last=%lldms avg=%lldms max=%lldms",
+            g_pool[i].name, stats.requests, stats.failures, stats.connects, stats.recreates,
+            stats.last_latency_us / 1000, avg_latency_us / 1000, stats.max_latency_us / 1000);
+    }
+}
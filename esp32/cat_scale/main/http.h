@@ -1,6 +1,45 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include <esp_err.h>
 
+#define HTTP_JSON_ENDPOINT_COUNT    (2)
+
+typedef enum {
+    HTTP_CLIENT_INFLUX,
+    HTTP_CLIENT_JSON_ENDPOINT_0,
+    HTTP_CLIENT_JSON_ENDPOINT_1,
+    HTTP_CLIENT_COUNT,
+} http_client_id_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t failures;
+    uint32_t connects;          // TCP/TLS handshakes
+    uint32_t recreates;         // client handle thrown away after repeated failures
+    int64_t last_latency_us;
+    int64_t max_latency_us;
+    int64_t total_latency_us;
+    uint64_t body_bytes;        // of all requests, without the http headers
+} http_client_stats_t;
+
+// Receives the request body piece by piece.
+typedef esp_err_t (*http_body_writer_t)(void *sink, const char *data, size_t length);
+
+// Produces a request body by calling write as often as needed. Must produce the same body every time (retries).
+typedef esp_err_t (*http_body_source_t)(const void *context, http_body_writer_t write, void *sink);
+
+esp_err_t http_init(void);
+
 esp_err_t http_post_sensor_data_influx(const char *sensor_data);
-esp_err_t http_post_json_data(const char *path, const char *json);
+
+// Posts to a single JSON endpoint. http_status (optional) receives the response status or 0 if there was none.
+esp_err_t http_post_json_data(int endpoint, const char *path, const char *json, int *http_status);
+
+// Same as http_post_json_data but streams the body with chunked transfer encoding, the size of the body is not limited.
+esp_err_t http_post_json_stream(int endpoint, const char *path, http_body_source_t source, const void *context, int *http_status);
+
+void http_get_client_stats(http_client_id_t id, http_client_stats_t *stats);
+void http_log_stats(void);
@@ -17,69 +17,123 @@
 
 
 
-#define PIN_CLOCK   GPIO_NUM_18
-#define PIN_DATA    GPIO_NUM_19
-
 static const char *TAG = "hx711";
 
 static portMUX_TYPE g_signal_spinlock = portMUX_INITIALIZER_UNLOCKED;
 
+static hx711_channel_config_t g_channels[HX711_MAX_CHANNELS] = {};
+static uint32_t g_clock_groups[HX711_MAX_CHANNELS] = {}; // per channel: mask of the channels on its clock line
+static size_t g_channel_count = 0;
+
 
-esp_err_t hx711_init()
+esp_err_t hx711_init(const hx711_channel_config_t *channels, size_t count)
 {
     ESP_LOGI(TAG, "hx711_init ...");
 
+    assert(channels);
+    assert(count > 0 && count <= HX711_MAX_CHANNELS);
+
+    memcpy(g_channels, channels, count * sizeof(hx711_channel_config_t));
+    g_channel_count = count;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        g_clock_groups[i] = 0;
+        for (size_t j = 0; j < count; j++)
+            if (channels[j].clock_pin == channels[i].clock_pin)
+                g_clock_groups[i] |= 1u << j;
+    }
+
     // configure pins
-    gpio_reset_pin(PIN_CLOCK); // select gpio function, enable pullup and disable input and output
-    gpio_reset_pin(PIN_DATA);
-    gpio_set_direction(PIN_CLOCK, GPIO_MODE_OUTPUT);
-    gpio_set_direction(PIN_DATA, GPIO_MODE_INPUT);
-
-    // reset sensor
-    gpio_set_level(PIN_CLOCK, 1);
-    esp_rom_delay_us(100);
-    gpio_set_level(PIN_CLOCK, 0);
-    esp_rom_delay_us(10);
-
-    // read some values
-    uint32_t values[10];
-    uint32_t t0 = esp_timer_get_time(); // us since boot
-    for(int i=0; i<10; i++)
-        values[i] = hx711_read_from_sensor();
-    uint32_t t1 = esp_timer_get_time(); // us since boot
-    
-    ESP_LOGI(TAG, "dt for 10 samples: %u", t1 - t0); // should be ~1s
-    for(int i=0; i<10; i++)
-        ESP_LOGI(TAG, "value %d = %u", i, values[i]);
+    for (size_t i = 0; i < count; i++)
+    {
+        gpio_reset_pin(channels[i].clock_pin); // select gpio function, enable pullup and disable input and output
+        gpio_reset_pin(channels[i].data_pin);
+        gpio_set_direction(channels[i].clock_pin, GPIO_MODE_OUTPUT);
+        gpio_set_direction(channels[i].data_pin, GPIO_MODE_INPUT);
+    }
 
-    return ESP_OK;
-}
+    // reset sensors, once per clock line
+    for (size_t i = 0; i < count; i++)
+    {
+        if (g_clock_groups[i] & ((1u << i) - 1))
+            continue;
 
-uint32_t hx711_read_from_sensor()
-{
-    // Wait for data line to go low. Indicating a sample is ready to be read.
-    while(gpio_get_level(PIN_DATA))
+        gpio_set_level(channels[i].clock_pin, 1);
+        esp_rom_delay_us(100);
+        gpio_set_level(channels[i].clock_pin, 0);
+        esp_rom_delay_us(10);
+    }
+
+    // read one value of every channel, a missing sensor never gets ready
+    uint32_t values[HX711_MAX_CHANNELS] = {};
+    uint32_t read_mask = 0;
+    const uint32_t all_mask = (1u << count) - 1;
+    const int64_t t0 = esp_timer_get_time(); // us since boot
+    while (read_mask != all_mask && esp_timer_get_time() - t0 < 1000 * 1000)
     {
+        for (size_t i = 0; i < count; i++)
+            if (!(read_mask & (1u << i)))
+                read_mask |= hx711_read(i, values);
         vTaskDelay(1);
     }
+    const int64_t t1 = esp_timer_get_time(); // us since boot
 
-    uint32_t data = 0;
+    ESP_LOGI(TAG, "dt for the first samples: %lld", t1 - t0); // should be ~100ms
+    for (size_t i = 0; i < count; i++)
+    {
+        if (read_mask & (1u << i))
+            ESP_LOGI(TAG, "channel %u: value = %u", i, values[i]);
+        else
+            ESP_LOGE(TAG, "channel %u: not ready (clock %d, data %d)", i, channels[i].clock_pin, channels[i].data_pin);
+    }
 
-    taskENTER_CRITICAL(&g_signal_spinlock); // ~25us
+    return ESP_OK;
+}
+
+uint32_t hx711_read(size_t channel, uint32_t *values)
+{
+    assert(channel < g_channel_count);
+    assert(values);
+
+    const uint32_t group = g_clock_groups[channel];
+    const gpio_num_t clock_pin = g_channels[channel].clock_pin;
+
+    gpio_num_t data_pins[HX711_MAX_CHANNELS] = {};
+    size_t group_size = 0;
+    for (size_t i = 0; i < g_channel_count; i++)
+        if (group & (1u << i))
+            data_pins[group_size++] = g_channels[i].data_pin;
+
+    // The data line goes low when a sample is ready to be read.
+    for (size_t i = 0; i < group_size; i++)
+        if (gpio_get_level(data_pins[i]))
+            return 0;
+
+    uint32_t data[HX711_MAX_CHANNELS] = {};
+
+    taskENTER_CRITICAL(&g_signal_spinlock); // ~25us, a few more per additional channel on the clock line
     {
         for (int i=0; i<24; i++)
         {
-            gpio_set_level(PIN_CLOCK, 1);
-            data <<= 1;
-            gpio_set_level(PIN_CLOCK, 0);
-            data |= gpio_get_level(PIN_DATA);
+            gpio_set_level(clock_pin, 1);
+            for (size_t j = 0; j < group_size; j++)
+                data[j] <<= 1;
+            gpio_set_level(clock_pin, 0);
+            for (size_t j = 0; j < group_size; j++)
+                data[j] |= gpio_get_level(data_pins[j]);
         }
 
-        gpio_set_level(PIN_CLOCK, 1);
-        data = data ^ 0x00800000; // signed to unsigned
-        gpio_set_level(PIN_CLOCK, 0);
+        gpio_set_level(clock_pin, 1);
+        for (size_t j = 0; j < group_size; j++)
+            data[j] = data[j] ^ 0x00800000; // signed to unsigned
+        gpio_set_level(clock_pin, 0);
     }
     taskEXIT_CRITICAL(&g_signal_spinlock);
 
-    return data;
+    for (size_t i = 0, j = 0; i < g_channel_count; i++)
+        if (group & (1u << i))
+            values[i] = data[j++];
+
+    return group;
 }
@@ -1,8 +1,20 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 #include <esp_err.h>
 
-esp_err_t hx711_init();
+#define HX711_MAX_CHANNELS  (4)
 
-uint32_t hx711_read_from_sensor();
+// Channels can share the clock line, every clock pulse shifts a bit out of all of them.
+// Those are read together, as soon as the conversions of all of them are done.
+typedef struct {
+    int clock_pin;
+    int data_pin;
+} hx711_channel_config_t;
+
+esp_err_t hx711_init(const hx711_channel_config_t *channels, size_t count);
+
+// Reads the channel and the channels sharing its clock line if their conversions are done, doesn't wait.
+// values has an entry per channel. Returns the bit mask of the channels that were read, 0 if they weren't ready.
+uint32_t hx711_read(size_t channel, uint32_t *values);
@@ -0,0 +1,296 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "i2c_bus.h"
+
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+#include <esp_system.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <driver/i2c.h>
+
+static const char *TAG = "i2c_bus";
+
+#define I2C_BUS_PORT            (0)
+#define I2C_BUS_SCL_IO          (GPIO_NUM_4)
+#define I2C_BUS_SDA_IO          (GPIO_NUM_5)
+#define I2C_BUS_QUEUE_LENGTH    (8)
+
+typedef struct {
+    const char *name;
+    uint8_t address;
+    uint32_t clock_speed;
+    uint32_t timeout_ms;        // per transfer, the ccs811 stretches the clock for a while
+} i2c_bus_device_config_t;
+
+static const i2c_bus_device_config_t g_devices[I2C_BUS_DEVICE_COUNT] = {
+    [I2C_BUS_DEVICE_BME280] = { "bme280", 0x76, CONFIG_CATSCALE_I2C_BME280_CLOCK_HZ, 20 },
+    [I2C_BUS_DEVICE_CCS811] = { "ccs811", 0x5A, CONFIG_CATSCALE_I2C_CCS811_CLOCK_HZ, 100 },
+};
+
+typedef struct {
+    i2c_bus_device_t device;
+    size_t count;
+    i2c_bus_transfer_t transfers[I2C_BUS_MAX_TRANSFERS];
+    uint8_t write_buffer[I2C_BUS_WRITE_BUFFER_SIZE];
+    i2c_bus_done_t done;
+    void *context;
+} i2c_bus_job_t;
+
+typedef struct {
+    TaskHandle_t task;
+    esp_err_t result;
+} i2c_bus_waiter_t;
+
+static QueueHandle_t g_queue = NULL;
+static TaskHandle_t g_task = NULL;
+static uint32_t g_clock_speed = 0;     // current clock of the bus, only used by the bus task
+
+static portMUX_TYPE g_stats_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static i2c_bus_stats_t g_stats[I2C_BUS_DEVICE_COUNT] = {};
+
+static void i2c_bus_task(void*);
+
+static i2c_config_t get_config(uint32_t clock_speed)
+{
+    return (i2c_config_t){
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = I2C_BUS_SDA_IO,
+        .scl_io_num = I2C_BUS_SCL_IO,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = clock_speed,
+    };
+}
+
+esp_err_t i2c_bus_init(void)
+{
+    ESP_LOGI(TAG, "i2c_bus_init");
+
+    // Start with the slowest device, every job switches to the speed it needs.
+    g_clock_speed = g_devices[0].clock_speed;
+    for (int i = 1; i < I2C_BUS_DEVICE_COUNT; i++)
+        if (g_devices[i].clock_speed < g_clock_speed)
+            g_clock_speed = g_devices[i].clock_speed;
+
+    const i2c_config_t conf = get_config(g_clock_speed);
+
+    esp_err_t err = i2c_param_config(I2C_BUS_PORT, &conf);
+    if (err != ESP_OK)
+        return err;
+
+    err = i2c_driver_install(I2C_BUS_PORT, conf.mode, 0, 0, 0);
+    if (err != ESP_OK)
+        return err;
+
+    g_queue = xQueueCreate(I2C_BUS_QUEUE_LENGTH, sizeof(i2c_bus_job_t));
+    assert(g_queue);
+
+    // Below the weight sampling, which never waits for the bus.
+    xTaskCreate(i2c_bus_task, "i2c_bus_task", 4 * 1024, NULL, tskIDLE_PRIORITY + 1, &g_task);
+
+    return ESP_OK;
+}
+
+static esp_err_t select_device(const i2c_bus_device_config_t *device)
+{
+    if (device->clock_speed == g_clock_speed)
+        return ESP_OK;
+
+    const i2c_config_t conf = get_config(device->clock_speed);
+    const esp_err_t err = i2c_param_config(I2C_BUS_PORT, &conf);
+    if (err != ESP_OK)
+        return err;
+
+    g_clock_speed = device->clock_speed;
+    return ESP_OK;
+}
+
+// A read is write(reg), repeated start, read(length).
+static esp_err_t run_transfer(const i2c_bus_device_config_t *device, const i2c_bus_transfer_t *transfer,
+    uint8_t *link_buffer, size_t link_buffer_size)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(link_buffer, link_buffer_size);
+    assert(cmd);
+
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (device->address << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, transfer->reg, true);
+
+    if (transfer->read_data)
+    {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (device->address << 1) | I2C_MASTER_READ, true);
+        i2c_master_read(cmd, transfer->read_data, transfer->length, I2C_MASTER_LAST_NACK);
+    }
+    else if (transfer->length > 0)
+    {
+        i2c_master_write(cmd, transfer->write_data, transfer->length, true);
+    }
+
+    i2c_master_stop(cmd);
+
+    const esp_err_t ret = i2c_master_cmd_begin(I2C_BUS_PORT, cmd, device->timeout_ms / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete_static(cmd);
+
+    return ret;
+}
+
+static void i2c_bus_task(void*)
+{
+    ESP_LOGI(TAG, "i2c_bus_task");
+
+    // Reused for every transfer, the driver would allocate the command link otherwise.
+    static uint8_t link_buffer[I2C_LINK_RECOMMENDED_SIZE(2)];
+
+    i2c_bus_job_t job = {};
+
+    while (true)
+    {
+        xQueueReceive(g_queue, &job, portMAX_DELAY);
+
+        // The queue holds a copy of the job, the write data is taken from its buffer in the order it was copied.
+        size_t write_offset = 0;
+        for (size_t i = 0; i < job.count; i++)
+        {
+            if (!job.transfers[i].read_data)
+            {
+                job.transfers[i].write_data = job.write_buffer + write_offset;
+                write_offset += job.transfers[i].length;
+            }
+        }
+
+        const i2c_bus_device_config_t * const device = &g_devices[job.device];
+        const int64_t start_time = esp_timer_get_time();
+
+        esp_err_t result = select_device(device);
+        for (size_t i = 0; i < job.count && result == ESP_OK; i++)
+            result = run_transfer(device, &job.transfers[i], link_buffer, sizeof(link_buffer));
+
+        const uint32_t job_time_us = (uint32_t)(esp_timer_get_time() - start_time);
+
+        taskENTER_CRITICAL(&g_stats_spinlock);
+        {
+            i2c_bus_stats_t * const stats = &g_stats[job.device];
+            stats->jobs++;
+            if (result != ESP_OK)
+                stats->failures++;
+            stats->last_job_time_us = job_time_us;
+            if (job_time_us > stats->max_job_time_us)
+                stats->max_job_time_us = job_time_us;
+        }
+        taskEXIT_CRITICAL(&g_stats_spinlock);
+
+        if (result != ESP_OK)
+            ESP_LOGE(TAG, "%s: job failed reg=%x err=%x (%s)", device->name, job.transfers[0].reg, result, esp_err_to_name(result));
+
+        if (job.done)
+            job.done(job.context, result);
+    }
+}
+
+static esp_err_t queue_job(i2c_bus_device_t device, const i2c_bus_transfer_t *transfers, size_t count,
+    i2c_bus_done_t done, void *context, TickType_t ticks_to_wait)
+{
+    assert(device < I2C_BUS_DEVICE_COUNT);
+    assert(transfers);
+    assert(count > 0 && count <= I2C_BUS_MAX_TRANSFERS);
+    assert(g_queue);
+
+    i2c_bus_job_t job = {
+        .device = device,
+        .count = count,
+        .done = done,
+        .context = context,
+    };
+
+    size_t write_offset = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const i2c_bus_transfer_t * const transfer = &transfers[i];
+        assert(!transfer->read_data || transfer->length > 0);
+
+        job.transfers[i] = *transfer;
+
+        if (!transfer->read_data && transfer->length > 0)
+        {
+            assert(transfer->write_data);
+            if (write_offset + transfer->length > sizeof(job.write_buffer))
+                return ESP_ERR_INVALID_SIZE;
+
+            memcpy(job.write_buffer + write_offset, transfer->write_data, transfer->length);
+            write_offset += transfer->length;
+        }
+    }
+
+    if (xQueueSend(g_queue, &job, ticks_to_wait) != pdTRUE)
+    {
+        taskENTER_CRITICAL(&g_stats_spinlock);
+        g_stats[device].dropped++;
+        taskEXIT_CRITICAL(&g_stats_spinlock);
+
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_submit(i2c_bus_device_t device, const i2c_bus_transfer_t *transfers, size_t count,
+    i2c_bus_done_t done, void *context)
+{
+    return queue_job(device, transfers, count, done, context, 0);
+}
+
+static void wake_waiter(void *context, esp_err_t result)
+{
+    i2c_bus_waiter_t * const waiter = context;
+    waiter->result = result;
+    xTaskNotifyGive(waiter->task);
+}
+
+esp_err_t i2c_bus_transfer(i2c_bus_device_t device, const i2c_bus_transfer_t *transfers, size_t count)
+{
+    assert(xTaskGetCurrentTaskHandle() != g_task);
+
+    i2c_bus_waiter_t waiter = {
+        .task = xTaskGetCurrentTaskHandle(),
+        .result = ESP_FAIL,
+    };
+
+    const esp_err_t err = queue_job(device, transfers, count, wake_waiter, &waiter, portMAX_DELAY);
+    if (err != ESP_OK)
+        return err;
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return waiter.result;
+}
+
+esp_err_t i2c_bus_read(i2c_bus_device_t device, uint8_t reg, uint8_t *data, size_t length)
+{
+    const i2c_bus_transfer_t transfer = { .reg = reg, .read_data = data, .length = length };
+    return i2c_bus_transfer(device, &transfer, 1);
+}
+
+esp_err_t i2c_bus_write(i2c_bus_device_t device, uint8_t reg, const uint8_t *data, size_t length)
+{
+    const i2c_bus_transfer_t transfer = { .reg = reg, .write_data = data, .length = length };
+    return i2c_bus_transfer(device, &transfer, 1);
+}
+
+void i2c_bus_get_stats(i2c_bus_device_t device, i2c_bus_stats_t *stats)
+{
+    assert(device < I2C_BUS_DEVICE_COUNT);
+    assert(stats);
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    *stats = g_stats[device];
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+// All i2c traffic goes through the bus task: drivers queue jobs and either wait for them or get called back.
+// The bus is switched to the clock speed of a device before its job runs.
+
+typedef enum {
+    I2C_BUS_DEVICE_BME280 = 0,
+    I2C_BUS_DEVICE_CCS811,
+    I2C_BUS_DEVICE_COUNT,
+} i2c_bus_device_t;
+
+#define I2C_BUS_MAX_TRANSFERS       (4)
+#define I2C_BUS_WRITE_BUFFER_SIZE   (32)    // all writes of a job together, bme280_set_regs writes up to 20 bytes
+
+// Reads or writes length bytes starting at reg, the devices increment the register address themselves.
+typedef struct {
+    uint8_t reg;
+    uint8_t *read_data;         // NULL for a write
+    const uint8_t *write_data;  // copied when the job is queued
+    size_t length;
+} i2c_bus_transfer_t;
+
+typedef struct {
+    uint32_t jobs;
+    uint32_t failures;
+    uint32_t dropped;           // queue was full
+    uint32_t last_job_time_us;
+    uint32_t max_job_time_us;
+} i2c_bus_stats_t;
+
+// Called from the bus task, must not wait for the bus.
+typedef void (*i2c_bus_done_t)(void *context, esp_err_t result);
+
+esp_err_t i2c_bus_init(void);
+
+// Queues the transfers and returns right away. They run back to back, no other job gets in between.
+// read_data has to stay valid until done was called, done may be NULL.
+esp_err_t i2c_bus_submit(i2c_bus_device_t device, const i2c_bus_transfer_t *transfers, size_t count,
+    i2c_bus_done_t done, void *context);
+
+// Blocks the calling task until the transfers are done.
+esp_err_t i2c_bus_transfer(i2c_bus_device_t device, const i2c_bus_transfer_t *transfers, size_t count);
+
+esp_err_t i2c_bus_read(i2c_bus_device_t device, uint8_t reg, uint8_t *data, size_t length);
+esp_err_t i2c_bus_write(i2c_bus_device_t device, uint8_t reg, const uint8_t *data, size_t length);
+
+void i2c_bus_get_stats(i2c_bus_device_t device, i2c_bus_stats_t *stats);
@@ -0,0 +1,213 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "json_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+void json_writer_init(json_writer_t *writer, json_sink_t write, void *sink)
+{
+    assert(writer);
+    assert(write);
+
+    writer->write = write;
+    writer->sink = sink;
+    writer->result = ESP_OK;
+    writer->depth = 0;
+    writer->has_members = 0;
+    writer->length = 0;
+}
+
+static void flush(json_writer_t *writer)
+{
+    if (writer->length > 0 && writer->result == ESP_OK)
+        writer->result = writer->write(writer->sink, writer->buffer, writer->length);
+
+    writer->length = 0;
+}
+
+static void append(json_writer_t *writer, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        if (writer->length == JSON_WRITER_BUFFER_SIZE)
+            flush(writer);
+
+        size_t n = JSON_WRITER_BUFFER_SIZE - writer->length;
+        if (n > length)
+            n = length;
+
+        memcpy(writer->buffer + writer->length, data, n);
+        writer->length += n;
+        data += n;
+        length -= n;
+    }
+}
+
+static void append_char(json_writer_t *writer, char c)
+{
+    if (writer->length == JSON_WRITER_BUFFER_SIZE)
+        flush(writer);
+
+    writer->buffer[writer->length++] = c;
+}
+
+static void append_escaped(json_writer_t *writer, const char *value)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    append_char(writer, '"');
+
+    for (const char *p = value; *p; p++)
+    {
+        const unsigned char c = (unsigned char)*p;
+
+        if (c == '"' || c == '\\') {
+            append_char(writer, '\\');
+            append_char(writer, c);
+        } else if (c < 0x20) {
+            const char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            append(writer, escaped, sizeof(escaped));
+        } else {
+            append_char(writer, c);
+        }
+    }
+
+    append_char(writer, '"');
+}
+
+// Separator and member name in front of every value.
+static void begin_value(json_writer_t *writer, const char *key)
+{
+    const uint32_t level_bit = 1u << writer->depth;
+
+    if (writer->has_members & level_bit)
+        append_char(writer, ',');
+    writer->has_members |= level_bit;
+
+    if (key) {
+        append_escaped(writer, key);
+        append_char(writer, ':');
+    }
+}
+
+static void begin_container(json_writer_t *writer, const char *key, char bracket)
+{
+    assert(writer->depth + 1 < JSON_WRITER_MAX_DEPTH);
+
+    begin_value(writer, key);
+    append_char(writer, bracket);
+
+    writer->depth++;
+    writer->has_members &= ~(1u << writer->depth);
+}
+
+static void end_container(json_writer_t *writer, char bracket)
+{
+    assert(writer->depth > 0);
+
+    writer->depth--;
+    append_char(writer, bracket);
+}
+
+esp_err_t json_writer_finish(json_writer_t *writer)
+{
+    assert(writer);
+    assert(writer->depth == 0);
+
+    flush(writer);
+    return writer->result;
+}
+
+void json_writer_begin_object(json_writer_t *writer, const char *key)
+{
+    begin_container(writer, key, '{');
+}
+
+void json_writer_end_object(json_writer_t *writer)
+{
+    end_container(writer, '}');
+}
+
+void json_writer_begin_array(json_writer_t *writer, const char *key)
+{
+    begin_container(writer, key, '[');
+}
+
+void json_writer_end_array(json_writer_t *writer)
+{
+    end_container(writer, ']');
+}
+
+void json_writer_int(json_writer_t *writer, const char *key, int64_t value)
+{
+    char buffer[24];
+    const int length = snprintf(buffer, sizeof(buffer), "%lld", (long long)value);
+
+    begin_value(writer, key);
+    append(writer, buffer, length);
+}
+
+void json_writer_double(json_writer_t *writer, const char *key, double value, int decimals)
+{
+    begin_value(writer, key);
+
+    if (!isfinite(value)) {
+        append(writer, "null", 4);
+        return;
+    }
+
+    char buffer[48];
+    const int length = snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    if (length > 0 && length < sizeof(buffer))
+        append(writer, buffer, length);
+    else
+        append(writer, "null", 4);
+}
+
+void json_writer_bool(json_writer_t *writer, const char *key, bool value)
+{
+    begin_value(writer, key);
+
+    if (value)
+        append(writer, "true", 4);
+    else
+        append(writer, "false", 5);
+}
+
+void json_writer_string(json_writer_t *writer, const char *key, const char *value)
+{
+    assert(value);
+
+    begin_value(writer, key);
+    append_escaped(writer, value);
+}
+
+void json_writer_base64(json_writer_t *writer, const char *key, const uint8_t *data, size_t length)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    assert(data || length == 0);
+
+    begin_value(writer, key);
+    append_char(writer, '"');
+
+    for (size_t i = 0; i < length; i += 3)
+    {
+        const uint32_t n =
+            ((uint32_t)data[i] << 16) |
+            (i + 1 < length ? (uint32_t)data[i + 1] << 8 : 0) |
+            (i + 2 < length ? (uint32_t)data[i + 2] : 0);
+
+        const char encoded[4] = {
+            alphabet[(n >> 18) & 0x3f],
+            alphabet[(n >> 12) & 0x3f],
+            i + 1 < length ? alphabet[(n >> 6) & 0x3f] : '=',
+            i + 2 < length ? alphabet[n & 0x3f] : '=',
+        };
+        append(writer, encoded, sizeof(encoded));
+    }
+
+    append_char(writer, '"');
+}
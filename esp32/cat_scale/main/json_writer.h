@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#define JSON_WRITER_BUFFER_SIZE     (128)
+#define JSON_WRITER_MAX_DEPTH       (16)
+
+// Receives the output piece by piece, at most JSON_WRITER_BUFFER_SIZE bytes at once.
+// Same signature as http_body_writer_t, so a writer can feed a request body directly.
+typedef esp_err_t (*json_sink_t)(void *sink, const char *data, size_t length);
+
+// Streaming JSON writer with constant memory usage, the size of the document is not limited.
+// The first error of the sink is kept and all further output is discarded, so callers only check json_writer_finish.
+typedef struct {
+    json_sink_t write;
+    void *sink;
+    esp_err_t result;
+    uint32_t depth;
+    uint32_t has_members;   // one bit per nesting level
+    size_t length;
+    char buffer[JSON_WRITER_BUFFER_SIZE];
+} json_writer_t;
+
+void json_writer_init(json_writer_t *writer, json_sink_t write, void *sink);
+
+// Flushes the remaining output. Returns the first error of the sink.
+esp_err_t json_writer_finish(json_writer_t *writer);
+
+// key: member name inside of objects, NULL inside of arrays and for the root value.
+void json_writer_begin_object(json_writer_t *writer, const char *key);
+void json_writer_end_object(json_writer_t *writer);
+void json_writer_begin_array(json_writer_t *writer, const char *key);
+void json_writer_end_array(json_writer_t *writer);
+
+void json_writer_int(json_writer_t *writer, const char *key, int64_t value);
+// Non-finite values are written as null.
+void json_writer_double(json_writer_t *writer, const char *key, double value, int decimals);
+void json_writer_bool(json_writer_t *writer, const char *key, bool value);
+void json_writer_string(json_writer_t *writer, const char *key, const char *value);
+void json_writer_base64(json_writer_t *writer, const char *key, const uint8_t *data, size_t length);
@@ -0,0 +1,69 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "live_record.h"
+
+#include <string.h>
+#include <assert.h>
+
+static void put_u32(uint8_t *data, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        data[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *data)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (uint32_t)data[i] << (8 * i);
+    return value;
+}
+
+static void put_float(uint8_t *data, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_u32(data, bits);
+}
+
+static float get_float(const uint8_t *data)
+{
+    const uint32_t bits = get_u32(data);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void live_record_encode(const live_record_t *record, uint8_t *data)
+{
+    assert(record);
+    assert(data);
+
+    data[0] = record->channel;
+    data[1] = record->flags;
+    data[2] = (uint8_t)record->dropped;
+    data[3] = (uint8_t)(record->dropped >> 8);
+    put_u32(data + 4, record->sequence);
+    put_u32(data + 8, (uint32_t)record->timestamp);
+    put_u32(data + 12, (uint32_t)((uint64_t)record->timestamp >> 32));
+    put_u32(data + 16, record->weight_raw);
+    put_float(data + 20, record->weight);
+    put_float(data + 24, record->stable_time);
+    put_float(data + 28, record->hold_timer);
+}
+
+void live_record_decode(const uint8_t *data, live_record_t *record)
+{
+    assert(data);
+    assert(record);
+
+    record->channel = data[0];
+    record->flags = data[1];
+    record->dropped = (uint16_t)(data[2] | data[3] << 8);
+    record->sequence = get_u32(data + 4);
+    record->timestamp = (int64_t)((uint64_t)get_u32(data + 8) | (uint64_t)get_u32(data + 12) << 32);
+    record->weight_raw = get_u32(data + 16);
+    record->weight = get_float(data + 20);
+    record->stable_time = get_float(data + 24);
+    record->hold_timer = get_float(data + 28);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Wire format of the live weight stream (live_stream.c, CONFIG_CATSCALE_LIVE_STREAM_PORT).
+// The device sends one fixed size record per hx711 sample of every channel, nothing is sent to it.
+//
+// Record (little endian, LIVE_RECORD_SIZE bytes):
+//   channel (uint8), flags (uint8), dropped (uint16), sequence (uint32), timestamp in µs since boot (int64),
+//   raw hx711 count (uint32), filtered weight in g, stable time in s, hold timer in s (float, IEEE 754).
+
+#define LIVE_RECORD_SIZE                (32)
+
+#define LIVE_RECORD_FLAG_VALID          (0x01)  // the hx711 returned data, otherwise only the timestamp is set
+#define LIVE_RECORD_FLAG_INPUT_SWITCH   (0x02)  // the cascade holds the offset, something is on the scale
+
+typedef struct {
+    uint8_t channel;
+    uint8_t flags;
+    uint16_t dropped;           // records this client missed right before this one, saturated
+    uint32_t sequence;          // per channel
+    int64_t timestamp;
+    uint32_t weight_raw;
+    float weight;
+    float stable_time;
+    float hold_timer;           // left until the input switch is released
+} live_record_t;
+
+void live_record_encode(const live_record_t *record, uint8_t *data);
+void live_record_decode(const uint8_t *data, live_record_t *record);
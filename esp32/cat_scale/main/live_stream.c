@@ -0,0 +1,293 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "live_stream.h"
+#include "radio.h"
+
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+#include <esp_system.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <lwip/err.h>
+#include <lwip/sockets.h>
+#include <lwip/sys.h>
+
+static const char *TAG = "live_stream";
+
+#define LIVE_STREAM_MAX_CLIENTS     (2)
+#define LIVE_STREAM_QUEUE_LENGTH    (32)        // a few sample periods of all channels
+#define LIVE_STREAM_POLL_MS         (100)       // accept and check the clients at least this often
+#define LIVE_STREAM_STALL_US        (10000000)  // a client which doesn't read for this long is closed
+
+typedef struct {
+    int sock;                               // -1 if the slot is free
+    uint8_t pending[LIVE_RECORD_SIZE];      // rest of a record the tcp stack only took partly
+    size_t pending_offset;
+    size_t pending_length;
+    uint32_t dropped;                       // since the last record it got
+    int64_t last_progress_time;
+} client_t;
+
+static QueueHandle_t g_queue = NULL;
+static volatile uint32_t g_client_count = 0; // written by the stream task only
+
+static portMUX_TYPE g_stats_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static live_stream_stats_t g_stats = {};
+
+static void live_stream_task(void*);
+
+esp_err_t live_stream_init(void)
+{
+    ESP_LOGI(TAG, "live_stream_init");
+
+    g_queue = xQueueCreate(LIVE_STREAM_QUEUE_LENGTH, sizeof(live_record_t));
+    assert(g_queue);
+
+    // Below the sampling, which only ever queues records.
+    xTaskCreate(live_stream_task, "live_stream_task", 4 * 1024, NULL, tskIDLE_PRIORITY + 1, NULL);
+
+    return ESP_OK;
+}
+
+bool live_stream_is_active(void)
+{
+    return g_client_count > 0;
+}
+
+void live_stream_push(const live_record_t *record)
+{
+    assert(record);
+
+    if (!g_queue || g_client_count == 0)
+        return;
+
+    const bool queued = xQueueSend(g_queue, record, 0) == pdTRUE;
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    g_stats.records++;
+    if (!queued)
+        g_stats.queue_dropped++;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+}
+
+void live_stream_get_stats(live_stream_stats_t *stats)
+{
+    assert(stats);
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    *stats = g_stats;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+}
+
+static void set_blocking(int sock, bool blocking)
+{
+    const int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+}
+
+static void close_client(client_t *client, const char *reason)
+{
+    ESP_LOGI(TAG, "closing client %d: %s", client->sock, reason);
+
+    shutdown(client->sock, SHUT_RDWR);
+    close(client->sock);
+    client->sock = -1;
+    if (--g_client_count == 0)
+        radio_release();
+}
+
+static void accept_client(int listen_sock, client_t *clients)
+{
+    const int sock = accept(listen_sock, NULL, NULL);
+    if (sock < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            ESP_LOGE(TAG, "unable to accept connection: errno %d", errno);
+        return;
+    }
+
+    client_t *client = NULL;
+    for (size_t i = 0; i < LIVE_STREAM_MAX_CLIENTS && !client; i++)
+        if (clients[i].sock < 0)
+            client = &clients[i];
+
+    if (!client)
+    {
+        ESP_LOGW(TAG, "more than %d clients, connection refused", LIVE_STREAM_MAX_CLIENTS);
+        close(sock);
+        return;
+    }
+
+    // Records are small and should go out right away.
+    int opt = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    set_blocking(sock, false);
+
+    *client = (client_t){
+        .sock = sock,
+        .last_progress_time = esp_timer_get_time(),
+    };
+    // Modem sleep would hold back the records until the next beacon.
+    if (g_client_count++ == 0)
+        radio_acquire();
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    g_stats.clients++;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+
+    ESP_LOGI(TAG, "client %d connected", sock);
+}
+
+// Returns false if the client has to be closed.
+static bool flush_pending(client_t *client)
+{
+    while (client->pending_offset < client->pending_length)
+    {
+        const int sent = send(client->sock, client->pending + client->pending_offset,
+            client->pending_length - client->pending_offset, MSG_DONTWAIT);
+        if (sent < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+
+        client->pending_offset += (size_t)sent;
+        client->last_progress_time = esp_timer_get_time();
+    }
+
+    client->pending_offset = 0;
+    client->pending_length = 0;
+    return true;
+}
+
+static void send_record(client_t *client, const live_record_t *record)
+{
+    if (!flush_pending(client))
+    {
+        close_client(client, "send failed");
+        return;
+    }
+
+    // Still busy with the previous record, this one is lost for the client.
+    if (client->pending_length > 0)
+    {
+        client->dropped++;
+        taskENTER_CRITICAL(&g_stats_spinlock);
+        g_stats.client_dropped++;
+        taskEXIT_CRITICAL(&g_stats_spinlock);
+        return;
+    }
+
+    live_record_t copy = *record;
+    copy.dropped = client->dropped > UINT16_MAX ? UINT16_MAX : (uint16_t)client->dropped;
+    live_record_encode(&copy, client->pending);
+    client->pending_length = LIVE_RECORD_SIZE;
+    client->dropped = 0;
+
+    if (!flush_pending(client))
+        close_client(client, "send failed");
+}
+
+// The clients never send anything, a read only tells whether they are still there.
+static void check_client(client_t *client, int64_t now)
+{
+    uint8_t buffer[16];
+    const int received = recv(client->sock, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+    if (received == 0)
+        close_client(client, "closed by peer");
+    else if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        close_client(client, "receive failed");
+    else if (!flush_pending(client))
+        close_client(client, "send failed");
+    else if (client->pending_length > 0 && now - client->last_progress_time > LIVE_STREAM_STALL_US)
+    {
+        close_client(client, "stalled");
+
+        taskENTER_CRITICAL(&g_stats_spinlock);
+        g_stats.stalled++;
+        taskEXIT_CRITICAL(&g_stats_spinlock);
+    }
+}
+
+static void live_stream_task(void*)
+{
+    ESP_LOGI(TAG, "live_stream_task");
+
+    struct sockaddr_in dest_addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_CATSCALE_LIVE_STREAM_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+
+    const int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (listen_sock < 0) {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    int opt = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    if (bind(listen_sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr)) != 0 ||
+        listen(listen_sock, 1) != 0)
+    {
+        ESP_LOGE(TAG, "Socket unable to listen: errno %d", errno);
+        close(listen_sock);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    client_t clients[LIVE_STREAM_MAX_CLIENTS];
+    for (size_t i = 0; i < LIVE_STREAM_MAX_CLIENTS; i++)
+        clients[i].sock = -1;
+
+    int64_t last_poll_time = 0;
+
+    while (true)
+    {
+        // Without clients the task just waits for one, the sampling doesn't queue anything meanwhile.
+        if (g_client_count == 0)
+        {
+            xQueueReset(g_queue);
+            set_blocking(listen_sock, true);
+            accept_client(listen_sock, clients);
+            set_blocking(listen_sock, false);
+            if (g_client_count == 0)
+                vTaskDelay(LIVE_STREAM_POLL_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        live_record_t record;
+        if (xQueueReceive(g_queue, &record, LIVE_STREAM_POLL_MS / portTICK_PERIOD_MS) == pdTRUE)
+        {
+            for (size_t i = 0; i < LIVE_STREAM_MAX_CLIENTS; i++)
+                if (clients[i].sock >= 0)
+                    send_record(&clients[i], &record);
+
+            const uint32_t latency_us = (uint32_t)(esp_timer_get_time() - record.timestamp);
+            taskENTER_CRITICAL(&g_stats_spinlock);
+            if (latency_us > g_stats.max_latency_us)
+                g_stats.max_latency_us = latency_us;
+            taskEXIT_CRITICAL(&g_stats_spinlock);
+        }
+
+        const int64_t now = esp_timer_get_time();
+        if (now - last_poll_time >= LIVE_STREAM_POLL_MS * 1000)
+        {
+            last_poll_time = now;
+
+            accept_client(listen_sock, clients);
+            for (size_t i = 0; i < LIVE_STREAM_MAX_CLIENTS; i++)
+                if (clients[i].sock >= 0)
+                    check_client(&clients[i], now);
+        }
+    }
+}
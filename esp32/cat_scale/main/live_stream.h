@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#include "live_record.h"
+
+// Live weight stream for watching the filters while calibrating: tcp server on CONFIG_CATSCALE_LIVE_STREAM_PORT,
+// every connected client gets a live_record_t per hx711 sample (see live_record.h, host/tools/live_client.c).
+//
+// Nothing is collected while no client is connected. The sampling never waits for the stream:
+// records are queued without blocking and a client that can't keep up misses records instead.
+
+typedef struct {
+    uint32_t clients;           // accepted connections
+    uint32_t records;           // queued by the sampling
+    uint32_t queue_dropped;     // queue full, lost for every client
+    uint32_t client_dropped;    // send buffer of a client full, lost for that client
+    uint32_t stalled;           // clients closed because they didn't read for too long
+    uint32_t max_latency_us;    // from the sample until its record was handed to the tcp stack
+} live_stream_stats_t;
+
+esp_err_t live_stream_init(void);
+
+// Cheap enough to be called for every sample.
+bool live_stream_is_active(void);
+
+// Doesn't block, from the sampling task.
+void live_stream_push(const live_record_t *record);
+
+void live_stream_get_stats(live_stream_stats_t *stats);
@@ -0,0 +1,106 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "log_datagram.h"
+
+#include <string.h>
+#include <assert.h>
+
+static void put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = value >> 24;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void log_datagram_builder_reset(log_datagram_builder_t *builder)
+{
+    assert(builder);
+
+    builder->length = LOG_DATAGRAM_HEADER_SIZE;
+    builder->line_count = 0;
+}
+
+bool log_datagram_builder_append(log_datagram_builder_t *builder, const char *line, size_t length)
+{
+    assert(builder);
+    assert(line);
+
+    if (length > 0 && line[length - 1] == '\n')
+        length--;
+
+    const size_t max_length = LOG_DATAGRAM_MAX_SIZE - LOG_DATAGRAM_HEADER_SIZE - 1;
+    if (length > max_length)
+    {
+        if (builder->line_count > 0)
+            return false;
+        length = max_length;
+    }
+
+    if (builder->length + length + 1 > LOG_DATAGRAM_MAX_SIZE || builder->line_count == UINT16_MAX)
+        return false;
+
+    memcpy(builder->data + builder->length, line, length);
+    builder->data[builder->length + length] = '\n';
+    builder->length += length + 1;
+    builder->line_count++;
+
+    return true;
+}
+
+size_t log_datagram_builder_finish(log_datagram_builder_t *builder, uint32_t boot_id, uint32_t sequence, uint32_t dropped)
+{
+    assert(builder);
+    assert(builder->length >= LOG_DATAGRAM_HEADER_SIZE);
+
+    uint8_t * const p = builder->data;
+    memcpy(p, LOG_DATAGRAM_MAGIC, 4);
+    p[4] = LOG_DATAGRAM_VERSION;
+    p[5] = 0;
+    put_u16(p + 6, builder->line_count);
+    put_u32(p + 8, boot_id);
+    put_u32(p + 12, sequence);
+    put_u32(p + 16, dropped);
+
+    return builder->length;
+}
+
+bool log_datagram_parse(const uint8_t *data, size_t length, log_datagram_header_t *header,
+    const char **payload, size_t *payload_length)
+{
+    assert(data);
+    assert(header);
+    assert(payload);
+    assert(payload_length);
+
+    if (length < LOG_DATAGRAM_HEADER_SIZE || length > LOG_DATAGRAM_MAX_SIZE)
+        return false;
+    if (memcmp(data, LOG_DATAGRAM_MAGIC, 4) != 0 || data[4] != LOG_DATAGRAM_VERSION)
+        return false;
+
+    header->line_count = get_u16(data + 6);
+    header->boot_id = get_u32(data + 8);
+    header->sequence = get_u32(data + 12);
+    header->dropped = get_u32(data + 16);
+
+    *payload = (const char *)data + LOG_DATAGRAM_HEADER_SIZE;
+    *payload_length = length - LOG_DATAGRAM_HEADER_SIZE;
+
+    return true;
+}
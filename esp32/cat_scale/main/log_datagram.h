@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Wire format of the udp log: log lines are batched into datagrams, each one with a header that allows
+// the receiver to put them back in order and to report what got lost on the way.
+//
+// Header (little endian):
+//   magic "CSLG", version, flags (0), line count (uint16), boot id (uint32), sequence (uint32),
+//   lines dropped by the device since boot (uint32)
+// followed by the lines, each one terminated by '\n'.
+
+#define LOG_DATAGRAM_MAGIC          "CSLG"
+#define LOG_DATAGRAM_VERSION        (1)
+#define LOG_DATAGRAM_HEADER_SIZE    (20)
+#define LOG_DATAGRAM_MAX_SIZE       (1400)  // stays below the ethernet mtu, no ip fragmentation
+
+typedef struct {
+    uint16_t line_count;
+    uint32_t boot_id;       // random, changes with every boot
+    uint32_t sequence;      // starts at 0 with every boot
+    uint32_t dropped;       // lines the device could not buffer, total since boot
+} log_datagram_header_t;
+
+typedef struct {
+    uint8_t data[LOG_DATAGRAM_MAX_SIZE];
+    size_t length;
+    uint16_t line_count;
+} log_datagram_builder_t;
+
+void log_datagram_builder_reset(log_datagram_builder_t *builder);
+
+// Returns false if the line does not fit anymore, the datagram has to be sent first.
+// Lines longer than an empty datagram are truncated. A missing '\n' is added.
+bool log_datagram_builder_append(log_datagram_builder_t *builder, const char *line, size_t length);
+
+// Writes the header, returns the size of the datagram in builder->data.
+size_t log_datagram_builder_finish(log_datagram_builder_t *builder, uint32_t boot_id, uint32_t sequence, uint32_t dropped);
+
+// Returns false if data is not a valid datagram. The lines are returned as one block (payload, payload_length).
+bool log_datagram_parse(const uint8_t *data, size_t length, log_datagram_header_t *header,
+    const char **payload, size_t *payload_length);
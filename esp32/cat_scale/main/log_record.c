@@ -0,0 +1,351 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "log_record.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+// Record layout: format pointer, followed by the arguments, each one a type byte and the value.
+enum {
+    ARG_INT32 = 'i',
+    ARG_INT64 = 'I',
+    ARG_DOUBLE = 'd',
+    ARG_POINTER = 'p',
+    ARG_STRING = 's',   // length byte, then the characters (not terminated)
+};
+
+typedef enum {
+    LENGTH_DEFAULT,
+    LENGTH_LONG,
+    LENGTH_LONG_LONG,
+    LENGTH_SIZE,        // z, j, t
+    LENGTH_LONG_DOUBLE,
+} length_modifier_t;
+
+typedef struct {
+    const char *start;
+    const char *end;    // after the conversion character
+    char conversion;
+    length_modifier_t length;
+    int star_count;     // width and/or precision given as argument
+} conversion_spec_t;
+
+// Parses the conversion specification at format (pointing to the '%').
+static void parse_spec(const char *format, conversion_spec_t *spec)
+{
+    const char *p = format + 1;
+
+    spec->start = format;
+    spec->star_count = 0;
+    spec->length = LENGTH_DEFAULT;
+
+    while (*p && strchr("-+ #0", *p)) p++;
+
+    if (*p == '*') { spec->star_count++; p++; }
+    while (*p >= '0' && *p <= '9') p++;
+
+    if (*p == '.') {
+        p++;
+        if (*p == '*') { spec->star_count++; p++; }
+        while (*p >= '0' && *p <= '9') p++;
+    }
+
+    if (*p == 'h') {
+        p++;
+        if (*p == 'h') p++;
+    } else if (*p == 'l') {
+        p++;
+        spec->length = LENGTH_LONG;
+        if (*p == 'l') { p++; spec->length = LENGTH_LONG_LONG; }
+    } else if (*p == 'z' || *p == 'j' || *p == 't') {
+        p++;
+        spec->length = LENGTH_SIZE;
+    } else if (*p == 'L') {
+        p++;
+        spec->length = LENGTH_LONG_DOUBLE;
+    }
+
+    spec->conversion = *p;
+    spec->end = *p ? p + 1 : p;
+}
+
+static size_t get_integer_size(length_modifier_t length)
+{
+    switch (length)
+    {
+        case LENGTH_LONG: return sizeof(long);
+        case LENGTH_LONG_LONG: return sizeof(long long);
+        case LENGTH_SIZE: return sizeof(size_t);
+        default: return sizeof(int);
+    }
+}
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t position;
+    bool overflow;
+} record_writer_t;
+
+static void put(record_writer_t *writer, const void *data, size_t length)
+{
+    if (writer->position + length > writer->size) {
+        writer->overflow = true;
+        return;
+    }
+
+    memcpy(writer->data + writer->position, data, length);
+    writer->position += length;
+}
+
+static void put_int32(record_writer_t *writer, int32_t value)
+{
+    const uint8_t type = ARG_INT32;
+    put(writer, &type, 1);
+    put(writer, &value, sizeof(value));
+}
+
+size_t log_record_encode(uint8_t *output, size_t output_size, const char *format, va_list args)
+{
+    assert(output);
+    assert(format);
+
+    record_writer_t writer = {
+        .data = output,
+        .size = output_size,
+    };
+
+    put(&writer, &format, sizeof(format));
+
+    for (const char *p = strchr(format, '%'); p && !writer.overflow; p = strchr(p, '%'))
+    {
+        conversion_spec_t spec;
+        parse_spec(p, &spec);
+        p = spec.end;
+
+        for (int i = 0; i < spec.star_count; i++)
+            put_int32(&writer, va_arg(args, int));
+
+        switch (spec.conversion)
+        {
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+                if (get_integer_size(spec.length) > sizeof(int32_t)) {
+                    const int64_t value = va_arg(args, long long);
+                    const uint8_t type = ARG_INT64;
+                    put(&writer, &type, 1);
+                    put(&writer, &value, sizeof(value));
+                } else {
+                    // int, long and size_t are passed the same way on the esp32
+                    put_int32(&writer, (int32_t)va_arg(args, int));
+                }
+                break;
+
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            {
+                const double value = spec.length == LENGTH_LONG_DOUBLE ? (double)va_arg(args, long double) : va_arg(args, double);
+                const uint8_t type = ARG_DOUBLE;
+                put(&writer, &type, 1);
+                put(&writer, &value, sizeof(value));
+                break;
+            }
+
+            case 'p':
+            {
+                const void *value = va_arg(args, void *);
+                const uint8_t type = ARG_POINTER;
+                put(&writer, &type, 1);
+                put(&writer, &value, sizeof(value));
+                break;
+            }
+
+            case 's':
+            {
+                const char *value = va_arg(args, const char *);
+                if (!value)
+                    value = "(null)";
+
+                const size_t length = strnlen(value, LOG_RECORD_MAX_STRING);
+                const uint8_t header[2] = { ARG_STRING, (uint8_t)length };
+                put(&writer, header, sizeof(header));
+                put(&writer, value, length);
+                break;
+            }
+
+            case 'n':
+                (void)va_arg(args, void *); // not supported, skipped
+                break;
+
+            default: // "%%" or broken specification
+                break;
+        }
+    }
+
+    return writer.overflow ? 0 : writer.position;
+}
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t position;
+} record_reader_t;
+
+static bool get_arg(record_reader_t *reader, uint8_t expected_type, void *value, size_t value_size)
+{
+    if (reader->position + 1 + value_size > reader->size || reader->data[reader->position] != expected_type)
+        return false;
+
+    memcpy(value, reader->data + reader->position + 1, value_size);
+    reader->position += 1 + value_size;
+    return true;
+}
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t length;
+} text_writer_t;
+
+static void put_text(text_writer_t *writer, const char *text, size_t length)
+{
+    const size_t available = writer->size - 1 - writer->length;
+    if (length > available)
+        length = available;
+
+    memcpy(writer->data + writer->length, text, length);
+    writer->length += length;
+    writer->data[writer->length] = '\0';
+}
+
+static void put_formatted(text_writer_t *writer, const char *spec, ...)
+{
+    char buffer[LOG_RECORD_MAX_STRING + 64];
+
+    va_list args;
+    va_start(args, spec);
+    const int length = vsnprintf(buffer, sizeof(buffer), spec, args);
+    va_end(args);
+
+    if (length > 0)
+        put_text(writer, buffer, (size_t)length < sizeof(buffer) ? (size_t)length : sizeof(buffer) - 1);
+}
+
+size_t log_record_format(const uint8_t *record, size_t record_size, char *output, size_t output_size)
+{
+    assert(record);
+    assert(output);
+    assert(output_size > 0);
+
+    text_writer_t writer = {
+        .data = output,
+        .size = output_size,
+        .length = 0,
+    };
+    output[0] = '\0';
+
+    const char *format = NULL;
+    if (record_size < sizeof(format))
+        return 0;
+    memcpy(&format, record, sizeof(format));
+
+    record_reader_t reader = {
+        .data = record,
+        .size = record_size,
+        .position = sizeof(format),
+    };
+
+    const char *p = format;
+    while (*p)
+    {
+        const char *percent = strchr(p, '%');
+        if (!percent) {
+            put_text(&writer, p, strlen(p));
+            break;
+        }
+
+        put_text(&writer, p, percent - p);
+
+        conversion_spec_t spec;
+        parse_spec(percent, &spec);
+        p = spec.end;
+
+        if (spec.conversion == '%') {
+            put_text(&writer, "%", 1);
+            continue;
+        }
+
+        // The specification without length modifier, width and precision from the record instead of '*'.
+        char spec_buffer[32];
+        size_t spec_length = 0;
+        for (const char *s = spec.start; s < spec.end && spec_length < sizeof(spec_buffer) - 4; s++)
+        {
+            if (*s == '*') {
+                int32_t value = 0;
+                get_arg(&reader, ARG_INT32, &value, sizeof(value));
+                spec_length += snprintf(spec_buffer + spec_length, sizeof(spec_buffer) - spec_length, "%d", (int)value);
+            } else if (!strchr("hlzjtL", *s)) {
+                spec_buffer[spec_length++] = *s;
+            }
+        }
+        spec_buffer[spec_length] = '\0';
+
+        int32_t int32_value = 0;
+        int64_t int64_value = 0;
+        double double_value = 0.0;
+        void *pointer_value = NULL;
+
+        switch (spec.conversion)
+        {
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+                if (get_arg(&reader, ARG_INT32, &int32_value, sizeof(int32_value))) {
+                    put_formatted(&writer, spec_buffer, (int)int32_value);
+                } else if (get_arg(&reader, ARG_INT64, &int64_value, sizeof(int64_value))) {
+                    // re-add the length modifier for 64 bit values
+                    char spec64[sizeof(spec_buffer) + 2];
+                    snprintf(spec64, sizeof(spec64), "%.*sll%c", (int)(spec_length - 1), spec_buffer, spec.conversion);
+                    put_formatted(&writer, spec64, (long long)int64_value);
+                } else {
+                    put_text(&writer, "<?>", 3);
+                }
+                break;
+
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                if (get_arg(&reader, ARG_DOUBLE, &double_value, sizeof(double_value)))
+                    put_formatted(&writer, spec_buffer, double_value);
+                else
+                    put_text(&writer, "<?>", 3);
+                break;
+
+            case 'p':
+                if (get_arg(&reader, ARG_POINTER, &pointer_value, sizeof(pointer_value)))
+                    put_formatted(&writer, spec_buffer, pointer_value);
+                else
+                    put_text(&writer, "<?>", 3);
+                break;
+
+            case 's':
+                if (reader.position + 2 <= reader.size && reader.data[reader.position] == ARG_STRING &&
+                    reader.position + 2 + reader.data[reader.position + 1] <= reader.size)
+                {
+                    char string_value[LOG_RECORD_MAX_STRING + 1];
+                    const size_t length = reader.data[reader.position + 1];
+                    memcpy(string_value, reader.data + reader.position + 2, length);
+                    string_value[length] = '\0';
+                    reader.position += 2 + length;
+
+                    put_formatted(&writer, spec_buffer, string_value);
+                }
+                else
+                {
+                    put_text(&writer, "<?>", 3);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return writer.length;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+// Binary log records for deferred logging: instead of formatting a message right away only the pointer to the
+// format string and the raw arguments are recorded, the text is produced later by log_record_format.
+// The format string must stay valid (string literals do), %s arguments are copied.
+
+#define LOG_RECORD_MAX_SIZE     (256)
+#define LOG_RECORD_MAX_STRING   (64)    // longer %s arguments are truncated
+
+// Returns the size of the record or 0 if it does not fit into output.
+size_t log_record_encode(uint8_t *output, size_t output_size, const char *format, va_list args);
+
+// Returns the length of the text (like snprintf, but never more than output_size - 1).
+size_t log_record_format(const uint8_t *record, size_t record_size, char *output, size_t output_size);
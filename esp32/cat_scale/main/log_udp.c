@@ -1,11 +1,14 @@
 #undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
 
 #include "log_udp.h"
+#include "log_record.h"
+#include "log_datagram.h"
 
 #include "sdkconfig.h"
 
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -13,9 +16,11 @@
 #include <freertos/message_buffer.h>
 
 #include <esp_system.h>
+#include <esp_random.h>
 #include <esp_event.h>
 #include <esp_log.h>
 #include <esp_netif.h>
+#include <esp_timer.h>
 
 #include <lwip/err.h>
 #include <lwip/sockets.h>
@@ -25,8 +30,31 @@
 
 static const char *TAG = "log_udp";
 
+#ifdef CONFIG_CATSCALE_LOG_DEFERRED
+#define LOG_DEFERRED (true)
+#else
+#define LOG_DEFERRED (false)
+#endif
+
+#define LOG_UDP_FLUSH_MS (CONFIG_CATSCALE_LOG_UDP_FLUSH_MS)
+
 static vprintf_like_t original_log_function = NULL;
-static MessageBufferHandle_t log_message_buffer = NULL;
+static MessageBufferHandle_t log_message_buffer = NULL; // formatted lines waiting to be sent
+
+// Deferred logging: the log hook only appends binary records (see log_record.h) to this ring,
+// formatting for the console and the udp target happens in the publish task.
+// Every record is prefixed with its length (uint16_t), head and tail are free running.
+static uint8_t *log_ring = NULL;
+static uint32_t log_ring_head = 0;
+static uint32_t log_ring_tail = 0;
+static portMUX_TYPE log_ring_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+static log_udp_stats_t log_stats = {};
+
+// Lines are batched into sequenced datagrams, see log_datagram.h. Only used by the publish task.
+static log_datagram_builder_t log_datagram = {};
+static uint32_t log_boot_id = 0;
+static uint32_t log_sequence = 0;
 
 extern bool g_network_ready;
 
@@ -43,7 +71,19 @@ esp_err_t log_udp_init()
         ESP_LOGE(TAG, "failed to create log message buffer");
         return ESP_FAIL;
     }
-    
+
+    if (LOG_DEFERRED)
+    {
+        log_ring = malloc(CONFIG_CATSCALE_LOG_RING_SIZE);
+        if (!log_ring)
+        {
+            ESP_LOGE(TAG, "failed to create log ring");
+            return ESP_FAIL;
+        }
+    }
+
+    log_boot_id = esp_random();
+
     original_log_function = esp_log_set_vprintf(custom_log_function);
 
     ESP_LOGI(TAG, "First message to log buffer");
@@ -72,23 +112,170 @@ static bool string_has_content(const char *str, size_t length)
     return false;
 }
 
+static void ring_copy_in(uint32_t position, const void *data, size_t length)
+{
+    const size_t offset = position % CONFIG_CATSCALE_LOG_RING_SIZE;
+    const size_t first = length < CONFIG_CATSCALE_LOG_RING_SIZE - offset ? length : CONFIG_CATSCALE_LOG_RING_SIZE - offset;
+
+    memcpy(log_ring + offset, data, first);
+    memcpy(log_ring, (const uint8_t *)data + first, length - first);
+}
+
+static void ring_copy_out(uint32_t position, void *data, size_t length)
+{
+    const size_t offset = position % CONFIG_CATSCALE_LOG_RING_SIZE;
+    const size_t first = length < CONFIG_CATSCALE_LOG_RING_SIZE - offset ? length : CONFIG_CATSCALE_LOG_RING_SIZE - offset;
+
+    memcpy(data, log_ring + offset, first);
+    memcpy((uint8_t *)data + first, log_ring, length - first);
+}
+
+// Called from the log hook, must not log itself.
+static void ring_push_record(const char *format, va_list args)
+{
+    uint8_t record[LOG_RECORD_MAX_SIZE];
+    const uint16_t length = (uint16_t)log_record_encode(record, sizeof(record), format, args);
+
+    taskENTER_CRITICAL(&log_ring_spinlock);
+    if (length == 0 || CONFIG_CATSCALE_LOG_RING_SIZE - (log_ring_head - log_ring_tail) < sizeof(length) + length)
+    {
+        log_stats.dropped++;
+    }
+    else
+    {
+        ring_copy_in(log_ring_head, &length, sizeof(length));
+        ring_copy_in(log_ring_head + sizeof(length), record, length);
+        log_ring_head += sizeof(length) + length;
+    }
+    taskEXIT_CRITICAL(&log_ring_spinlock);
+}
+
+// Returns the size of the record, 0 if the ring is empty.
+static size_t ring_pop_record(uint8_t *record, size_t record_size)
+{
+    size_t length = 0;
+
+    taskENTER_CRITICAL(&log_ring_spinlock);
+    if (log_ring_head != log_ring_tail)
+    {
+        uint16_t stored_length = 0;
+        ring_copy_out(log_ring_tail, &stored_length, sizeof(stored_length));
+        assert(stored_length <= record_size);
+
+        ring_copy_out(log_ring_tail + sizeof(stored_length), record, stored_length);
+        log_ring_tail += sizeof(stored_length) + stored_length;
+        length = stored_length;
+    }
+    taskEXIT_CRITICAL(&log_ring_spinlock);
+
+    return length;
+}
+
 static int custom_log_function(const char *format, va_list args)
 {
-    if (log_message_buffer)
+    const int64_t t0 = esp_timer_get_time();
+    int ret = 0;
+
+    if (LOG_DEFERRED && log_ring)
+    {
+        ring_push_record(format, args);
+    }
+    else
+    {
+        if (log_message_buffer)
+        {
+            char buffer[256] = {};
+            va_list args_copy;
+            va_copy(args_copy, args);
+            vsnprintf(buffer, sizeof(buffer), format, args_copy);
+            va_end(args_copy);
+            const size_t length = strlen(buffer);
+
+            if (string_has_content(buffer, length))
+            {
+                BaseType_t pxHigherPriorityTaskWoken = pdFALSE;
+                size_t bytes_written = xMessageBufferSendFromISR(log_message_buffer, buffer, length, &pxHigherPriorityTaskWoken);
+                if (!bytes_written) log_stats.dropped++;
+            }
+        }
+
+        ret = original_log_function(format, args);
+    }
+
+    // Note: No locking, the numbers are only used for monitoring.
+    const uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+    log_stats.messages++;
+    log_stats.hook_time_total_us += dt;
+    if (dt > log_stats.hook_time_max_us)
+        log_stats.hook_time_max_us = dt;
+
+    return ret;
+}
+
+static int write_console(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int ret = original_log_function(format, args);
+    va_end(args);
+    return ret;
+}
+
+// Deferred logging: formats the recorded messages, writes them to the console and queues them for the udp target.
+static void format_deferred_messages(void)
+{
+    uint8_t record[LOG_RECORD_MAX_SIZE];
+    char line[LOG_RECORD_MAX_SIZE];
+
+    size_t record_size = 0;
+    while ((record_size = ring_pop_record(record, sizeof(record))) > 0)
     {
-        char buffer[256] = {};
-        vsnprintf(buffer, sizeof(buffer), format, args);
-        const size_t length = strlen(buffer);
+        const size_t length = log_record_format(record, record_size, line, sizeof(line));
+        write_console("%s", line);
 
-        if (string_has_content(buffer, length))
+        if (string_has_content(line, length))
         {
-            BaseType_t pxHigherPriorityTaskWoken = pdFALSE;
-            size_t bytes_written = xMessageBufferSendFromISR(log_message_buffer, buffer, length, &pxHigherPriorityTaskWoken);
-            if (!bytes_written) ESP_LOGE(TAG, "not enough space in log buffer");
+            if (!xMessageBufferSend(log_message_buffer, line, length, 0))
+                log_stats.dropped++;
         }
     }
+}
 
-    return original_log_function(format, args);
+void log_udp_get_stats(log_udp_stats_t *stats)
+{
+    assert(stats);
+    memcpy(stats, &log_stats, sizeof(log_udp_stats_t));
+}
+
+void log_udp_log_stats(void)
+{
+    log_udp_stats_t stats = {};
+    log_udp_get_stats(&stats);
+
+    ESP_LOGI(TAG, "%s: messages=%"PRIu32" dropped=%"PRIu32" hook_avg=%"PRIu64"us hook_max=%"PRIu32"us",
+        LOG_DEFERRED ? "deferred" : "immediate",
+        stats.messages, stats.dropped,
+        stats.messages ? stats.hook_time_total_us / stats.messages : 0,
+        stats.hook_time_max_us);
+    ESP_LOGI(TAG, "udp: boot_id=%08"PRIx32" datagrams=%"PRIu32" lines=%"PRIu32" send_errors=%"PRIu32,
+        log_boot_id, stats.datagrams_sent, stats.lines_sent, stats.send_errors);
+}
+
+// Sends the pending lines. Failed datagrams still use up their sequence number, the receiver sees them as lost.
+// Called by the publish task only, must not log (the message would end up in the next datagram, forever).
+static void send_datagram(int sock, const struct sockaddr_in *dest_addr)
+{
+    const size_t length = log_datagram_builder_finish(&log_datagram, log_boot_id, log_sequence++, log_stats.dropped);
+
+    const ssize_t sent_bytes = sendto(sock, log_datagram.data, length, 0, (const struct sockaddr *)dest_addr, sizeof(*dest_addr));
+    if (sent_bytes < (ssize_t)length) {
+        log_stats.send_errors++;
+    } else {
+        log_stats.datagrams_sent++;
+        log_stats.lines_sent += log_datagram.line_count;
+    }
+
+    log_datagram_builder_reset(&log_datagram);
 }
 
 static void log_publish_task()
@@ -98,8 +285,11 @@ static void log_publish_task()
 
     ESP_LOGI(TAG, "log_publish_task");
 
+    // The console output must not wait for the network.
     while(!g_network_ready) {
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        if (LOG_DEFERRED)
+            format_deferred_messages();
+        vTaskDelay((LOG_DEFERRED ? 20 : 1000) / portTICK_PERIOD_MS);
     }
 
     ESP_LOGI(TAG, "network is ready");
@@ -127,21 +317,39 @@ static void log_publish_task()
             goto try_again_later;
         }
 
+        log_datagram_builder_reset(&log_datagram);
+        int64_t batch_start = 0;
+
         while(true)
         {
-            char buffer[256] = {};
-            const size_t received_bytes = xMessageBufferReceive(log_message_buffer, buffer, sizeof(buffer), portMAX_DELAY); // blocks until message received
-            if (!received_bytes) {
-                ESP_LOGE(TAG, "did not get any item from message buffer");
-                vTaskDelay(1000 / portTICK_PERIOD_MS);
-                continue;
+            if (LOG_DEFERRED)
+                format_deferred_messages();
+
+            // Waits at most until the pending datagram is due.
+            TickType_t wait = LOG_DEFERRED ? 20 / portTICK_PERIOD_MS : portMAX_DELAY;
+            if (log_datagram.line_count > 0)
+            {
+                const int64_t remaining_ms = LOG_UDP_FLUSH_MS - (esp_timer_get_time() - batch_start) / 1000;
+                const TickType_t remaining = remaining_ms > 0 ? remaining_ms / portTICK_PERIOD_MS : 0;
+                if (remaining < wait)
+                    wait = remaining;
             }
 
-            const ssize_t sent_bytes = sendto(sock, buffer, received_bytes, 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-            if (sent_bytes < received_bytes) {
-                ESP_LOGW(TAG, "sendto failed (sent %d / %u)", sent_bytes, received_bytes);
-                // TODO break loop if this happens more than x times?
+            char buffer[256] = {};
+            const size_t received_bytes = xMessageBufferReceive(log_message_buffer, buffer, sizeof(buffer), wait);
+            if (received_bytes)
+            {
+                if (!log_datagram_builder_append(&log_datagram, buffer, received_bytes))
+                {
+                    send_datagram(sock, &dest_addr);
+                    log_datagram_builder_append(&log_datagram, buffer, received_bytes);
+                }
+                if (log_datagram.line_count == 1)
+                    batch_start = esp_timer_get_time();
             }
+
+            if (log_datagram.line_count > 0 && esp_timer_get_time() - batch_start >= LOG_UDP_FLUSH_MS * 1000LL)
+                send_datagram(sock, &dest_addr);
         }
 
         close(sock);
@@ -1,5 +1,19 @@
 #pragma once
 
+#include <stdint.h>
 #include <esp_err.h>
 
+typedef struct {
+    uint32_t messages;
+    uint32_t dropped;               // ring or send buffer full
+    uint64_t hook_time_total_us;    // time spent in the log hook, by the logging task
+    uint32_t hook_time_max_us;
+    uint32_t datagrams_sent;
+    uint32_t lines_sent;
+    uint32_t send_errors;           // datagrams lost at the sender, the receiver sees a gap in the sequence
+} log_udp_stats_t;
+
 esp_err_t log_udp_init();
+
+void log_udp_get_stats(log_udp_stats_t *stats);
+void log_udp_log_stats(void);
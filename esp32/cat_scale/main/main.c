@@ -3,10 +3,16 @@
 #include "sensors.h"
 #include "wifi.h"
 #include "http.h"
+#include "post_queue.h"
 #include "time.h"
 #include "rc.h"
 #include "log_udp.h"
 #include "measurement.h"
+#include "settings.h"
+#include "metrics.h"
+#include "mqtt_upload.h"
+#include "live_stream.h"
+#include "radio.h"
 
 #include "sdkconfig.h"
 
@@ -39,18 +45,37 @@ void app_main()
     
     ESP_ERROR_CHECK(log_udp_init());
     ESP_ERROR_CHECK(flash_init());
-    ESP_ERROR_CHECK(wifi_init_sta());
-    g_network_ready = true;
-    ESP_ERROR_CHECK(time_init_and_sync());
+    ESP_ERROR_CHECK(settings_init());
+    ESP_ERROR_CHECK(http_init());
+#if CONFIG_CATSCALE_MQTT
+    ESP_ERROR_CHECK(mqtt_upload_init());
+#endif
+    ESP_ERROR_CHECK(post_queue_init());
+
+    // Sampling starts right away, the sensors warm up while wifi connects and the clock is synchronized.
+    // Timestamps are taken from esp_timer and converted to utc once the sntp answered.
     ESP_ERROR_CHECK(measurement_init());
     ESP_ERROR_CHECK(sensors_init());
+    ESP_ERROR_CHECK(metrics_init());
+    ESP_ERROR_CHECK(wifi_init_sta());
+    ESP_ERROR_CHECK(radio_init());
+    ESP_ERROR_CHECK(time_init());
+
+    ESP_ERROR_CHECK(wifi_wait_for_connection());
+    g_network_ready = true;
     ESP_ERROR_CHECK(rc_init());
+    ESP_ERROR_CHECK(live_stream_init());
 
     while(true)
     {
         vTaskDelay(30 * 1000 / portTICK_PERIOD_MS);
         ESP_LOGI(TAG, "min free heap %u KiB", esp_get_minimum_free_heap_size() / 1024);
         wifi_check_health();
+        radio_log_stats();
+        http_log_stats();
+        post_queue_log_stats();
+        measurement_log_stats();
+        log_udp_log_stats();
     }
 }
 
@@ -2,7 +2,10 @@
 
 #include "measurement.h"
 #include "time.h"
-#include "http.h"
+#include "post_queue.h"
+#include "scale_event.h"
+#include "json_writer.h"
+#include "scale_channel.h"
 
 #include "sdkconfig.h"
 
@@ -11,6 +14,8 @@
 #include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <assert.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -18,49 +23,61 @@
 
 #include <esp_system.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 
 static const char *TAG = "measurement";
 
 enum event_type {
     event_type_start_of_event,
     event_type_stable_phase,
-    event_type_end_of_event
+    event_type_end_of_event,
+    event_type_sample,
 };
 
 typedef struct {
     const uint32_t event_type;
-    const struct timeval timestamp;
+    const uint32_t channel;
+    const int64_t timestamp;   // µs since boot
     union {
         struct {
             const double length;
             const double value;
         } stable_phase;
+        struct {
+            const double raw;
+            const double weight;
+        } sample;
         // possibly other data later ...
      };
 } event_t;
 
-typedef struct stable_phase {
-    const struct timeval timestamp;
-    const double length;
-    const double value;
-    struct stable_phase *next;
-} stable_phase_t;
-
-typedef struct {
-    const struct timeval start;
-    struct timeval end;
-    stable_phase_t *first_stable_phase;
-    stable_phase_t *last_stable_phase;
-    double temperature;
-    double humidity;
-    double pressure;
-} scale_event_t;
+// A message takes the event and its length in the buffer.
+#define MESSAGE_SIZE                (sizeof(event_t) + sizeof(size_t))
+#define CONTROL_RESERVE_SIZE        (MESSAGE_SIZE * MEASUREMENT_CONTROL_MESSAGES * CONFIG_CATSCALE_SCALE_CHANNELS)
+#define MESSAGE_BUFFER_SIZE         (MESSAGE_SIZE * FAST_SAMPLES_PER_SECOND * CONFIG_CATSCALE_SCALE_CHANNELS \
+                                        * MEASUREMENT_SAMPLE_BACKLOG_S + CONTROL_RESERVE_SIZE)
 
 static MessageBufferHandle_t event_message_buffer = NULL;
 
+// Written by the slow sensor task, read by the post task. A double is not copied atomically on the esp32 and the three
+// values belong together.
 static double current_temperature;
 static double current_humidity;
 static double current_pressure;
+static portMUX_TYPE environment_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile bool event_active[SCALE_CHANNEL_MAX] = {};
+
+// Events live in a fixed pool which is allocated once at init, nothing is allocated per event.
+// A slot is in use from the start of the event until the post queue released it, see CATSCALE_EVENT_POOL_SIZE.
+static scale_event_t *event_pool = NULL;
+static bool event_pool_used[CONFIG_CATSCALE_EVENT_POOL_SIZE] = {};
+static uint8_t *waveform_pool = NULL;
+static portMUX_TYPE event_pool_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static measurement_pool_status_t event_pool_status = {};
+
+static_assert(CONFIG_CATSCALE_EVENT_POOL_SIZE >= CONFIG_CATSCALE_SCALE_CHANNELS,
+    "CATSCALE_EVENT_POOL_SIZE must be at least CATSCALE_SCALE_CHANNELS");
 
 static void measurement_post_task(void*);
 
@@ -68,25 +85,65 @@ esp_err_t measurement_init(void)
 {
     ESP_LOGI(TAG, "measurement_init");
 
-    event_message_buffer = xMessageBufferCreate(1024);
+    event_message_buffer = xMessageBufferCreate(MESSAGE_BUFFER_SIZE);
     assert(event_message_buffer);
 
+    event_pool = calloc(CONFIG_CATSCALE_EVENT_POOL_SIZE, sizeof(scale_event_t));
+    assert(event_pool);
+
+    if (CONFIG_CATSCALE_EVENT_WAVEFORM_BUFFER_SIZE > 0)
+    {
+        waveform_pool = malloc(CONFIG_CATSCALE_EVENT_POOL_SIZE * CONFIG_CATSCALE_EVENT_WAVEFORM_BUFFER_SIZE);
+        if (!waveform_pool)
+            ESP_LOGE(TAG, "Failed to allocate waveform buffers, recording no waveforms");
+    }
+
+    event_pool_status.capacity = CONFIG_CATSCALE_EVENT_POOL_SIZE;
+    event_pool_status.message_buffer_size = MESSAGE_BUFFER_SIZE;
+    event_pool_status.message_buffer_min_free = MESSAGE_BUFFER_SIZE;
+
     xTaskCreate(measurement_post_task, "measurement_post_task", 8 * 1024, NULL, tskIDLE_PRIORITY + 1, NULL);
 
     return ESP_OK;
 }
 
+// Policy when all slots are taken (all previous events still waiting for delivery):
+// the new event is not recorded, the ones already in flight are kept.
 static scale_event_t *create_scale_event(const event_t *event)
 {
     assert(event);
 
-    const scale_event_t init = {
-        .start = event->timestamp,
-    };
+    scale_event_t *scale_event = NULL;
+    size_t slot = 0;
 
-    scale_event_t *scale_event = malloc(sizeof(scale_event_t));
-    assert(scale_event);
-    memcpy(scale_event, &init, sizeof(scale_event_t));
+    taskENTER_CRITICAL(&event_pool_spinlock);
+    for (size_t i = 0; i < CONFIG_CATSCALE_EVENT_POOL_SIZE; i++)
+    {
+        if (!event_pool_used[i])
+        {
+            event_pool_used[i] = true;
+            scale_event = &event_pool[i];
+            slot = i;
+
+            event_pool_status.in_use++;
+            if (event_pool_status.in_use > event_pool_status.in_use_high_water)
+                event_pool_status.in_use_high_water = event_pool_status.in_use;
+            break;
+        }
+    }
+    if (!scale_event)
+        event_pool_status.events_dropped++;
+    taskEXIT_CRITICAL(&event_pool_spinlock);
+
+    if (!scale_event)
+    {
+        ESP_LOGE(TAG, "Event pool exhausted, event not recorded");
+        return NULL;
+    }
+
+    scale_event_reset(scale_event, scale_channel_get(event->channel)->toilet_id, event->timestamp,
+        waveform_pool ? waveform_pool + slot * CONFIG_CATSCALE_EVENT_WAVEFORM_BUFFER_SIZE : NULL,
+        CONFIG_CATSCALE_EVENT_WAVEFORM_BUFFER_SIZE);
 
     return scale_event;
 }
@@ -97,141 +154,55 @@ static void finish_scale_event(scale_event_t *scale_event, const event_t *event)
     assert(event);
 
     scale_event->end = event->timestamp;
+
+    taskENTER_CRITICAL(&event_pool_spinlock);
+    if (scale_event->stable_phase_count > event_pool_status.stable_phases_high_water)
+        event_pool_status.stable_phases_high_water = scale_event->stable_phase_count;
+    if (scale_event->waveform.length > event_pool_status.waveform_bytes_high_water)
+        event_pool_status.waveform_bytes_high_water = scale_event->waveform.length;
+    event_pool_status.stable_phases_dropped += scale_event->stable_phases_dropped;
+    if (scale_event->waveform.truncated)
+        event_pool_status.waveforms_truncated++;
+    taskEXIT_CRITICAL(&event_pool_spinlock);
 }
 
 static void destroy_scale_event(scale_event_t *scale_event)
 {
     assert(scale_event);
+    assert(scale_event >= event_pool && scale_event < event_pool + CONFIG_CATSCALE_EVENT_POOL_SIZE);
 
-    stable_phase_t *current = scale_event->first_stable_phase;
-    while(current) {
-        stable_phase_t *next = current->next;
-        free(current);
-        current = next;
-    }
+    const size_t slot = scale_event - event_pool;
 
-    free(scale_event);
+    taskENTER_CRITICAL(&event_pool_spinlock);
+    assert(event_pool_used[slot]);
+    event_pool_used[slot] = false;
+    event_pool_status.in_use--;
+    taskEXIT_CRITICAL(&event_pool_spinlock);
 }
 
-static void add_stable_phase(scale_event_t *scale_event, const event_t *event)
+static esp_err_t write_scale_event(const void *context, bool compact, http_body_writer_t write, void *sink)
 {
-    assert(scale_event);
-    assert(event);
-
-    const stable_phase_t init = {
-        .timestamp = event->timestamp,
-        .length = event->stable_phase.length,
-        .value = event->stable_phase.value,
-        .next = NULL,
-    };
+    const scale_event_t * const scale_event = context;
 
-    stable_phase_t *stable_phase = malloc(sizeof(stable_phase_t));
-    assert(stable_phase);
-    memcpy(stable_phase, &init, sizeof(stable_phase_t));
+    // The offset of the start is good enough for the whole event, the clock is slewed only slowly.
+    const int64_t unix_offset_us = time_monotonic_to_unix_us(scale_event->start) - scale_event->start;
 
-    if (scale_event->first_stable_phase == NULL || scale_event->last_stable_phase == NULL) {
-        scale_event->first_stable_phase = stable_phase;
-        scale_event->last_stable_phase = stable_phase;
-    } else {
-        scale_event->last_stable_phase->next = stable_phase;
-        scale_event->last_stable_phase = stable_phase;
-    }
+    json_writer_t writer;
+    json_writer_init(&writer, write, sink);
+    scale_event_write_json(scale_event, compact, unix_offset_us, &writer);
+    return json_writer_finish(&writer);
 }
 
-static esp_err_t serialize_scale_event(const scale_event_t *scale_event, char *output_buffer, size_t output_buffer_size)
+static void release_scale_event(void *context)
 {
-    assert(scale_event);
-    assert(output_buffer);
-    assert(output_buffer_size);
-
-    memset(output_buffer, 0, output_buffer_size);
-    size_t written_characters = 0;
-
-    const int toiletId = 1; // TODO get from config?
-
-    char start_time_buffer[32] = {};
-    char end_time_buffer[32] = {};
-    convert_timeval_to_iso8601(scale_event->start, start_time_buffer, sizeof(start_time_buffer));
-    convert_timeval_to_iso8601(scale_event->end, end_time_buffer, sizeof(end_time_buffer));
-
-    // prefix
-    written_characters += snprintf(
-        output_buffer + written_characters,
-        output_buffer_size - written_characters,
-        "{"
-        "\"toiletId\": %d,"
-        "\"startTime\": \"%s\","
-        "\"endTime\": \"%s\","
-        "\"temperature\": %0.2f,"   // °C
-        "\"humidity\": %0.2f,"      // %
-        "\"pressure\": %0.1f,"      // Pa
-        "\"stablePhases\": [",
-        toiletId,
-        start_time_buffer,
-        end_time_buffer,
-        scale_event->temperature,
-        scale_event->humidity,
-        scale_event->pressure
-        );
-
-    if (written_characters >= output_buffer_size) {
-        ESP_LOGE(TAG, "buffer full #1");
-        return ESP_ERR_NO_MEM;
-    }
-
-    // stable phases
-    stable_phase_t *stable_phase = scale_event->first_stable_phase;
-    while(stable_phase) {
-
-        char time_buffer[32] = {};
-        convert_timeval_to_iso8601(stable_phase->timestamp, time_buffer, sizeof(time_buffer));
-
-        written_characters += snprintf(
-            output_buffer + written_characters,
-            output_buffer_size - written_characters,
-            "{"
-            "\"timestamp\": \"%s\","
-            "\"length\": %0.1f,"
-            "\"value\": %0.1f"
-            "}%s",
-            time_buffer,
-            stable_phase->length,
-            stable_phase->value,
-            stable_phase->next ? "," : ""
-        );
-
-        if (written_characters >= output_buffer_size) {
-            ESP_LOGE(TAG, "buffer full #2");
-            return ESP_ERR_NO_MEM;
-        }
-
-        stable_phase = stable_phase->next;
-    }
-
-    // postfix
-    written_characters += snprintf(
-        output_buffer + written_characters,
-        output_buffer_size - written_characters,
-        "]}");
-
-    if (written_characters >= output_buffer_size) {
-        ESP_LOGE(TAG, "buffer full #3");
-        return ESP_ERR_NO_MEM;
-    }
-
-    return ESP_OK;
+    destroy_scale_event(context);
 }
 
 static void measurement_post_task(void*)
 {
     ESP_LOGI(TAG, "measurement_post_task");
 
-    scale_event_t *current_event = NULL;
-
-    const size_t message_buffer_size = 4 * 1024;
-    char *message_buffer = malloc(message_buffer_size);
-    assert(message_buffer);
-    memset(message_buffer, 0, message_buffer_size);
+    scale_event_t *current_events[SCALE_CHANNEL_MAX] = {};
 
     while(true)
     {
@@ -239,44 +210,59 @@ static void measurement_post_task(void*)
         size_t bytes_read = xMessageBufferReceive(event_message_buffer, &e, sizeof(event_t), portMAX_DELAY); // blocking read
         if (bytes_read == sizeof(event_t))
         {
+            assert(e.channel < SCALE_CHANNEL_MAX);
+            scale_event_t ** const current = &current_events[e.channel];
+
             switch (e.event_type)
             {
                 case event_type_start_of_event:
-                    ESP_LOGI(TAG, "Post task: received start of event");
-                    if (current_event)
-                        destroy_scale_event(current_event);
-                    current_event = create_scale_event(&e);
-                    // Copy environmental conditions at the start of the event.
-                    current_event->temperature = current_temperature;
-                    current_event->humidity = current_humidity;
-                    current_event->pressure = current_pressure;
+                    ESP_LOGI(TAG, "Post task: received start of event (channel %u)", e.channel);
+                    if (*current)
+                        destroy_scale_event(*current);
+                    *current = create_scale_event(&e);
+                    if (*current) {
+                        // Copy environmental conditions at the start of the event.
+                        taskENTER_CRITICAL(&environment_spinlock);
+                        (*current)->temperature = current_temperature;
+                        (*current)->humidity = current_humidity;
+                        (*current)->pressure = current_pressure;
+                        taskEXIT_CRITICAL(&environment_spinlock);
+                    }
                     break;
 
                 case event_type_stable_phase:
                     ESP_LOGI(TAG, "Post task: received stable phase");
-                    if (current_event)
-                        add_stable_phase(current_event, &e);
+                    if (*current)
+                        scale_event_add_stable_phase(*current, e.timestamp, e.stable_phase.length, e.stable_phase.value);
+                    break;
+
+                case event_type_sample:
+                    if (*current)
+                        scale_event_add_sample(*current, e.timestamp, e.sample.raw, e.sample.weight);
                     break;
 
                 case event_type_end_of_event:
-                    ESP_LOGI(TAG, "Post task: received end of event");
-                    if (current_event)
+                    ESP_LOGI(TAG, "Post task: received end of event (channel %u)", e.channel);
+                    if (*current)
                     {
-                        finish_scale_event(current_event, &e);
-
-                        ESP_LOGI(TAG, "Posting scale event data (%zu bytes) ...", strlen(message_buffer));
-                        esp_err_t ret = serialize_scale_event(current_event, message_buffer, message_buffer_size);
-                        if (ret == ESP_OK) {
-                            ret = http_post_json_data("api/ScaleEvent/Create", message_buffer);
-                            if (ret != ESP_OK) {
-                                ESP_LOGE(TAG, "Failed to post scale event data");
-                            }
-                        } else {
-                            ESP_LOGE(TAG, "Failed to serialize scale event");
+                        finish_scale_event(*current, &e);
+
+                        ESP_LOGI(TAG, "Posting scale event (%"PRIu32" samples, %zu bytes) ...",
+                            (*current)->waveform.sample_count, (*current)->waveform.length);
+
+                        // Delivery to the individual endpoints happens in the background,
+                        // the event is serialized while it is sent and destroyed afterwards.
+                        const post_document_t document = {
+                            .write = write_scale_event,
+                            .release = release_scale_event,
+                            .context = *current,
+                        };
+                        *current = NULL;
+
+                        esp_err_t ret = post_queue_submit_scale_event(&document);
+                        if (ret != ESP_OK) {
+                            ESP_LOGE(TAG, "Failed to queue scale event");
                         }
-
-                        destroy_scale_event(current_event);
-                        current_event = NULL;
                     }
                     break;
 
@@ -291,36 +277,57 @@ static void measurement_post_task(void*)
 static void send_event(const event_t *event)
 {
     assert(event);
-    size_t bytes_written = xMessageBufferSend(event_message_buffer, event, sizeof(event_t), 0);
+
+    // Samples leave the reserve to the start, stable phase and end messages, a lost end would keep the event
+    // from being posted at all.
+    const bool is_sample = event->event_type == event_type_sample;
+    size_t bytes_written = 0;
+    if (!is_sample || xMessageBufferSpacesAvailable(event_message_buffer) >= CONTROL_RESERVE_SIZE + MESSAGE_SIZE)
+        bytes_written = xMessageBufferSend(event_message_buffer, event, sizeof(event_t), 0);
+    const size_t free_space = xMessageBufferSpacesAvailable(event_message_buffer);
+
+    taskENTER_CRITICAL(&event_pool_spinlock);
     if (bytes_written != sizeof(event_t))
+    {
+        if (is_sample)
+            event_pool_status.samples_dropped++;
+        else
+            event_pool_status.messages_dropped++;
+    }
+    if (free_space < event_pool_status.message_buffer_min_free)
+        event_pool_status.message_buffer_min_free = free_space;
+    taskEXIT_CRITICAL(&event_pool_spinlock);
+
+    if (bytes_written != sizeof(event_t) && !is_sample)
         ESP_LOGE(TAG, "Failed to add event to buffer");
 }
 
-void measurement_mark_start_of_event(void)
+void measurement_mark_start_of_event(size_t channel)
 {
-    ESP_LOGI(TAG, "measurement_mark_start_of_event");
+    ESP_LOGI(TAG, "measurement_mark_start_of_event %u", channel);
 
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
+    assert(channel < SCALE_CHANNEL_MAX);
+    event_active[channel] = true;
 
     const event_t e = {
         .event_type = event_type_start_of_event,
-        .timestamp = tv,
+        .channel = channel,
+        .timestamp = esp_timer_get_time(),
     };
 
     send_event(&e);
 }
 
-void measurement_push_stable_phase(double length, double value)
+void measurement_push_stable_phase(size_t channel, double length, double value)
 {
-    ESP_LOGI(TAG, "measurement_push_stable_phase %0.1f %0.1f", length, value);
+    ESP_LOGI(TAG, "measurement_push_stable_phase %u %0.1f %0.1f", channel, length, value);
 
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
+    assert(channel < SCALE_CHANNEL_MAX);
 
     const event_t e = {
         .event_type = event_type_stable_phase,
-        .timestamp = tv,
+        .channel = channel,
+        .timestamp = esp_timer_get_time(),
         .stable_phase.length = length,
         .stable_phase.value = value,
     };
@@ -328,25 +335,73 @@ void measurement_push_stable_phase(double length, double value)
     send_event(&e);
 }
 
-void measurement_mark_end_of_event(void)
+void measurement_mark_end_of_event(size_t channel)
 {
-    ESP_LOGI(TAG, "measurement_mark_end_of_event");
+    ESP_LOGI(TAG, "measurement_mark_end_of_event %u", channel);
 
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
+    assert(channel < SCALE_CHANNEL_MAX);
+    event_active[channel] = false;
 
     const event_t e = {
         .event_type = event_type_end_of_event,
-        .timestamp = tv,
+        .channel = channel,
+        .timestamp = esp_timer_get_time(),
+    };
+
+    send_event(&e);
+}
+
+void measurement_push_sample(size_t channel, int64_t timestamp, double raw, double weight)
+{
+    assert(channel < SCALE_CHANNEL_MAX);
+
+    // Samples are only recorded during an event, no need to bother the post task otherwise.
+    if (!event_active[channel])
+        return;
+
+    const event_t e = {
+        .event_type = event_type_sample,
+        .channel = channel,
+        .timestamp = timestamp,
+        .sample.raw = raw,
+        .sample.weight = weight,
     };
 
     send_event(&e);
 }
 
+bool measurement_is_event_active(size_t channel)
+{
+    assert(channel < SCALE_CHANNEL_MAX);
+    return event_active[channel];
+}
+
+void measurement_get_pool_status(measurement_pool_status_t *status)
+{
+    assert(status);
+
+    taskENTER_CRITICAL(&event_pool_spinlock);
+    memcpy(status, &event_pool_status, sizeof(measurement_pool_status_t));
+    taskEXIT_CRITICAL(&event_pool_spinlock);
+}
+
+void measurement_log_stats(void)
+{
+    measurement_pool_status_t status = {};
+    measurement_get_pool_status(&status);
+
+    ESP_LOGI(TAG, "event pool: in_use=%"PRIu32"/%"PRIu32" max=%"PRIu32" dropped=%"PRIu32" stable_phases_max=%"PRIu32"/%d stable_phases_dropped=%"PRIu32" waveform_max=%"PRIu32"/%d truncated=%"PRIu32" messages_dropped=%"PRIu32" samples_dropped=%"PRIu32" message_buffer_min_free=%"PRIu32"/%"PRIu32,
+        status.in_use, status.capacity, status.in_use_high_water, status.events_dropped,
+        status.stable_phases_high_water, CONFIG_CATSCALE_EVENT_MAX_STABLE_PHASES, status.stable_phases_dropped,
+        status.waveform_bytes_high_water, CONFIG_CATSCALE_EVENT_WAVEFORM_BUFFER_SIZE, status.waveforms_truncated,
+        status.messages_dropped, status.samples_dropped, status.message_buffer_min_free, status.message_buffer_size);
+}
+
 void measurement_update_environment_data(double temperature, double humidity, double pressure)
 {
-    // Note: Intentionally not using any synchronization primitive here under the assumption that double's are copied atomically.
+    taskENTER_CRITICAL(&environment_spinlock);
     current_temperature = temperature;
     current_humidity = humidity;
     current_pressure = pressure;
+    taskEXIT_CRITICAL(&environment_spinlock);
 }
@@ -1,11 +1,45 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include <esp_err.h>
 
+// Samples of all channels the post task can fall behind by. The start, stable phase and end messages have
+// room of their own, samples are dropped first.
+#define MEASUREMENT_SAMPLE_BACKLOG_S        (2)
+#define MEASUREMENT_CONTROL_MESSAGES        (4)     // per channel
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t in_use;
+    uint32_t in_use_high_water;
+    uint32_t events_dropped;            // pool was exhausted
+    uint32_t stable_phases_high_water;  // per event
+    uint32_t stable_phases_dropped;
+    uint32_t waveform_bytes_high_water; // per event
+    uint32_t waveforms_truncated;
+    uint32_t messages_dropped;          // start, stable phase or end, the message buffer to the post task was full
+    uint32_t samples_dropped;           // the post task fell behind by more than MEASUREMENT_SAMPLE_BACKLOG_S
+    uint32_t message_buffer_size;       // bytes
+    uint32_t message_buffer_min_free;   // bytes
+} measurement_pool_status_t;
+
 esp_err_t measurement_init(void);
 
-void measurement_mark_start_of_event(void);
-void measurement_push_stable_phase(double length, double value);
-void measurement_mark_end_of_event(void);
+// Every scale channel has its own current event, see scale_channel.h.
+void measurement_mark_start_of_event(size_t channel);
+void measurement_push_stable_phase(size_t channel, double length, double value);
+void measurement_mark_end_of_event(size_t channel);
+
+// Raw and filtered weight of every sample, recorded into the waveform of the current event of the channel.
+// timestamp: when the hx711 was read, µs since boot.
+void measurement_push_sample(size_t channel, int64_t timestamp, double raw, double weight);
+
+// True between measurement_mark_start_of_event and measurement_mark_end_of_event.
+bool measurement_is_event_active(size_t channel);
+
+void measurement_get_pool_status(measurement_pool_status_t *status);
+void measurement_log_stats(void);
 
 void measurement_update_environment_data(double temperature, double humidity, double pressure);
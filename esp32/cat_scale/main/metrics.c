@@ -0,0 +1,257 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "metrics.h"
+#include "sensors.h"
+#include "measurement.h"
+#include "log_udp.h"
+#include "http.h"
+#include "post_queue.h"
+#include "time.h"
+#include "wifi.h"
+#include "scale_channel.h"
+
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include <esp_system.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_wifi.h>
+
+static const char *TAG = "metrics";
+
+static_assert((int)METRICS_HTTP_COUNT == (int)HTTP_CLIENT_COUNT, "metrics_http_id_t does not match http_client_id_t");
+static_assert(METRICS_POST_ENDPOINT_COUNT == HTTP_JSON_ENDPOINT_COUNT, "METRICS_POST_ENDPOINT_COUNT does not match");
+static_assert((int)METRICS_BUFFER_COUNT == (int)SENSORS_BUFFER_COUNT, "metrics_buffer_id_t does not match sensors_buffer_id_t");
+
+// Snapshots are too large to be copied in a critical section.
+static SemaphoreHandle_t g_mutex = NULL;
+static metrics_snapshot_t *g_latest = NULL;
+static uint32_t g_uploaded_sequence = 0;
+
+static void metrics_task(void*);
+
+esp_err_t metrics_init(void)
+{
+    ESP_LOGI(TAG, "metrics_init");
+
+    g_mutex = xSemaphoreCreateMutex();
+    assert(g_mutex);
+
+    g_latest = calloc(1, sizeof(metrics_snapshot_t));
+    assert(g_latest);
+
+    xTaskCreate(metrics_task, "metrics_task", 8 * 1024, NULL, tskIDLE_PRIORITY + 1, NULL);
+
+    return ESP_OK;
+}
+
+static void collect_tasks(metrics_snapshot_t *snapshot, TaskStatus_t *task_status)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    uint32_t total_run_time = 0;
+    const UBaseType_t count = uxTaskGetSystemState(task_status, METRICS_MAX_TASKS, &total_run_time);
+    if (count == 0)
+        ESP_LOGW(TAG, "more than %d tasks, task metrics not available", METRICS_MAX_TASKS);
+
+    snapshot->run_time = total_run_time;
+    snapshot->task_count = count;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        metrics_task_t * const task = &snapshot->tasks[i];
+        snprintf(task->name, sizeof(task->name), "%s", task_status[i].pcTaskName);
+        task->number = task_status[i].xTaskNumber;
+        task->run_time = task_status[i].ulRunTimeCounter;
+        task->stack_free = task_status[i].usStackHighWaterMark; // StackType_t is a byte on the esp32
+    }
+#else
+    snapshot->run_time = 0;
+    snapshot->task_count = 0;
+#endif
+}
+
+// prev_http: latency totals of the previous snapshot, for the average of the requests in between.
+static void collect(metrics_snapshot_t *snapshot, TaskStatus_t *task_status, http_client_stats_t *prev_http)
+{
+    snapshot->timestamp = esp_timer_get_time();
+
+    collect_tasks(snapshot, task_status);
+
+    snapshot->heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    snapshot->heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    snapshot->heap_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+    for (int i = 0; i < SENSORS_BUFFER_COUNT; i++)
+    {
+        ringbuffer_stats_t stats = {};
+        sensors_get_buffer_stats(i, &stats);
+        snapshot->buffers[i] = (metrics_buffer_t){
+            .capacity = stats.capacity,
+            .count = stats.count,
+            .high_water = stats.count_high_water,
+            .overflows = stats.overflows,
+        };
+    }
+
+    {
+        measurement_pool_status_t status = {};
+        measurement_get_pool_status(&status);
+        snapshot->events_dropped = status.events_dropped;
+        snapshot->event_messages_dropped = status.messages_dropped;
+        snapshot->event_buffer_min_free = status.message_buffer_min_free;
+    }
+
+    {
+        log_udp_stats_t stats = {};
+        log_udp_get_stats(&stats);
+        snapshot->log_dropped = stats.dropped;
+    }
+
+    for (int i = 0; i < HTTP_CLIENT_COUNT; i++)
+    {
+        http_client_stats_t stats = {};
+        http_get_client_stats(i, &stats);
+
+        const uint32_t requests = stats.requests - prev_http[i].requests;
+        snapshot->http[i] = (metrics_http_t){
+            .requests = stats.requests,
+            .failures = stats.failures,
+            .latency_avg_us = requests > 0 ? (uint32_t)((stats.total_latency_us - prev_http[i].total_latency_us) / requests) : 0,
+            .latency_max_us = (uint32_t)stats.max_latency_us,
+        };
+        prev_http[i] = stats;
+    }
+
+    {
+        wifi_stats_t stats = {};
+        wifi_get_stats(&stats);
+
+        wifi_ap_record_t ap = {};
+        snapshot->wifi = (metrics_wifi_t){
+            .rssi = esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0,
+            .connects = stats.connects,
+            .disconnects = stats.disconnects,
+            .fast_connects = stats.fast_connects,
+            .fast_connect_failures = stats.fast_connect_failures,
+            .boot_to_network_ms = stats.boot_to_network_ms,
+            .last_outage_ms = stats.last_outage_ms,
+            .max_outage_ms = stats.max_outage_ms,
+        };
+    }
+
+    for (int i = 0; i < HTTP_JSON_ENDPOINT_COUNT; i++)
+    {
+        post_queue_status_t status = {};
+        post_queue_get_status(i, &status);
+        snapshot->post[i] = (metrics_post_t){
+            .delivered = status.delivered,
+            .failed = status.failed,
+            .dropped = status.dropped,
+            .queue_level = status.queue_level,
+            .outbox_level = status.outbox_level,
+        };
+    }
+}
+
+static void log_snapshot(const metrics_snapshot_t *snapshot)
+{
+    ESP_LOGI(TAG, "heap free=%"PRIu32" min=%"PRIu32" largest=%"PRIu32" fragmentation=%"PRIu32"/1000",
+        snapshot->heap_free, snapshot->heap_min_free, snapshot->heap_largest_block, metrics_heap_fragmentation(snapshot));
+
+    for (size_t i = 0; i < snapshot->task_count; i++)
+    {
+        const metrics_task_t * const task = &snapshot->tasks[i];
+        ESP_LOGI(TAG, "task %-16s cpu=%3"PRIu32"/1000 stack_free=%"PRIu32, task->name, task->cpu_permille, task->stack_free);
+    }
+}
+
+static void metrics_task(void*)
+{
+    ESP_LOGI(TAG, "metrics_task");
+
+    // Both snapshots and the task list are about 4 KiB, too much for the stack.
+    metrics_snapshot_t * const current = calloc(1, sizeof(metrics_snapshot_t));
+    metrics_snapshot_t * const previous = calloc(1, sizeof(metrics_snapshot_t));
+    TaskStatus_t * const task_status = calloc(METRICS_MAX_TASKS, sizeof(TaskStatus_t));
+    assert(current && previous && task_status);
+
+    http_client_stats_t prev_http[HTTP_CLIENT_COUNT] = {};
+
+    while (true)
+    {
+        vTaskDelay(CONFIG_CATSCALE_METRICS_INTERVAL_S * 1000 / portTICK_PERIOD_MS);
+
+        collect(current, task_status, prev_http);
+        current->sequence = previous->sequence + 1;
+        metrics_update_cpu(current, previous->sequence ? previous : NULL);
+
+        xSemaphoreTake(g_mutex, portMAX_DELAY);
+        memcpy(g_latest, current, sizeof(metrics_snapshot_t));
+        xSemaphoreGive(g_mutex);
+
+        log_snapshot(current);
+
+        memcpy(previous, current, sizeof(metrics_snapshot_t));
+    }
+}
+
+bool metrics_get_snapshot(metrics_snapshot_t *snapshot)
+{
+    assert(snapshot);
+    assert(g_mutex);
+
+    xSemaphoreTake(g_mutex, portMAX_DELAY);
+    memcpy(snapshot, g_latest, sizeof(metrics_snapshot_t));
+    xSemaphoreGive(g_mutex);
+
+    return snapshot->sequence != 0;
+}
+
+bool metrics_append_line_protocol(char *buffer, size_t buffer_size, size_t *offset, uint32_t *sequence)
+{
+    assert(buffer);
+    assert(offset);
+    assert(sequence);
+    assert(*offset <= buffer_size);
+
+    if (!g_mutex)
+        return false;
+
+    bool appended = false;
+
+    xSemaphoreTake(g_mutex, portMAX_DELAY);
+    if (g_latest->sequence != 0 && g_latest->sequence != g_uploaded_sequence)
+    {
+        const uint64_t timestamp_ns = (uint64_t)time_monotonic_to_unix_us(g_latest->timestamp) * 1000;
+        const size_t length = metrics_write_line_protocol(g_latest, scale_channel_device_scale_id(), timestamp_ns,
+            buffer + *offset, buffer_size - *offset);
+        if (length > 0)
+        {
+            *offset += length;
+            *sequence = g_latest->sequence;
+            appended = true;
+        }
+    }
+    xSemaphoreGive(g_mutex);
+
+    return appended;
+}
+
+void metrics_set_uploaded(uint32_t sequence)
+{
+    if (!g_mutex)
+        return;
+
+    xSemaphoreTake(g_mutex, portMAX_DELAY);
+    g_uploaded_sequence = sequence;
+    xSemaphoreGive(g_mutex);
+}
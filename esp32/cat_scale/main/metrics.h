@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#include "metrics_snapshot.h"
+
+// Takes a snapshot every CONFIG_CATSCALE_METRICS_INTERVAL_S.
+esp_err_t metrics_init(void);
+
+// Returns false if there is no snapshot yet.
+bool metrics_get_snapshot(metrics_snapshot_t *snapshot);
+
+// Appends the latest snapshot as influx line protocol, until it was uploaded. For the sensors post task only.
+// Returns false if there was nothing new or it did not fit, offset is not changed then.
+// sequence: of the appended snapshot, for metrics_set_uploaded.
+bool metrics_append_line_protocol(char *buffer, size_t buffer_size, size_t *offset, uint32_t *sequence);
+
+// After the snapshot was posted successfully, it is not appended again.
+void metrics_set_uploaded(uint32_t sequence);
@@ -0,0 +1,199 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "metrics_snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <assert.h>
+
+static const char *g_buffer_names[METRICS_BUFFER_COUNT] = { "fast", "aggregate", "slow" };
+static const char *g_http_names[METRICS_HTTP_COUNT] = { "influx", "json0", "json1" };
+
+static const metrics_task_t *find_task(const metrics_snapshot_t *snapshot, uint32_t number)
+{
+    for (size_t i = 0; i < snapshot->task_count; i++)
+        if (snapshot->tasks[i].number == number)
+            return &snapshot->tasks[i];
+    return NULL;
+}
+
+void metrics_update_cpu(metrics_snapshot_t *snapshot, const metrics_snapshot_t *previous)
+{
+    assert(snapshot);
+
+    // The counters wrap, the differences are still right as long as the snapshots are close enough.
+    const uint32_t elapsed = previous ? snapshot->run_time - previous->run_time : snapshot->run_time;
+
+    for (size_t i = 0; i < snapshot->task_count; i++)
+    {
+        metrics_task_t * const task = &snapshot->tasks[i];
+
+        // Tasks started after the previous snapshot ran for all of their run time since then.
+        const metrics_task_t * const previous_task = previous ? find_task(previous, task->number) : NULL;
+        const uint32_t run_time = previous_task ? task->run_time - previous_task->run_time : task->run_time;
+
+        task->cpu_permille = elapsed > 0 ? (uint32_t)((uint64_t)run_time * 1000 / elapsed) : 0;
+    }
+}
+
+uint32_t metrics_heap_fragmentation(const metrics_snapshot_t *snapshot)
+{
+    assert(snapshot);
+
+    if (snapshot->heap_free == 0 || snapshot->heap_largest_block >= snapshot->heap_free)
+        return 0;
+
+    return (uint32_t)(1000 - (uint64_t)snapshot->heap_largest_block * 1000 / snapshot->heap_free);
+}
+
+static void visit_named(metrics_field_visitor_t visit, void *context, const char *prefix, const char *name, int64_t value)
+{
+    char full_name[64];
+    snprintf(full_name, sizeof(full_name), "%s_%s", prefix, name);
+    visit(context, full_name, value);
+}
+
+void metrics_for_each_field(const metrics_snapshot_t *snapshot, metrics_field_visitor_t visit, void *context)
+{
+    assert(snapshot);
+    assert(visit);
+
+    visit(context, "uptime_s", snapshot->timestamp / 1000000);
+
+    visit(context, "heap_free", snapshot->heap_free);
+    visit(context, "heap_min_free", snapshot->heap_min_free);
+    visit(context, "heap_largest_block", snapshot->heap_largest_block);
+    visit(context, "heap_fragmentation", metrics_heap_fragmentation(snapshot));
+
+    for (size_t i = 0; i < METRICS_BUFFER_COUNT; i++)
+    {
+        const metrics_buffer_t * const buffer = &snapshot->buffers[i];
+        visit_named(visit, context, g_buffer_names[i], "capacity", buffer->capacity);
+        visit_named(visit, context, g_buffer_names[i], "count", buffer->count);
+        visit_named(visit, context, g_buffer_names[i], "high_water", buffer->high_water);
+        visit_named(visit, context, g_buffer_names[i], "overflows", buffer->overflows);
+    }
+
+    visit(context, "events_dropped", snapshot->events_dropped);
+    visit(context, "event_messages_dropped", snapshot->event_messages_dropped);
+    visit(context, "event_buffer_min_free", snapshot->event_buffer_min_free);
+    visit(context, "log_dropped", snapshot->log_dropped);
+
+    for (size_t i = 0; i < METRICS_HTTP_COUNT; i++)
+    {
+        const metrics_http_t * const http = &snapshot->http[i];
+        visit_named(visit, context, g_http_names[i], "requests", http->requests);
+        visit_named(visit, context, g_http_names[i], "failures", http->failures);
+        visit_named(visit, context, g_http_names[i], "latency_avg_us", http->latency_avg_us);
+        visit_named(visit, context, g_http_names[i], "latency_max_us", http->latency_max_us);
+    }
+
+    for (size_t i = 0; i < METRICS_POST_ENDPOINT_COUNT; i++)
+    {
+        const metrics_post_t * const post = &snapshot->post[i];
+        char prefix[8];
+        snprintf(prefix, sizeof(prefix), "post%u", (unsigned)i);
+        visit_named(visit, context, prefix, "delivered", post->delivered);
+        visit_named(visit, context, prefix, "failed", post->failed);
+        visit_named(visit, context, prefix, "dropped", post->dropped);
+        visit_named(visit, context, prefix, "queue_level", post->queue_level);
+        visit_named(visit, context, prefix, "outbox_level", post->outbox_level);
+    }
+
+    visit(context, "wifi_rssi", snapshot->wifi.rssi);
+    visit(context, "wifi_connects", snapshot->wifi.connects);
+    visit(context, "wifi_disconnects", snapshot->wifi.disconnects);
+    visit(context, "wifi_fast_connects", snapshot->wifi.fast_connects);
+    visit(context, "wifi_fast_connect_failures", snapshot->wifi.fast_connect_failures);
+    visit(context, "wifi_boot_to_network_ms", snapshot->wifi.boot_to_network_ms);
+    visit(context, "wifi_last_outage_ms", snapshot->wifi.last_outage_ms);
+    visit(context, "wifi_max_outage_ms", snapshot->wifi.max_outage_ms);
+}
+
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t length;
+    bool overflow;
+    bool first_field;
+} line_writer_t;
+
+static void append(line_writer_t *writer, const char *format, ...)
+{
+    if (writer->overflow)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(writer->buffer + writer->length, writer->size - writer->length, format, args);
+    va_end(args);
+
+    if (length < 0 || (size_t)length >= writer->size - writer->length)
+        writer->overflow = true;
+    else
+        writer->length += (size_t)length;
+}
+
+// Spaces, commas and equal signs have to be escaped in tag values.
+static void append_tag_value(line_writer_t *writer, const char *value)
+{
+    for (const char *c = value; *c; c++)
+    {
+        if (*c == ' ' || *c == ',' || *c == '=')
+            append(writer, "\\%c", *c);
+        else
+            append(writer, "%c", *c);
+    }
+}
+
+static void append_field(void *context, const char *name, int64_t value)
+{
+    line_writer_t * const writer = context;
+
+    append(writer, "%s%s=%"PRId64"i", writer->first_field ? " " : ",", name, value);
+    writer->first_field = false;
+}
+
+size_t metrics_write_line_protocol(const metrics_snapshot_t *snapshot, const char *scale_id, uint64_t timestamp_ns,
+    char *buffer, size_t buffer_size)
+{
+    assert(snapshot);
+    assert(scale_id);
+    assert(buffer);
+
+    line_writer_t writer = {
+        .buffer = buffer,
+        .size = buffer_size,
+        .length = 0,
+        .overflow = buffer_size == 0,
+    };
+
+    append(&writer, "metrics,scale_id=");
+    append_tag_value(&writer, scale_id);
+    writer.first_field = true;
+    metrics_for_each_field(snapshot, append_field, &writer);
+    append(&writer, " %"PRIu64"\n", timestamp_ns);
+
+    for (size_t i = 0; i < snapshot->task_count; i++)
+    {
+        const metrics_task_t * const task = &snapshot->tasks[i];
+
+        append(&writer, "metrics,scale_id=");
+        append_tag_value(&writer, scale_id);
+        append(&writer, ",task=");
+        append_tag_value(&writer, task->name);
+        append(&writer, " cpu_permille=%"PRIu32"i,stack_free=%"PRIu32"i %"PRIu64"\n",
+            task->cpu_permille, task->stack_free, timestamp_ns);
+    }
+
+    if (writer.overflow)
+    {
+        if (buffer_size > 0)
+            buffer[0] = '\0';
+        return 0;
+    }
+
+    return writer.length;
+}
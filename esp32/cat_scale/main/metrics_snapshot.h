@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Runtime metrics of the device at one point in time, collected by metrics.c.
+// Uploaded to influx as measurement "metrics" (one line for the device, one per task) and served by the rpc.
+
+#define METRICS_MAX_TASKS           (32)
+#define METRICS_TASK_NAME_SIZE      (16)    // CONFIG_FREERTOS_MAX_TASK_NAME_LEN
+
+typedef enum {
+    METRICS_BUFFER_FAST,            // sensor ring buffers, see sensors.h
+    METRICS_BUFFER_AGGREGATE,
+    METRICS_BUFFER_SLOW,
+    METRICS_BUFFER_COUNT,
+} metrics_buffer_id_t;
+
+typedef enum {
+    METRICS_HTTP_INFLUX,            // same order as http_client_id_t
+    METRICS_HTTP_JSON_ENDPOINT_0,
+    METRICS_HTTP_JSON_ENDPOINT_1,
+    METRICS_HTTP_COUNT,
+} metrics_http_id_t;
+
+#define METRICS_POST_ENDPOINT_COUNT (2)     // HTTP_JSON_ENDPOINT_COUNT
+
+typedef struct {
+    char name[METRICS_TASK_NAME_SIZE];
+    uint32_t number;                // FreeRTOS task number, identifies the task across snapshots
+    uint32_t run_time;              // run time counter, wraps
+    uint32_t cpu_permille;          // of one core, since the previous snapshot
+    uint32_t stack_free;            // bytes, lowest since the task was started
+} metrics_task_t;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t high_water;
+    uint32_t overflows;
+} metrics_buffer_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t failures;
+    uint32_t latency_avg_us;        // of the requests since the previous snapshot, 0 if there were none
+    uint32_t latency_max_us;        // since boot
+} metrics_http_t;
+
+typedef struct {
+    uint32_t delivered;
+    uint32_t failed;
+    uint32_t dropped;
+    uint32_t queue_level;
+    uint32_t outbox_level;
+} metrics_post_t;
+
+typedef struct {
+    int32_t rssi;                   // 0 while not connected
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t fast_connects;         // with the cached ap, see wifi.h
+    uint32_t fast_connect_failures;
+    uint32_t boot_to_network_ms;
+    uint32_t last_outage_ms;        // from losing the ap until the next ip
+    uint32_t max_outage_ms;
+} metrics_wifi_t;
+
+typedef struct {
+    uint32_t sequence;              // increments with every snapshot, 0 = no snapshot yet
+    int64_t timestamp;              // µs since boot
+    uint32_t run_time;              // total run time counter, same clock as the ones of the tasks
+
+    size_t task_count;
+    metrics_task_t tasks[METRICS_MAX_TASKS];
+
+    uint32_t heap_free;
+    uint32_t heap_min_free;
+    uint32_t heap_largest_block;
+
+    metrics_buffer_t buffers[METRICS_BUFFER_COUNT];
+
+    uint32_t events_dropped;        // event pool exhausted
+    uint32_t event_messages_dropped;
+    uint32_t event_buffer_min_free; // bytes
+    uint32_t log_dropped;
+
+    metrics_http_t http[METRICS_HTTP_COUNT];
+    metrics_post_t post[METRICS_POST_ENDPOINT_COUNT];
+    metrics_wifi_t wifi;
+} metrics_snapshot_t;
+
+// Fills in cpu_permille of all tasks. previous may be NULL for the first snapshot, the usage since boot is reported then.
+void metrics_update_cpu(metrics_snapshot_t *snapshot, const metrics_snapshot_t *previous);
+
+// Share of the free heap which can't be allocated in one piece, in permille.
+uint32_t metrics_heap_fragmentation(const metrics_snapshot_t *snapshot);
+
+typedef void (*metrics_field_visitor_t)(void *context, const char *name, int64_t value);
+
+// Calls visit for every value of the device (not the tasks), in a fixed order.
+void metrics_for_each_field(const metrics_snapshot_t *snapshot, metrics_field_visitor_t visit, void *context);
+
+// Influx line protocol. Returns the length written (without the terminating zero) or 0 if it does not fit.
+size_t metrics_write_line_protocol(const metrics_snapshot_t *snapshot, const char *scale_id, uint64_t timestamp_ns,
+    char *buffer, size_t buffer_size);
@@ -0,0 +1,265 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "mqtt_packet.h"
+
+#include <string.h>
+#include <assert.h>
+
+static size_t remaining_length_size(size_t remaining)
+{
+    if (remaining < 128) return 1;
+    if (remaining < 16384) return 2;
+    if (remaining < 2097152) return 3;
+    return 4;
+}
+
+size_t mqtt_packet_publish_size(size_t topic_length, size_t payload_length, uint8_t qos)
+{
+    const size_t remaining = 2 + topic_length + (qos > 0 ? 2 : 0) + payload_length;
+    return 1 + remaining_length_size(remaining) + remaining;
+}
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t length;
+    bool overflow;
+} writer_t;
+
+static void put_byte(writer_t *writer, uint8_t value)
+{
+    if (writer->length >= writer->size) {
+        writer->overflow = true;
+        return;
+    }
+    writer->data[writer->length++] = value;
+}
+
+static void put_u16(writer_t *writer, uint16_t value)
+{
+    put_byte(writer, value >> 8);
+    put_byte(writer, value & 0xFF);
+}
+
+static void put_bytes(writer_t *writer, const void *data, size_t length)
+{
+    if (length > writer->size - writer->length) {
+        writer->overflow = true;
+        return;
+    }
+    memcpy(writer->data + writer->length, data, length);
+    writer->length += length;
+}
+
+static void put_string(writer_t *writer, const char *value, size_t length)
+{
+    put_u16(writer, (uint16_t)length);
+    put_bytes(writer, value, length);
+}
+
+static void put_fixed_header(writer_t *writer, uint8_t type, uint8_t flags, size_t remaining)
+{
+    assert(remaining <= MQTT_PACKET_MAX_REMAINING);
+
+    put_byte(writer, (uint8_t)(type << 4 | flags));
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        if (remaining > 0)
+            digit |= 0x80;
+        put_byte(writer, digit);
+    } while (remaining > 0);
+}
+
+static size_t finish(const writer_t *writer)
+{
+    return writer->overflow ? 0 : writer->length;
+}
+
+size_t mqtt_packet_encode_connect(uint8_t *data, size_t size, const char *client_id, uint16_t keep_alive_s, bool clean_session)
+{
+    assert(data);
+    assert(client_id);
+
+    const size_t client_id_length = strlen(client_id);
+    writer_t writer = { .data = data, .size = size };
+
+    put_fixed_header(&writer, MQTT_PACKET_CONNECT, 0, 10 + 2 + client_id_length);
+    put_string(&writer, "MQTT", 4);
+    put_byte(&writer, 4);                               // protocol level 3.1.1
+    put_byte(&writer, clean_session ? 0x02 : 0x00);     // connect flags
+    put_u16(&writer, keep_alive_s);
+    put_string(&writer, client_id, client_id_length);
+
+    return finish(&writer);
+}
+
+size_t mqtt_packet_encode_subscribe(uint8_t *data, size_t size, uint16_t packet_id, const char *topic_filter, uint8_t qos)
+{
+    assert(data);
+    assert(topic_filter);
+    assert(packet_id != 0);
+    assert(qos <= 2);
+
+    const size_t topic_length = strlen(topic_filter);
+    writer_t writer = { .data = data, .size = size };
+
+    put_fixed_header(&writer, MQTT_PACKET_SUBSCRIBE, 0x02, 2 + 2 + topic_length + 1);
+    put_u16(&writer, packet_id);
+    put_string(&writer, topic_filter, topic_length);
+    put_byte(&writer, qos);
+
+    return finish(&writer);
+}
+
+size_t mqtt_packet_encode_publish(uint8_t *data, size_t size, const mqtt_publish_t *publish)
+{
+    assert(data);
+    assert(publish);
+    assert(publish->qos <= 2);
+    assert(publish->qos == 0 || publish->packet_id != 0);
+
+    writer_t writer = { .data = data, .size = size };
+
+    put_fixed_header(&writer, MQTT_PACKET_PUBLISH, (publish->dup ? 0x08 : 0x00) | publish->qos << 1,
+        2 + publish->topic_length + (publish->qos > 0 ? 2 : 0) + publish->payload_length);
+    put_string(&writer, publish->topic, publish->topic_length);
+    if (publish->qos > 0)
+        put_u16(&writer, publish->packet_id);
+    put_bytes(&writer, publish->payload, publish->payload_length);
+
+    return finish(&writer);
+}
+
+size_t mqtt_packet_encode_puback(uint8_t *data, size_t size, uint16_t packet_id)
+{
+    assert(data);
+
+    writer_t writer = { .data = data, .size = size };
+    put_fixed_header(&writer, MQTT_PACKET_PUBACK, 0, 2);
+    put_u16(&writer, packet_id);
+
+    return finish(&writer);
+}
+
+size_t mqtt_packet_encode_pingreq(uint8_t *data, size_t size)
+{
+    assert(data);
+
+    writer_t writer = { .data = data, .size = size };
+    put_fixed_header(&writer, MQTT_PACKET_PINGREQ, 0, 0);
+
+    return finish(&writer);
+}
+
+int mqtt_packet_parse(const uint8_t *data, size_t length, mqtt_packet_t *packet)
+{
+    assert(data);
+    assert(packet);
+
+    if (length < 2)
+        return 0;
+
+    size_t remaining = 0;
+    size_t multiplier = 1;
+    size_t position = 1;
+    while (true)
+    {
+        if (position > 4)
+            return -1; // at most 4 bytes of remaining length
+        if (position >= length)
+            return 0;
+
+        const uint8_t digit = data[position++];
+        remaining += (digit & 0x7F) * multiplier;
+        multiplier *= 128;
+
+        if (!(digit & 0x80))
+            break;
+    }
+
+    if (length - position < remaining)
+        return 0;
+
+    packet->type = data[0] >> 4;
+    packet->flags = data[0] & 0x0F;
+    packet->body = data + position;
+    packet->length = remaining;
+
+    return (int)(position + remaining);
+}
+
+static bool get_u16(const mqtt_packet_t *packet, size_t *position, uint16_t *value)
+{
+    if (packet->length - *position < 2)
+        return false;
+    *value = (uint16_t)(packet->body[*position] << 8 | packet->body[*position + 1]);
+    *position += 2;
+    return true;
+}
+
+bool mqtt_packet_parse_publish(const mqtt_packet_t *packet, mqtt_publish_t *publish)
+{
+    assert(packet);
+    assert(publish);
+
+    if (packet->type != MQTT_PACKET_PUBLISH)
+        return false;
+
+    memset(publish, 0, sizeof(mqtt_publish_t));
+    publish->qos = (packet->flags >> 1) & 0x03;
+    publish->dup = packet->flags & 0x08;
+    if (publish->qos > 2)
+        return false;
+
+    size_t position = 0;
+    uint16_t topic_length = 0;
+    if (!get_u16(packet, &position, &topic_length) || packet->length - position < topic_length)
+        return false;
+    publish->topic = (const char *)packet->body + position;
+    publish->topic_length = topic_length;
+    position += topic_length;
+
+    if (publish->qos > 0 && (!get_u16(packet, &position, &publish->packet_id) || publish->packet_id == 0))
+        return false;
+
+    publish->payload = packet->body + position;
+    publish->payload_length = packet->length - position;
+
+    return true;
+}
+
+bool mqtt_packet_parse_connack(const mqtt_packet_t *packet, uint8_t *return_code)
+{
+    assert(packet);
+    assert(return_code);
+
+    if (packet->type != MQTT_PACKET_CONNACK || packet->length != 2)
+        return false;
+
+    *return_code = packet->body[1];
+    return true;
+}
+
+bool mqtt_packet_parse_suback(const mqtt_packet_t *packet, uint16_t *packet_id, uint8_t *granted_qos)
+{
+    assert(packet);
+    assert(packet_id);
+    assert(granted_qos);
+
+    size_t position = 0;
+    if (packet->type != MQTT_PACKET_SUBACK || !get_u16(packet, &position, packet_id) || packet->length != 3)
+        return false;
+
+    *granted_qos = packet->body[position];
+    return true;
+}
+
+bool mqtt_packet_parse_puback(const mqtt_packet_t *packet, uint16_t *packet_id)
+{
+    assert(packet);
+    assert(packet_id);
+
+    size_t position = 0;
+    return packet->type == MQTT_PACKET_PUBACK && packet->length == 2 && get_u16(packet, &position, packet_id);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// MQTT 3.1.1 packets, as far as the sensor data upload needs them: the device counts the bytes of its publishes
+// (the client of esp-idf does the rest), the bridge on the host (host/tools/mqtt_bridge.c) speaks the protocol itself.
+//
+// Fixed header: type (4 bits) and flags (4 bits), remaining length (1 to 4 bytes, 7 bits each, little end first).
+// Strings are a length (uint16, big endian) followed by the characters.
+
+#define MQTT_PACKET_MAX_HEADER_SIZE     (5)
+#define MQTT_PACKET_MAX_REMAINING       (268435455)
+
+typedef enum {
+    MQTT_PACKET_CONNECT     = 1,
+    MQTT_PACKET_CONNACK     = 2,
+    MQTT_PACKET_PUBLISH     = 3,
+    MQTT_PACKET_PUBACK      = 4,
+    MQTT_PACKET_SUBSCRIBE   = 8,
+    MQTT_PACKET_SUBACK      = 9,
+    MQTT_PACKET_PINGREQ     = 12,
+    MQTT_PACKET_PINGRESP    = 13,
+    MQTT_PACKET_DISCONNECT  = 14,
+} mqtt_packet_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    const uint8_t *body;        // the remaining length bytes after the fixed header
+    size_t length;
+} mqtt_packet_t;
+
+typedef struct {
+    const char *topic;          // not terminated
+    size_t topic_length;
+    uint8_t qos;
+    bool dup;
+    uint16_t packet_id;         // 0 for qos 0
+    const uint8_t *payload;
+    size_t payload_length;
+} mqtt_publish_t;
+
+// Bytes of a publish on the wire, fixed header included.
+size_t mqtt_packet_publish_size(size_t topic_length, size_t payload_length, uint8_t qos);
+
+// The encoders return the length of the packet, 0 if it doesn't fit into size.
+size_t mqtt_packet_encode_connect(uint8_t *data, size_t size, const char *client_id, uint16_t keep_alive_s, bool clean_session);
+size_t mqtt_packet_encode_subscribe(uint8_t *data, size_t size, uint16_t packet_id, const char *topic_filter, uint8_t qos);
+size_t mqtt_packet_encode_publish(uint8_t *data, size_t size, const mqtt_publish_t *publish);
+size_t mqtt_packet_encode_puback(uint8_t *data, size_t size, uint16_t packet_id);
+size_t mqtt_packet_encode_pingreq(uint8_t *data, size_t size);
+
+// Returns the length of the packet at the start of data, 0 if it isn't complete yet and -1 if it is malformed.
+int mqtt_packet_parse(const uint8_t *data, size_t length, mqtt_packet_t *packet);
+
+bool mqtt_packet_parse_publish(const mqtt_packet_t *packet, mqtt_publish_t *publish);
+// CONNACK: return code, SUBACK: granted qos (0x80 is a failure), PUBACK: packet id.
+bool mqtt_packet_parse_connack(const mqtt_packet_t *packet, uint8_t *return_code);
+bool mqtt_packet_parse_suback(const mqtt_packet_t *packet, uint16_t *packet_id, uint8_t *granted_qos);
+bool mqtt_packet_parse_puback(const mqtt_packet_t *packet, uint16_t *packet_id);
@@ -0,0 +1,247 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "mqtt_upload.h"
+#include "mqtt_packet.h"
+#include "radio.h"
+
+#include "sdkconfig.h"
+
+#if CONFIG_CATSCALE_MQTT
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include <esp_system.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <mqtt_client.h>
+
+static const char *TAG = "mqtt_upload";
+
+#define MQTT_KEEP_ALIVE_S           (30)
+#define MQTT_TRACKED_MESSAGES       (32)    // for the latency, messages beyond are not measured
+
+typedef struct {
+    int msg_id;                 // 0: unused
+    int64_t queued_at;          // µs since boot
+} tracked_message_t;
+
+static esp_mqtt_client_handle_t g_client = NULL;
+static volatile bool g_connected = false;
+
+static portMUX_TYPE g_stats_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static mqtt_upload_stats_t g_stats = {};
+static tracked_message_t g_tracked[MQTT_TRACKED_MESSAGES] = {};    // under g_stats_spinlock
+
+// The messages are sent by the task of the mqtt client after mqtt_upload_publish_lines returned,
+// the radio is held until the broker acknowledged all of them.
+static SemaphoreHandle_t g_radio_mutex = NULL;
+static bool g_radio_held = false;                                   // under g_radio_mutex
+
+static void update_radio(void)
+{
+    xSemaphoreTake(g_radio_mutex, portMAX_DELAY);
+
+    // Not while disconnected, the client only retransmits after it reconnected.
+    const bool needed = g_connected && esp_mqtt_client_get_outbox_size(g_client) > 0;
+    if (needed && !g_radio_held)
+        radio_acquire();
+    else if (!needed && g_radio_held)
+        radio_release();
+    g_radio_held = needed;
+
+    xSemaphoreGive(g_radio_mutex);
+}
+
+static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    const esp_mqtt_event_handle_t event = event_data;
+
+    switch ((esp_mqtt_event_id_t)event_id)
+    {
+        case MQTT_EVENT_CONNECTED:
+            ESP_LOGI(TAG, "connected to %s", CONFIG_CATSCALE_MQTT_BROKER_URI);
+            g_connected = true;
+            taskENTER_CRITICAL(&g_stats_spinlock);
+            g_stats.connects++;
+            taskEXIT_CRITICAL(&g_stats_spinlock);
+            update_radio();
+            break;
+
+        case MQTT_EVENT_DISCONNECTED:
+            ESP_LOGW(TAG, "disconnected");
+            g_connected = false;
+            taskENTER_CRITICAL(&g_stats_spinlock);
+            g_stats.disconnects++;
+            taskEXIT_CRITICAL(&g_stats_spinlock);
+            update_radio();
+            break;
+
+        case MQTT_EVENT_PUBLISHED:
+        {
+            const int64_t now = esp_timer_get_time();
+
+            taskENTER_CRITICAL(&g_stats_spinlock);
+            g_stats.acked++;
+            for (size_t i = 0; i < MQTT_TRACKED_MESSAGES; i++)
+            {
+                if (g_tracked[i].msg_id != event->msg_id)
+                    continue;
+
+                const uint32_t latency_us = (uint32_t)(now - g_tracked[i].queued_at);
+                g_stats.last_latency_us = latency_us;
+                if (latency_us > g_stats.max_latency_us)
+                    g_stats.max_latency_us = latency_us;
+                g_stats.total_latency_us += latency_us;
+                g_stats.latency_count++;
+                g_tracked[i].msg_id = 0;
+                break;
+            }
+            taskEXIT_CRITICAL(&g_stats_spinlock);
+
+            // The message is already out of the outbox.
+            update_radio();
+            break;
+        }
+
+        case MQTT_EVENT_ERROR:
+            ESP_LOGE(TAG, "error (type %d)", event->error_handle ? (int)event->error_handle->error_type : -1);
+            break;
+
+        default:
+            break;
+    }
+}
+
+esp_err_t mqtt_upload_init(void)
+{
+    ESP_LOGI(TAG, "mqtt_upload_init");
+
+    g_radio_mutex = xSemaphoreCreateMutex();
+    assert(g_radio_mutex);
+
+    const esp_mqtt_client_config_t config = {
+        .broker.address.uri = CONFIG_CATSCALE_MQTT_BROKER_URI,
+        .session.keepalive = MQTT_KEEP_ALIVE_S,
+        .outbox.limit = CONFIG_CATSCALE_MQTT_OUTBOX_SIZE,
+    };
+
+    g_client = esp_mqtt_client_init(&config);
+    if (!g_client)
+        return ESP_FAIL;
+
+    esp_err_t err = esp_mqtt_client_register_event(g_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    if (err != ESP_OK)
+        return err;
+
+    // Connects in the background and reconnects by itself.
+    return esp_mqtt_client_start(g_client);
+}
+
+bool mqtt_upload_is_ready(void)
+{
+    if (!g_client || !g_connected)
+        return false;
+
+    return esp_mqtt_client_get_outbox_size(g_client) < CONFIG_CATSCALE_MQTT_OUTBOX_SIZE / 2;
+}
+
+static esp_err_t publish(const char *payload, size_t length, uint32_t line_count)
+{
+    const size_t topic_length = strlen(CONFIG_CATSCALE_MQTT_TOPIC);
+
+    // Stored in the outbox and sent by the task of the mqtt client, retransmitted until the broker acknowledged it.
+    const int msg_id = esp_mqtt_client_enqueue(g_client, CONFIG_CATSCALE_MQTT_TOPIC, payload, (int)length, 1, 0, true);
+    const int64_t queued_at = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    if (msg_id < 0)
+    {
+        g_stats.dropped++;
+    }
+    else
+    {
+        g_stats.messages++;
+        g_stats.lines += line_count;
+        g_stats.payload_bytes += length;
+        g_stats.wire_bytes += mqtt_packet_publish_size(topic_length, length, 1);
+
+        for (size_t i = 0; i < MQTT_TRACKED_MESSAGES; i++)
+        {
+            if (g_tracked[i].msg_id == 0)
+            {
+                g_tracked[i] = (tracked_message_t){ .msg_id = msg_id, .queued_at = queued_at };
+                break;
+            }
+        }
+    }
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+
+    if (msg_id < 0)
+    {
+        ESP_LOGE(TAG, "outbox full, %"PRIu32" lines dropped", line_count);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t mqtt_upload_publish_lines(const char *lines, size_t length)
+{
+    assert(lines);
+    assert(g_client);
+
+    const int64_t start_time = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+
+    size_t message_start = 0;
+    uint32_t line_count = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (lines[i] != '\n')
+            continue;
+
+        if (++line_count == CONFIG_CATSCALE_MQTT_BATCH_SIZE || i + 1 == length)
+        {
+            const esp_err_t err = publish(lines + message_start, i + 1 - message_start, line_count);
+            if (err != ESP_OK)
+                ret = err;
+
+            message_start = i + 1;
+            line_count = 0;
+        }
+    }
+
+    // Messages which were never acknowledged (lost connection, deleted from the outbox) would block the slots forever.
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    for (size_t i = 0; i < MQTT_TRACKED_MESSAGES; i++)
+        if (g_tracked[i].msg_id != 0 && start_time - g_tracked[i].queued_at > 60 * 1000 * 1000)
+            g_tracked[i].msg_id = 0;
+    g_stats.publish_time_us += esp_timer_get_time() - start_time;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+
+    // Also releases the radio if messages left the outbox without being acknowledged (expired).
+    update_radio();
+
+    return ret;
+}
+
+void mqtt_upload_get_stats(mqtt_upload_stats_t *stats)
+{
+    assert(stats);
+
+    const int outbox_bytes = g_client ? esp_mqtt_client_get_outbox_size(g_client) : 0;
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    *stats = g_stats;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+
+    stats->outbox_bytes = outbox_bytes > 0 ? (uint32_t)outbox_bytes : 0;
+}
+
+#endif // CONFIG_CATSCALE_MQTT
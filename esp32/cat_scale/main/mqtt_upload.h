@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+// Upload of the sensor data over mqtt (CONFIG_CATSCALE_MQTT) instead of http posts to influx.
+// One persistent connection to the broker, the influx line protocol is published in messages of
+// CONFIG_CATSCALE_MQTT_BATCH_SIZE lines with qos 1. host/tools/mqtt_bridge.c forwards them into influx.
+
+typedef struct {
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t messages;          // queued for publishing
+    uint32_t acked;             // PUBACK received
+    uint32_t dropped;           // outbox full, the lines are lost
+    uint32_t lines;
+    uint64_t payload_bytes;
+    uint64_t wire_bytes;        // publish packets including the mqtt headers, without retransmissions
+    uint32_t last_latency_us;   // queued until acknowledged
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;  // of the acked messages which were tracked
+    uint32_t latency_count;
+    uint64_t publish_time_us;   // spent in mqtt_upload_publish_lines
+    uint32_t outbox_bytes;      // not acknowledged yet
+} mqtt_upload_stats_t;
+
+esp_err_t mqtt_upload_init(void);
+
+// False while the broker is not connected or too much is waiting for acknowledgement,
+// the samples stay in the sensor buffers until then.
+bool mqtt_upload_is_ready(void);
+
+// lines: '\n' terminated lines of influx line protocol. Queues the messages and returns right away.
+// Keeps the radio awake (radio_acquire) until the broker acknowledged everything that was queued.
+esp_err_t mqtt_upload_publish_lines(const char *lines, size_t length);
+
+void mqtt_upload_get_stats(mqtt_upload_stats_t *stats);
@@ -0,0 +1,325 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "ota.h"
+
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#include <esp_system.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+
+#include <mbedtls/sha256.h>
+
+static const char *TAG = "ota";
+
+#define OTA_BUFFER_SIZE             (CONFIG_CATSCALE_OTA_BUFFER_SIZE)
+#define OTA_PROGRESS_INTERVAL_US    (2 * 1000 * 1000)
+
+// Passed through the queues. A buffer without data tells the ota task that the update is over.
+typedef struct {
+    uint8_t *data;
+    size_t length;
+} ota_buffer_t;
+
+typedef struct {
+    bool active;
+    esp_ota_handle_t handle;
+    const esp_partition_t *partition;
+    esp_err_t write_error;          // first error of the ota task, sticky
+    mbedtls_sha256_context sha256;
+    uint8_t *buffers[OTA_BUFFER_COUNT];
+    int64_t start_time;             // esp_timer
+    int64_t last_progress_time;
+    ota_progress_t progress;
+} ota_state_t;
+
+static ota_state_t ota_state = {};
+
+static QueueHandle_t ota_free_queue = NULL;      // empty buffers, to the receiver
+static QueueHandle_t ota_write_queue = NULL;     // filled buffers, to the ota task
+static SemaphoreHandle_t ota_done_semaphore = NULL;
+
+static void ota_write_task(void*);
+
+esp_err_t ota_init(void)
+{
+    ESP_LOGI(TAG, "ota_init");
+
+    ota_free_queue = xQueueCreate(OTA_BUFFER_COUNT, sizeof(ota_buffer_t));
+    ota_write_queue = xQueueCreate(OTA_BUFFER_COUNT + 1, sizeof(ota_buffer_t));
+    ota_done_semaphore = xSemaphoreCreateBinary();
+    assert(ota_free_queue);
+    assert(ota_write_queue);
+    assert(ota_done_semaphore);
+
+    // Higher priority than the receiving task, so flash writes start as soon as a buffer is full.
+    xTaskCreate(ota_write_task, "ota_write_task", 4 * 1024, NULL, tskIDLE_PRIORITY + 2, NULL);
+
+    return ESP_OK;
+}
+
+static void free_buffers(void)
+{
+    for (size_t i = 0; i < OTA_BUFFER_COUNT; i++)
+    {
+        free(ota_state.buffers[i]);
+        ota_state.buffers[i] = NULL;
+    }
+}
+
+esp_err_t ota_begin(uint32_t image_size)
+{
+    assert(!ota_state.active);
+
+    ota_state.partition = esp_ota_get_next_update_partition(NULL);
+    if (!ota_state.partition)
+    {
+        ESP_LOGE(TAG, "esp_ota_get_next_update_partition failed");
+        return ESP_FAIL;
+    }
+
+    if (image_size > ota_state.partition->size)
+    {
+        ESP_LOGE(TAG, "Image too large (%"PRIu32" bytes, partition has %"PRIu32")", image_size, ota_state.partition->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (size_t i = 0; i < OTA_BUFFER_COUNT; i++)
+    {
+        ota_state.buffers[i] = malloc(OTA_BUFFER_SIZE);
+        if (!ota_state.buffers[i])
+        {
+            ESP_LOGE(TAG, "Failed to allocate ota buffers");
+            free_buffers();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    ESP_LOGI(TAG, "OTA update partition: subtype %d at offset 0x%"PRIx32, ota_state.partition->subtype, ota_state.partition->address);
+
+    // Sectors are erased while writing, the erase is part of the pipeline as well.
+    esp_err_t err = esp_ota_begin(ota_state.partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_state.handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(err));
+        free_buffers();
+        return err;
+    }
+
+    xQueueReset(ota_free_queue);
+    xQueueReset(ota_write_queue);
+    for (size_t i = 0; i < OTA_BUFFER_COUNT; i++)
+    {
+        const ota_buffer_t buffer = { .data = ota_state.buffers[i], .length = 0 };
+        xQueueSend(ota_free_queue, &buffer, 0);
+    }
+
+    mbedtls_sha256_init(&ota_state.sha256);
+    mbedtls_sha256_starts(&ota_state.sha256, 0);
+
+    memset(&ota_state.progress, 0, sizeof(ota_progress_t));
+    ota_state.progress.image_size = image_size;
+    ota_state.write_error = ESP_OK;
+    ota_state.start_time = esp_timer_get_time();
+    ota_state.last_progress_time = ota_state.start_time;
+    ota_state.active = true;
+
+    ESP_LOGI(TAG, "Starting OTA (%"PRIu32" bytes, %d x %d bytes buffers) ...", image_size, OTA_BUFFER_COUNT, OTA_BUFFER_SIZE);
+
+    return ESP_OK;
+}
+
+uint8_t *ota_get_buffer(void)
+{
+    assert(ota_state.active);
+
+    const int64_t t0 = esp_timer_get_time();
+    ota_buffer_t buffer = {};
+    xQueueReceive(ota_free_queue, &buffer, portMAX_DELAY);
+    ota_state.progress.receive_wait_us += esp_timer_get_time() - t0;
+
+    return buffer.data;
+}
+
+esp_err_t ota_submit_buffer(uint8_t *buffer, size_t length)
+{
+    assert(ota_state.active);
+    assert(buffer);
+    assert(length > 0 && length <= OTA_BUFFER_SIZE);
+
+    // Hashing here overlaps with the flash write of the previous buffer.
+    mbedtls_sha256_update(&ota_state.sha256, buffer, length);
+    ota_state.progress.bytes_received += length;
+
+    const ota_buffer_t item = { .data = buffer, .length = length };
+    xQueueSend(ota_write_queue, &item, portMAX_DELAY);
+
+    return ota_state.write_error;
+}
+
+// Waits until the ota task processed all buffers.
+static void drain(void)
+{
+    const ota_buffer_t end = { .data = NULL, .length = 0 };
+    xQueueSend(ota_write_queue, &end, portMAX_DELAY);
+    xSemaphoreTake(ota_done_semaphore, portMAX_DELAY);
+
+    ota_state.progress.duration_us = esp_timer_get_time() - ota_state.start_time;
+}
+
+static void log_summary(void)
+{
+    const ota_progress_t * const p = &ota_state.progress;
+    const int64_t duration_ms = p->duration_us / 1000;
+
+    ESP_LOGI(TAG, "%"PRIu32" bytes in %lld ms (%lld KiB/s): flash write %lld ms, receiver waited %lld ms for flash, writer waited %lld ms for network",
+        p->bytes_written, duration_ms,
+        duration_ms > 0 ? (int64_t)p->bytes_written * 1000 / 1024 / duration_ms : 0,
+        p->write_time_us / 1000, p->receive_wait_us / 1000, p->write_wait_us / 1000);
+}
+
+esp_err_t ota_end(const uint8_t *expected_sha256, uint8_t sha256[OTA_SHA256_SIZE])
+{
+    assert(ota_state.active);
+    assert(sha256);
+
+    drain();
+    ota_state.active = false;
+
+    mbedtls_sha256_finish(&ota_state.sha256, sha256);
+    mbedtls_sha256_free(&ota_state.sha256);
+    free_buffers();
+    log_summary();
+
+    esp_err_t err = ota_state.write_error;
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Aborting OTA, write failed: %s", esp_err_to_name(err));
+        esp_ota_abort(ota_state.handle);
+        return err;
+    }
+
+    if (ota_state.progress.image_size && ota_state.progress.bytes_received != ota_state.progress.image_size)
+    {
+        ESP_LOGE(TAG, "Aborting OTA, received %"PRIu32" of %"PRIu32" bytes",
+            ota_state.progress.bytes_received, ota_state.progress.image_size);
+        esp_ota_abort(ota_state.handle);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (expected_sha256 && memcmp(expected_sha256, sha256, OTA_SHA256_SIZE) != 0)
+    {
+        ESP_LOGE(TAG, "Aborting OTA, SHA-256 mismatch");
+        esp_ota_abort(ota_state.handle);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    // Validates the image as well.
+    err = esp_ota_end(ota_state.handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_ota_end failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = esp_ota_set_boot_partition(ota_state.partition);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_ota_set_boot_partition failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    return ESP_OK;
+}
+
+void ota_abort(void)
+{
+    assert(ota_state.active);
+
+    ESP_LOGE(TAG, "Aborting OTA ...");
+
+    drain();
+    ota_state.active = false;
+
+    mbedtls_sha256_free(&ota_state.sha256);
+    free_buffers();
+    esp_ota_abort(ota_state.handle);
+}
+
+void ota_get_progress(ota_progress_t *progress)
+{
+    assert(progress);
+    memcpy(progress, &ota_state.progress, sizeof(ota_progress_t));
+}
+
+static void log_progress(void)
+{
+    const ota_progress_t * const p = &ota_state.progress;
+    const int64_t elapsed_ms = (esp_timer_get_time() - ota_state.start_time) / 1000;
+    const int64_t rate = elapsed_ms > 0 ? (int64_t)p->bytes_written * 1000 / 1024 / elapsed_ms : 0;
+
+    if (p->image_size)
+        ESP_LOGI(TAG, "%"PRIu32" / %"PRIu32" KiB (%d%%), %lld KiB/s",
+            p->bytes_written / 1024, p->image_size / 1024, (int)((uint64_t)p->bytes_written * 100 / p->image_size), rate);
+    else
+        ESP_LOGI(TAG, "%"PRIu32" KiB, %lld KiB/s", p->bytes_written / 1024, rate);
+}
+
+static void ota_write_task(void*)
+{
+    ESP_LOGI(TAG, "ota_write_task");
+
+    while (true)
+    {
+        const int64_t t0 = esp_timer_get_time();
+        ota_buffer_t buffer = {};
+        xQueueReceive(ota_write_queue, &buffer, portMAX_DELAY);
+        const int64_t t1 = esp_timer_get_time();
+
+        if (!buffer.data)
+        {
+            xSemaphoreGive(ota_done_semaphore);
+            continue;
+        }
+
+        // The wait for the first buffer of an update is not counted.
+        if (ota_state.progress.bytes_written > 0)
+            ota_state.progress.write_wait_us += t1 - t0;
+
+        // After an error the remaining data is only consumed, the receiver aborts.
+        if (ota_state.write_error == ESP_OK)
+        {
+            const esp_err_t err = esp_ota_write(ota_state.handle, buffer.data, buffer.length);
+            if (err == ESP_OK)
+            {
+                ota_state.progress.bytes_written += buffer.length;
+            }
+            else
+            {
+                ESP_LOGE(TAG, "esp_ota_write failed: %s (written %"PRIu32")", esp_err_to_name(err), ota_state.progress.bytes_written);
+                ota_state.write_error = err;
+            }
+        }
+        ota_state.progress.write_time_us += esp_timer_get_time() - t1;
+
+        buffer.length = 0;
+        xQueueSend(ota_free_queue, &buffer, portMAX_DELAY);
+
+        if (t1 - ota_state.last_progress_time >= OTA_PROGRESS_INTERVAL_US)
+        {
+            ota_state.last_progress_time = t1;
+            log_progress();
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+// Pipelined over-the-air update: the receiving task fills one buffer while the ota task writes
+// the previous one to flash. The image is hashed (SHA-256) while it is received.
+//
+//   ota_begin()
+//   while (data) { buffer = ota_get_buffer(); <fill buffer>; ota_submit_buffer(buffer, length); }
+//   ota_end() or ota_abort()
+
+#define OTA_SHA256_SIZE     (32)
+#define OTA_BUFFER_COUNT    (2)
+
+typedef struct {
+    uint32_t image_size;            // 0 if unknown
+    uint32_t bytes_received;
+    uint32_t bytes_written;
+    int64_t duration_us;
+    int64_t receive_wait_us;        // receiver waiting for a free buffer: flash is the bottleneck
+    int64_t write_wait_us;          // ota task waiting for data: the network is the bottleneck
+    int64_t write_time_us;          // in esp_ota_write (erase and write)
+} ota_progress_t;
+
+esp_err_t ota_init(void);
+
+// Prepares the next update partition. An image larger than the partition is rejected, ota_end fails if
+// a different number of bytes was received. image_size is also used for the progress, 0 if unknown (no checks).
+esp_err_t ota_begin(uint32_t image_size);
+
+// Returns an empty buffer of CONFIG_CATSCALE_OTA_BUFFER_SIZE bytes, waits until the ota task is done with one.
+uint8_t *ota_get_buffer(void);
+
+// Hashes the data and hands the buffer over to the ota task.
+// Returns the first write error of the ota task, the update should be aborted then.
+esp_err_t ota_submit_buffer(uint8_t *buffer, size_t length);
+
+// Waits until everything is written and checks the image. expected_sha256 may be NULL.
+// The SHA-256 of the received image is returned in sha256. Activates the new image on success.
+esp_err_t ota_end(const uint8_t *expected_sha256, uint8_t sha256[OTA_SHA256_SIZE]);
+
+void ota_abort(void);
+
+void ota_get_progress(ota_progress_t *progress);
@@ -0,0 +1,178 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "ota_patch.h"
+
+#include <string.h>
+#include <assert.h>
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void ota_patch_init(ota_patch_t *patch, ota_patch_read_t read, ota_patch_write_t write,
+    ota_patch_check_base_t check_base, void *context)
+{
+    assert(patch);
+    assert(read);
+    assert(write);
+    assert(check_base);
+
+    memset(patch, 0, sizeof(ota_patch_t));
+    patch->read = read;
+    patch->write = write;
+    patch->check_base = check_base;
+    patch->context = context;
+    patch->stage = OTA_PATCH_STAGE_HEADER;
+}
+
+// Collects a header or record which may be split across several calls. Returns the number of bytes used.
+static size_t collect(ota_patch_t *patch, size_t size, const uint8_t *data, size_t length)
+{
+    size_t n = size - patch->header_length;
+    if (n > length)
+        n = length;
+
+    memcpy(patch->header + patch->header_length, data, n);
+    patch->header_length += n;
+    return n;
+}
+
+static esp_err_t parse_header(ota_patch_t *patch)
+{
+    const uint8_t * const h = patch->header;
+
+    if (memcmp(h, OTA_PATCH_MAGIC, 4) != 0 || get_u32(h + 4) != OTA_PATCH_VERSION)
+        return ESP_ERR_INVALID_VERSION;
+
+    patch->old_size = get_u32(h + 8);
+    patch->new_size = get_u32(h + 12);
+
+    const esp_err_t err = patch->check_base(patch->context, patch->old_size, h + 16);
+    if (err != ESP_OK)
+        return err;
+
+    patch->stage = patch->new_size > 0 ? OTA_PATCH_STAGE_RECORD : OTA_PATCH_STAGE_DONE;
+    return ESP_OK;
+}
+
+static esp_err_t parse_record(ota_patch_t *patch)
+{
+    const uint8_t * const r = patch->header;
+    const uint32_t diff_length = get_u32(r);
+    const uint32_t extra_length = get_u32(r + 4);
+    const int32_t seek = (int32_t)get_u32(r + 8);
+
+    if ((uint64_t)patch->new_position + diff_length + extra_length > patch->new_size ||
+        (uint64_t)patch->old_position + diff_length > patch->old_size)
+        return ESP_ERR_INVALID_SIZE;
+
+    patch->remaining = diff_length;
+    patch->extra_length = extra_length;
+    patch->seek = seek;
+    patch->stage = OTA_PATCH_STAGE_DIFF;
+    return ESP_OK;
+}
+
+// After the extra bytes of a record.
+static esp_err_t end_record(ota_patch_t *patch)
+{
+    const int64_t old_position = (int64_t)patch->old_position + patch->seek;
+    if (old_position < 0 || old_position > patch->old_size)
+        return ESP_ERR_INVALID_SIZE;
+
+    patch->old_position = (uint32_t)old_position;
+    patch->stage = patch->new_position == patch->new_size ? OTA_PATCH_STAGE_DONE : OTA_PATCH_STAGE_RECORD;
+    return ESP_OK;
+}
+
+esp_err_t ota_patch_feed(ota_patch_t *patch, const uint8_t *data, size_t length)
+{
+    assert(patch);
+    assert(data || length == 0);
+
+    esp_err_t err = ESP_OK;
+
+    while (err == ESP_OK && (length > 0 || patch->stage == OTA_PATCH_STAGE_DIFF || patch->stage == OTA_PATCH_STAGE_EXTRA))
+    {
+        size_t used = 0;
+
+        switch (patch->stage)
+        {
+            case OTA_PATCH_STAGE_HEADER:
+                used = collect(patch, OTA_PATCH_HEADER_SIZE, data, length);
+                if (patch->header_length == OTA_PATCH_HEADER_SIZE)
+                {
+                    patch->header_length = 0;
+                    err = parse_header(patch);
+                }
+                break;
+
+            case OTA_PATCH_STAGE_RECORD:
+                used = collect(patch, OTA_PATCH_RECORD_SIZE, data, length);
+                if (patch->header_length == OTA_PATCH_RECORD_SIZE)
+                {
+                    patch->header_length = 0;
+                    err = parse_record(patch);
+                }
+                break;
+
+            case OTA_PATCH_STAGE_DIFF:
+                if (patch->remaining == 0)
+                {
+                    patch->remaining = patch->extra_length;
+                    patch->stage = OTA_PATCH_STAGE_EXTRA;
+                    break;
+                }
+                if (length == 0)
+                    return ESP_OK;
+
+                used = patch->remaining < length ? patch->remaining : length;
+                if (used > sizeof(patch->old_data))
+                    used = sizeof(patch->old_data);
+
+                err = patch->read(patch->context, patch->old_position, patch->old_data, used);
+                if (err != ESP_OK)
+                    break;
+                for (size_t i = 0; i < used; i++)
+                    patch->old_data[i] += data[i];
+                err = patch->write(patch->context, patch->old_data, used);
+
+                patch->old_position += used;
+                patch->new_position += used;
+                patch->remaining -= used;
+                break;
+
+            case OTA_PATCH_STAGE_EXTRA:
+                if (patch->remaining == 0)
+                {
+                    err = end_record(patch);
+                    break;
+                }
+                if (length == 0)
+                    return ESP_OK;
+
+                used = patch->remaining < length ? patch->remaining : length;
+                err = patch->write(patch->context, data, used);
+
+                patch->new_position += used;
+                patch->remaining -= used;
+                break;
+
+            case OTA_PATCH_STAGE_DONE:
+                // Trailing data.
+                return ESP_ERR_INVALID_SIZE;
+        }
+
+        data += used;
+        length -= used;
+    }
+
+    return err;
+}
+
+esp_err_t ota_patch_finish(const ota_patch_t *patch)
+{
+    assert(patch);
+    return patch->stage == OTA_PATCH_STAGE_DONE ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
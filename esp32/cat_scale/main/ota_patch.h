@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+// Binary delta updates (bsdiff style): the new image is built from the running one, the patch is applied
+// while it is received. Produced by host/tools/ota_delta.c.
+//
+// Patch layout (little endian):
+//   header: magic "CSDP", version (uint32), old size (uint32), new size (uint32), SHA-256 of the old image
+//   records until the new image is complete:
+//     diff length (uint32), extra length (uint32), seek (int32)
+//     diff bytes:  new = old + diff, byte by byte, old and new position advance
+//     extra bytes: new = extra, only the new position advances
+//     then the old position moves by seek
+
+#define OTA_PATCH_MAGIC         "CSDP"
+#define OTA_PATCH_VERSION       (1)
+#define OTA_PATCH_HEADER_SIZE   (48)
+#define OTA_PATCH_RECORD_SIZE   (12)
+#define OTA_PATCH_SHA256_SIZE   (32)
+
+// Reads from the old image.
+typedef esp_err_t (*ota_patch_read_t)(void *context, uint32_t offset, void *data, size_t length);
+// Appends to the new image.
+typedef esp_err_t (*ota_patch_write_t)(void *context, const void *data, size_t length);
+// Called once the header is received, the old image has to match before anything is written.
+typedef esp_err_t (*ota_patch_check_base_t)(void *context, uint32_t old_size, const uint8_t *old_sha256);
+
+typedef enum {
+    OTA_PATCH_STAGE_HEADER,
+    OTA_PATCH_STAGE_RECORD,
+    OTA_PATCH_STAGE_DIFF,
+    OTA_PATCH_STAGE_EXTRA,
+    OTA_PATCH_STAGE_DONE,
+} ota_patch_stage_t;
+
+typedef struct {
+    ota_patch_read_t read;
+    ota_patch_write_t write;
+    ota_patch_check_base_t check_base;
+    void *context;
+
+    ota_patch_stage_t stage;
+    uint8_t header[OTA_PATCH_HEADER_SIZE];  // header or record being received
+    size_t header_length;
+
+    uint32_t old_size;
+    uint32_t new_size;
+    uint32_t old_position;
+    uint32_t new_position;
+
+    uint32_t remaining;                     // of the current diff or extra bytes
+    uint32_t extra_length;
+    int32_t seek;
+
+    uint8_t old_data[256];
+} ota_patch_t;
+
+void ota_patch_init(ota_patch_t *patch, ota_patch_read_t read, ota_patch_write_t write,
+    ota_patch_check_base_t check_base, void *context);
+
+// Processes the next part of the patch, may be called with any length.
+esp_err_t ota_patch_feed(ota_patch_t *patch, const uint8_t *data, size_t length);
+
+// Returns ESP_ERR_INVALID_SIZE if the patch ended before the new image was complete.
+esp_err_t ota_patch_finish(const ota_patch_t *patch);
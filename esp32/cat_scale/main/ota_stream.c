@@ -0,0 +1,243 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "ota_stream.h"
+#include "ota.h"
+#include "ota_patch.h"
+
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <esp_system.h>
+#include <esp_log.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+
+#include <mbedtls/sha256.h>
+
+// The inflater of the rom, nothing to link.
+#include <esp32/rom/miniz.h>
+
+static const char *TAG = "ota_stream";
+
+typedef struct {
+    ota_encoding_t encoding;
+
+    tinfl_decompressor *inflator;
+    uint8_t *dictionary;            // TINFL_LZ_DICT_SIZE, the inflated data is taken from here
+    size_t dictionary_position;
+    tinfl_status inflate_status;
+
+    ota_patch_t patch;
+    const esp_partition_t *running;
+
+    uint8_t *buffer;                // ota buffer being filled
+    size_t buffer_length;
+} ota_stream_state_t;
+
+static ota_stream_state_t stream = {};
+
+static esp_err_t write_image(void *context, const void *data, size_t length)
+{
+    const uint8_t *p = data;
+
+    while (length > 0)
+    {
+        if (!stream.buffer)
+        {
+            stream.buffer = ota_get_buffer();
+            stream.buffer_length = 0;
+        }
+
+        size_t n = CONFIG_CATSCALE_OTA_BUFFER_SIZE - stream.buffer_length;
+        if (n > length)
+            n = length;
+
+        memcpy(stream.buffer + stream.buffer_length, p, n);
+        stream.buffer_length += n;
+        p += n;
+        length -= n;
+
+        if (stream.buffer_length == CONFIG_CATSCALE_OTA_BUFFER_SIZE)
+        {
+            uint8_t * const buffer = stream.buffer;
+            stream.buffer = NULL;
+
+            const esp_err_t err = ota_submit_buffer(buffer, CONFIG_CATSCALE_OTA_BUFFER_SIZE);
+            if (err != ESP_OK)
+                return err;
+        }
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t read_running_image(void *context, uint32_t offset, void *data, size_t length)
+{
+    return esp_partition_read(stream.running, offset, data, length);
+}
+
+// A delta only makes sense for the image it was made for.
+static esp_err_t check_running_image(void *context, uint32_t old_size, const uint8_t *old_sha256)
+{
+    if (old_size > stream.running->size)
+    {
+        ESP_LOGE(TAG, "Delta base larger than the running partition");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    mbedtls_sha256_context sha256;
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts(&sha256, 0);
+
+    uint8_t buffer[512];
+    esp_err_t err = ESP_OK;
+    for (uint32_t offset = 0; offset < old_size && err == ESP_OK; offset += sizeof(buffer))
+    {
+        const size_t n = old_size - offset < sizeof(buffer) ? old_size - offset : sizeof(buffer);
+        err = esp_partition_read(stream.running, offset, buffer, n);
+        if (err == ESP_OK)
+            mbedtls_sha256_update(&sha256, buffer, n);
+    }
+
+    uint8_t digest[OTA_PATCH_SHA256_SIZE];
+    mbedtls_sha256_finish(&sha256, digest);
+    mbedtls_sha256_free(&sha256);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to read the running image: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    if (memcmp(digest, old_sha256, sizeof(digest)) != 0)
+    {
+        ESP_LOGE(TAG, "Delta was not made for the running image (%"PRIu32" bytes)", old_size);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGI(TAG, "Applying delta to the running image (%"PRIu32" bytes)", old_size);
+    return ESP_OK;
+}
+
+static esp_err_t write_decoded(const uint8_t *data, size_t length)
+{
+    if (stream.encoding == OTA_ENCODING_DELTA)
+        return ota_patch_feed(&stream.patch, data, length);
+    return write_image(NULL, data, length);
+}
+
+static void free_resources(void)
+{
+    free(stream.inflator);
+    free(stream.dictionary);
+    stream.inflator = NULL;
+    stream.dictionary = NULL;
+}
+
+esp_err_t ota_stream_begin(ota_encoding_t encoding)
+{
+    assert(encoding == OTA_ENCODING_DEFLATE || encoding == OTA_ENCODING_DELTA);
+
+    memset(&stream, 0, sizeof(stream));
+    stream.encoding = encoding;
+    stream.inflate_status = TINFL_STATUS_NEEDS_MORE_INPUT;
+
+    stream.inflator = malloc(sizeof(tinfl_decompressor));
+    stream.dictionary = malloc(TINFL_LZ_DICT_SIZE);
+    if (!stream.inflator || !stream.dictionary)
+    {
+        ESP_LOGE(TAG, "Failed to allocate the inflator");
+        free_resources();
+        return ESP_ERR_NO_MEM;
+    }
+    tinfl_init(stream.inflator);
+
+    if (encoding == OTA_ENCODING_DELTA)
+    {
+        stream.running = esp_ota_get_running_partition();
+        if (!stream.running)
+        {
+            free_resources();
+            return ESP_FAIL;
+        }
+        ota_patch_init(&stream.patch, read_running_image, write_image, check_running_image, NULL);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ota_stream_feed(const uint8_t *data, size_t length)
+{
+    assert(stream.inflator);
+
+    while (length > 0 || stream.inflate_status == TINFL_STATUS_HAS_MORE_OUTPUT)
+    {
+        if (stream.inflate_status == TINFL_STATUS_DONE)
+        {
+            ESP_LOGE(TAG, "Data after the end of the stream");
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        size_t in_bytes = length;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - stream.dictionary_position;
+        stream.inflate_status = tinfl_decompress(stream.inflator, data, &in_bytes,
+            stream.dictionary, stream.dictionary + stream.dictionary_position, &out_bytes,
+            TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+
+        data += in_bytes;
+        length -= in_bytes;
+
+        if (out_bytes > 0)
+        {
+            const esp_err_t err = write_decoded(stream.dictionary + stream.dictionary_position, out_bytes);
+            if (err != ESP_OK)
+                return err;
+            stream.dictionary_position = (stream.dictionary_position + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (stream.inflate_status < 0)
+        {
+            ESP_LOGE(TAG, "tinfl_decompress failed: %d", stream.inflate_status);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ota_stream_finish(void)
+{
+    esp_err_t err = ESP_OK;
+
+    if (stream.inflate_status != TINFL_STATUS_DONE)
+    {
+        ESP_LOGE(TAG, "Stream incomplete");
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    else if (stream.encoding == OTA_ENCODING_DELTA)
+    {
+        err = ota_patch_finish(&stream.patch);
+        if (err != ESP_OK)
+            ESP_LOGE(TAG, "Delta incomplete");
+    }
+
+    if (err == ESP_OK && stream.buffer)
+    {
+        uint8_t * const buffer = stream.buffer;
+        stream.buffer = NULL;
+        err = ota_submit_buffer(buffer, stream.buffer_length);
+    }
+
+    free_resources();
+    return err;
+}
+
+void ota_stream_abort(void)
+{
+    // A buffer not submitted yet is freed by ota_abort.
+    stream.buffer = NULL;
+    free_resources();
+}
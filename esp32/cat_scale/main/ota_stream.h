@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+// Decodes a compressed or delta encoded update into the ota pipeline (see ota.h), between ota_begin and ota_end.
+// Both encodings are zlib streams, a delta contains a patch against the running image (see ota_patch.h).
+
+typedef enum {
+    OTA_ENCODING_NONE,
+    OTA_ENCODING_DEFLATE,
+    OTA_ENCODING_DELTA,
+} ota_encoding_t;
+
+esp_err_t ota_stream_begin(ota_encoding_t encoding);
+esp_err_t ota_stream_feed(const uint8_t *data, size_t length);
+// Hands the rest of the image to the ota pipeline, fails if the stream is incomplete.
+esp_err_t ota_stream_finish(void);
+void ota_stream_abort(void);
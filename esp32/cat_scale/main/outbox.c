@@ -0,0 +1,234 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "outbox.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <esp_log.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+
+static const char *TAG = "outbox";
+
+// Dedicated data partition for the outboxes. Devices with an older partition table
+// (only updated over the air) don't have it and fall back to the default nvs partition.
+#define OUTBOX_PARTITION    "outbox"
+
+#define OUTBOX_KEY_HEAD     "head"
+#define OUTBOX_KEY_TAIL     "tail"
+#define OUTBOX_KEY_CAPACITY "capacity"
+
+static bool g_partition_checked = false;
+static bool g_partition_available = false;
+
+static bool init_partition(void)
+{
+    if (!g_partition_checked)
+    {
+        g_partition_checked = true;
+
+        esp_err_t ret = nvs_flash_init_partition(OUTBOX_PARTITION);
+        if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+        {
+            ESP_LOGE(TAG, "nvs_flash_init_partition failed: %s. Resetting partition ...", esp_err_to_name(ret));
+            nvs_flash_erase_partition(OUTBOX_PARTITION);
+            ret = nvs_flash_init_partition(OUTBOX_PARTITION);
+        }
+
+        g_partition_available = (ret == ESP_OK);
+
+        if (!g_partition_available)
+            ESP_LOGW(TAG, "partition '%s' not available (%s), using default nvs", OUTBOX_PARTITION, esp_err_to_name(ret));
+    }
+
+    return g_partition_available;
+}
+
+static void get_entry_key(const outbox_t *outbox, uint32_t sequence, char *key, size_t key_size)
+{
+    snprintf(key, key_size, "e%"PRIu32, sequence % outbox->capacity);
+}
+
+static esp_err_t store_indices(outbox_t *outbox)
+{
+    esp_err_t ret = nvs_set_u32(outbox->nvs, OUTBOX_KEY_HEAD, outbox->head);
+    if (ret == ESP_OK)
+        ret = nvs_set_u32(outbox->nvs, OUTBOX_KEY_TAIL, outbox->tail);
+    if (ret == ESP_OK)
+        ret = nvs_commit(outbox->nvs);
+
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "failed to store indices: %s", esp_err_to_name(ret));
+
+    return ret;
+}
+
+outbox_t *outbox_create(const char *name, uint32_t capacity)
+{
+    assert(name);
+    assert(capacity);
+
+    nvs_handle_t nvs = 0;
+    esp_err_t ret = init_partition()
+        ? nvs_open_from_partition(OUTBOX_PARTITION, name, NVS_READWRITE, &nvs)
+        : nvs_open(name, NVS_READWRITE, &nvs);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "nvs_open(%s) failed: %s", name, esp_err_to_name(ret));
+        return NULL;
+    }
+
+    const outbox_t outbox_config = {
+        .nvs = nvs,
+        .capacity = capacity,
+        .head = 0,
+        .tail = 0,
+        .dropped = 0,
+    };
+
+    outbox_t * const outbox = malloc(sizeof(outbox_t));
+    assert(outbox);
+    memcpy(outbox, &outbox_config, sizeof(outbox_t));
+
+    // Entry keys depend on the capacity, so entries written with a different one can't be found anymore.
+    uint32_t stored_capacity = 0;
+    if (nvs_get_u32(nvs, OUTBOX_KEY_CAPACITY, &stored_capacity) == ESP_OK && stored_capacity != capacity)
+    {
+        ESP_LOGW(TAG, "'%s' capacity changed from %"PRIu32" to %"PRIu32", clearing", name, stored_capacity, capacity);
+        nvs_erase_all(nvs);
+    }
+
+    nvs_get_u32(nvs, OUTBOX_KEY_HEAD, &outbox->head);
+    nvs_get_u32(nvs, OUTBOX_KEY_TAIL, &outbox->tail);
+
+    if (outbox->tail - outbox->head > capacity)
+    {
+        ESP_LOGE(TAG, "'%s' indices are corrupt, clearing", name);
+        nvs_erase_all(nvs);
+        outbox->head = 0;
+        outbox->tail = 0;
+    }
+
+    nvs_set_u32(nvs, OUTBOX_KEY_CAPACITY, capacity);
+    store_indices(outbox);
+
+    ESP_LOGI(TAG, "'%s' opened with %zu entries", name, outbox_count(outbox));
+
+    return outbox;
+}
+
+void outbox_destroy(outbox_t *outbox)
+{
+    assert(outbox);
+
+    nvs_close(outbox->nvs);
+    free(outbox);
+}
+
+size_t outbox_count(const outbox_t *outbox)
+{
+    assert(outbox);
+
+    return (size_t)(outbox->tail - outbox->head);
+}
+
+static void drop_oldest(outbox_t *outbox)
+{
+    char key[16] = {};
+    get_entry_key(outbox, outbox->head, key, sizeof(key));
+
+    outbox->head++;
+    outbox->dropped++;
+    store_indices(outbox);
+
+    nvs_erase_key(outbox->nvs, key);
+}
+
+esp_err_t outbox_push(outbox_t *outbox, const void *data, size_t length)
+{
+    assert(outbox);
+    assert(data);
+    assert(length);
+
+    if (outbox_count(outbox) >= outbox->capacity)
+    {
+        ESP_LOGW(TAG, "outbox full, dropping oldest entry");
+        drop_oldest(outbox);
+    }
+
+    char key[16] = {};
+    get_entry_key(outbox, outbox->tail, key, sizeof(key));
+
+    esp_err_t ret = nvs_set_blob(outbox->nvs, key, data, length);
+
+    // Make room on the flash by giving up old entries.
+    while (ret == ESP_ERR_NVS_NOT_ENOUGH_SPACE && outbox_count(outbox) > 0)
+    {
+        ESP_LOGW(TAG, "not enough space, dropping oldest entry");
+        drop_oldest(outbox);
+        ret = nvs_set_blob(outbox->nvs, key, data, length);
+    }
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "nvs_set_blob failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    outbox->tail++;
+    return store_indices(outbox);
+}
+
+esp_err_t outbox_peek(outbox_t *outbox, size_t index, void *buffer, size_t *length)
+{
+    assert(outbox);
+    assert(buffer);
+    assert(length);
+
+    if (index >= outbox_count(outbox))
+        return ESP_ERR_NOT_FOUND;
+
+    char key[16] = {};
+    get_entry_key(outbox, outbox->head + index, key, sizeof(key));
+
+    size_t required_length = 0;
+    esp_err_t ret = nvs_get_blob(outbox->nvs, key, NULL, &required_length);
+    if (ret != ESP_OK)
+        return ret;
+
+    if (required_length > *length)
+    {
+        *length = required_length;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    *length = required_length;
+    return nvs_get_blob(outbox->nvs, key, buffer, length);
+}
+
+esp_err_t outbox_remove(outbox_t *outbox, size_t count)
+{
+    assert(outbox);
+
+    if (count > outbox_count(outbox))
+        count = outbox_count(outbox);
+
+    const uint32_t old_head = outbox->head;
+
+    // Move the head first, the entries are dead from here on even if erasing them fails.
+    outbox->head += count;
+    esp_err_t ret = store_indices(outbox);
+
+    for(uint32_t sequence = old_head; sequence != outbox->head; sequence++)
+    {
+        char key[16] = {};
+        get_entry_key(outbox, sequence, key, sizeof(key));
+        nvs_erase_key(outbox->nvs, key);
+    }
+    nvs_commit(outbox->nvs);
+
+    return ret;
+}
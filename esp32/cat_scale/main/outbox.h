@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <nvs.h>
+
+// Persistent FIFO of serialized documents, one NVS namespace per outbox.
+// Not thread safe, every outbox is meant to be used by a single task.
+typedef struct {
+
+    nvs_handle_t nvs;
+
+    const uint32_t capacity;
+
+    uint32_t head; // sequence number of the oldest entry
+    uint32_t tail; // sequence number of the next entry to write
+
+    uint32_t dropped;
+
+} outbox_t;
+
+
+outbox_t *outbox_create(const char *name, uint32_t capacity);
+void outbox_destroy(outbox_t *outbox);
+
+// Appends an entry. The oldest entry is dropped if the outbox (or the flash) is full.
+esp_err_t outbox_push(outbox_t *outbox, const void *data, size_t length);
+
+size_t outbox_count(const outbox_t *outbox);
+
+// Reads the entry at position index (0 = oldest). length: size of buffer in, size of entry out.
+esp_err_t outbox_peek(outbox_t *outbox, size_t index, void *buffer, size_t *length);
+
+// Removes the count oldest entries.
+esp_err_t outbox_remove(outbox_t *outbox, size_t count);
@@ -0,0 +1,473 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "post_queue.h"
+#include "http.h"
+#include "outbox.h"
+#include "time.h"
+#include "radio.h"
+
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+#include <esp_system.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+static const char *TAG = "post_queue";
+
+#define SCALE_EVENT_PATH        "api/ScaleEvent/Create"
+#define SCALE_EVENT_BATCH_PATH  "api/ScaleEvent/CreateBatch"
+
+// Upper limit for a compact document stored in the outbox, it has to fit into a batch on its own.
+#define OUTBOX_ENTRY_MAX_SIZE   (CONFIG_CATSCALE_OUTBOX_BATCH_BUFFER_SIZE - 2)
+
+// One document shared by all endpoint workers, released by the last one.
+typedef struct {
+    bool used;
+    uint32_t refcount;
+    int64_t queued_time;        // µs since boot
+    post_document_t document;
+} post_item_t;
+
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t length;
+} buffer_sink_t;
+
+typedef struct {
+    int endpoint;
+    QueueHandle_t queue;
+    outbox_t *outbox;           // undelivered events, NULL if the nvs is not usable
+    uint32_t replay_delay_ms;
+    int64_t next_replay_time;   // µs since boot
+    post_queue_status_t status;
+} post_worker_t;
+
+static post_worker_t g_workers[HTTP_JSON_ENDPOINT_COUNT] = {};
+
+// Every document in flight holds a slot of the event pool in measurement.c, so there are never more items than slots.
+static post_item_t g_items[CONFIG_CATSCALE_EVENT_POOL_SIZE] = {};
+static portMUX_TYPE g_items_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+static void post_worker_task(void*);
+
+esp_err_t post_queue_init(void)
+{
+    ESP_LOGI(TAG, "post_queue_init");
+
+    for(int i=0; i<HTTP_JSON_ENDPOINT_COUNT; i++)
+    {
+        post_worker_t * const worker = &g_workers[i];
+
+        worker->endpoint = i;
+        worker->queue = xQueueCreate(CONFIG_CATSCALE_POST_QUEUE_LENGTH, sizeof(post_item_t*));
+        assert(worker->queue);
+
+        char name[24] = {};
+        snprintf(name, sizeof(name), "outbox%d", i);
+        worker->outbox = outbox_create(name, CONFIG_CATSCALE_OUTBOX_CAPACITY);
+        if (!worker->outbox)
+            ESP_LOGE(TAG, "Endpoint %d: no outbox, undelivered events will be lost", i);
+
+        // Events left over from before the reboot are replayed right away.
+        worker->replay_delay_ms = CONFIG_CATSCALE_POST_RETRY_DELAY_MS;
+        worker->next_replay_time = 0;
+
+        snprintf(name, sizeof(name), "post_worker_%d", i);
+        xTaskCreate(post_worker_task, name, 8 * 1024, worker, tskIDLE_PRIORITY + 1, NULL);
+    }
+
+    return ESP_OK;
+}
+
+static void release_item(post_item_t *item)
+{
+    assert(item);
+
+    if (__atomic_sub_fetch(&item->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        if (item->document.release)
+            item->document.release(item->document.context);
+
+        taskENTER_CRITICAL(&g_items_spinlock);
+        item->used = false;
+        taskEXIT_CRITICAL(&g_items_spinlock);
+    }
+}
+
+static post_item_t *take_item(void)
+{
+    post_item_t *item = NULL;
+
+    taskENTER_CRITICAL(&g_items_spinlock);
+    for (size_t i = 0; i < CONFIG_CATSCALE_EVENT_POOL_SIZE; i++)
+    {
+        if (!g_items[i].used)
+        {
+            item = &g_items[i];
+            item->used = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&g_items_spinlock);
+
+    return item;
+}
+
+esp_err_t post_queue_submit_scale_event(const post_document_t *document)
+{
+    assert(document);
+    assert(document->write);
+
+    post_item_t * const item = take_item();
+    if (!item) {
+        ESP_LOGE(TAG, "No free post item");
+        if (document->release)
+            document->release(document->context);
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(&item->document, document, sizeof(post_document_t));
+    item->queued_time = esp_timer_get_time();
+
+    // Hold a reference while handing out so a fast worker can't free the item in between.
+    item->refcount = 1;
+
+    esp_err_t ret = ESP_FAIL;
+
+    for(int i=0; i<HTTP_JSON_ENDPOINT_COUNT; i++)
+    {
+        post_worker_t * const worker = &g_workers[i];
+
+        __atomic_add_fetch(&item->refcount, 1, __ATOMIC_ACQ_REL);
+
+        if (xQueueSend(worker->queue, &item, 0) == pdTRUE)
+        {
+            worker->status.queued++;
+            ret = ESP_OK;
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Queue of endpoint %d is full, dropping event", i);
+            worker->status.dropped++;
+            release_item(item);
+        }
+    }
+
+    release_item(item);
+
+    return ret;
+}
+
+static esp_err_t write_full_document(const void *context, http_body_writer_t write, void *sink)
+{
+    const post_item_t * const item = context;
+    return item->document.write(item->document.context, false, write, sink);
+}
+
+static esp_err_t write_buffer_sink(void *sink_ptr, const char *data, size_t length)
+{
+    buffer_sink_t * const sink = sink_ptr;
+
+    if (sink->length + length >= sink->size)
+        return ESP_ERR_NO_MEM;
+
+    memcpy(sink->buffer + sink->length, data, length);
+    sink->length += length;
+    sink->buffer[sink->length] = '\0';
+
+    return ESP_OK;
+}
+
+static bool is_retryable(esp_err_t result, int http_status)
+{
+    // No response at all or a server side problem. A 4xx will not get any better by trying again.
+    return result != ESP_OK && (http_status == 0 || http_status / 100 == 5);
+}
+
+static void increase_replay_delay(post_worker_t *worker)
+{
+    // Replays are not urgent, they go out together with the sensor upload.
+    worker->next_replay_time = radio_next_window(esp_timer_get_time() + (int64_t)worker->replay_delay_ms * 1000);
+
+    worker->replay_delay_ms *= 2;
+    if (worker->replay_delay_ms > CONFIG_CATSCALE_POST_MAX_RETRY_DELAY_MS)
+        worker->replay_delay_ms = CONFIG_CATSCALE_POST_MAX_RETRY_DELAY_MS;
+}
+
+static void reset_replay_delay(post_worker_t *worker)
+{
+    worker->replay_delay_ms = CONFIG_CATSCALE_POST_RETRY_DELAY_MS;
+    worker->next_replay_time = esp_timer_get_time();
+}
+
+static void store_item(post_worker_t *worker, const post_item_t *item)
+{
+    if (!worker->outbox)
+    {
+        worker->status.failed++;
+        return;
+    }
+
+    // Bulky attachments (eg. waveforms) are left out, they would not fit into the nvs.
+    buffer_sink_t sink = {
+        .buffer = malloc(OUTBOX_ENTRY_MAX_SIZE),
+        .size = OUTBOX_ENTRY_MAX_SIZE,
+        .length = 0,
+    };
+    if (!sink.buffer)
+    {
+        ESP_LOGE(TAG, "Endpoint %d: failed to allocate outbox entry", worker->endpoint);
+        worker->status.failed++;
+        return;
+    }
+
+    const bool was_empty = outbox_count(worker->outbox) == 0;
+    const uint32_t dropped_before = worker->outbox->dropped;
+
+    esp_err_t ret = item->document.write(item->document.context, true, write_buffer_sink, &sink);
+    if (ret == ESP_OK)
+        ret = outbox_push(worker->outbox, sink.buffer, sink.length);
+
+    free(sink.buffer);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Endpoint %d: failed to store event: %s", worker->endpoint, esp_err_to_name(ret));
+        worker->status.failed++;
+        return;
+    }
+
+    worker->status.stored++;
+    worker->status.failed += worker->outbox->dropped - dropped_before;
+
+    if (was_empty)
+        increase_replay_delay(worker);
+}
+
+static void deliver_item(post_worker_t *worker, const post_item_t *item)
+{
+    // A failed event goes to the outbox right away and is retried by the replay, so its pool slot
+    // is not held through the backoff. Only without an outbox the event itself is retried.
+    const int max_attempts = worker->outbox ? 1 : CONFIG_CATSCALE_POST_MAX_ATTEMPTS;
+
+    uint32_t retry_delay_ms = CONFIG_CATSCALE_POST_RETRY_DELAY_MS;
+
+    for(int attempt=1; ; attempt++)
+    {
+        int http_status = 0;
+        const esp_err_t result = http_post_json_stream(worker->endpoint, SCALE_EVENT_PATH, write_full_document, item, &http_status);
+
+        worker->status.last_result = result;
+        worker->status.last_http_status = http_status;
+
+        if (result == ESP_OK)
+        {
+            worker->status.delivered++;
+            worker->status.last_delivery_time = esp_timer_get_time();
+            worker->status.last_latency_us = (uint32_t)(worker->status.last_delivery_time - item->queued_time);
+            if (worker->status.last_latency_us > worker->status.max_latency_us)
+                worker->status.max_latency_us = worker->status.last_latency_us;
+
+            // Endpoint is back, don't wait for the backoff to expire.
+            if (worker->outbox && outbox_count(worker->outbox) > 0)
+                reset_replay_delay(worker);
+            return;
+        }
+
+        if (!is_retryable(result, http_status))
+        {
+            ESP_LOGE(TAG, "Endpoint %d: event rejected (status %d)", worker->endpoint, http_status);
+            worker->status.failed++;
+            return;
+        }
+
+        if (attempt >= max_attempts)
+        {
+            ESP_LOGW(TAG, "Endpoint %d: storing event after %d attempt(s) (status %d)",
+                worker->endpoint, attempt, http_status);
+            store_item(worker, item);
+            return;
+        }
+
+        ESP_LOGW(TAG, "Endpoint %d: attempt %d failed, retrying in %"PRIu32" ms",
+            worker->endpoint, attempt, retry_delay_ms);
+        worker->status.retries++;
+
+        vTaskDelay(retry_delay_ms / portTICK_PERIOD_MS);
+
+        retry_delay_ms *= 2;
+        if (retry_delay_ms > CONFIG_CATSCALE_POST_MAX_RETRY_DELAY_MS)
+            retry_delay_ms = CONFIG_CATSCALE_POST_MAX_RETRY_DELAY_MS;
+    }
+}
+
+// Builds a JSON array of the oldest stored events. Returns the number of events in the batch.
+static size_t build_batch(post_worker_t *worker, char *buffer, size_t buffer_size)
+{
+    outbox_t * const outbox = worker->outbox;
+
+    size_t pos = 0;
+    size_t count = 0;
+
+    buffer[pos++] = '[';
+
+    while (count < CONFIG_CATSCALE_OUTBOX_BATCH_SIZE && count < outbox_count(outbox))
+    {
+        const size_t separator = count > 0 ? 1 : 0;
+        if (pos + separator + 2 >= buffer_size)
+            break;
+
+        // Keep room for the separator, the closing bracket and the terminator.
+        size_t length = buffer_size - pos - separator - 2;
+        const esp_err_t ret = outbox_peek(outbox, count, buffer + pos + separator, &length);
+
+        if (ret != ESP_OK)
+        {
+            if (count > 0)
+                break; // Goes into the next batch.
+
+            // Doesn't even fit into an empty batch or can't be read at all.
+            ESP_LOGE(TAG, "Endpoint %d: dropping unreadable stored event: %s", worker->endpoint, esp_err_to_name(ret));
+            outbox_remove(outbox, 1);
+            worker->status.failed++;
+            continue;
+        }
+
+        if (separator)
+            buffer[pos++] = ',';
+        pos += length;
+        count++;
+    }
+
+    buffer[pos++] = ']';
+    buffer[pos] = '\0';
+
+    return count;
+}
+
+static void replay_outbox(post_worker_t *worker)
+{
+    char * const buffer = malloc(CONFIG_CATSCALE_OUTBOX_BATCH_BUFFER_SIZE);
+    if (!buffer)
+    {
+        ESP_LOGE(TAG, "Failed to allocate batch buffer");
+        increase_replay_delay(worker);
+        return;
+    }
+
+    const size_t count = build_batch(worker, buffer, CONFIG_CATSCALE_OUTBOX_BATCH_BUFFER_SIZE);
+    if (count > 0)
+    {
+        int http_status = 0;
+        const esp_err_t result = http_post_json_data(worker->endpoint, SCALE_EVENT_BATCH_PATH, buffer, &http_status);
+
+        worker->status.last_result = result;
+        worker->status.last_http_status = http_status;
+
+        if (result == ESP_OK)
+        {
+            // Events rejected one by one are reported in the response, they would be rejected again anyway.
+            ESP_LOGI(TAG, "Endpoint %d: replayed %zu stored event(s)", worker->endpoint, count);
+            outbox_remove(worker->outbox, count);
+            worker->status.replayed += count;
+            worker->status.last_delivery_time = esp_timer_get_time();
+            reset_replay_delay(worker);
+        }
+        else if (http_status == 400)
+        {
+            ESP_LOGE(TAG, "Endpoint %d: batch of %zu event(s) rejected, dropping", worker->endpoint, count);
+            outbox_remove(worker->outbox, count);
+            worker->status.failed += count;
+            reset_replay_delay(worker);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Endpoint %d: replay failed (status %d), next try in %"PRIu32" ms",
+                worker->endpoint, http_status, worker->replay_delay_ms);
+            increase_replay_delay(worker);
+        }
+    }
+
+    free(buffer);
+}
+
+static void post_worker_task(void *task_args)
+{
+    post_worker_t * const worker = task_args;
+    assert(worker);
+
+    ESP_LOGI(TAG, "post_worker_task %d", worker->endpoint);
+
+    // Scale events carry esp_timer timestamps which are converted to utc when serialized, that needs a synchronized clock.
+    // Events recorded in the meantime wait in the queue.
+    while (!time_is_synchronized())
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+
+    while(true)
+    {
+        TickType_t wait_ticks = portMAX_DELAY;
+
+        if (worker->outbox && outbox_count(worker->outbox) > 0)
+        {
+            const int64_t remaining_us = worker->next_replay_time - esp_timer_get_time();
+            wait_ticks = remaining_us > 0 ? (remaining_us / 1000) / portTICK_PERIOD_MS : 0;
+        }
+
+        post_item_t *item = NULL;
+        if (xQueueReceive(worker->queue, &item, wait_ticks) != pdTRUE)
+        {
+            if (worker->outbox && outbox_count(worker->outbox) > 0)
+            {
+                radio_acquire();
+                replay_outbox(worker);
+                radio_release();
+            }
+            continue;
+        }
+        assert(item);
+
+        // Scale events don't wait for an upload window.
+        radio_acquire();
+        deliver_item(worker, item);
+        radio_release();
+        release_item(item);
+    }
+}
+
+void post_queue_get_status(int endpoint, post_queue_status_t *status)
+{
+    assert(endpoint >= 0 && endpoint < HTTP_JSON_ENDPOINT_COUNT);
+    assert(status);
+
+    const post_worker_t * const worker = &g_workers[endpoint];
+
+    // Note: No locking here, the numbers are only used for monitoring.
+    memcpy(status, &worker->status, sizeof(post_queue_status_t));
+    status->queue_level = worker->queue ? uxQueueMessagesWaiting(worker->queue) : 0;
+    status->outbox_level = worker->outbox ? outbox_count(worker->outbox) : 0;
+}
+
+void post_queue_log_stats(void)
+{
+    for(int i=0; i<HTTP_JSON_ENDPOINT_COUNT; i++)
+    {
+        post_queue_status_t status = {};
+        post_queue_get_status(i, &status);
+
+        ESP_LOGI(TAG, "endpoint %d: queued=%"PRIu32" delivered=%"PRIu32" retries=%"PRIu32" failed=%"PRIu32" dropped=%"PRIu32" level=%"PRIu32" stored=%"PRIu32" replayed=%"PRIu32" outbox=%"PRIu32" last=%s/%d latency=%"PRIu32"/%"PRIu32"ms",
+            i, status.queued, status.delivered, status.retries, status.failed, status.dropped, status.queue_level,
+            status.stored, status.replayed, status.outbox_level,
+            esp_err_to_name(status.last_result), status.last_http_status,
+            status.last_latency_us / 1000, status.max_latency_us / 1000);
+    }
+}
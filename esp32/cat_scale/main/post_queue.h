@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#include "http.h"
+
+typedef struct {
+    uint32_t queued;
+    uint32_t delivered;
+    uint32_t retries;
+    uint32_t failed;            // rejected by the server or lost from the outbox
+    uint32_t dropped;           // queue was full
+    uint32_t queue_level;
+    uint32_t stored;            // put into the outbox after the last attempt
+    uint32_t replayed;          // delivered from the outbox
+    uint32_t outbox_level;
+    int last_http_status;
+    esp_err_t last_result;
+    int64_t last_delivery_time; // µs since boot
+    uint32_t last_latency_us;   // from submitting until delivered, without the replays
+    uint32_t max_latency_us;
+} post_queue_status_t;
+
+// A JSON document that is serialized while it is sent, possibly several times and by several tasks at once.
+typedef struct {
+    // compact: leave out bulky attachments, the document is stored in flash.
+    esp_err_t (*write)(const void *context, bool compact, http_body_writer_t write, void *sink);
+    // Called once when the document is not needed anymore.
+    void (*release)(void *context);
+    void *context;
+} post_document_t;
+
+esp_err_t post_queue_init(void);
+
+// Hands the scale event to the worker of every endpoint, the queue takes ownership of the document. Does not block.
+// Events that can't be delivered are stored in flash (without attachments) and replayed in batches later.
+esp_err_t post_queue_submit_scale_event(const post_document_t *document);
+
+void post_queue_get_status(int endpoint, post_queue_status_t *status);
+void post_queue_log_stats(void);
@@ -0,0 +1,154 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "radio.h"
+#include "settings.h"
+
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include <esp_system.h>
+#include <esp_wifi.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+static const char *TAG = "radio";
+
+#if CONFIG_CATSCALE_RADIO_POWER_SAVE
+#define RADIO_IDLE_PS_MODE (WIFI_PS_MAX_MODEM)
+#else
+#define RADIO_IDLE_PS_MODE (WIFI_PS_NONE)
+#endif
+
+// esp_wifi_set_ps may block, the state is switched under a mutex. The stats are read under the spinlock.
+static SemaphoreHandle_t g_mutex = NULL;
+static uint32_t g_acquire_count = 0;
+static int64_t g_last_window = -1;
+
+static portMUX_TYPE g_stats_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static radio_stats_t g_stats = {};
+static bool g_sleeping = false;
+static int64_t g_state_since = 0;   // µs since boot
+
+// Call with the spinlock held.
+static void account_state(int64_t now)
+{
+    if (g_sleeping)
+        g_stats.sleep_time_us += now - g_state_since;
+    else
+        g_stats.awake_time_us += now - g_state_since;
+    g_state_since = now;
+}
+
+static void set_sleeping(bool sleeping)
+{
+    const esp_err_t err = esp_wifi_set_ps(sleeping ? RADIO_IDLE_PS_MODE : WIFI_PS_NONE);
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "esp_wifi_set_ps failed: %s", esp_err_to_name(err));
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    account_state(esp_timer_get_time());
+    g_sleeping = sleeping && RADIO_IDLE_PS_MODE != WIFI_PS_NONE && err == ESP_OK;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+}
+
+esp_err_t radio_init(void)
+{
+    ESP_LOGI(TAG, "radio_init power save %s, listen interval %d", RADIO_IDLE_PS_MODE != WIFI_PS_NONE ? "on" : "off",
+        CONFIG_CATSCALE_WIFI_LISTEN_INTERVAL);
+
+    g_mutex = xSemaphoreCreateMutex();
+    assert(g_mutex);
+
+    // Takes effect once the station is associated.
+    set_sleeping(true);
+
+    return ESP_OK;
+}
+
+static int64_t window_interval_us(void)
+{
+    return (int64_t)settings_get(SETTING_UPLOAD_POST_INTERVAL) * 1000 * 1000;
+}
+
+int64_t radio_next_window(int64_t time)
+{
+    const int64_t interval_us = window_interval_us();
+    assert(interval_us > 0);
+
+    return (time + interval_us - 1) / interval_us * interval_us;
+}
+
+void radio_wait_for_window(void)
+{
+    const int64_t now = esp_timer_get_time();
+    const int64_t next = radio_next_window(now + 1);
+
+    // Rounded up, waking a tick late is fine, waking early would miss the window.
+    const int64_t tick_us = (int64_t)portTICK_PERIOD_MS * 1000;
+    vTaskDelay((TickType_t)((next - now + tick_us - 1) / tick_us));
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    if (next != g_last_window)
+    {
+        g_last_window = next;
+        g_stats.windows++;
+    }
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+}
+
+void radio_acquire(void)
+{
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    g_stats.acquired++;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+
+    assert(g_mutex);
+
+    xSemaphoreTake(g_mutex, portMAX_DELAY);
+    if (g_acquire_count++ == 0)
+        set_sleeping(false);
+    xSemaphoreGive(g_mutex);
+}
+
+void radio_release(void)
+{
+    assert(g_mutex);
+
+    xSemaphoreTake(g_mutex, portMAX_DELAY);
+    assert(g_acquire_count > 0);
+    if (--g_acquire_count == 0)
+        set_sleeping(true);
+    xSemaphoreGive(g_mutex);
+}
+
+void radio_get_stats(radio_stats_t *stats)
+{
+    assert(stats);
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    account_state(esp_timer_get_time());
+    *stats = g_stats;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+
+    const uint64_t total_us = stats->awake_time_us + stats->sleep_time_us;
+    if (total_us > 0)
+        stats->avg_current_ma = (uint32_t)((stats->awake_time_us * CONFIG_CATSCALE_RADIO_AWAKE_CURRENT_MA +
+            stats->sleep_time_us * CONFIG_CATSCALE_RADIO_SLEEP_CURRENT_MA) / total_us);
+}
+
+void radio_log_stats(void)
+{
+    radio_stats_t stats = {};
+    radio_get_stats(&stats);
+
+    const uint64_t total_us = stats.awake_time_us + stats.sleep_time_us;
+    ESP_LOGI(TAG, "windows=%"PRIu32" acquired=%"PRIu32" awake=%"PRIu32"/1000 avg current ~%"PRIu32" mA",
+        stats.windows, stats.acquired, total_us > 0 ? (uint32_t)(stats.awake_time_us * 1000 / total_us) : 0,
+        stats.avg_current_ma);
+}
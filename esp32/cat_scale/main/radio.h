@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+// Schedules the radio: modem sleep (CONFIG_CATSCALE_RADIO_POWER_SAVE) while nobody needs the radio and
+// upload windows at multiples of SETTING_UPLOAD_POST_INTERVAL, so the periodic uploads share one wake-up.
+// Traffic that can't wait (scale events, rc sessions, live stream clients) holds the radio awake instead.
+
+typedef struct {
+    uint32_t windows;           // upload windows that were waited for
+    uint32_t acquired;          // radio_acquire calls
+    uint64_t awake_time_us;     // power save off, since boot
+    uint64_t sleep_time_us;     // modem sleep, since boot
+    uint32_t avg_current_ma;    // estimated from the time in each state, see CONFIG_CATSCALE_RADIO_*_CURRENT_MA
+} radio_stats_t;
+
+// After wifi_init_sta, before anything uses the network. Until then the radio counts as awake.
+esp_err_t radio_init(void);
+
+// Start of the first upload window at or after time (µs since boot).
+int64_t radio_next_window(int64_t time);
+
+// Blocks until the next upload window starts.
+void radio_wait_for_window(void);
+
+// Keeps the radio awake until the matching radio_release, for low latency transfers. Nests.
+void radio_acquire(void);
+void radio_release(void);
+
+void radio_get_stats(radio_stats_t *stats);
+void radio_log_stats(void);
@@ -2,11 +2,16 @@
 
 #include "rc.h"
 #include "measurement.h"
+#include "ota.h"
+#include "ota_stream.h"
+#include "rpc.h"
+#include "radio.h"
 
 #include "sdkconfig.h"
 
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -143,6 +148,8 @@ esp_err_t rc_init()
         }
     }
 
+    ESP_ERROR_CHECK(ota_init());
+
     xTaskCreate(rc_ota_task, "rc_ota_task", 8 * 1024, NULL, tskIDLE_PRIORITY + 1, NULL);
 
     return ESP_OK;
@@ -156,9 +163,17 @@ esp_err_t rc_init()
 typedef struct {
     size_t total_bytes_received;
 
+    bool is_rpc_session;
+
     bool is_doing_ota;
-    esp_ota_handle_t ota_update_handle;
-    const esp_partition_t *ota_update_partition;
+    bool ota_finished;
+    size_t ota_header_length;       // "ota <size> <sha256>[ <encoding> <transfer size>]\n", in front of the image
+    uint32_t ota_image_size;        // 0 if unknown (plain image without header)
+    ota_encoding_t ota_encoding;
+    uint32_t ota_transfer_size;     // encoded size, what is received
+    bool ota_has_sha256;
+    uint8_t ota_sha256[HASH_LEN];
+    uint8_t ota_received_sha256[HASH_LEN];
 
     uint32_t commands_received;
     uint32_t commands_parameter;
@@ -169,52 +184,128 @@ static void process_begin(process_state_t *state)
 {
     state->total_bytes_received = 0;
 
+    state->is_rpc_session = false;
+
     state->is_doing_ota = false;
-    state->ota_update_handle = 0;
-    state->ota_update_partition = NULL;
+    state->ota_finished = false;
+    state->ota_header_length = 0;
+    state->ota_image_size = 0;
+    state->ota_encoding = OTA_ENCODING_NONE;
+    state->ota_transfer_size = 0;
+    state->ota_has_sha256 = false;
 
     state->commands_received = 0;
     state->commands_parameter = 0;
 }
 
+static bool parse_hex(const char *hex, uint8_t *output, size_t output_size)
+{
+    for (size_t i = 0; i < output_size; i++)
+    {
+        unsigned int value = 0;
+        if (sscanf(hex + 2 * i, "%2x", &value) != 1)
+            return false;
+        output[i] = (uint8_t)value;
+    }
+    return true;
+}
+
+// "ota <size> <sha256 as hex>\n" or "ota <size> <sha256 as hex> <deflate|delta> <transfer size>\n",
+// size and hash are the ones of the decoded image.
+static bool parse_ota_header(process_state_t *state, const char *data, size_t length)
+{
+    if (length < 4 || strncmp(data, "ota ", 4) != 0)
+        return false;
+
+    const char * const end = memchr(data, '\n', length);
+    if (!end)
+    {
+        ESP_LOGE(TAG, "OTA header incomplete");
+        return false;
+    }
+
+    char header[128] = {};
+    const size_t header_length = end - data;
+    if (header_length >= sizeof(header))
+        return false;
+    memcpy(header, data, header_length);
+
+    unsigned int image_size = 0;
+    char sha256_hex[HASH_LEN * 2 + 1] = {};
+    char encoding[16] = {};
+    unsigned int transfer_size = 0;
+    const int fields = sscanf(header, "ota %u %64s %15s %u", &image_size, sha256_hex, encoding, &transfer_size);
+    if ((fields != 2 && fields != 4) ||
+        strlen(sha256_hex) != HASH_LEN * 2 ||
+        !parse_hex(sha256_hex, state->ota_sha256, HASH_LEN))
+    {
+        ESP_LOGE(TAG, "Invalid OTA header");
+        return false;
+    }
+
+    if (fields == 4)
+    {
+        if (strcmp(encoding, "deflate") == 0)
+            state->ota_encoding = OTA_ENCODING_DEFLATE;
+        else if (strcmp(encoding, "delta") == 0)
+            state->ota_encoding = OTA_ENCODING_DELTA;
+        else
+        {
+            ESP_LOGE(TAG, "Unknown OTA encoding '%s'", encoding);
+            return false;
+        }
+        state->ota_transfer_size = transfer_size;
+    }
+
+    state->ota_header_length = header_length + 1;
+    state->ota_image_size = image_size;
+    state->ota_has_sha256 = true;
+    return true;
+}
+
 static void process_data(process_state_t *state, void *data, size_t length)
 {
     if (state->total_bytes_received == 0)
     {
         ESP_LOGI(TAG, "got %u bytes on first read", length);
 
-        const esp_image_header_t * const image_header = data;
-        const esp_app_desc_t * const app_desc = data + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t);
+        // Binary requests (settings, stats), see rpc_frame.h.
+        if (rpc_is_session(data, length))
+        {
+            state->is_rpc_session = true;
+            state->total_bytes_received += (size_t)length;
+            return;
+        }
 
-        if (image_header->magic == ESP_IMAGE_HEADER_MAGIC &&
-            app_desc->magic_word == ESP_APP_DESC_MAGIC_WORD)
+        // The sender may announce the size and the SHA-256 of the image, which is checked after the transfer.
+        if (parse_ota_header(state, data, length))
         {
-            ESP_LOGI(TAG, "project '%s' version '%s' date '%s' time '%s' ver '%s'",
-                app_desc->project_name, app_desc->version, app_desc->date, app_desc->time, app_desc->version);
-            print_sha256(app_desc->app_elf_sha256, "app_elf_sha256");
+            ESP_LOGI(TAG, "OTA header: %"PRIu32" bytes, %s %"PRIu32" bytes", state->ota_image_size,
+                state->ota_encoding == OTA_ENCODING_DELTA ? "delta" : state->ota_encoding == OTA_ENCODING_DEFLATE ? "deflate" : "plain",
+                state->ota_encoding == OTA_ENCODING_NONE ? state->ota_image_size : state->ota_transfer_size);
+            print_sha256(state->ota_sha256, "expected sha256");
 
-            state->ota_update_partition = esp_ota_get_next_update_partition(NULL);
+            data += state->ota_header_length;
+            length -= state->ota_header_length;
+        }
 
-            if (state->ota_update_partition)
-            {
-                ESP_LOGI(TAG, "OTA update partition: subtype %d at offset 0x%x",
-                    state->ota_update_partition->subtype, state->ota_update_partition->address);
+        const esp_image_header_t * const image_header = data;
+        const esp_app_desc_t * const app_desc = data + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t);
 
-                esp_err_t err = esp_ota_begin(state->ota_update_partition, OTA_WITH_SEQUENTIAL_WRITES, &state->ota_update_handle);
-                if (err == ESP_OK)
-                {
-                    ESP_LOGI(TAG, "Starting OTA ...");
-                    state->is_doing_ota = true;
-                }
-                else
-                {
-                    ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(err));
-                }
-            }
-            else
+        if (state->ota_header_length > 0 ||
+            (image_header->magic == ESP_IMAGE_HEADER_MAGIC &&
+             app_desc->magic_word == ESP_APP_DESC_MAGIC_WORD))
+        {
+            if (length >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t) &&
+                app_desc->magic_word == ESP_APP_DESC_MAGIC_WORD)
             {
-                ESP_LOGE(TAG, "esp_ota_get_next_update_partition failed");
+                ESP_LOGI(TAG, "project '%s' version '%s' date '%s' time '%s' ver '%s'",
+                    app_desc->project_name, app_desc->version, app_desc->date, app_desc->time, app_desc->version);
+                print_sha256(app_desc->app_elf_sha256, "app_elf_sha256");
             }
+
+            if (ota_begin(state->ota_image_size) == ESP_OK)
+                state->is_doing_ota = true;
         }
         else
         {
@@ -247,28 +338,6 @@ static void process_data(process_state_t *state, void *data, size_t length)
             {
                 ESP_LOGI(TAG, "Unknown command");
             }
-
-            // TODO
-            // set runtime config ?
-            // eg:
-            // "set http_addr Framework:5155"
-
-        }
-    }
-
-    if (state->is_doing_ota)
-    {
-        esp_err_t err = esp_ota_write(state->ota_update_handle, data, length);
-        if (err != ESP_OK)
-        {
-            ESP_LOGE(TAG, "esp_ota_write failed: %s (total received %u)", esp_err_to_name(err), state->total_bytes_received);
-
-            ESP_LOGE(TAG, "Aborting OTA ...");
-            esp_ota_abort(state->ota_update_handle);
-
-            state->is_doing_ota = false;
-            state->ota_update_handle = 0;
-            state->ota_update_partition = 0;
         }
     }
 
@@ -279,24 +348,8 @@ static void process_end(process_state_t *state)
 {
     ESP_LOGI(TAG, "total received %u", state->total_bytes_received);
 
-    if (state->is_doing_ota)
+    if (state->ota_finished)
     {
-        ESP_LOGI(TAG, "Finishing OTA ...");
-
-        esp_err_t err = esp_ota_end(state->ota_update_handle);
-        if (err != ESP_OK)
-        {
-            ESP_LOGE(TAG, "esp_ota_end failed: %s", esp_err_to_name(err));
-            return;
-        }
-
-        err = esp_ota_set_boot_partition(state->ota_update_partition);
-        if (err != ESP_OK)
-        {
-            ESP_LOGE(TAG, "esp_ota_set_boot_partition failed: %s", esp_err_to_name(err));
-            return;
-        }
-
         for(int i=3; i>0; i--)
         {
             ESP_LOGI(TAG, "OTA finished. Rebooting in %ds ...", i);
@@ -315,22 +368,161 @@ static void process_end(process_state_t *state)
         esp_restart();
     }
 
+    // The test events belong to the first channel.
     if (state->commands_received & RC_COMMAND_TEST_START)
     {
-        measurement_mark_start_of_event();
+        measurement_mark_start_of_event(0);
     }
 
     if (state->commands_received & RC_COMMAND_TEST_STABLE)
     {
-        measurement_push_stable_phase(10.0, (double)state->commands_parameter);
+        measurement_push_stable_phase(0, 10.0, (double)state->commands_parameter);
     }
 
     if (state->commands_received & RC_COMMAND_TEST_END)
     {
-        measurement_mark_end_of_event();
+        measurement_mark_end_of_event(0);
     }
 }
 
+// Receives the rest of the image (the first part was already received with the header) into the ota pipeline,
+// the flash is written while the next buffer is received.
+static esp_err_t receive_ota_plain(int sock, process_state_t *state, const uint8_t *initial, size_t initial_length)
+{
+    assert(initial_length <= CONFIG_CATSCALE_OTA_BUFFER_SIZE);
+
+    uint8_t *buffer = ota_get_buffer();
+    memcpy(buffer, initial, initial_length);
+    size_t fill = initial_length;
+    uint32_t total = initial_length;
+    esp_err_t err = ESP_OK;
+
+    // With a header the transfer is over after the announced size, the sender does not need to close its side.
+    while (!state->ota_image_size || total < state->ota_image_size)
+    {
+        size_t wanted = CONFIG_CATSCALE_OTA_BUFFER_SIZE - fill;
+        if (state->ota_image_size && wanted > state->ota_image_size - total)
+            wanted = state->ota_image_size - total;
+
+        const int received_bytes = recv(sock, buffer + fill, wanted, 0);
+        if (received_bytes < 0)
+        {
+            ESP_LOGE(TAG, "Error while receiving: errno %d (total received %"PRIu32")", errno, total);
+            err = ESP_FAIL;
+            break;
+        }
+        if (received_bytes == 0)
+            break;
+
+        fill += (size_t)received_bytes;
+        total += (uint32_t)received_bytes;
+
+        if (fill == CONFIG_CATSCALE_OTA_BUFFER_SIZE)
+        {
+            err = ota_submit_buffer(buffer, fill);
+            if (err != ESP_OK)
+                break;
+            buffer = ota_get_buffer();
+            fill = 0;
+        }
+    }
+
+    if (err == ESP_OK && fill > 0)
+        err = ota_submit_buffer(buffer, fill);
+
+    state->total_bytes_received += total - initial_length;
+
+    return err;
+}
+
+// Compressed image or delta: received in small pieces which are decoded into the ota pipeline.
+static esp_err_t receive_ota_encoded(int sock, process_state_t *state, const uint8_t *initial, size_t initial_length)
+{
+    esp_err_t err = ota_stream_begin(state->ota_encoding);
+    if (err != ESP_OK)
+        return err;
+
+    const size_t receive_buffer_size = 4 * 1024;
+    uint8_t * const receive_buffer = malloc(receive_buffer_size);
+    if (!receive_buffer)
+    {
+        ota_stream_abort();
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t total = initial_length;
+    err = ota_stream_feed(initial, initial_length);
+
+    while (err == ESP_OK && total < state->ota_transfer_size)
+    {
+        const size_t wanted = state->ota_transfer_size - total < receive_buffer_size ? state->ota_transfer_size - total : receive_buffer_size;
+
+        const int received_bytes = recv(sock, receive_buffer, wanted, 0);
+        if (received_bytes < 0)
+        {
+            ESP_LOGE(TAG, "Error while receiving: errno %d (total received %"PRIu32")", errno, total);
+            err = ESP_FAIL;
+            break;
+        }
+        if (received_bytes == 0)
+            break;
+
+        total += (uint32_t)received_bytes;
+        err = ota_stream_feed(receive_buffer, (size_t)received_bytes);
+    }
+
+    free(receive_buffer);
+    state->total_bytes_received += total - initial_length;
+
+    if (err == ESP_OK)
+        err = ota_stream_finish();
+    else
+        ota_stream_abort();
+
+    ESP_LOGI(TAG, "Received %"PRIu32" bytes for a %"PRIu32" bytes image", total, state->ota_image_size);
+    return err;
+}
+
+static esp_err_t receive_ota(int sock, process_state_t *state, const uint8_t *initial, size_t initial_length)
+{
+    esp_err_t err = state->ota_encoding == OTA_ENCODING_NONE
+        ? receive_ota_plain(sock, state, initial, initial_length)
+        : receive_ota_encoded(sock, state, initial, initial_length);
+
+    if (err != ESP_OK)
+    {
+        ota_abort();
+        return err;
+    }
+
+    err = ota_end(state->ota_has_sha256 ? state->ota_sha256 : NULL, state->ota_received_sha256);
+    print_sha256(state->ota_received_sha256, "received image sha256");
+    return err;
+}
+
+static void send_ota_result(int sock, esp_err_t err, const process_state_t *state)
+{
+    char reply[HASH_LEN * 2 + 64] = {};
+
+    if (err == ESP_OK)
+    {
+        ota_progress_t progress = {};
+        ota_get_progress(&progress);
+
+        const int length = snprintf(reply, sizeof(reply), "ok %"PRIu32" bytes %lld ms sha256 ",
+            progress.bytes_written, progress.duration_us / 1000);
+        for (int i = 0; i < HASH_LEN; i++)
+            snprintf(reply + length + 2 * i, 3, "%02x", state->ota_received_sha256[i]);
+        strcat(reply, "\n");
+    }
+    else
+    {
+        snprintf(reply, sizeof(reply), "error %s\n", esp_err_to_name(err));
+    }
+
+    send(sock, reply, strlen(reply), 0);
+}
+
 static void rc_ota_task()
 {
     ESP_LOGI(TAG, "rc ota task");
@@ -377,6 +569,9 @@ static void rc_ota_task()
             break;
         }
 
+        // Interactive, don't let the answers wait for the next beacon.
+        radio_acquire();
+
         // Set tcp keepalive option
         int keepAlive = 1;
         int keepIdle = 5;       // Keep-alive idle time. In idle time without receiving any data from peer, will send keep-alive probe packet
@@ -406,7 +601,7 @@ static void rc_ota_task()
         process_begin(&state);
 
         const size_t receive_buffer_size = 1024;
-        void * const receive_buffer = malloc(receive_buffer_size);
+        uint8_t * const receive_buffer = malloc(receive_buffer_size);
         assert(receive_buffer);
 
         while(1)
@@ -425,6 +620,27 @@ static void rc_ota_task()
             {
                 assert(received_bytes > 0);
                 process_data(&state, receive_buffer, (size_t)received_bytes);
+
+                // The rest of the connection is a sequence of rpc frames.
+                if (state.is_rpc_session)
+                {
+                    bool reboot_requested = false;
+                    rpc_serve(sock, receive_buffer, (size_t)received_bytes, &reboot_requested);
+                    if (reboot_requested)
+                        state.commands_received |= RC_COMMAND_REBOOT;
+                    break;
+                }
+
+                // The first read started an update, the rest of the connection goes through the ota pipeline.
+                if (state.is_doing_ota)
+                {
+                    const esp_err_t err = receive_ota(sock, &state,
+                        receive_buffer + state.ota_header_length, (size_t)received_bytes - state.ota_header_length);
+                    state.is_doing_ota = false;
+                    state.ota_finished = err == ESP_OK;
+                    send_ota_result(sock, err, &state);
+                    break;
+                }
             }
         }
 
@@ -434,6 +650,7 @@ static void rc_ota_task()
 
         shutdown(sock, 0);
         close(sock);
+        radio_release();
 
         process_end(&state);
     }
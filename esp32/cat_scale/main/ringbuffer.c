@@ -15,6 +15,19 @@
 
 static const char *TAG = "ringbuffer";
 
+// Must be called inside the critical section.
+static size_t get_count(const ringbuffer_t *ringbuffer)
+{
+    return (ringbuffer->write_index + ringbuffer->buffer_size_in_items - ringbuffer->read_index) % ringbuffer->buffer_size_in_items;
+}
+
+static void update_high_water(ringbuffer_t *ringbuffer)
+{
+    const size_t count = get_count(ringbuffer);
+    if (count > ringbuffer->count_high_water)
+        ringbuffer->count_high_water = count;
+}
+
 ringbuffer_t *ringbuffer_create(size_t item_size, size_t buffer_size_in_items)
 {
     assert(item_size);
@@ -32,6 +45,8 @@ ringbuffer_t *ringbuffer_create(size_t item_size, size_t buffer_size_in_items)
         .memory = memory,
         .read_index = 0,
         .write_index = 0,
+        .count_high_water = 0,
+        .overflows = 0,
     };
 
     ringbuffer_t * const ringbuffer = malloc(sizeof(ringbuffer_t));
@@ -62,12 +77,38 @@ void ringbuffer_push(ringbuffer_t *ringbuffer, const void *item)
         memcpy(target, item, ringbuffer->item_size);
         ringbuffer->write_index = (ringbuffer->write_index + 1) % ringbuffer->buffer_size_in_items;
         overflow = ringbuffer->write_index == ringbuffer->read_index;
+        if (overflow)
+        {
+            ringbuffer->overflows++;
+            ringbuffer->count_high_water = ringbuffer->buffer_size_in_items - 1;
+        }
+        else
+        {
+            update_high_water(ringbuffer);
+        }
     }
     taskEXIT_CRITICAL(&ringbuffer->spinlock);
 
     if (overflow) ESP_LOGE(TAG, "ring buffer overflow");
 }
 
+void ringbuffer_push_overwrite(ringbuffer_t *ringbuffer, const void *item)
+{
+    assert(ringbuffer);
+    assert(item);
+
+    taskENTER_CRITICAL(&ringbuffer->spinlock);
+    {
+        void * const target = ringbuffer->memory + ringbuffer->item_size * ringbuffer->write_index;
+        memcpy(target, item, ringbuffer->item_size);
+        ringbuffer->write_index = (ringbuffer->write_index + 1) % ringbuffer->buffer_size_in_items;
+        if (ringbuffer->write_index == ringbuffer->read_index)
+            ringbuffer->read_index = (ringbuffer->read_index + 1) % ringbuffer->buffer_size_in_items;
+        update_high_water(ringbuffer);
+    }
+    taskEXIT_CRITICAL(&ringbuffer->spinlock);
+}
+
 bool ringbuffer_try_pop(ringbuffer_t *ringbuffer, void *item)
 {
     assert(ringbuffer);
@@ -88,4 +129,34 @@ bool ringbuffer_try_pop(ringbuffer_t *ringbuffer, void *item)
     taskEXIT_CRITICAL(&ringbuffer->spinlock);
 
     return ret;
+}
+
+size_t ringbuffer_count(ringbuffer_t *ringbuffer)
+{
+    assert(ringbuffer);
+
+    size_t count = 0;
+
+    taskENTER_CRITICAL(&ringbuffer->spinlock);
+    {
+        count = get_count(ringbuffer);
+    }
+    taskEXIT_CRITICAL(&ringbuffer->spinlock);
+
+    return count;
+}
+
+void ringbuffer_get_stats(ringbuffer_t *ringbuffer, ringbuffer_stats_t *stats)
+{
+    assert(ringbuffer);
+    assert(stats);
+
+    taskENTER_CRITICAL(&ringbuffer->spinlock);
+    {
+        stats->capacity = ringbuffer->buffer_size_in_items - 1;
+        stats->count = get_count(ringbuffer);
+        stats->count_high_water = ringbuffer->count_high_water;
+        stats->overflows = ringbuffer->overflows;
+    }
+    taskEXIT_CRITICAL(&ringbuffer->spinlock);
 }
\ No newline at end of file
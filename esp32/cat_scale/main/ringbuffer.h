@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #include <freertos/FreeRTOS.h>
@@ -19,11 +20,24 @@ typedef struct {
     size_t write_index;
     size_t read_index;
 
+    size_t count_high_water;
+    uint32_t overflows;
+
 } ringbuffer_t;
 
+typedef struct {
+    size_t capacity;
+    size_t count;
+    size_t count_high_water;
+    uint32_t overflows;         // ringbuffer_push into a full buffer, which loses the buffered items
+} ringbuffer_stats_t;
+
 
 ringbuffer_t *ringbuffer_create(size_t item_size, size_t buffer_size_in_items);
 void ringbuffer_destroy(ringbuffer_t *ringbuffer);
 
 void ringbuffer_push(ringbuffer_t *ringbuffer, const void *item);
+void ringbuffer_push_overwrite(ringbuffer_t *ringbuffer, const void *item); // drops the oldest item if full
 bool ringbuffer_try_pop(ringbuffer_t *ringbuffer, void *item);
+size_t ringbuffer_count(ringbuffer_t *ringbuffer);
+void ringbuffer_get_stats(ringbuffer_t *ringbuffer, ringbuffer_stats_t *stats);
@@ -0,0 +1,529 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "rpc.h"
+#include "rpc_frame.h"
+#include "settings.h"
+#include "http.h"
+#include "post_queue.h"
+#include "measurement.h"
+#include "log_udp.h"
+#include "metrics.h"
+#include "i2c_bus.h"
+#include "bme280_user.h"
+#include "ccs811.h"
+#include "sensors.h"
+#include "scale_channel.h"
+#include "mqtt_upload.h"
+#include "live_stream.h"
+#include "radio.h"
+
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <esp_system.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <lwip/sockets.h>
+
+static const char *TAG = "rpc";
+
+#define RPC_BUFFER_SIZE     (RPC_FRAME_HEADER_SIZE + RPC_FRAME_MAX_PAYLOAD)
+
+typedef struct {
+    int sock;
+    bool reboot_requested;
+    uint8_t *request;       // RPC_BUFFER_SIZE
+    size_t request_fill;
+    uint8_t *response;      // RPC_BUFFER_SIZE
+} rpc_session_t;
+
+bool rpc_is_session(const void *data, size_t length)
+{
+    return length >= RPC_MAGIC_SIZE && memcmp(data, RPC_MAGIC, RPC_MAGIC_SIZE) == 0;
+}
+
+// Counts go in front of the entries, they are patched in at the end.
+static void patch_count(rpc_writer_t *writer, size_t position, uint16_t count)
+{
+    if (!writer->overflow)
+    {
+        writer->data[position] = count & 0xFF;
+        writer->data[position + 1] = count >> 8;
+    }
+}
+
+static void put_stat(rpc_writer_t *writer, uint16_t *count, const char *name, int64_t value)
+{
+    rpc_put_string(writer, name);
+    rpc_put_i64(writer, value);
+    (*count)++;
+}
+
+static void write_stats(rpc_writer_t *writer)
+{
+    const size_t count_position = writer->length;
+    uint16_t count = 0;
+    rpc_put_u16(writer, 0);
+
+    put_stat(writer, &count, "uptime_ms", esp_timer_get_time() / 1000);
+    put_stat(writer, &count, "free_heap", esp_get_free_heap_size());
+    put_stat(writer, &count, "min_free_heap", esp_get_minimum_free_heap_size());
+
+    {
+        http_client_stats_t stats = {};
+        http_get_client_stats(HTTP_CLIENT_INFLUX, &stats);
+        put_stat(writer, &count, "influx.requests", stats.requests);
+        put_stat(writer, &count, "influx.failures", stats.failures);
+        put_stat(writer, &count, "influx.connects", stats.connects);
+        put_stat(writer, &count, "influx.last_latency_us", stats.last_latency_us);
+        put_stat(writer, &count, "influx.max_latency_us", stats.max_latency_us);
+        put_stat(writer, &count, "influx.body_bytes", stats.body_bytes);
+    }
+
+    {
+        radio_stats_t stats = {};
+        radio_get_stats(&stats);
+        put_stat(writer, &count, "radio.windows", stats.windows);
+        put_stat(writer, &count, "radio.acquired", stats.acquired);
+        put_stat(writer, &count, "radio.awake_time_us", stats.awake_time_us);
+        put_stat(writer, &count, "radio.sleep_time_us", stats.sleep_time_us);
+        put_stat(writer, &count, "radio.avg_current_ma", stats.avg_current_ma);
+    }
+
+    {
+        sensors_upload_stats_t stats = {};
+        sensors_get_upload_stats(&stats);
+        put_stat(writer, &count, "upload.count", stats.uploads);
+        put_stat(writer, &count, "upload.last_latency_ms", stats.last_latency_ms);
+        put_stat(writer, &count, "upload.max_latency_ms", stats.max_latency_ms);
+    }
+
+    {
+        live_stream_stats_t stats = {};
+        live_stream_get_stats(&stats);
+        put_stat(writer, &count, "live.clients", stats.clients);
+        put_stat(writer, &count, "live.records", stats.records);
+        put_stat(writer, &count, "live.queue_dropped", stats.queue_dropped);
+        put_stat(writer, &count, "live.client_dropped", stats.client_dropped);
+        put_stat(writer, &count, "live.stalled", stats.stalled);
+        put_stat(writer, &count, "live.max_latency_us", stats.max_latency_us);
+    }
+
+#if CONFIG_CATSCALE_MQTT
+    {
+        mqtt_upload_stats_t stats = {};
+        mqtt_upload_get_stats(&stats);
+        put_stat(writer, &count, "mqtt.connects", stats.connects);
+        put_stat(writer, &count, "mqtt.disconnects", stats.disconnects);
+        put_stat(writer, &count, "mqtt.messages", stats.messages);
+        put_stat(writer, &count, "mqtt.acked", stats.acked);
+        put_stat(writer, &count, "mqtt.dropped", stats.dropped);
+        put_stat(writer, &count, "mqtt.lines", stats.lines);
+        put_stat(writer, &count, "mqtt.payload_bytes", stats.payload_bytes);
+        put_stat(writer, &count, "mqtt.wire_bytes", stats.wire_bytes);
+        put_stat(writer, &count, "mqtt.last_latency_us", stats.last_latency_us);
+        put_stat(writer, &count, "mqtt.max_latency_us", stats.max_latency_us);
+        put_stat(writer, &count, "mqtt.avg_latency_us", stats.latency_count ? stats.total_latency_us / stats.latency_count : 0);
+        put_stat(writer, &count, "mqtt.publish_time_us", stats.publish_time_us);
+        put_stat(writer, &count, "mqtt.outbox_bytes", stats.outbox_bytes);
+    }
+#endif
+
+    for (int endpoint = 0; endpoint < HTTP_JSON_ENDPOINT_COUNT; endpoint++)
+    {
+        post_queue_status_t status = {};
+        post_queue_get_status(endpoint, &status);
+
+        char name[32];
+        snprintf(name, sizeof(name), "post%d.delivered", endpoint);
+        put_stat(writer, &count, name, status.delivered);
+        snprintf(name, sizeof(name), "post%d.failed", endpoint);
+        put_stat(writer, &count, name, status.failed);
+        snprintf(name, sizeof(name), "post%d.dropped", endpoint);
+        put_stat(writer, &count, name, status.dropped);
+        snprintf(name, sizeof(name), "post%d.queue_level", endpoint);
+        put_stat(writer, &count, name, status.queue_level);
+        snprintf(name, sizeof(name), "post%d.outbox_level", endpoint);
+        put_stat(writer, &count, name, status.outbox_level);
+        snprintf(name, sizeof(name), "post%d.last_latency_us", endpoint);
+        put_stat(writer, &count, name, status.last_latency_us);
+        snprintf(name, sizeof(name), "post%d.max_latency_us", endpoint);
+        put_stat(writer, &count, name, status.max_latency_us);
+    }
+
+    {
+        measurement_pool_status_t status = {};
+        measurement_get_pool_status(&status);
+        put_stat(writer, &count, "events.in_use", status.in_use);
+        put_stat(writer, &count, "events.dropped", status.events_dropped);
+        put_stat(writer, &count, "events.waveforms_truncated", status.waveforms_truncated);
+    }
+
+    {
+        log_udp_stats_t stats = {};
+        log_udp_get_stats(&stats);
+        put_stat(writer, &count, "log.messages", stats.messages);
+        put_stat(writer, &count, "log.dropped", stats.dropped);
+        put_stat(writer, &count, "log.send_errors", stats.send_errors);
+    }
+
+    {
+        bme280_user_stats_t stats = {};
+        bme280_user_get_stats(&stats);
+        put_stat(writer, &count, "bme280.readings", stats.readings);
+        put_stat(writer, &count, "bme280.failures", stats.failures);
+        put_stat(writer, &count, "bme280.compensation_cycles", stats.compensation_cycles);
+        put_stat(writer, &count, "bme280.max_compensation_cycles", stats.max_compensation_cycles);
+        put_stat(writer, &count, "bme280.current_na", stats.current_na);
+    }
+
+    {
+        ccs811_stats_t stats = {};
+        ccs811_get_stats(&stats);
+        put_stat(writer, &count, "ccs811.readings", stats.readings);
+        put_stat(writer, &count, "ccs811.transactions", stats.transactions);
+        put_stat(writer, &count, "ccs811.interrupts", stats.interrupts);
+        put_stat(writer, &count, "ccs811.baseline_restored", stats.baseline_restored);
+        put_stat(writer, &count, "ccs811.baseline_saves", stats.baseline_saves);
+        put_stat(writer, &count, "ccs811.time_to_valid_ms", stats.time_to_valid_ms);
+    }
+
+    for (size_t channel = 0; channel < scale_channel_count(); channel++)
+    {
+        sensors_channel_stats_t stats = {};
+        sensors_get_channel_stats(channel, &stats);
+
+        const char * const scale_id = scale_channel_get(channel)->scale_id;
+
+        char name[32];
+        snprintf(name, sizeof(name), "%s.samples", scale_id);
+        put_stat(writer, &count, name, stats.samples);
+        snprintf(name, sizeof(name), "%s.failures", scale_id);
+        put_stat(writer, &count, name, stats.failures);
+        snprintf(name, sizeof(name), "%s.max_interval_us", scale_id);
+        put_stat(writer, &count, name, stats.max_interval_us);
+        snprintf(name, sizeof(name), "%s.max_busy_us", scale_id);
+        put_stat(writer, &count, name, stats.max_busy_us);
+        snprintf(name, sizeof(name), "%s.total_busy_us", scale_id);
+        put_stat(writer, &count, name, stats.total_busy_us);
+    }
+
+    static const char *i2c_device_names[I2C_BUS_DEVICE_COUNT] = { "bme280", "ccs811" };
+    for (int device = 0; device < I2C_BUS_DEVICE_COUNT; device++)
+    {
+        i2c_bus_stats_t stats = {};
+        i2c_bus_get_stats(device, &stats);
+
+        char name[32];
+        snprintf(name, sizeof(name), "i2c.%s.jobs", i2c_device_names[device]);
+        put_stat(writer, &count, name, stats.jobs);
+        snprintf(name, sizeof(name), "i2c.%s.failures", i2c_device_names[device]);
+        put_stat(writer, &count, name, stats.failures);
+        snprintf(name, sizeof(name), "i2c.%s.dropped", i2c_device_names[device]);
+        put_stat(writer, &count, name, stats.dropped);
+        snprintf(name, sizeof(name), "i2c.%s.max_job_time_us", i2c_device_names[device]);
+        put_stat(writer, &count, name, stats.max_job_time_us);
+    }
+
+    patch_count(writer, count_position, count);
+}
+
+typedef struct {
+    rpc_writer_t *writer;
+    uint16_t count;
+} metrics_writer_t;
+
+static void put_metric(void *context, const char *name, int64_t value)
+{
+    metrics_writer_t * const metrics_writer = context;
+    put_stat(metrics_writer->writer, &metrics_writer->count, name, value);
+}
+
+static rpc_status_t write_metrics(rpc_writer_t *writer)
+{
+    // Not on the stack, the snapshot is large.
+    metrics_snapshot_t * const snapshot = malloc(sizeof(metrics_snapshot_t));
+    if (!snapshot)
+        return RPC_STATUS_FAILED;
+
+    if (!metrics_get_snapshot(snapshot))
+    {
+        free(snapshot);
+        return RPC_STATUS_NOT_FOUND;
+    }
+
+    rpc_put_i64(writer, (esp_timer_get_time() - snapshot->timestamp) / 1000);
+
+    const size_t count_position = writer->length;
+    metrics_writer_t metrics_writer = { .writer = writer, .count = 0 };
+    rpc_put_u16(writer, 0);
+
+    metrics_for_each_field(snapshot, put_metric, &metrics_writer);
+
+    for (size_t i = 0; i < snapshot->task_count; i++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "task.%s.cpu_permille", snapshot->tasks[i].name);
+        put_metric(&metrics_writer, name, snapshot->tasks[i].cpu_permille);
+        snprintf(name, sizeof(name), "task.%s.stack_free", snapshot->tasks[i].name);
+        put_metric(&metrics_writer, name, snapshot->tasks[i].stack_free);
+    }
+
+    patch_count(writer, count_position, metrics_writer.count);
+
+    free(snapshot);
+    return RPC_STATUS_OK;
+}
+
+static void write_setting(rpc_writer_t *writer, setting_id_t id)
+{
+    const setting_info_t * const info = settings_get_info(id);
+
+    rpc_put_u16(writer, (uint16_t)id);
+    rpc_put_u8(writer, info->integer ? RPC_SETTING_FLAG_INTEGER : 0);
+    rpc_put_double(writer, settings_get(id));
+    rpc_put_double(writer, info->min);
+    rpc_put_double(writer, info->max);
+    rpc_put_double(writer, info->default_value);
+    rpc_put_string(writer, info->name);
+    rpc_put_string(writer, info->unit);
+}
+
+static rpc_status_t handle_request(rpc_session_t *session, uint8_t command, rpc_reader_t *request, rpc_writer_t *response)
+{
+    switch (command)
+    {
+        case RPC_COMMAND_PING:
+            return RPC_STATUS_OK;
+
+        case RPC_COMMAND_LIST_SETTINGS:
+        {
+            const uint16_t index = rpc_get_u16(request);
+            if (request->error)
+                return RPC_STATUS_INVALID_REQUEST;
+            if (index >= SETTING_COUNT)
+                return RPC_STATUS_NOT_FOUND;
+
+            write_setting(response, index);
+            return RPC_STATUS_OK;
+        }
+
+        case RPC_COMMAND_GET_SETTING:
+        case RPC_COMMAND_SET_SETTING:
+        {
+            const uint16_t id = rpc_get_u16(request);
+            const double value = command == RPC_COMMAND_SET_SETTING ? rpc_get_double(request) : 0.0;
+            if (request->error)
+                return RPC_STATUS_INVALID_REQUEST;
+            if (id >= SETTING_COUNT)
+                return RPC_STATUS_NOT_FOUND;
+
+            if (command == RPC_COMMAND_SET_SETTING && settings_set(id, value) != ESP_OK)
+                return RPC_STATUS_OUT_OF_RANGE;
+
+            rpc_put_u16(response, id);
+            rpc_put_double(response, settings_get(id));
+            return RPC_STATUS_OK;
+        }
+
+        case RPC_COMMAND_SAVE_SETTINGS:
+            return settings_save() == ESP_OK ? RPC_STATUS_OK : RPC_STATUS_FAILED;
+
+        case RPC_COMMAND_RESET_SETTINGS:
+            settings_reset();
+            return RPC_STATUS_OK;
+
+        case RPC_COMMAND_GET_LOG_LEVELS:
+        {
+            settings_log_level_t levels[SETTINGS_LOG_LEVEL_COUNT];
+            const size_t count = settings_get_log_levels(levels, SETTINGS_LOG_LEVEL_COUNT);
+
+            rpc_put_u8(response, (uint8_t)count);
+            for (size_t i = 0; i < count; i++)
+            {
+                rpc_put_string(response, levels[i].tag);
+                rpc_put_u8(response, levels[i].level);
+            }
+            return RPC_STATUS_OK;
+        }
+
+        case RPC_COMMAND_SET_LOG_LEVEL:
+        {
+            char tag[SETTINGS_LOG_TAG_SIZE] = {};
+            rpc_get_string(request, tag, sizeof(tag));
+            const uint8_t level = rpc_get_u8(request);
+            if (request->error)
+                return RPC_STATUS_INVALID_REQUEST;
+
+            const esp_err_t ret = settings_set_log_level(tag, level);
+            if (ret == ESP_ERR_INVALID_ARG)
+                return RPC_STATUS_OUT_OF_RANGE;
+            return ret == ESP_OK ? RPC_STATUS_OK : RPC_STATUS_FAILED;
+        }
+
+        case RPC_COMMAND_GET_STATS:
+            write_stats(response);
+            return RPC_STATUS_OK;
+
+        case RPC_COMMAND_GET_METRICS:
+            return write_metrics(response);
+
+        case RPC_COMMAND_REBOOT:
+            session->reboot_requested = true;
+            return RPC_STATUS_OK;
+
+        default:
+            return RPC_STATUS_UNKNOWN_COMMAND;
+    }
+}
+
+static esp_err_t send_all(int sock, const void *data, size_t length)
+{
+    const uint8_t *p = data;
+    while (length > 0)
+    {
+        const int sent = send(sock, p, length, 0);
+        if (sent < 0)
+        {
+            ESP_LOGE(TAG, "Error while sending: errno %d", errno);
+            return ESP_FAIL;
+        }
+        p += sent;
+        length -= (size_t)sent;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t process_frame(rpc_session_t *session, const rpc_frame_header_t *header, const uint8_t *payload)
+{
+    rpc_reader_t request;
+    rpc_reader_init(&request, payload, header->length);
+
+    rpc_writer_t response;
+    rpc_writer_init(&response, session->response + RPC_FRAME_HEADER_SIZE, RPC_FRAME_MAX_PAYLOAD);
+    rpc_put_u8(&response, RPC_STATUS_OK);
+
+    rpc_status_t status = handle_request(session, header->command, &request, &response);
+    if (response.overflow)
+    {
+        ESP_LOGE(TAG, "response to command %02X does not fit", header->command);
+        status = RPC_STATUS_FAILED;
+    }
+    // Errors are answered with the status only.
+    if (status != RPC_STATUS_OK)
+    {
+        rpc_writer_init(&response, session->response + RPC_FRAME_HEADER_SIZE, RPC_FRAME_MAX_PAYLOAD);
+        rpc_put_u8(&response, status);
+    }
+
+    ESP_LOGD(TAG, "command %02X: %s", header->command, rpc_status_to_name(status));
+
+    const rpc_frame_header_t response_header = {
+        .command = header->command | RPC_RESPONSE_FLAG,
+        .sequence = header->sequence,
+        .length = (uint16_t)response.length,
+    };
+    rpc_frame_encode_header(&response_header, session->response);
+
+    return send_all(session->sock, session->response, RPC_FRAME_HEADER_SIZE + response.length);
+}
+
+// Processes all complete frames in the request buffer and keeps the rest for the next read.
+static esp_err_t process_request_buffer(rpc_session_t *session)
+{
+    size_t position = 0;
+
+    while (session->request_fill - position >= RPC_FRAME_HEADER_SIZE)
+    {
+        rpc_frame_header_t header = {};
+        if (!rpc_frame_decode_header(session->request + position, &header))
+        {
+            ESP_LOGE(TAG, "invalid frame (%u bytes payload)", header.length);
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        if (session->request_fill - position < RPC_FRAME_HEADER_SIZE + header.length)
+            break;
+
+        const esp_err_t ret = process_frame(session, &header, session->request + position + RPC_FRAME_HEADER_SIZE);
+        if (ret != ESP_OK)
+            return ret;
+
+        position += RPC_FRAME_HEADER_SIZE + header.length;
+    }
+
+    memmove(session->request, session->request + position, session->request_fill - position);
+    session->request_fill -= position;
+    return ESP_OK;
+}
+
+esp_err_t rpc_serve(int sock, const void *initial, size_t initial_length, bool *reboot_requested)
+{
+    assert(rpc_is_session(initial, initial_length));
+    assert(reboot_requested);
+
+    ESP_LOGI(TAG, "rpc session started");
+
+    rpc_session_t session = {
+        .sock = sock,
+        .reboot_requested = false,
+        .request = malloc(RPC_BUFFER_SIZE),
+        .request_fill = 0,
+        .response = malloc(RPC_BUFFER_SIZE),
+    };
+
+    esp_err_t ret = ESP_OK;
+    if (!session.request || !session.response)
+        ret = ESP_ERR_NO_MEM;
+
+    const uint8_t *pending = (const uint8_t *)initial + RPC_MAGIC_SIZE;
+    size_t pending_length = initial_length - RPC_MAGIC_SIZE;
+
+    while (ret == ESP_OK)
+    {
+        // The first read may hold more than fits, it is consumed in pieces.
+        while (ret == ESP_OK && pending_length > 0)
+        {
+            size_t length = RPC_BUFFER_SIZE - session.request_fill;
+            if (length > pending_length)
+                length = pending_length;
+
+            memcpy(session.request + session.request_fill, pending, length);
+            session.request_fill += length;
+            pending += length;
+            pending_length -= length;
+
+            ret = process_request_buffer(&session);
+        }
+        if (ret != ESP_OK)
+            break;
+
+        const int received_bytes = recv(sock, session.request + session.request_fill, RPC_BUFFER_SIZE - session.request_fill, 0);
+        if (received_bytes < 0)
+        {
+            ESP_LOGE(TAG, "Error while receiving: errno %d", errno);
+            ret = ESP_FAIL;
+            break;
+        }
+        if (received_bytes == 0)
+            break;
+
+        session.request_fill += (size_t)received_bytes;
+        ret = process_request_buffer(&session);
+    }
+
+    if (session.request_fill > 0)
+        ESP_LOGW(TAG, "%u bytes of an incomplete frame left", session.request_fill);
+
+    free(session.request);
+    free(session.response);
+
+    ESP_LOGI(TAG, "rpc session ended: %s", esp_err_to_name(ret));
+
+    *reboot_requested = session.reboot_requested;
+    return ret;
+}
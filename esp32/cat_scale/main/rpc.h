@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+
+// True if the first read of a rc connection starts a rpc session (see rpc_frame.h).
+bool rpc_is_session(const void *data, size_t length);
+
+// Answers requests until the client closes the connection.
+// initial: what was received with the first read, starting with the magic.
+// reboot_requested is set if the client asked for a restart, which is up to the caller.
+esp_err_t rpc_serve(int sock, const void *initial, size_t initial_length, bool *reboot_requested);
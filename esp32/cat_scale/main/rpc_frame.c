@@ -0,0 +1,207 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "rpc_frame.h"
+
+#include <string.h>
+#include <assert.h>
+
+void rpc_frame_encode_header(const rpc_frame_header_t *header, uint8_t *data)
+{
+    assert(header);
+    assert(data);
+    assert(header->length <= RPC_FRAME_MAX_PAYLOAD);
+
+    data[0] = header->command;
+    data[1] = header->sequence;
+    data[2] = header->length & 0xFF;
+    data[3] = header->length >> 8;
+}
+
+bool rpc_frame_decode_header(const uint8_t *data, rpc_frame_header_t *header)
+{
+    assert(data);
+    assert(header);
+
+    header->command = data[0];
+    header->sequence = data[1];
+    header->length = (uint16_t)(data[2] | (data[3] << 8));
+
+    return header->length <= RPC_FRAME_MAX_PAYLOAD;
+}
+
+const char *rpc_status_to_name(uint8_t status)
+{
+    switch (status)
+    {
+        case RPC_STATUS_OK:                 return "ok";
+        case RPC_STATUS_UNKNOWN_COMMAND:    return "unknown command";
+        case RPC_STATUS_INVALID_REQUEST:    return "invalid request";
+        case RPC_STATUS_NOT_FOUND:          return "not found";
+        case RPC_STATUS_OUT_OF_RANGE:       return "out of range";
+        case RPC_STATUS_FAILED:             return "failed";
+        default:                            return "unknown status";
+    }
+}
+
+void rpc_writer_init(rpc_writer_t *writer, uint8_t *data, size_t size)
+{
+    assert(writer);
+    assert(data);
+
+    writer->data = data;
+    writer->size = size;
+    writer->length = 0;
+    writer->overflow = false;
+}
+
+static void put_bytes(rpc_writer_t *writer, const void *data, size_t length)
+{
+    assert(writer);
+
+    if (writer->overflow || writer->size - writer->length < length)
+    {
+        writer->overflow = true;
+        return;
+    }
+
+    memcpy(writer->data + writer->length, data, length);
+    writer->length += length;
+}
+
+static void put_le(rpc_writer_t *writer, uint64_t value, size_t size)
+{
+    uint8_t bytes[8];
+    for (size_t i = 0; i < size; i++)
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    put_bytes(writer, bytes, size);
+}
+
+void rpc_put_u8(rpc_writer_t *writer, uint8_t value)
+{
+    put_le(writer, value, 1);
+}
+
+void rpc_put_u16(rpc_writer_t *writer, uint16_t value)
+{
+    put_le(writer, value, 2);
+}
+
+void rpc_put_u32(rpc_writer_t *writer, uint32_t value)
+{
+    put_le(writer, value, 4);
+}
+
+void rpc_put_i64(rpc_writer_t *writer, int64_t value)
+{
+    put_le(writer, (uint64_t)value, 8);
+}
+
+void rpc_put_double(rpc_writer_t *writer, double value)
+{
+    static_assert(sizeof(double) == sizeof(uint64_t), "double is not 64 bit");
+
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    put_le(writer, bits, 8);
+}
+
+void rpc_put_string(rpc_writer_t *writer, const char *value)
+{
+    assert(value);
+
+    size_t length = strlen(value);
+    if (length > UINT8_MAX)
+        length = UINT8_MAX;
+
+    rpc_put_u8(writer, (uint8_t)length);
+    put_bytes(writer, value, length);
+}
+
+void rpc_reader_init(rpc_reader_t *reader, const uint8_t *data, size_t length)
+{
+    assert(reader);
+    assert(data || length == 0);
+
+    reader->data = data;
+    reader->length = length;
+    reader->position = 0;
+    reader->error = false;
+}
+
+static const uint8_t *get_bytes(rpc_reader_t *reader, size_t length)
+{
+    assert(reader);
+
+    if (reader->error || reader->length - reader->position < length)
+    {
+        reader->error = true;
+        return NULL;
+    }
+
+    const uint8_t * const p = reader->data + reader->position;
+    reader->position += length;
+    return p;
+}
+
+static uint64_t get_le(rpc_reader_t *reader, size_t size)
+{
+    const uint8_t * const p = get_bytes(reader, size);
+    if (!p)
+        return 0;
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+        value |= (uint64_t)p[i] << (8 * i);
+    return value;
+}
+
+uint8_t rpc_get_u8(rpc_reader_t *reader)
+{
+    return (uint8_t)get_le(reader, 1);
+}
+
+uint16_t rpc_get_u16(rpc_reader_t *reader)
+{
+    return (uint16_t)get_le(reader, 2);
+}
+
+uint32_t rpc_get_u32(rpc_reader_t *reader)
+{
+    return (uint32_t)get_le(reader, 4);
+}
+
+int64_t rpc_get_i64(rpc_reader_t *reader)
+{
+    return (int64_t)get_le(reader, 8);
+}
+
+double rpc_get_double(rpc_reader_t *reader)
+{
+    const uint64_t bits = get_le(reader, 8);
+
+    double value = 0.0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void rpc_get_string(rpc_reader_t *reader, char *value, size_t size)
+{
+    assert(value);
+    assert(size > 0);
+
+    value[0] = '\0';
+
+    const size_t length = rpc_get_u8(reader);
+    const uint8_t * const p = get_bytes(reader, length);
+    if (!p)
+        return;
+
+    if (length >= size)
+    {
+        reader->error = true;
+        return;
+    }
+
+    memcpy(value, p, length);
+    value[length] = '\0';
+}
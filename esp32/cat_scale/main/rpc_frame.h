@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Wire format of the rpc on the rc socket: the client starts the connection with the magic "CSRP"
+// (instead of an ota header or a text command) and then sends requests, the device answers every one of them.
+//
+// Frame (little endian): command (uint8), sequence (uint8), payload length (uint16), payload.
+// The response repeats the sequence, has RPC_RESPONSE_FLAG set in the command and starts its payload with a status (uint8).
+//
+// Payload fields: integers and doubles (IEEE 754) little endian, strings as length (uint8) followed by the characters.
+
+#define RPC_MAGIC                   "CSRP"
+#define RPC_MAGIC_SIZE              (4)
+#define RPC_FRAME_HEADER_SIZE       (4)
+#define RPC_FRAME_MAX_PAYLOAD       (4096)
+#define RPC_RESPONSE_FLAG           (0x80)
+
+typedef enum {
+    RPC_COMMAND_PING            = 0x01, // -> nothing
+    RPC_COMMAND_LIST_SETTINGS   = 0x02, // index (uint16) -> id (uint16), flags (uint8), value, min, max, default (double), name, unit
+    RPC_COMMAND_GET_SETTING     = 0x03, // id (uint16) -> id (uint16), value (double)
+    RPC_COMMAND_SET_SETTING     = 0x04, // id (uint16), value (double) -> id (uint16), value (double)
+    RPC_COMMAND_SAVE_SETTINGS   = 0x05, // -> nothing
+    RPC_COMMAND_RESET_SETTINGS  = 0x06, // -> nothing
+    RPC_COMMAND_GET_LOG_LEVELS  = 0x07, // -> count (uint8), count * (tag, level (uint8))
+    RPC_COMMAND_SET_LOG_LEVEL   = 0x08, // tag, level (uint8) -> nothing
+    RPC_COMMAND_GET_STATS       = 0x09, // -> count (uint16), count * (name, value (int64))
+    RPC_COMMAND_REBOOT          = 0x0A, // -> nothing, the device restarts after the connection was closed
+    RPC_COMMAND_GET_METRICS     = 0x0B, // -> age in ms (int64), count (uint16), count * (name, value (int64)), see metrics_snapshot.h
+} rpc_command_t;
+
+typedef enum {
+    RPC_STATUS_OK = 0,
+    RPC_STATUS_UNKNOWN_COMMAND,
+    RPC_STATUS_INVALID_REQUEST,     // payload too short or malformed
+    RPC_STATUS_NOT_FOUND,
+    RPC_STATUS_OUT_OF_RANGE,
+    RPC_STATUS_FAILED,
+} rpc_status_t;
+
+#define RPC_SETTING_FLAG_INTEGER    (0x01)
+
+typedef struct {
+    uint8_t command;
+    uint8_t sequence;
+    uint16_t length;        // of the payload
+} rpc_frame_header_t;
+
+void rpc_frame_encode_header(const rpc_frame_header_t *header, uint8_t *data);
+
+// Returns false if the payload would be larger than RPC_FRAME_MAX_PAYLOAD.
+bool rpc_frame_decode_header(const uint8_t *data, rpc_frame_header_t *header);
+
+const char *rpc_status_to_name(uint8_t status);
+
+// Builds a payload. Writing past the end sets overflow, the payload is not usable then.
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t length;
+    bool overflow;
+} rpc_writer_t;
+
+void rpc_writer_init(rpc_writer_t *writer, uint8_t *data, size_t size);
+void rpc_put_u8(rpc_writer_t *writer, uint8_t value);
+void rpc_put_u16(rpc_writer_t *writer, uint16_t value);
+void rpc_put_u32(rpc_writer_t *writer, uint32_t value);
+void rpc_put_i64(rpc_writer_t *writer, int64_t value);
+void rpc_put_double(rpc_writer_t *writer, double value);
+// Strings longer than 255 characters are truncated.
+void rpc_put_string(rpc_writer_t *writer, const char *value);
+
+// Reads a payload. Reading past the end sets error and returns zeros.
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t position;
+    bool error;
+} rpc_reader_t;
+
+void rpc_reader_init(rpc_reader_t *reader, const uint8_t *data, size_t length);
+uint8_t rpc_get_u8(rpc_reader_t *reader);
+uint16_t rpc_get_u16(rpc_reader_t *reader);
+uint32_t rpc_get_u32(rpc_reader_t *reader);
+int64_t rpc_get_i64(rpc_reader_t *reader);
+double rpc_get_double(rpc_reader_t *reader);
+// Always terminates value. Strings which don't fit are an error.
+void rpc_get_string(rpc_reader_t *reader, char *value, size_t size);
@@ -0,0 +1,37 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "scale_channel.h"
+
+#include "sdkconfig.h"
+
+#include <assert.h>
+
+#include <driver/gpio.h>
+
+static_assert(CONFIG_CATSCALE_SCALE_CHANNELS >= 1 && CONFIG_CATSCALE_SCALE_CHANNELS <= SCALE_CHANNEL_MAX,
+    "CONFIG_CATSCALE_SCALE_CHANNELS out of range");
+
+// The first CONFIG_CATSCALE_SCALE_CHANNELS entries are used.
+// Channels on the same clock line are read together, see hx711.h.
+static const scale_channel_config_t g_channels[SCALE_CHANNEL_MAX] = {
+    { .hx711 = { GPIO_NUM_18, GPIO_NUM_19 }, .toilet_id = 1, .scale_id = "CAT1" },
+    { .hx711 = { GPIO_NUM_18, GPIO_NUM_21 }, .toilet_id = 2, .scale_id = "CAT2" },
+    { .hx711 = { GPIO_NUM_22, GPIO_NUM_23 }, .toilet_id = 3, .scale_id = "CAT3" },
+    { .hx711 = { GPIO_NUM_22, GPIO_NUM_25 }, .toilet_id = 4, .scale_id = "CAT4" },
+};
+
+size_t scale_channel_count(void)
+{
+    return CONFIG_CATSCALE_SCALE_CHANNELS;
+}
+
+const scale_channel_config_t *scale_channel_get(size_t channel)
+{
+    assert(channel < CONFIG_CATSCALE_SCALE_CHANNELS);
+    return &g_channels[channel];
+}
+
+const char *scale_channel_device_scale_id(void)
+{
+    return g_channels[0].scale_id;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "hx711.h"
+
+// The scales connected to this device, one hx711 each. Every channel has its own filter cascade, sample buffers
+// and toilet id, the channels of a device share the upload and the environment sensors.
+#define SCALE_CHANNEL_MAX   (HX711_MAX_CHANNELS)
+
+// Of every channel.
+#define FAST_SAMPLES_PER_SECOND (10)
+
+typedef struct {
+    hx711_channel_config_t hx711;
+    int toilet_id;          // of the scale events
+    const char *scale_id;   // tag of the samples in influx
+} scale_channel_config_t;
+
+// CONFIG_CATSCALE_SCALE_CHANNELS
+size_t scale_channel_count(void);
+
+const scale_channel_config_t *scale_channel_get(size_t channel);
+
+// Tag of the values which belong to the device rather than to one of its scales, the one of the first channel.
+const char *scale_channel_device_scale_id(void);
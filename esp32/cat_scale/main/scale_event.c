@@ -0,0 +1,143 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "scale_event.h"
+#include "time.h"
+
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include <esp_log.h>
+
+static const char *TAG = "scale_event";
+
+void scale_event_reset(scale_event_t *scale_event, int toilet_id, int64_t start, uint8_t *waveform_buffer, size_t waveform_buffer_size)
+{
+    assert(scale_event);
+
+    scale_event->toilet_id = toilet_id;
+    scale_event->start = start;
+    scale_event->end = 0;
+    scale_event->stable_phase_count = 0;
+    scale_event->stable_phases_dropped = 0;
+    scale_event->temperature = 0.0;
+    scale_event->humidity = 0.0;
+    scale_event->pressure = 0.0;
+
+    scale_event->waveform = (waveform_t){
+        .data = waveform_buffer,
+        .capacity = waveform_buffer ? waveform_buffer_size : 0,
+    };
+}
+
+void scale_event_add_stable_phase(scale_event_t *scale_event, int64_t timestamp, double length, double value)
+{
+    assert(scale_event);
+
+    if (scale_event->stable_phase_count >= CONFIG_CATSCALE_EVENT_MAX_STABLE_PHASES) {
+        ESP_LOGW(TAG, "Too many stable phases, dropping");
+        scale_event->stable_phases_dropped++;
+        return;
+    }
+
+    stable_phase_t * const stable_phase = &scale_event->stable_phases[scale_event->stable_phase_count++];
+    stable_phase->timestamp = timestamp;
+    stable_phase->length = length;
+    stable_phase->value = value;
+}
+
+static size_t encode_varint(int64_t value, uint8_t *output)
+{
+    // zigzag: small negative numbers become small positive numbers
+    uint64_t n = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    size_t length = 0;
+
+    while (n >= 0x80) {
+        output[length++] = (uint8_t)(n | 0x80);
+        n >>= 7;
+    }
+    output[length++] = (uint8_t)n;
+
+    return length;
+}
+
+void scale_event_add_sample(scale_event_t *scale_event, int64_t timestamp, double raw, double weight)
+{
+    assert(scale_event);
+
+    waveform_t * const waveform = &scale_event->waveform;
+    if (!waveform->data || waveform->truncated)
+        return;
+
+    const int64_t time_ms = (timestamp - scale_event->start) / 1000;
+    const int64_t raw_value = llround(raw);
+    const int64_t weight_value = llround(weight * 10.0);
+
+    uint8_t encoded[3 * 10] = {};
+    size_t length = 0;
+    length += encode_varint(time_ms - waveform->last_time_ms, encoded + length);
+    length += encode_varint(raw_value - waveform->last_raw, encoded + length);
+    length += encode_varint(weight_value - waveform->last_weight, encoded + length);
+
+    // Keep the beginning of the event, that's where the cat enters the scale.
+    if (waveform->length + length > waveform->capacity) {
+        ESP_LOGW(TAG, "Waveform buffer full after %"PRIu32" samples", waveform->sample_count);
+        waveform->truncated = true;
+        return;
+    }
+
+    memcpy(waveform->data + waveform->length, encoded, length);
+    waveform->length += length;
+    waveform->sample_count++;
+    waveform->last_time_ms = time_ms;
+    waveform->last_raw = raw_value;
+    waveform->last_weight = weight_value;
+}
+
+void scale_event_write_json(const scale_event_t *scale_event, bool compact, int64_t unix_offset_us, json_writer_t *writer)
+{
+    assert(scale_event);
+    assert(writer);
+
+    char time_buffer[TIME_ISO8601_BUFFER_SIZE] = {};
+
+    json_writer_begin_object(writer, NULL);
+    json_writer_int(writer, "toiletId", scale_event->toilet_id);
+
+    time_format_iso8601(scale_event->start + unix_offset_us, time_buffer, sizeof(time_buffer));
+    json_writer_string(writer, "startTime", time_buffer);
+
+    time_format_iso8601(scale_event->end + unix_offset_us, time_buffer, sizeof(time_buffer));
+    json_writer_string(writer, "endTime", time_buffer);
+
+    json_writer_double(writer, "temperature", scale_event->temperature, 2);    // °C
+    json_writer_double(writer, "humidity", scale_event->humidity, 2);          // %
+    json_writer_double(writer, "pressure", scale_event->pressure, 1);          // Pa
+
+    json_writer_begin_array(writer, "stablePhases");
+    for (size_t i = 0; i < scale_event->stable_phase_count; i++)
+    {
+        const stable_phase_t * const stable_phase = &scale_event->stable_phases[i];
+
+        time_format_iso8601(stable_phase->timestamp + unix_offset_us, time_buffer, sizeof(time_buffer));
+
+        json_writer_begin_object(writer, NULL);
+        json_writer_string(writer, "timestamp", time_buffer);
+        json_writer_double(writer, "length", stable_phase->length, 1);
+        json_writer_double(writer, "value", stable_phase->value, 1);
+        json_writer_end_object(writer);
+    }
+    json_writer_end_array(writer);
+
+    const waveform_t * const waveform = &scale_event->waveform;
+    if (!compact && waveform->sample_count > 0)
+    {
+        json_writer_begin_object(writer, "waveform");
+        json_writer_int(writer, "sampleCount", waveform->sample_count);
+        json_writer_bool(writer, "truncated", waveform->truncated);
+        json_writer_base64(writer, "data", waveform->data, waveform->length);
+        json_writer_end_object(writer);
+    }
+
+    json_writer_end_object(writer);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#include "sdkconfig.h"
+#include "json_writer.h"
+
+// All timestamps are µs since boot (esp_timer), they are converted to UTC when the event is serialized.
+// That way events recorded before the clock was synchronized get correct timestamps as well.
+
+typedef struct {
+    int64_t timestamp;
+    double length;
+    double value;
+} stable_phase_t;
+
+// Raw and filtered samples of an event, delta encoded as they arrive (format: see WaveformCodec on the server).
+typedef struct {
+    uint8_t *data;
+    size_t capacity;
+    size_t length;
+    uint32_t sample_count;
+    bool truncated;
+    int64_t last_time_ms;
+    int64_t last_raw;
+    int64_t last_weight;    // 0.1 g
+} waveform_t;
+
+// Everything is stored inline, the memory (including the waveform buffer) is provided by the owner.
+typedef struct {
+    int toilet_id;
+    int64_t start;
+    int64_t end;
+    stable_phase_t stable_phases[CONFIG_CATSCALE_EVENT_MAX_STABLE_PHASES];
+    size_t stable_phase_count;
+    uint32_t stable_phases_dropped;
+    double temperature;
+    double humidity;
+    double pressure;
+    waveform_t waveform;
+} scale_event_t;
+
+// waveform_buffer may be NULL, no waveform is recorded then.
+void scale_event_reset(scale_event_t *scale_event, int toilet_id, int64_t start, uint8_t *waveform_buffer, size_t waveform_buffer_size);
+
+// When the array is full, the first phases are kept and later ones are only counted.
+void scale_event_add_stable_phase(scale_event_t *scale_event, int64_t timestamp, double length, double value);
+
+// When the waveform buffer is full, the beginning is kept and the waveform is marked as truncated.
+void scale_event_add_sample(scale_event_t *scale_event, int64_t timestamp, double raw, double weight);
+
+// compact: leave out the waveform. unix_offset_us: added to the timestamps to get unix time.
+void scale_event_write_json(const scale_event_t *scale_event, bool compact, int64_t unix_offset_us, json_writer_t *writer);
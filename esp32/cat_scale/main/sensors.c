@@ -10,13 +10,22 @@
 #include "measurement.h"
 #include "filters.h"
 #include "filter_cascade.h"
+#include "settings.h"
+#include "metrics.h"
 #include "ringbuffer.h"
+#include "i2c_bus.h"
+#include "scale_channel.h"
+#include "mqtt_upload.h"
+#include "live_stream.h"
+#include "radio.h"
 
 #include "sdkconfig.h"
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <math.h>
+#include <inttypes.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -25,19 +34,22 @@
 #include <esp_system.h>
 #include <esp_log.h>
 #include <esp_timer.h>
-
-#include <driver/i2c.h>
+#include <esp_attr.h>
+#include <sys/time.h>
 
 static const char *TAG = "sensors";
 
+// Timestamps are µs since boot (esp_timer), converted to unix-time when uploaded.
+// Sampling starts before the clock is synchronized, this way the early samples get correct timestamps as well.
+
 typedef struct {
-    uint64_t timestamp; // unix-time in ns
+    int64_t timestamp;
     double weight_raw;
     double weight;
 } fast_sensor_data_t;
 
 typedef struct {
-    uint64_t timestamp; // unix-time in ns
+    int64_t timestamp;
     double temperature;
     double pressure;
     double humidity;
@@ -45,14 +57,79 @@ typedef struct {
     uint32_t tvoc;
 } slow_sensor_data_t;
 
+typedef struct {
+    int64_t timestamp;  // start of the interval
+    double weight_raw_mean;
+    double weight_min;
+    double weight_max;
+    double weight_mean;
+    uint32_t count;
+} aggregate_sensor_data_t;
+
 static_assert(sizeof(fast_sensor_data_t) == 24);
 static_assert(sizeof(slow_sensor_data_t) == 40);
 
-static ringbuffer_t *sensor_ringbuffer_fast_data = NULL;
+#ifdef CONFIG_CATSCALE_UPLOAD_ADAPTIVE
+#define UPLOAD_ADAPTIVE (true)
+#else
+#define UPLOAD_ADAPTIVE (false)
+#endif
+
+#define HX711_POLL_INTERVAL_MS (10)
+#define CHANNEL_REPORT_INTERVAL_S (60)
+#define ENVIRONMENT_READ_INTERVAL_MS (1000)
+
+// Adaptive upload: While the scale is idle only per-interval aggregates of the weight are uploaded.
+// Raw samples are uploaded from CONFIG_CATSCALE_UPLOAD_PRE_TRIGGER_S before the start of an event
+// until SETTING_UPLOAD_POST_TRIGGER after its end.
+typedef struct {
+    bool capturing;
+    int64_t capture_end_time;       // µs since boot
+    int64_t aggregate_start_time;   // µs since boot
+    double weight_sum;
+    double weight_raw_sum;
+    aggregate_sensor_data_t aggregate;
+} upload_state_t;
+
+// A scale, see scale_channel.h. The ring buffers are emptied by the post task, the rest belongs to the read task.
+typedef struct {
+    size_t index;
+    const scale_channel_config_t *config;
+    filter_cascade_t *cascade;
+    ringbuffer_t *fast_data;
+    ringbuffer_t *fast_history;     // pre-trigger samples, only uploaded if an event starts
+    ringbuffer_t *aggregate_data;
+    upload_state_t upload_state;
+    int64_t last_read_time;         // µs since boot
+    uint32_t live_sequence;
+} channel_t;
+
+static channel_t g_channels[SCALE_CHANNEL_MAX] = {};
+static size_t g_channel_count = 0;
+
 static ringbuffer_t *sensor_ringbuffer_slow_data = NULL;
 
-static esp_err_t i2c_master_init(void);
+static portMUX_TYPE g_stats_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static sensors_channel_stats_t g_channel_stats[SCALE_CHANNEL_MAX] = {};
+static sensors_upload_stats_t g_upload_stats = {};
+
+static volatile int64_t first_sample_time = 0; // µs since boot, 0 until the first valid sample
+
+// Filter state of the idle scales in rtc memory, it survives software resets (ota, reboot command, watchdog) but not a power loss.
+#define FILTER_CHECKPOINT_MAGIC (0x46435031) // "FCP1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t checksum;
+    int64_t saved_at;   // system time in µs, which keeps running across software resets
+    filter_cascade_state_t state;
+} filter_checkpoint_t;
+
+static RTC_NOINIT_ATTR filter_checkpoint_t g_filter_checkpoints[SCALE_CHANNEL_MAX];
+
+static void restore_filter_checkpoint(channel_t *channel);
 static void sensors_read_task(void*);
+static void sensors_environment_task(void*);
 static void sensors_post_task(void*);
 
 esp_err_t sensors_init()
@@ -60,81 +137,183 @@ esp_err_t sensors_init()
     esp_log_level_set(TAG, ESP_LOG_DEBUG);
     ESP_LOGI(TAG, "sensors_init");
 
+    g_channel_count = scale_channel_count();
+
     // GPIO sensors.
-    ESP_ERROR_CHECK(hx711_init());
+    hx711_channel_config_t hx711_channels[SCALE_CHANNEL_MAX] = {};
+    for (size_t i = 0; i < g_channel_count; i++)
+        hx711_channels[i] = scale_channel_get(i)->hx711;
+    ESP_ERROR_CHECK(hx711_init(hx711_channels, g_channel_count));
     
     // I2C sensors.
-    ESP_ERROR_CHECK(i2c_master_init());
-    ESP_ERROR_CHECK(bme280_user_init());
+    ESP_ERROR_CHECK(i2c_bus_init());
+    ESP_ERROR_CHECK(bme280_user_init(ENVIRONMENT_READ_INTERVAL_MS));
     ESP_ERROR_CHECK(ccs811_init());
 
-    filter_cascade_init();
+    static const setting_id_t calibrations[SCALE_CHANNEL_MAX] = {
+        SETTING_CALIBRATION_FACTOR,
+        SETTING_CALIBRATION_FACTOR_2,
+        SETTING_CALIBRATION_FACTOR_3,
+        SETTING_CALIBRATION_FACTOR_4,
+    };
+
+    for (size_t i = 0; i < g_channel_count; i++)
+    {
+        channel_t * const channel = &g_channels[i];
+        channel->index = i;
+        channel->config = scale_channel_get(i);
+
+        channel->cascade = filter_cascade_create(i, calibrations[i]);
+        restore_filter_checkpoint(channel);
+
+        // 60 s, the maximum of SETTING_UPLOAD_POST_INTERVAL is below that.
+        channel->fast_data = ringbuffer_create(sizeof(fast_sensor_data_t), FAST_SAMPLES_PER_SECOND * 60);
+        channel->fast_history = ringbuffer_create(sizeof(fast_sensor_data_t),
+            FAST_SAMPLES_PER_SECOND * CONFIG_CATSCALE_UPLOAD_PRE_TRIGGER_S + 1);
+        channel->aggregate_data = ringbuffer_create(sizeof(aggregate_sensor_data_t),
+            CONFIG_CATSCALE_UPLOAD_IDLE_POST_INTERVAL_S / CONFIG_CATSCALE_UPLOAD_AGGREGATE_INTERVAL_S + 10);
+    }
 
-    sensor_ringbuffer_fast_data = ringbuffer_create(sizeof(fast_sensor_data_t), 10 * 60);
-    sensor_ringbuffer_slow_data = ringbuffer_create(sizeof(slow_sensor_data_t), 1 * 60);
+    sensor_ringbuffer_slow_data = ringbuffer_create(sizeof(slow_sensor_data_t), CONFIG_CATSCALE_UPLOAD_IDLE_POST_INTERVAL_S + 60);
 
     xTaskCreate(sensors_read_task, "sensors_read_task", 8 * 1024, NULL, tskIDLE_PRIORITY + 2, NULL);
+    xTaskCreate(sensors_environment_task, "sensors_env_task", 8 * 1024, NULL, tskIDLE_PRIORITY + 1, NULL);
     xTaskCreate(sensors_post_task, "sensors_post_task", 8 * 1024, NULL, tskIDLE_PRIORITY + 1, NULL);
 
     return ESP_OK;
 }
 
-static esp_err_t i2c_master_init()
+void sensors_get_buffer_stats(sensors_buffer_id_t id, ringbuffer_stats_t *stats)
 {
-    ESP_LOGI(TAG, "i2c master init ...");
-
-    // *** config ***
-    const i2c_port_t i2c_master_port = 0;
-    const uint32_t i2c_clock_speed = 100000; // max is 400kHz but ccs811 doesn't work above 100kHz for some reason :/
-    const int scl_io_num = GPIO_NUM_4;
-    const int sda_io_num = GPIO_NUM_5;
-    // *** config ***
-
-    const i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = sda_io_num,
-        .scl_io_num = scl_io_num,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = i2c_clock_speed,
-    };
+    assert(stats);
+    assert(id < SENSORS_BUFFER_COUNT);
+
+    if (id == SENSORS_BUFFER_SLOW)
+    {
+        assert(sensor_ringbuffer_slow_data);
+        ringbuffer_get_stats(sensor_ringbuffer_slow_data, stats);
+        return;
+    }
 
-    esp_err_t err = i2c_param_config(i2c_master_port, &conf);
-    if (err != ESP_OK) {
-        return err;
+    // The fast and aggregate buffers of all channels together.
+    memset(stats, 0, sizeof(ringbuffer_stats_t));
+    for (size_t i = 0; i < g_channel_count; i++)
+    {
+        ringbuffer_t * const ringbuffer = id == SENSORS_BUFFER_FAST ? g_channels[i].fast_data : g_channels[i].aggregate_data;
+        assert(ringbuffer);
+
+        ringbuffer_stats_t channel_stats = {};
+        ringbuffer_get_stats(ringbuffer, &channel_stats);
+        stats->capacity += channel_stats.capacity;
+        stats->count += channel_stats.count;
+        stats->count_high_water += channel_stats.count_high_water;
+        stats->overflows += channel_stats.overflows;
     }
+}
+
+void sensors_get_channel_stats(size_t channel, sensors_channel_stats_t *stats)
+{
+    assert(channel < SCALE_CHANNEL_MAX);
+    assert(stats);
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    *stats = g_channel_stats[channel];
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+}
+
+void sensors_get_upload_stats(sensors_upload_stats_t *stats)
+{
+    assert(stats);
 
-    return i2c_driver_install(i2c_master_port, conf.mode, 0, 0, 0);
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    *stats = g_upload_stats;
+    taskEXIT_CRITICAL(&g_stats_spinlock);
 }
 
-static uint64_t get_unix_timestamp_in_ns()
+static int64_t get_system_time_us(void)
 {
     struct timeval tv = {};
     gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 * 1000 + tv.tv_usec;
+}
+
+static uint32_t get_filter_checkpoint_checksum(const filter_checkpoint_t *checkpoint)
+{
+    // FNV-1a over everything after the checksum
+    const uint8_t *data = (const uint8_t *)&checkpoint->saved_at;
+    const size_t length = sizeof(filter_checkpoint_t) - offsetof(filter_checkpoint_t, saved_at);
+
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
 
-    uint64_t timestamp = ((tv.tv_sec * 1000 * 1000) + tv.tv_usec) * 1000;
+    return hash;
+}
 
-    return timestamp;
+static void save_filter_checkpoint(const channel_t *channel)
+{
+    filter_cascade_state_t state;
+    if (!filter_cascade_save_state(channel->cascade, &state))
+        return; // keep the last one
+
+    filter_checkpoint_t * const checkpoint = &g_filter_checkpoints[channel->index];
+    checkpoint->magic = 0;
+    checkpoint->saved_at = get_system_time_us();
+    memcpy(&checkpoint->state, &state, sizeof(filter_cascade_state_t));
+    checkpoint->checksum = get_filter_checkpoint_checksum(checkpoint);
+    checkpoint->magic = FILTER_CHECKPOINT_MAGIC;
 }
 
-static esp_err_t read_fast_data_from_sensors(fast_sensor_data_t *sensor_data, double dt)
+static void restore_filter_checkpoint(channel_t *channel)
+{
+    const filter_checkpoint_t * const checkpoint = &g_filter_checkpoints[channel->index];
+
+    if (checkpoint->magic != FILTER_CHECKPOINT_MAGIC ||
+        checkpoint->checksum != get_filter_checkpoint_checksum(checkpoint))
+    {
+        ESP_LOGI(TAG, "%s: no filter checkpoint, cold start", channel->config->scale_id);
+        return;
+    }
+
+    const int64_t age = get_system_time_us() - checkpoint->saved_at;
+    if (age < 0 || age > (int64_t)CONFIG_CATSCALE_FILTER_CHECKPOINT_MAX_AGE_S * 1000 * 1000)
+    {
+        ESP_LOGI(TAG, "%s: filter checkpoint too old (%lld ms), cold start", channel->config->scale_id, age / 1000);
+        return;
+    }
+
+    filter_cascade_restore_state(channel->cascade, &checkpoint->state);
+    ESP_LOGI(TAG, "%s: filter state restored from checkpoint (%lld ms old)", channel->config->scale_id, age / 1000);
+}
+
+// unix-time in ns, as expected by influx
+static uint64_t get_unix_timestamp_in_ns(int64_t timestamp)
+{
+    return (uint64_t)time_monotonic_to_unix_us(timestamp) * 1000;
+}
+
+static esp_err_t process_fast_data(channel_t *channel, uint32_t hx711_data, int64_t timestamp, double dt,
+    fast_sensor_data_t *sensor_data)
 {
     assert(sensor_data);
     memset(sensor_data, 0, sizeof(fast_sensor_data_t));
 
     // time
-    sensor_data->timestamp = get_unix_timestamp_in_ns();
+    sensor_data->timestamp = timestamp;
 
     // weight
-    uint32_t hx711_data = hx711_read_from_sensor();
     if (hx711_data == 0)
     {
-        ESP_LOGD(TAG, "failed to read data from hx711");
+        ESP_LOGD(TAG, "%s: invalid data from hx711", channel->config->scale_id);
         return ESP_FAIL;
     }
 
     sensor_data->weight_raw = (double)hx711_data;
-    sensor_data->weight = filter_cascade_process(sensor_data->weight_raw, dt);
+    sensor_data->weight = filter_cascade_process(channel->cascade, sensor_data->weight_raw, dt);
+
+    measurement_push_sample(channel->index, sensor_data->timestamp, sensor_data->weight_raw, sensor_data->weight);
 
     return ESP_OK;
 }
@@ -145,54 +324,283 @@ static esp_err_t read_slow_data_from_sensors(slow_sensor_data_t *sensor_data)
     memset(sensor_data, 0, sizeof(slow_sensor_data_t));
 
     // time
-    sensor_data->timestamp = get_unix_timestamp_in_ns();
+    sensor_data->timestamp = esp_timer_get_time();
 
-    // temperature, pressure, humidity
-    esp_err_t ret = bme280_user_read_from_sensor(&sensor_data->temperature, &sensor_data->pressure, &sensor_data->humidity);
+    // The bme280 converts while the ccs811 is read, only this task waits for the rest of the conversion.
+    uint32_t bme280_ready_in_ms = 0;
+    esp_err_t bme280_ret = bme280_user_start_measurement(&bme280_ready_in_ms);
+    TickType_t conversion_start = xTaskGetTickCount();
+
+    // co2, tvoc
+    esp_err_t ret = ccs811_get_latest_values(&sensor_data->co2, &sensor_data->tvoc);
     if (ret != ESP_OK)
+        ESP_LOGD(TAG, "failed to read data from ccs811");
+
+    // temperature, pressure, humidity
+    if (bme280_ret == ESP_OK)
+    {
+        if (bme280_ready_in_ms > 0)
+            vTaskDelayUntil(&conversion_start, bme280_ready_in_ms / portTICK_PERIOD_MS + 1);
+        bme280_ret = bme280_user_read_from_sensor(&sensor_data->temperature, &sensor_data->pressure, &sensor_data->humidity);
+    }
+    if (bme280_ret != ESP_OK)
     {
         ESP_LOGD(TAG, "failed to read data from bme280");
         return ESP_FAIL;
     }
 
-    // co2, tvoc
-    ret = ccs811_get_latest_values(&sensor_data->co2, &sensor_data->tvoc);
-    if (ret != ESP_OK)
+    return ret;
+}
+
+static void aggregate_add(upload_state_t *state, const fast_sensor_data_t *data)
+{
+    aggregate_sensor_data_t * const aggregate = &state->aggregate;
+
+    if (aggregate->count == 0)
     {
-        ESP_LOGD(TAG, "failed to read data from ccs811");
-        return ESP_FAIL;
+        aggregate->timestamp = data->timestamp;
+        aggregate->weight_min = data->weight;
+        aggregate->weight_max = data->weight;
+        state->weight_sum = 0.0;
+        state->weight_raw_sum = 0.0;
     }
 
-    return ESP_OK;
+    if (data->weight < aggregate->weight_min) aggregate->weight_min = data->weight;
+    if (data->weight > aggregate->weight_max) aggregate->weight_max = data->weight;
+    state->weight_sum += data->weight;
+    state->weight_raw_sum += data->weight_raw;
+    aggregate->count++;
+}
+
+static void aggregate_flush(channel_t *channel, int64_t now)
+{
+    upload_state_t * const state = &channel->upload_state;
+    aggregate_sensor_data_t * const aggregate = &state->aggregate;
+
+    if (aggregate->count > 0)
+    {
+        aggregate->weight_mean = state->weight_sum / aggregate->count;
+        aggregate->weight_raw_mean = state->weight_raw_sum / aggregate->count;
+        ringbuffer_push(channel->aggregate_data, aggregate);
+    }
+
+    memset(aggregate, 0, sizeof(aggregate_sensor_data_t));
+    state->aggregate_start_time = now;
+}
+
+static void handle_fast_data(channel_t *channel, const fast_sensor_data_t *data, bool valid, int64_t now)
+{
+    upload_state_t * const state = &channel->upload_state;
+
+    if (!UPLOAD_ADAPTIVE)
+    {
+        ringbuffer_push(channel->fast_data, data);
+        return;
+    }
+
+    if (measurement_is_event_active(channel->index))
+        state->capture_end_time = now + (int64_t)settings_get(SETTING_UPLOAD_POST_TRIGGER) * 1000 * 1000;
+
+    if (now < state->capture_end_time)
+    {
+        if (!state->capturing)
+        {
+            state->capturing = true;
+            aggregate_flush(channel, now);
+
+            // Upload the history so the waveform leading up to the event is not lost.
+            size_t history_count = 0;
+            fast_sensor_data_t history_data = {};
+            while (ringbuffer_try_pop(channel->fast_history, &history_data))
+            {
+                ringbuffer_push(channel->fast_data, &history_data);
+                history_count++;
+            }
+
+            ESP_LOGI(TAG, "%s: capture started with %u pre-trigger samples", channel->config->scale_id, history_count);
+        }
+
+        ringbuffer_push(channel->fast_data, data);
+        return;
+    }
+
+    if (state->capturing)
+    {
+        state->capturing = false;
+        state->aggregate_start_time = now;
+        ESP_LOGI(TAG, "%s: capture finished", channel->config->scale_id);
+    }
+
+    ringbuffer_push_overwrite(channel->fast_history, data);
+
+    if (valid)
+        aggregate_add(state, data);
+
+    if (now - state->aggregate_start_time >= (int64_t)settings_get(SETTING_UPLOAD_AGGREGATE_INTERVAL) * 1000 * 1000)
+        aggregate_flush(channel, now);
+}
+
+static void push_live_record(channel_t *channel, uint32_t hx711_data, const fast_sensor_data_t *fast_data, bool valid)
+{
+    filter_cascade_status_t status = {};
+    filter_cascade_get_status(channel->cascade, &status);
+
+    const live_record_t record = {
+        .channel = (uint8_t)channel->index,
+        .flags = (valid ? LIVE_RECORD_FLAG_VALID : 0) | (status.input_switch ? LIVE_RECORD_FLAG_INPUT_SWITCH : 0),
+        .sequence = channel->live_sequence++,
+        .timestamp = fast_data->timestamp,
+        .weight_raw = hx711_data,
+        .weight = (float)fast_data->weight,
+        .stable_time = (float)status.stable_time,
+        .hold_timer = (float)status.input_switch_timer,
+    };
+    live_stream_push(&record);
+}
+
+// read_us: share of the channel in the time it took to read the hx711.
+static void process_sample(channel_t *channel, uint32_t hx711_data, int64_t read_time, uint32_t read_us)
+{
+    const int64_t start_time = esp_timer_get_time();
+
+    // Every hx711 converts at the rate of its own oscillator, dt is the time since the last sample of the channel.
+    const int64_t interval_us = read_time - channel->last_read_time;
+    const double dt = (double)interval_us / 1e6;
+    channel->last_read_time = read_time;
+
+    fast_sensor_data_t fast_data = {};
+    const esp_err_t ret = process_fast_data(channel, hx711_data, read_time, dt, &fast_data);
+    handle_fast_data(channel, &fast_data, ret == ESP_OK, read_time);
+
+    if (live_stream_is_active())
+        push_live_record(channel, hx711_data, &fast_data, ret == ESP_OK);
+
+    if (ret == ESP_OK && first_sample_time == 0)
+    {
+        first_sample_time = read_time;
+        ESP_LOGI(TAG, "first sample %lld ms after boot", first_sample_time / 1000);
+    }
+
+    const uint32_t busy_us = read_us + (uint32_t)(esp_timer_get_time() - start_time);
+
+    taskENTER_CRITICAL(&g_stats_spinlock);
+    {
+        sensors_channel_stats_t * const stats = &g_channel_stats[channel->index];
+        stats->samples++;
+        if (ret != ESP_OK)
+            stats->failures++;
+        stats->last_interval_us = (uint32_t)interval_us;
+        if (stats->samples > 1 && stats->last_interval_us > stats->max_interval_us)
+            stats->max_interval_us = stats->last_interval_us;
+        stats->last_busy_us = busy_us;
+        if (busy_us > stats->max_busy_us)
+            stats->max_busy_us = busy_us;
+        stats->total_busy_us += busy_us;
+    }
+    taskEXIT_CRITICAL(&g_stats_spinlock);
+}
+
+// previous: stats at the last report, updated.
+static void log_channel_report(sensors_channel_stats_t *previous, int64_t elapsed_us)
+{
+    for (size_t i = 0; i < g_channel_count; i++)
+    {
+        sensors_channel_stats_t stats = {};
+        sensors_get_channel_stats(i, &stats);
+
+        const uint32_t samples = stats.samples - previous[i].samples;
+        const uint64_t busy_us = stats.total_busy_us - previous[i].total_busy_us;
+
+        ESP_LOGI(TAG, "%s: %0.1f Hz, busy avg=%"PRIu32"us max=%"PRIu32"us per sample, cpu=%"PRIu32"/1000, max interval=%"PRIu32"ms, failures=%"PRIu32,
+            g_channels[i].config->scale_id,
+            (double)samples * 1e6 / (double)elapsed_us,
+            samples > 0 ? (uint32_t)(busy_us / samples) : 0, stats.max_busy_us,
+            (uint32_t)(busy_us * 1000 / (uint64_t)elapsed_us),
+            stats.max_interval_us / 1000, stats.failures);
+
+        previous[i] = stats;
+    }
 }
 
 static void sensors_read_task(void *task_args)
 {
     ESP_LOGI(TAG, "sensors_read_task");
     
-    int64_t last_fast_read_time = esp_timer_get_time(); // µs since boot
-    int64_t last_slow_read_time = last_fast_read_time;
+    const int64_t start_time = esp_timer_get_time(); // µs since boot
 
-    while(true)
+    for (size_t i = 0; i < g_channel_count; i++)
     {
-        // Sampling rates:
-        // hx711:  1 / 100ms    (blocking)
-        // bme280: 1 / 62.5ms   (blocking)
-        // ccs811: 1 / 1s       (implementation does not block)
+        g_channels[i].last_read_time = start_time;
+        g_channels[i].upload_state = (upload_state_t){
+            .capturing = false,
+            .capture_end_time = 0,
+            .aggregate_start_time = start_time,
+        };
+    }
+
+    int64_t last_checkpoint_time = start_time;
+    int64_t last_report_time = start_time;
+    sensors_channel_stats_t report_stats[SCALE_CHANNEL_MAX] = {};
 
-        for(int i=0; i<10; i++)
+    while(true)
+    {
+        // Sampling rate:
+        // hx711:  1 / 100ms per channel, polled. A channel is processed as soon as its conversion is done,
+        //         channels on a shared clock line when all of them are done.
+        // The i2c sensors are read by sensors_environment_task, this task never waits for the i2c bus.
+        vTaskDelay(HX711_POLL_INTERVAL_MS / portTICK_PERIOD_MS);
+
+        uint32_t read_mask = 0;
+        for (size_t i = 0; i < g_channel_count; i++)
         {
-            vTaskDelay(80 / portTICK_PERIOD_MS);
+            if (read_mask & (1u << i))
+                continue; // already read together with a channel on the same clock line
+
+            uint32_t values[SCALE_CHANNEL_MAX] = {};
+            const int64_t read_time = esp_timer_get_time();
+            const uint32_t mask = hx711_read(i, values);
+            if (mask == 0)
+                continue;
+            read_mask |= mask;
+
+            const uint32_t read_us = (uint32_t)(esp_timer_get_time() - read_time) / __builtin_popcount(mask);
 
-            // Get time since last read and pass it down the filter-cascade.
-            const int64_t fast_read_time = esp_timer_get_time();
-            const double fast_read_dt = (double)(fast_read_time - last_fast_read_time) / 1e6;
-            last_fast_read_time = fast_read_time;
+            for (size_t j = 0; j < g_channel_count; j++)
+                if (mask & (1u << j))
+                    process_sample(&g_channels[j], values[j], read_time, read_us);
+        }
+
+        const int64_t now = esp_timer_get_time();
+
+        // Once per second, so a restart finds a recent state.
+        if (now - last_checkpoint_time >= 1000 * 1000)
+        {
+            last_checkpoint_time = now;
+            for (size_t i = 0; i < g_channel_count; i++)
+                save_filter_checkpoint(&g_channels[i]);
+        }
 
-            fast_sensor_data_t fast_data = {};
-            read_fast_data_from_sensors(&fast_data, fast_read_dt);
-            ringbuffer_push(sensor_ringbuffer_fast_data, &fast_data);
+        if (now - last_report_time >= (int64_t)CHANNEL_REPORT_INTERVAL_S * 1000 * 1000)
+        {
+            log_channel_report(report_stats, now - last_report_time);
+            last_report_time = now;
         }
+    }
+}
+
+static void sensors_environment_task(void *task_args)
+{
+    ESP_LOGI(TAG, "sensors_environment_task");
+
+    int64_t last_slow_read_time = esp_timer_get_time(); // µs since boot
+    TickType_t last_wake_time = xTaskGetTickCount();
+
+    while(true)
+    {
+        // Sampling rates:
+        // bme280: 1 / 1s       (forced mode, started before the ccs811 is read) or 1 / 62.5ms in normal mode
+        // ccs811: 1 / 1s       (results and baseline in one job, environment data is written asynchronously)
+        vTaskDelayUntil(&last_wake_time, ENVIRONMENT_READ_INTERVAL_MS / portTICK_PERIOD_MS);
 
         {
             const int64_t slow_read_time = esp_timer_get_time();
@@ -213,56 +621,82 @@ static void sensors_read_task(void *task_args)
     }
 }
 
-static size_t create_fast_sensor_data_line_protocol(char *message_buffer, size_t message_buffer_size)
+// oldest_time: lowered to the timestamp of the oldest sample appended.
+static size_t append_fast_sensor_data_line_protocol(const channel_t *channel, char *message_buffer, size_t message_buffer_size, size_t *message_buffer_offset,
+    int64_t *oldest_time)
 {
     assert(message_buffer);
     assert(message_buffer_size);
-    
-    memset(message_buffer, 0, message_buffer_size);
+    assert(message_buffer_offset);
 
-    size_t message_buffer_offset = 0;
     size_t data_count = 0;
 
     while(true)
     {
-        const size_t free_space = message_buffer_size - message_buffer_offset;
+        const size_t free_space = message_buffer_size - *message_buffer_offset;
         if (free_space < 256) {
-            ESP_LOGE(TAG, "http message buffer is full");
+            ESP_LOGW(TAG, "http message buffer is full");
             break;
         }
 
         fast_sensor_data_t data = {};
-        bool got_data = ringbuffer_try_pop(sensor_ringbuffer_fast_data, &data);
+        bool got_data = ringbuffer_try_pop(channel->fast_data, &data);
         if (!got_data) break;
 
-        char item_buffer[256] = {}; // TODO direkt in message buffer ?
-        size_t item_buffer_length = snprintf(item_buffer, sizeof(item_buffer),
-            "scales,scale_id=CAT1 weight_raw=%0.1f,weight=%0.1f %"PRIu64"\n",
-            data.weight_raw, data.weight, data.timestamp);
-        
-        strcpy(message_buffer + message_buffer_offset, item_buffer);
-        message_buffer_offset += item_buffer_length;
+        *message_buffer_offset += snprintf(message_buffer + *message_buffer_offset, free_space,
+            "scales,scale_id=%s weight_raw=%0.1f,weight=%0.1f %"PRIu64"\n",
+            channel->config->scale_id, data.weight_raw, data.weight, get_unix_timestamp_in_ns(data.timestamp));
         data_count++;
+
+        if (data.timestamp < *oldest_time)
+            *oldest_time = data.timestamp;
     }
 
     return data_count;
 }
 
-static size_t create_slow_sensor_data_line_protocol(char *message_buffer, size_t message_buffer_size)
+static size_t append_aggregate_sensor_data_line_protocol(const channel_t *channel, char *message_buffer, size_t message_buffer_size, size_t *message_buffer_offset)
 {
     assert(message_buffer);
     assert(message_buffer_size);
-    
-    memset(message_buffer, 0, message_buffer_size);
+    assert(message_buffer_offset);
 
-    size_t message_buffer_offset = 0;
     size_t data_count = 0;
 
     while(true)
     {
-        const size_t free_space = message_buffer_size - message_buffer_offset;
+        const size_t free_space = message_buffer_size - *message_buffer_offset;
         if (free_space < 256) {
-            ESP_LOGE(TAG, "http message buffer is full");
+            ESP_LOGW(TAG, "http message buffer is full");
+            break;
+        }
+
+        aggregate_sensor_data_t data = {};
+        bool got_data = ringbuffer_try_pop(channel->aggregate_data, &data);
+        if (!got_data) break;
+
+        *message_buffer_offset += snprintf(message_buffer + *message_buffer_offset, free_space,
+            "scales,scale_id=%s weight_raw_mean=%0.1f,weight_min=%0.1f,weight_max=%0.1f,weight_mean=%0.1f,samples=%"PRIu32"i %"PRIu64"\n",
+            channel->config->scale_id, data.weight_raw_mean, data.weight_min, data.weight_max, data.weight_mean, data.count, get_unix_timestamp_in_ns(data.timestamp));
+        data_count++;
+    }
+
+    return data_count;
+}
+
+static size_t append_slow_sensor_data_line_protocol(char *message_buffer, size_t message_buffer_size, size_t *message_buffer_offset)
+{
+    assert(message_buffer);
+    assert(message_buffer_size);
+    assert(message_buffer_offset);
+
+    size_t data_count = 0;
+
+    while(true)
+    {
+        const size_t free_space = message_buffer_size - *message_buffer_offset;
+        if (free_space < 256) {
+            ESP_LOGW(TAG, "http message buffer is full");
             break;
         }
 
@@ -270,19 +704,37 @@ static size_t create_slow_sensor_data_line_protocol(char *message_buffer, size_t
         bool got_data = ringbuffer_try_pop(sensor_ringbuffer_slow_data, &data);
         if (!got_data) break;
 
-        char item_buffer[256] = {}; // TODO direkt in message buffer ?
-        size_t item_buffer_length = snprintf(item_buffer, sizeof(item_buffer),
-            "scales,scale_id=CAT1 temperature=%0.3f,humidity=%0.3f,pressure=%0.3f,co2=%u,tvoc=%u %"PRIu64"\n",
-            data.temperature, data.humidity, data.pressure, data.co2, data.tvoc, data.timestamp);
-        
-        strcpy(message_buffer + message_buffer_offset, item_buffer);
-        message_buffer_offset += item_buffer_length;
+        *message_buffer_offset += snprintf(message_buffer + *message_buffer_offset, free_space,
+            "scales,scale_id=%s temperature=%0.3f,humidity=%0.3f,pressure=%0.3f,co2=%u,tvoc=%u %"PRIu64"\n",
+            scale_channel_device_scale_id(), data.temperature, data.humidity, data.pressure, data.co2, data.tvoc, get_unix_timestamp_in_ns(data.timestamp));
         data_count++;
     }
 
     return data_count;
 }
 
+// The radio duty cycle next to the upload latency, for choosing the upload intervals.
+static bool append_radio_line_protocol(char *message_buffer, size_t message_buffer_size, size_t *message_buffer_offset)
+{
+    const size_t free_space = message_buffer_size - *message_buffer_offset;
+    if (free_space < 256)
+        return false;
+
+    radio_stats_t radio = {};
+    radio_get_stats(&radio);
+    sensors_upload_stats_t upload = {};
+    sensors_get_upload_stats(&upload);
+
+    const uint64_t total_us = radio.awake_time_us + radio.sleep_time_us;
+    *message_buffer_offset += snprintf(message_buffer + *message_buffer_offset, free_space,
+        "scales,scale_id=%s radio_awake_permille=%"PRIu32"i,radio_current_ma=%"PRIu32"i,upload_latency_ms=%"PRIu32"i,post_interval_s=%0.0f,idle_post_interval_s=%0.0f %"PRIu64"\n",
+        scale_channel_device_scale_id(), total_us > 0 ? (uint32_t)(radio.awake_time_us * 1000 / total_us) : 0, radio.avg_current_ma, upload.last_latency_ms,
+        settings_get(SETTING_UPLOAD_POST_INTERVAL), settings_get(SETTING_UPLOAD_IDLE_POST_INTERVAL),
+        get_unix_timestamp_in_ns(esp_timer_get_time()));
+
+    return true;
+}
+
 static void sensors_post_task(void *task_args)
 {
     ESP_LOGI(TAG, "sensors_post_task");
@@ -291,25 +743,110 @@ static void sensors_post_task(void *task_args)
     char * const message_buffer = malloc(message_buffer_size);
     assert(message_buffer);
 
+    int64_t last_post_time = esp_timer_get_time(); // µs since boot
+    bool data_left = false;
+    bool boot_reported = false;
+    size_t first_channel = 0;
+
     while(true)
     {
-        vTaskDelay(10 * 1000 / portTICK_PERIOD_MS); // TODO wenn zuvor puffer voll war, nicht warten und direkt weiter
+        // Don't wait if the last message was full. The outbox replays share the window.
+        if (!data_left)
+            radio_wait_for_window();
 
-        const size_t fast_data_count = create_fast_sensor_data_line_protocol(message_buffer, message_buffer_size);
-        ESP_LOGI(TAG, "posting %u fast items (%u bytes) ...", fast_data_count, strlen(message_buffer));
-        if (fast_data_count) {
-            esp_err_t ret = http_post_sensor_data_influx(message_buffer);
-            if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "failed to post fast sensor data");
-            }
+        // Samples are buffered until their timestamps can be converted to unix-time.
+        if (!time_is_synchronized())
+        {
+            data_left = false;
+            continue;
+        }
+
+#if CONFIG_CATSCALE_MQTT
+        // Same while the broker is away, the outbox only holds what was published already.
+        if (!mqtt_upload_is_ready())
+        {
+            data_left = false;
+            continue;
+        }
+#endif
+
+        // Without raw samples there are only a few aggregates and slow values, keep the radio quiet for a while longer.
+        size_t fast_data_pending = 0;
+        for (size_t i = 0; i < g_channel_count; i++)
+            fast_data_pending += ringbuffer_count(g_channels[i].fast_data);
+
+        const int64_t now = esp_timer_get_time();
+        if (fast_data_pending == 0 &&
+            now - last_post_time < (int64_t)settings_get(SETTING_UPLOAD_IDLE_POST_INTERVAL) * 1000 * 1000)
+        {
+            data_left = false;
+            continue;
+        }
+        last_post_time = now;
+
+        // Everything goes into a single request, the data of all channels.
+        size_t message_buffer_offset = 0;
+        message_buffer[0] = '\0';
+
+        // When the buffer fills up, the channel which came first gets the most space. Rotate, so every channel gets its turn.
+        size_t fast_data_count = 0;
+        size_t aggregate_data_count = 0;
+        int64_t oldest_time = INT64_MAX;
+        for (size_t i = 0; i < g_channel_count; i++)
+        {
+            const channel_t * const channel = &g_channels[(first_channel + i) % g_channel_count];
+            fast_data_count += append_fast_sensor_data_line_protocol(channel, message_buffer, message_buffer_size, &message_buffer_offset,
+                &oldest_time);
+            aggregate_data_count += append_aggregate_sensor_data_line_protocol(channel, message_buffer, message_buffer_size, &message_buffer_offset);
+        }
+        first_channel = (first_channel + 1) % g_channel_count;
+
+        const size_t slow_data_count = append_slow_sensor_data_line_protocol(message_buffer, message_buffer_size, &message_buffer_offset);
+        uint32_t metrics_sequence = 0;
+        const bool metrics_appended = metrics_append_line_protocol(message_buffer, message_buffer_size, &message_buffer_offset,
+            &metrics_sequence);
+        append_radio_line_protocol(message_buffer, message_buffer_size, &message_buffer_offset);
+
+        if (!boot_reported && first_sample_time != 0 && message_buffer_size - message_buffer_offset >= 256)
+        {
+            message_buffer_offset += snprintf(message_buffer + message_buffer_offset, message_buffer_size - message_buffer_offset,
+                "scales,scale_id=%s boot_to_first_sample_ms=%lldi %"PRIu64"\n",
+                scale_channel_device_scale_id(), first_sample_time / 1000, get_unix_timestamp_in_ns(first_sample_time));
+            boot_reported = true;
         }
 
-        const size_t slow_data_count = create_slow_sensor_data_line_protocol(message_buffer, message_buffer_size);
-        ESP_LOGI(TAG, "posting %u slow items (%u bytes) ...", slow_data_count, strlen(message_buffer));
-        if (slow_data_count) {
+        data_left = message_buffer_size - message_buffer_offset < 256;
+
+        ESP_LOGI(TAG, "posting %u fast, %u aggregate, %u slow items%s (%u bytes) ...",
+            fast_data_count, aggregate_data_count, slow_data_count, metrics_appended ? ", metrics" : "", message_buffer_offset);
+
+        if (message_buffer_offset) {
+#if CONFIG_CATSCALE_MQTT
+            // Holds the radio itself until the messages are acknowledged.
+            esp_err_t ret = mqtt_upload_publish_lines(message_buffer, message_buffer_offset);
+#else
+            radio_acquire();
             esp_err_t ret = http_post_sensor_data_influx(message_buffer);
+            radio_release();
+#endif
             if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "failed to post slow sensor data");
+                ESP_LOGE(TAG, "failed to post sensor data");
+            }
+            else if (metrics_appended)
+            {
+                metrics_set_uploaded(metrics_sequence);
+            }
+
+            if (ret == ESP_OK && fast_data_count > 0)
+            {
+                const uint32_t latency_ms = (uint32_t)((esp_timer_get_time() - oldest_time) / 1000);
+
+                taskENTER_CRITICAL(&g_stats_spinlock);
+                g_upload_stats.uploads++;
+                g_upload_stats.last_latency_ms = latency_ms;
+                if (latency_ms > g_upload_stats.max_latency_ms)
+                    g_upload_stats.max_latency_ms = latency_ms;
+                taskEXIT_CRITICAL(&g_stats_spinlock);
             }
         }
     }
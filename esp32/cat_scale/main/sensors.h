@@ -1,6 +1,42 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
 #include <esp_err.h>
 
+#include "ringbuffer.h"
+
+// Buffers of the samples waiting for the upload to influx.
+typedef enum {
+    SENSORS_BUFFER_FAST,
+    SENSORS_BUFFER_AGGREGATE,
+    SENSORS_BUFFER_SLOW,
+    SENSORS_BUFFER_COUNT,
+} sensors_buffer_id_t;
+
+// Cpu time of a scale channel: reading the hx711 (shared with the channels on the same clock line),
+// the filter cascade and the buffering, per sample. At 10 Hz the budget of a channel is 100 ms per sample.
+typedef struct {
+    uint32_t samples;
+    uint32_t failures;              // invalid readings
+    uint32_t last_interval_us;      // between the last two samples
+    uint32_t max_interval_us;
+    uint32_t last_busy_us;
+    uint32_t max_busy_us;
+    uint64_t total_busy_us;
+} sensors_channel_stats_t;
+
+// Age of the oldest raw sample of an upload once it was handed over, the delay the upload interval adds.
+typedef struct {
+    uint32_t uploads;
+    uint32_t last_latency_ms;
+    uint32_t max_latency_ms;
+} sensors_upload_stats_t;
+
 esp_err_t sensors_init(void);
 
+// The fast and aggregate buffers are per channel, their stats are the sum of all channels.
+void sensors_get_buffer_stats(sensors_buffer_id_t id, ringbuffer_stats_t *stats);
+
+void sensors_get_channel_stats(size_t channel, sensors_channel_stats_t *stats);
+void sensors_get_upload_stats(sensors_upload_stats_t *stats);
@@ -0,0 +1,273 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "settings.h"
+
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <freertos/FreeRTOS.h>
+
+#include <esp_log.h>
+#include <nvs.h>
+
+static const char *TAG = "settings";
+
+#define SETTINGS_NAMESPACE          "settings"
+#define SETTINGS_KEY_LOG_LEVELS     "log_levels"
+
+static const setting_info_t g_infos[SETTING_COUNT] = {
+    [SETTING_DXDT_THRESHOLD]            = { "dxdt_threshold",   "g/s",  1.0,        1000.0,     50.0,       false },
+    [SETTING_STABLE_MIN_TIME]           = { "stable_min_time",  "s",    0.5,        60.0,       2.5,        false },
+    [SETTING_HOLD_TIMER]                = { "hold_timer",       "s",    1.0,        120.0,      10.0,       false },
+    [SETTING_HOLD_TIMEOUT]              = { "hold_timeout",     "s",    10.0,       3600.0,     300.0,      false },
+    [SETTING_HOLD_WEIGHT_LOW]           = { "hold_low",         "g",    -10000.0,   0.0,        -500.0,     false },
+    [SETTING_HOLD_WEIGHT_HIGH]          = { "hold_high",        "g",    0.0,        50000.0,    5000.0,     false },
+    [SETTING_SETTLE_TIME]               = { "settle_time",      "s",    0.0,        600.0,      30.0,       false },
+    [SETTING_CALIBRATION_FACTOR]        = { "calibration",      "g",    0.001,      1.0,        1.0 / 23.0, false },
+    // The ring buffers of the sensors are sized for the configured intervals, so aggregates can only become
+    // less frequent and idle posts more frequent.
+    [SETTING_UPLOAD_AGGREGATE_INTERVAL] = { "aggregate_s",      "s",    CONFIG_CATSCALE_UPLOAD_AGGREGATE_INTERVAL_S, 3600.0,
+                                                                        CONFIG_CATSCALE_UPLOAD_AGGREGATE_INTERVAL_S, true },
+    [SETTING_UPLOAD_IDLE_POST_INTERVAL] = { "idle_post_s",      "s",    0.0,        CONFIG_CATSCALE_UPLOAD_IDLE_POST_INTERVAL_S,
+                                                                        CONFIG_CATSCALE_UPLOAD_IDLE_POST_INTERVAL_S, true },
+    [SETTING_UPLOAD_POST_TRIGGER]       = { "post_trigger_s",   "s",    0.0,        600.0,      CONFIG_CATSCALE_UPLOAD_POST_TRIGGER_S, true },
+    // The fast ring buffer of a channel holds 60 s of raw samples, the rest of it is left for a slow upload.
+    [SETTING_UPLOAD_POST_INTERVAL]      = { "post_interval_s",  "s",    1.0,        50.0,       10.0,       true },
+    [SETTING_CALIBRATION_FACTOR_2]      = { "calibration_2",    "g",    0.001,      1.0,        1.0 / 23.0, false },
+    [SETTING_CALIBRATION_FACTOR_3]      = { "calibration_3",    "g",    0.001,      1.0,        1.0 / 23.0, false },
+    [SETTING_CALIBRATION_FACTOR_4]      = { "calibration_4",    "g",    0.001,      1.0,        1.0 / 23.0, false },
+};
+
+// Written by the rc task, read by the sensor tasks. A double is two words on the esp32, so it could be read
+// half written without the lock.
+static double g_values[SETTING_COUNT] = {};
+static portMUX_TYPE g_values_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static settings_log_level_t g_log_levels[SETTINGS_LOG_LEVEL_COUNT] = {};
+
+static bool is_valid(setting_id_t id, double value)
+{
+    const setting_info_t * const info = &g_infos[id];
+
+    if (!isfinite(value) || value < info->min || value > info->max)
+        return false;
+    if (info->integer && value != floor(value))
+        return false;
+    return true;
+}
+
+static void load_values(nvs_handle_t nvs)
+{
+    for (size_t i = 0; i < SETTING_COUNT; i++)
+    {
+        double value = 0.0;
+        size_t length = sizeof(value);
+        const esp_err_t ret = nvs_get_blob(nvs, g_infos[i].name, &value, &length);
+        if (ret == ESP_ERR_NVS_NOT_FOUND)
+            continue;
+
+        if (ret != ESP_OK || length != sizeof(value) || !is_valid(i, value))
+        {
+            ESP_LOGW(TAG, "ignoring stored value of '%s'", g_infos[i].name);
+            continue;
+        }
+
+        taskENTER_CRITICAL(&g_values_spinlock);
+        g_values[i] = value;
+        taskEXIT_CRITICAL(&g_values_spinlock);
+
+        ESP_LOGI(TAG, "%s = %g %s", g_infos[i].name, value, g_infos[i].unit);
+    }
+}
+
+static void load_log_levels(nvs_handle_t nvs)
+{
+    settings_log_level_t levels[SETTINGS_LOG_LEVEL_COUNT] = {};
+    size_t length = sizeof(levels);
+    const esp_err_t ret = nvs_get_blob(nvs, SETTINGS_KEY_LOG_LEVELS, levels, &length);
+    if (ret == ESP_ERR_NVS_NOT_FOUND)
+        return;
+
+    if (ret != ESP_OK || length != sizeof(levels))
+    {
+        ESP_LOGW(TAG, "ignoring stored log levels");
+        return;
+    }
+
+    for (size_t i = 0; i < SETTINGS_LOG_LEVEL_COUNT; i++)
+    {
+        levels[i].tag[SETTINGS_LOG_TAG_SIZE - 1] = '\0';
+        if (levels[i].tag[0] != '\0' && levels[i].level <= ESP_LOG_VERBOSE)
+            settings_set_log_level(levels[i].tag, levels[i].level);
+    }
+}
+
+esp_err_t settings_init(void)
+{
+    ESP_LOGI(TAG, "settings_init");
+
+    settings_reset();
+
+    nvs_handle_t nvs = 0;
+    const esp_err_t ret = nvs_open(SETTINGS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret == ESP_ERR_NVS_NOT_FOUND)
+        return ESP_OK; // nothing saved yet
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "nvs_open failed: %s, using defaults", esp_err_to_name(ret));
+        return ESP_OK;
+    }
+
+    load_values(nvs);
+    load_log_levels(nvs);
+
+    nvs_close(nvs);
+    return ESP_OK;
+}
+
+double settings_get(setting_id_t id)
+{
+    assert(id < SETTING_COUNT);
+
+    taskENTER_CRITICAL(&g_values_spinlock);
+    const double value = g_values[id];
+    taskEXIT_CRITICAL(&g_values_spinlock);
+
+    return value;
+}
+
+const setting_info_t *settings_get_info(setting_id_t id)
+{
+    assert(id < SETTING_COUNT);
+
+    return &g_infos[id];
+}
+
+bool settings_find(const char *name, setting_id_t *id)
+{
+    assert(name);
+    assert(id);
+
+    for (size_t i = 0; i < SETTING_COUNT; i++)
+    {
+        if (strcmp(g_infos[i].name, name) == 0)
+        {
+            *id = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t settings_set(setting_id_t id, double value)
+{
+    assert(id < SETTING_COUNT);
+
+    if (!is_valid(id, value))
+        return ESP_ERR_INVALID_ARG;
+
+    // Only the rc task writes, it can read without the lock.
+    if (g_values[id] != value)
+        ESP_LOGI(TAG, "%s: %g -> %g %s", g_infos[id].name, g_values[id], value, g_infos[id].unit);
+
+    taskENTER_CRITICAL(&g_values_spinlock);
+    g_values[id] = value;
+    taskEXIT_CRITICAL(&g_values_spinlock);
+
+    return ESP_OK;
+}
+
+esp_err_t settings_save(void)
+{
+    nvs_handle_t nvs = 0;
+    esp_err_t ret = nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "nvs_open failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Defaults are not stored, a device follows the defaults of a new firmware for everything that was not tuned.
+    for (size_t i = 0; i < SETTING_COUNT && ret == ESP_OK; i++)
+    {
+        if (g_values[i] == g_infos[i].default_value)
+        {
+            ret = nvs_erase_key(nvs, g_infos[i].name);
+            if (ret == ESP_ERR_NVS_NOT_FOUND)
+                ret = ESP_OK;
+        }
+        else
+        {
+            ret = nvs_set_blob(nvs, g_infos[i].name, &g_values[i], sizeof(double));
+        }
+    }
+
+    if (ret == ESP_OK)
+        ret = nvs_set_blob(nvs, SETTINGS_KEY_LOG_LEVELS, g_log_levels, sizeof(g_log_levels));
+    if (ret == ESP_OK)
+        ret = nvs_commit(nvs);
+
+    nvs_close(nvs);
+
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "failed to save settings: %s", esp_err_to_name(ret));
+    else
+        ESP_LOGI(TAG, "settings saved");
+
+    return ret;
+}
+
+void settings_reset(void)
+{
+    taskENTER_CRITICAL(&g_values_spinlock);
+    for (size_t i = 0; i < SETTING_COUNT; i++)
+        g_values[i] = g_infos[i].default_value;
+    taskEXIT_CRITICAL(&g_values_spinlock);
+
+    memset(g_log_levels, 0, sizeof(g_log_levels));
+}
+
+esp_err_t settings_set_log_level(const char *tag, esp_log_level_t level)
+{
+    assert(tag);
+
+    if (tag[0] == '\0' || strlen(tag) >= SETTINGS_LOG_TAG_SIZE || level > ESP_LOG_VERBOSE)
+        return ESP_ERR_INVALID_ARG;
+
+    settings_log_level_t *entry = NULL;
+    for (size_t i = 0; i < SETTINGS_LOG_LEVEL_COUNT && !entry; i++)
+    {
+        if (strcmp(g_log_levels[i].tag, tag) == 0)
+            entry = &g_log_levels[i];
+    }
+    for (size_t i = 0; i < SETTINGS_LOG_LEVEL_COUNT && !entry; i++)
+    {
+        if (g_log_levels[i].tag[0] == '\0')
+            entry = &g_log_levels[i];
+    }
+    if (!entry)
+        return ESP_ERR_NO_MEM;
+
+    strcpy(entry->tag, tag);
+    entry->level = (uint8_t)level;
+
+    esp_log_level_set(tag, level);
+    ESP_LOGI(TAG, "log level of '%s': %d", tag, level);
+
+    return ESP_OK;
+}
+
+size_t settings_get_log_levels(settings_log_level_t *levels, size_t count)
+{
+    assert(levels);
+
+    size_t copied = 0;
+    for (size_t i = 0; i < SETTINGS_LOG_LEVEL_COUNT && copied < count; i++)
+    {
+        if (g_log_levels[i].tag[0] != '\0')
+            levels[copied++] = g_log_levels[i];
+    }
+    return copied;
+}
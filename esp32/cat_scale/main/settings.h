@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+#include <esp_log.h>
+
+// Parameters which can be changed at runtime (rpc on the rc socket) and persisted in nvs.
+// The defaults come from Kconfig and the former constants of the filter cascade.
+// The ids are part of the rpc wire format: only append.
+typedef enum {
+    SETTING_DXDT_THRESHOLD,         // g/s, the signal is stable below
+    SETTING_STABLE_MIN_TIME,        // s, shorter stable phases are not reported
+    SETTING_HOLD_TIMER,             // s, the filters are held this long after the last trigger
+    SETTING_HOLD_TIMEOUT,           // s, an event ends after being stable this long
+    SETTING_HOLD_WEIGHT_LOW,        // g
+    SETTING_HOLD_WEIGHT_HIGH,       // g
+    SETTING_SETTLE_TIME,            // s, before the filter state is worth a checkpoint
+    SETTING_CALIBRATION_FACTOR,     // g per hx711 count
+    SETTING_UPLOAD_AGGREGATE_INTERVAL,
+    SETTING_UPLOAD_IDLE_POST_INTERVAL,
+    SETTING_UPLOAD_POST_TRIGGER,
+    SETTING_UPLOAD_POST_INTERVAL,
+    SETTING_CALIBRATION_FACTOR_2,   // g per hx711 count of the other channels, see scale_channel.h
+    SETTING_CALIBRATION_FACTOR_3,
+    SETTING_CALIBRATION_FACTOR_4,
+    SETTING_COUNT,
+} setting_id_t;
+
+typedef struct {
+    const char *name;       // also the nvs key, at most 15 characters
+    const char *unit;
+    double min;
+    double max;
+    double default_value;
+    bool integer;
+} setting_info_t;
+
+#define SETTINGS_LOG_LEVEL_COUNT    (8)
+#define SETTINGS_LOG_TAG_SIZE       (16)
+
+typedef struct {
+    char tag[SETTINGS_LOG_TAG_SIZE];    // "" = unused
+    uint8_t level;                      // esp_log_level_t
+} settings_log_level_t;
+
+// Loads the persisted values and applies the log levels, needs the initialized nvs flash.
+esp_err_t settings_init(void);
+
+// Cheap, called for every sample.
+double settings_get(setting_id_t id);
+const setting_info_t *settings_get_info(setting_id_t id);
+// Returns false if there is no setting with that name.
+bool settings_find(const char *name, setting_id_t *id);
+
+// Takes effect immediately but is lost on restart unless saved.
+// ESP_ERR_INVALID_ARG if the value is out of range (or not an integer for integer settings).
+esp_err_t settings_set(setting_id_t id, double value);
+// Persists all values and log levels.
+esp_err_t settings_save(void);
+// Back to the defaults and no log levels, persisted on the next save.
+// Log levels which were applied already stay in effect until the next restart.
+void settings_reset(void);
+
+// Applies the level (esp_log_level_set) and remembers it. "*" is allowed as tag.
+esp_err_t settings_set_log_level(const char *tag, esp_log_level_t level);
+// Returns the number of entries copied to levels.
+size_t settings_get_log_levels(settings_log_level_t *levels, size_t count);
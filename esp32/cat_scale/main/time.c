@@ -4,6 +4,9 @@
 
 #include <stdio.h>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_timer.h"
@@ -11,106 +14,107 @@
 
 static const char *TAG = "time";
 
-esp_err_t time_init_and_sync()
+// Corrections after the first sync are applied at this rate, fast enough to follow the drift of the crystal.
+#define TIME_SLEW_RATE_PPM          (500)
+// Larger corrections mean the clock was wrong and are applied at once.
+#define TIME_STEP_THRESHOLD_US      (60LL * 1000 * 1000)
+
+// unix time = esp_timer + offset, with the offset moving from slew_start_offset to target_offset.
+typedef struct {
+    bool synchronized;
+    int64_t slew_start_time;        // esp_timer
+    int64_t slew_start_offset;
+    int64_t target_offset;
+    uint32_t syncs;
+    uint32_t steps;
+    int64_t sntp_start_time;        // esp_timer
+} time_state_t;
+
+static time_state_t g_time = {};
+static portMUX_TYPE g_time_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t get_offset(int64_t monotonic_us)
 {
-    ESP_LOGI(TAG, "time_init");
-
-    sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    //sntp_setservername(0, "pool.ntp.org");
-    sntp_setservername(0, "fritz.box");
-    //sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
-    sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
-    sntp_set_sync_interval(15 * 1000);
-    sntp_init();
-
-    int64_t sntp_init_t0 = esp_timer_get_time();
+    const int64_t elapsed = monotonic_us - g_time.slew_start_time;
+    const int64_t max_change = elapsed > 0 ? elapsed * TIME_SLEW_RATE_PPM / 1000000 : 0;
+    const int64_t change = g_time.target_offset - g_time.slew_start_offset;
+
+    if (change > max_change)
+        return g_time.slew_start_offset + max_change;
+    if (change < -max_change)
+        return g_time.slew_start_offset - max_change;
+    return g_time.target_offset;
+}
 
-    while(true)
+// Called by the sntp after it set the system time.
+static void time_sync_notification(struct timeval *tv)
+{
+    const int64_t now = esp_timer_get_time();
+    const int64_t offset = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - now;
+
+    taskENTER_CRITICAL(&g_time_spinlock);
+    const int64_t current_offset = get_offset(now);
+    const int64_t correction = offset - current_offset;
+    const bool step = !g_time.synchronized || correction > TIME_STEP_THRESHOLD_US || correction < -TIME_STEP_THRESHOLD_US;
+
+    g_time.slew_start_time = now;
+    g_time.slew_start_offset = step ? offset : current_offset;
+    g_time.target_offset = offset;
+    g_time.synchronized = true;
+    g_time.syncs++;
+    if (step)
+        g_time.steps++;
+    taskEXIT_CRITICAL(&g_time_spinlock);
+
+    if (step)
+        ESP_LOGI(TAG, "sntp sync: clock set (correction %lld ms)", correction / 1000);
+    else
+        ESP_LOGD(TAG, "sntp sync: slewing by %lld us", correction);
+
+    if (g_time.syncs == 1)
     {
-        sntp_sync_status_t sync_status = sntp_get_sync_status();
-        if (sync_status == SNTP_SYNC_STATUS_COMPLETED)
-            break;
+        ESP_LOGI(TAG, "sntp init completed in %d ms", (int)((now - g_time.sntp_start_time) / 1000));
 
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+        char time_buffer[TIME_ISO8601_BUFFER_SIZE] = {};
+        time_format_iso8601(now + offset, time_buffer, sizeof(time_buffer));
+        ESP_LOGI(TAG, "Time: %s", time_buffer);
     }
-
-    int64_t sntp_init_t1 = esp_timer_get_time();
-    int64_t sntp_init_dt = sntp_init_t1 - sntp_init_t0;
-    int sntp_init_dt_ms = (int)(sntp_init_dt / 1000);
-
-    ESP_LOGI(TAG, "sntp init completed in %d ms", sntp_init_dt_ms);
-
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    char time_buffer[128] = {};
-    convert_timeval_to_iso8601(tv, time_buffer, sizeof(time_buffer));
-    ESP_LOGI(TAG, "Time: %s", time_buffer);
-
-    return ESP_OK;
 }
 
-#if 0
-void gettime_iso8601(char *output, size_t output_size)
+bool time_is_synchronized(void)
 {
-    struct timeval tv;
-    struct tm tm;
-    //char timestamp[] = "YYYY-MM-ddTHH:mm:ss.SSS+0000";
-
-    /* Get the current time at high precision; could also use clock_gettime() for
-    * even higher precision times if we want it. */
-    gettimeofday(&tv, NULL);
-
-    /* convert to time to 'struct tm' for use with strftime */
-    localtime_r(&tv.tv_sec, &tm);
-
-    /* format the time */
-    //strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S.000%z", &tm);
-    strftime(output, output_size, "%Y-%m-%dT%H:%M:%S.000%z", &tm);
-
-    /* but, since strftime() can't subsecond precision, we have to hack it
-    * in manually. '20' is the string offset of the subsecond value in our
-    * timestamp string. Also, because sprintf always writes a null, we have to 
-    * write the subsecond value as well as the rest of the string already there.
-    */
-    //sprintf(timestamp + 20, "%03ld%s", tv.tv_usec / 1000, timestamp + 23);
-    sprintf(output + 20, "%03ld", tv.tv_usec / 1000);
-
-    if (output_size > 25)
-    {
-        snprintf(output + 20, output_size - 20, "%03ld", tv.tv_usec / 1000);
-
-        output[23] = 'Z';
-        output[24] = 0;
-    }
+    return g_time.synchronized;
+}
 
-    // timestamp[23] = '+'; // Doesn't work for .net
-    // timestamp[24] = '0';
-    // timestamp[25] = '0';
-    // timestamp[26] = '0';
-    // timestamp[27] = '0';
-    // timestamp[28] = 0;
+int64_t time_monotonic_to_unix_us(int64_t monotonic_us)
+{
+    taskENTER_CRITICAL(&g_time_spinlock);
+    const int64_t offset = get_offset(monotonic_us);
+    taskEXIT_CRITICAL(&g_time_spinlock);
 
-    /* print the timestamp */
-    //printf("foofoofoo: '%s'\n", timestamp);
+    return monotonic_us + offset;
 }
-#endif
 
-void convert_timeval_to_iso8601(struct timeval tv, char *output, size_t output_size)
+int64_t time_get_unix_us(void)
 {
-    struct tm tm;
-
-    //localtime_r(&tv.tv_sec, &tm);
-    gmtime_r(&tv.tv_sec, &tm);
+    return time_monotonic_to_unix_us(esp_timer_get_time());
+}
 
-    strftime(output, output_size, "%Y-%m-%dT%H:%M:%S.000%z", &tm);
+esp_err_t time_init()
+{
+    ESP_LOGI(TAG, "time_init");
 
-    sprintf(output + 20, "%03ld", tv.tv_usec / 1000);
+    sntp_set_time_sync_notification_cb(time_sync_notification);
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    //sntp_setservername(0, "pool.ntp.org");
+    sntp_setservername(0, "fritz.box");
+    //sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
+    sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
+    sntp_set_sync_interval(15 * 1000);
 
-    if (output_size > 25)
-    {
-        snprintf(output + 20, output_size - 20, "%03ld", tv.tv_usec / 1000);
+    g_time.sntp_start_time = esp_timer_get_time();
+    sntp_init();
 
-        output[23] = 'Z';
-        output[24] = 0;
-    }
+    // Does not wait for the first sync, see time_is_synchronized.
+    return ESP_OK;
 }
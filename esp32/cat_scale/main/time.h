@@ -1,10 +1,25 @@
 #pragma once
 
+#include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include <sys/time.h>
 
 #include <esp_err.h>
 
-esp_err_t time_init_and_sync();
+// "2023-11-14T22:13:20.500Z" including the terminator
+#define TIME_ISO8601_BUFFER_SIZE    (25)
 
+// Starts the sntp in the background.
+esp_err_t time_init();
+
+// Wall clock derived from the monotonic esp_timer plus an offset which follows sntp.
+// Only the first sync steps the clock, later corrections are slewed so timestamps never go backwards.
+// Until the first sync the offset is 0, so store esp_timer timestamps and convert them when they are needed.
+bool time_is_synchronized(void);
+int64_t time_get_unix_us(void);
+int64_t time_monotonic_to_unix_us(int64_t monotonic_us);  // monotonic_us: esp_timer_get_time()
+
+// Always terminated, truncated if output_size is smaller than TIME_ISO8601_BUFFER_SIZE. Returns the length.
+size_t time_format_iso8601(int64_t unix_us, char *output, size_t output_size);
 void convert_timeval_to_iso8601(struct timeval tv, char *output, size_t output_size);
@@ -0,0 +1,100 @@
+#undef __linux__ // BUG: https://github.com/microsoft/vscode-cpptools/issues/9680
+
+#include "time.h"
+
+#include <string.h>
+
+// Split from time.c, this part does not depend on the sntp and is used by the host tests.
+
+#define US_PER_SECOND   (1000LL * 1000LL)
+#define SECONDS_PER_DAY (24LL * 60LL * 60LL)
+
+// The date only changes once a day, so the "YYYY-MM-DDT" prefix is cached (per task, as several tasks format timestamps).
+typedef struct {
+    bool valid;
+    int64_t day;
+    char prefix[11];
+} day_prefix_cache_t;
+
+static __thread day_prefix_cache_t g_day_prefix_cache = {};
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    return a / b - (a % b < 0 ? 1 : 0);
+}
+
+static void put_digits(char *output, uint32_t value, int digits)
+{
+    for (int i = digits - 1; i >= 0; i--) {
+        output[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+// Days since 1970-01-01 to the proleptic gregorian calendar, see http://howardhinnant.github.io/date_algorithms.html
+static void format_day_prefix(int64_t day, char *output)
+{
+    const int64_t z = day + 719468;
+    const int64_t era = floor_div(z, 146097);
+    const uint32_t doe = (uint32_t)(z - era * 146097);
+    const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const uint32_t mp = (5 * doy + 2) / 153;
+    const uint32_t d = doy - (153 * mp + 2) / 5 + 1;
+    const uint32_t m = mp < 10 ? mp + 3 : mp - 9;
+    const int64_t y = (int64_t)yoe + era * 400 + (m <= 2 ? 1 : 0);
+
+    put_digits(output, (uint32_t)(y < 0 ? 0 : y > 9999 ? 9999 : y), 4);
+    output[4] = '-';
+    put_digits(output + 5, m, 2);
+    output[7] = '-';
+    put_digits(output + 8, d, 2);
+    output[10] = 'T';
+}
+
+size_t time_format_iso8601(int64_t unix_us, char *output, size_t output_size)
+{
+    assert(output || output_size == 0);
+
+    if (output_size == 0)
+        return 0;
+
+    const int64_t unix_ms = floor_div(unix_us, 1000);
+    const int64_t unix_s = floor_div(unix_ms, 1000);
+    const int64_t day = floor_div(unix_s, SECONDS_PER_DAY);
+    const uint32_t second_of_day = (uint32_t)(unix_s - day * SECONDS_PER_DAY);
+    const uint32_t millisecond = (uint32_t)(unix_ms - unix_s * 1000);
+
+    day_prefix_cache_t * const cache = &g_day_prefix_cache;
+    if (!cache->valid || cache->day != day) {
+        format_day_prefix(day, cache->prefix);
+        cache->day = day;
+        cache->valid = true;
+    }
+
+    char buffer[TIME_ISO8601_BUFFER_SIZE];
+    memcpy(buffer, cache->prefix, sizeof(cache->prefix));
+    put_digits(buffer + 11, second_of_day / 3600, 2);
+    buffer[13] = ':';
+    put_digits(buffer + 14, second_of_day / 60 % 60, 2);
+    buffer[16] = ':';
+    put_digits(buffer + 17, second_of_day % 60, 2);
+    buffer[19] = '.';
+    put_digits(buffer + 20, millisecond, 3);
+    buffer[23] = 'Z';
+    buffer[24] = '\0';
+
+    size_t length = TIME_ISO8601_BUFFER_SIZE - 1;
+    if (length > output_size - 1)
+        length = output_size - 1;
+
+    memcpy(output, buffer, length);
+    output[length] = '\0';
+
+    return length;
+}
+
+void convert_timeval_to_iso8601(struct timeval tv, char *output, size_t output_size)
+{
+    time_format_iso8601((int64_t)tv.tv_sec * US_PER_SECOND + tv.tv_usec, output, output_size);
+}
@@ -5,6 +5,8 @@
 #include "sdkconfig.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -15,6 +17,8 @@
 #include <esp_event.h>
 #include <esp_log.h>
 #include <esp_netif.h>
+#include <esp_timer.h>
+#include <nvs.h>
 
 #include <lwip/err.h>
 #include <lwip/sys.h>
@@ -28,9 +32,248 @@ static EventGroupHandle_t s_wifi_event_group;
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
 
+#define WIFI_NVS_NAMESPACE              "wifi"
+#define WIFI_NVS_KEY_AP                 "ap"
+#define WIFI_RECONNECT_DELAY_MS         (500)       // before the second retry, doubles with every further one
+#define WIFI_RECONNECT_MAX_DELAY_MS     (30000)
+
 static const char *TAG = "wifi";
 
+// The ap of the last connection. A boot or reconnect tries it first, without scanning all channels.
+// The dhcp lease is kept by lwip (CONFIG_LWIP_DHCP_RESTORE_LAST_IP).
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+} wifi_ap_cache_t;
+
+// Only used by the event handler, which runs in the default event loop task.
+static esp_netif_t *s_netif = NULL;
+static esp_timer_handle_t s_reconnect_timer = NULL;
+static wifi_ap_cache_t s_ap_cache = {};
+static bool s_ap_cache_valid = false;
+static bool s_fast_connect = false;     // the current attempt uses the cached ap
+static bool s_has_ip = false;
 static int s_retry_num = 0;
+static int64_t s_outage_start = 0;      // µs since boot
+
+static portMUX_TYPE s_stats_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static wifi_stats_t s_stats = {};
+
+static bool load_ap_cache(wifi_ap_cache_t *cache)
+{
+    nvs_handle_t nvs = 0;
+    esp_err_t ret = nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret != ESP_OK)
+    {
+        // The namespace does not exist before the first connection.
+        if (ret != ESP_ERR_NVS_NOT_FOUND)
+            ESP_LOGE(TAG, "nvs_open failed: %s", esp_err_to_name(ret));
+        return false;
+    }
+
+    size_t length = sizeof(wifi_ap_cache_t);
+    ret = nvs_get_blob(nvs, WIFI_NVS_KEY_AP, cache, &length);
+    nvs_close(nvs);
+
+    return ret == ESP_OK && length == sizeof(wifi_ap_cache_t) && cache->channel != 0;
+}
+
+static esp_err_t save_ap_cache(const wifi_ap_cache_t *cache)
+{
+    nvs_handle_t nvs = 0;
+    esp_err_t ret = nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK)
+        return ret;
+
+    ret = nvs_set_blob(nvs, WIFI_NVS_KEY_AP, cache, sizeof(wifi_ap_cache_t));
+    if (ret == ESP_OK)
+        ret = nvs_commit(nvs);
+    nvs_close(nvs);
+
+    return ret;
+}
+
+// fast: connect to the cached ap, otherwise scan all channels for the strongest ap with the ssid.
+static void configure_sta(bool fast)
+{
+    wifi_config_t wifi_config = {
+        .sta = {
+            .ssid = CONFIG_CATSCALE_WIFI_SSID,
+            .password = CONFIG_CATSCALE_WIFI_PASSWORD,
+            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            // Beacons skipped in modem sleep, see radio.h.
+            .listen_interval = CONFIG_CATSCALE_WIFI_LISTEN_INTERVAL,
+        },
+    };
+
+    s_fast_connect = fast && s_ap_cache_valid;
+    if (s_fast_connect)
+    {
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, s_ap_cache.bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = s_ap_cache.channel;
+    }
+    else
+    {
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    }
+
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+}
+
+#if CONFIG_CATSCALE_WIFI_STATIC_IP
+// Applied on every connect, the netif raises IP_EVENT_STA_GOT_IP for it like for a dhcp lease.
+static void set_static_ip(void)
+{
+    const esp_err_t ret = esp_netif_dhcpc_stop(s_netif);
+    if (ret != ESP_OK && ret != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED)
+    {
+        ESP_LOGE(TAG, "failed to stop the dhcp client: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    esp_netif_ip_info_t ip_info = {};
+    ESP_ERROR_CHECK(esp_netif_str_to_ip4(CONFIG_CATSCALE_WIFI_STATIC_IP_ADDRESS, &ip_info.ip));
+    ESP_ERROR_CHECK(esp_netif_str_to_ip4(CONFIG_CATSCALE_WIFI_STATIC_IP_NETMASK, &ip_info.netmask));
+    ESP_ERROR_CHECK(esp_netif_str_to_ip4(CONFIG_CATSCALE_WIFI_STATIC_IP_GATEWAY, &ip_info.gw));
+    if (esp_netif_set_ip_info(s_netif, &ip_info) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "failed to set the static ip");
+        return;
+    }
+
+    esp_netif_dns_info_t dns = {};
+    ESP_ERROR_CHECK(esp_netif_str_to_ip4(CONFIG_CATSCALE_WIFI_STATIC_IP_DNS, &dns.ip.u_addr.ip4));
+    esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+}
+#endif
+
+static void reconnect_timer_callback(void*)
+{
+    esp_wifi_connect();
+}
+
+static void schedule_reconnect(void)
+{
+    s_retry_num++;
+
+    // The first retry right away, an ap that went away for a moment is back before the backoff would matter.
+    uint32_t delay_ms = 0;
+    if (s_retry_num > 1)
+    {
+        delay_ms = WIFI_RECONNECT_DELAY_MS;
+        for (int i = 2; i < s_retry_num && delay_ms < WIFI_RECONNECT_MAX_DELAY_MS; i++)
+            delay_ms *= 2;
+        if (delay_ms > WIFI_RECONNECT_MAX_DELAY_MS)
+            delay_ms = WIFI_RECONNECT_MAX_DELAY_MS;
+    }
+
+    ESP_LOGI(TAG, "retry %d to connect to the AP in %"PRIu32" ms", s_retry_num, delay_ms);
+
+    if (delay_ms == 0)
+        esp_wifi_connect();
+    else
+        esp_timer_start_once(s_reconnect_timer, (uint64_t)delay_ms * 1000);
+}
+
+static void handle_connected(const wifi_event_sta_connected_t *event)
+{
+    ESP_LOGI(TAG, "associated with bssid %02x:%02x:%02x:%02x:%02x:%02x channel %u%s",
+        event->bssid[0], event->bssid[1], event->bssid[2], event->bssid[3], event->bssid[4], event->bssid[5],
+        event->channel, s_fast_connect ? " (cached)" : "");
+
+    if (!s_ap_cache_valid || s_ap_cache.channel != event->channel ||
+        memcmp(s_ap_cache.bssid, event->bssid, sizeof(s_ap_cache.bssid)) != 0)
+    {
+        memcpy(s_ap_cache.bssid, event->bssid, sizeof(s_ap_cache.bssid));
+        s_ap_cache.channel = event->channel;
+        s_ap_cache_valid = true;
+
+        const esp_err_t ret = save_ap_cache(&s_ap_cache);
+        if (ret != ESP_OK)
+            ESP_LOGE(TAG, "failed to save the ap: %s", esp_err_to_name(ret));
+    }
+
+#if CONFIG_CATSCALE_WIFI_STATIC_IP
+    set_static_ip();
+#endif
+}
+
+static void handle_disconnected(void)
+{
+    const int64_t now = esp_timer_get_time();
+
+    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+
+    if (s_has_ip)
+    {
+        s_has_ip = false;
+        s_outage_start = now;
+
+        taskENTER_CRITICAL(&s_stats_spinlock);
+        s_stats.disconnects++;
+        taskEXIT_CRITICAL(&s_stats_spinlock);
+
+        ESP_LOGW(TAG, "lost the AP");
+
+        // Most likely the same ap comes back on the same channel.
+        s_retry_num = 0;
+        configure_sta(true);
+    }
+    else if (s_fast_connect)
+    {
+        taskENTER_CRITICAL(&s_stats_spinlock);
+        s_stats.fast_connect_failures++;
+        taskEXIT_CRITICAL(&s_stats_spinlock);
+
+        ESP_LOGW(TAG, "cached AP not found, scanning all channels");
+        configure_sta(false);
+        esp_wifi_connect();
+        return;
+    }
+
+    // Without an ip so far the boot gives up after a while (see wifi_wait_for_connection), later it keeps trying.
+    if (s_stats.boot_to_network_ms == 0 && s_retry_num >= CONFIG_CATSCALE_WIFI_MAXIMUM_RETRY)
+        xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+
+    schedule_reconnect();
+}
+
+static void handle_got_ip(const ip_event_got_ip_t *event)
+{
+    const int64_t now = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+
+    s_has_ip = true;
+    s_retry_num = 0;
+
+    taskENTER_CRITICAL(&s_stats_spinlock);
+    {
+        s_stats.connects++;
+        if (s_fast_connect)
+            s_stats.fast_connects++;
+        if (s_stats.boot_to_network_ms == 0)
+            s_stats.boot_to_network_ms = (uint32_t)(now / 1000);
+        if (s_outage_start != 0)
+        {
+            s_stats.last_outage_ms = (uint32_t)((now - s_outage_start) / 1000);
+            if (s_stats.last_outage_ms > s_stats.max_outage_ms)
+                s_stats.max_outage_ms = s_stats.last_outage_ms;
+        }
+    }
+    taskEXIT_CRITICAL(&s_stats_spinlock);
+
+    if (s_outage_start != 0)
+        ESP_LOGI(TAG, "network back after %"PRIu32" ms", s_stats.last_outage_ms);
+    else
+        ESP_LOGI(TAG, "network up %"PRIu32" ms after boot", s_stats.boot_to_network_ms);
+    s_outage_start = 0;
+
+    xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+}
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
 {
@@ -38,26 +281,17 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
     {
         esp_wifi_connect();
     }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
+    {
+        handle_connected(event_data);
+    }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
     {
-        if (s_retry_num < CONFIG_CATSCALE_WIFI_MAXIMUM_RETRY)
-        {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "retry to connect to the AP");
-        }
-        else
-        {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-        }
-        ESP_LOGI(TAG,"connect to the AP fail");
+        handle_disconnected();
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
     {
-        ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        handle_got_ip(event_data);
     }
 }
 
@@ -70,11 +304,17 @@ esp_err_t wifi_init_sta()
     ESP_ERROR_CHECK(esp_netif_init());
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    s_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
+    const esp_timer_create_args_t timer_args = {
+        .callback = reconnect_timer_callback,
+        .name = "wifi_reconnect",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_reconnect_timer));
+
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
@@ -88,17 +328,19 @@ esp_err_t wifi_init_sta()
                                                         NULL,
                                                         &instance_got_ip));
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = CONFIG_CATSCALE_WIFI_SSID,
-            .password = CONFIG_CATSCALE_WIFI_PASSWORD,
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-        },
-    };
+    s_ap_cache_valid = load_ap_cache(&s_ap_cache);
+    if (s_ap_cache_valid)
+        ESP_LOGI(TAG, "cached AP on channel %u", s_ap_cache.channel);
+
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    configure_sta(true);
     ESP_ERROR_CHECK(esp_wifi_start());
 
+    return ESP_OK;
+}
+
+esp_err_t wifi_wait_for_connection()
+{
     // Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
     // number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above)
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
@@ -132,4 +374,13 @@ void wifi_check_health()
     ESP_LOGI(TAG, "rssi=%d bssid=%x:%x:%x:%x:%x:%x ssid=%s",
         ap.rssi, ap.bssid[0], ap.bssid[1], ap.bssid[2],
         ap.bssid[3], ap.bssid[4], ap.bssid[5], ap.ssid);
-}
\ No newline at end of file
+}
+
+void wifi_get_stats(wifi_stats_t *stats)
+{
+    assert(stats);
+
+    taskENTER_CRITICAL(&s_stats_spinlock);
+    *stats = s_stats;
+    taskEXIT_CRITICAL(&s_stats_spinlock);
+}
@@ -1,7 +1,22 @@
 #pragma once
 
+#include <stdint.h>
 #include <esp_err.h>
 
+typedef struct {
+    uint32_t connects;              // got an ip
+    uint32_t disconnects;           // lost the ap after having an ip
+    uint32_t fast_connects;         // connected with the cached bssid and channel, without scanning
+    uint32_t fast_connect_failures; // cached ap not found, fell back to a full scan
+    uint32_t boot_to_network_ms;    // until the first ip, 0 before
+    uint32_t last_outage_ms;        // from losing the ap until the next ip
+    uint32_t max_outage_ms;
+} wifi_stats_t;
+
+// Starts connecting in the background. Reconnects on its own whenever the connection is lost.
 esp_err_t wifi_init_sta();
+// Blocks until connected (ESP_OK) or the maximum number of retries failed (ESP_FAIL).
+esp_err_t wifi_wait_for_connection();
 
 void wifi_check_health();
+void wifi_get_stats(wifi_stats_t *stats);